@@ -23,11 +23,14 @@ RMLIBSRCS=roadmap_log.c \
           roadmap_point.c \
           roadmap_line.c \
           roadmap_line_route.c \
+          roadmap_line_index.c \
           roadmap_line_speed.c \
           roadmap_shape.c \
+          roadmap_shape_simplify.c \
           roadmap_alert.c \
           roadmap_turns.c \
           roadmap_polygon.c \
+          roadmap_polygon_tess.c \
           roadmap_street.c \
           roadmap_plugin.c \
           roadmap_geocode.c \
@@ -39,6 +42,7 @@ RMLIBSRCS=roadmap_log.c \
           roadmap_http_comp.c \
           roadmap_io.c \
           roadmap_gps.c \
+          roadmap_gps_kalman.c \
           roadmap_state.c \
           roadmap_adjust.c \
           roadmap_lang.c \
@@ -61,6 +65,7 @@ RMLIBSRCS=roadmap_log.c \
 	  roadmap_tripserver.c \
           roadmap_jpeg.c \
           roadmap_gzm.c \
+          roadmap_gzm_import.c \
 	  roadmap_debug_info.c \
 	  roadmap_zlib.c \
           roadmap_map_download.c \
@@ -86,8 +91,10 @@ RMGUISRCS=roadmap_sprite.c \
           roadmap_layer.c \
           roadmap_fuzzy.c \
           roadmap_navigate.c \
+          roadmap_navigate_hmm.c \
           roadmap_pointer.c \
           roadmap_screen.c \
+          roadmap_performance.c \
           roadmap_view.c \
           roadmap_softkeys.c \
           roadmap_utf8.c \
@@ -151,6 +158,7 @@ endif
 RMPLUGINSRCS=roadmap_copy.c \
              roadmap_httpcopy.c \
              roadmap_alerter.c \
+             roadmap_alerter_index.c \
              editor/editor_main.c \
              editor/editor_plugin.c \
              editor/editor_screen.c \
@@ -212,6 +220,7 @@ RTSRCS=Realtime/Realtime.c \
        Realtime/RealtimeAlertCommentsList.c \
        Realtime/RealtimeNetDefs.c \
        Realtime/RealtimeNetRec.c \
+       Realtime/RealtimeNetPath.c \
        Realtime/RealtimeUsers.c \
        Realtime/RealtimeMath.c \
        Realtime/RealtimeDefs.c \
@@ -276,8 +285,8 @@ UNIX_SRCS=unix/roadmap_file.c \
 	      unix/roadmap_device_events.c \
 	      unix/roadmap_input_type.c \
 	      unix/roadmap_time.c \
-	      unix/roadmap_ssl.c
-#	      unix/resolver.c
+	      unix/roadmap_ssl.c \
+	      unix/resolver.c
 
 GLU_SRCS= $(OPENGL_DIR)/glu/libtess/dict.c \
 	$(OPENGL_DIR)/glu/libtess/geom.c \
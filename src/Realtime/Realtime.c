@@ -3966,6 +3966,11 @@ void OnDeviceEvent( device_event event, void* context)
    switch(event)
    {
       case device_event_network_connected:
+         // Keep using the cached addresses while they are refreshed
+         roadmap_net_refresh_hosts();
+         eNewStatus = CS_Connected;
+         break;
+
       case device_event_RS232_connection_established:
          eNewStatus = CS_Connected;
          break;
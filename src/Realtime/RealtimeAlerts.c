@@ -35,6 +35,7 @@
 #include "../roadmap_object.h"
 #include "../roadmap_types.h"
 #include "../roadmap_alerter.h"
+#include "../roadmap_alerter_index.h"
 #include "../roadmap_db_alert.h"
 #include "../roadmap_display.h"
 #include "../roadmap_time.h"
@@ -48,6 +49,7 @@
 #include "../roadmap_line_route.h"
 #include "../roadmap_line.h"
 #include "../roadmap_gps.h"
+#include "../roadmap_hash.h"
 #include "../roadmap_mood.h"
 #include "../roadmap_softkeys.h"
 #include "../roadmap_social.h"
@@ -100,6 +102,7 @@
 #endif //IPHONE
 
 static RTAlerts gAlertsTable;
+static RoadMapHash *gAlertsHash = NULL;
 static int gIterator;
 static int gIdleScrolling;
 static int gThumbsUpScrolling = FALSE;
@@ -432,6 +435,11 @@ void RTAlerts_Init()
     for (i=0; i<RT_MAXIMUM_ALERT_COUNT; i++)
         gAlertsTable.alert[i] = NULL;
 
+    if (gAlertsHash == NULL)
+        gAlertsHash = roadmap_hash_new ("RTAlerts", RT_MAXIMUM_ALERT_COUNT);
+    else
+        roadmap_hash_clean (gAlertsHash);
+
     gAlertsTable.iCount = 0;
     gAlertsTable.iGroupCount = 0;
     gAlertsTable.iArchiveCount = 0;
@@ -569,6 +577,43 @@ RTAlert * RTAlerts_Get(int record)
     return gAlertsTable.alert[record];
 }
 
+/**
+ * The position of an alert in the alerts table
+ * @param iID - The id of the alert
+ * @return the index of the alert, -1 if not found
+ */
+static int RTAlerts_Index_By_ID(int iID)
+{
+    int i;
+
+    if (gAlertsHash == NULL)
+        return -1;
+
+    // Other ids may share the hash list
+    for (i = roadmap_hash_get_first (gAlertsHash, iID);
+         i >= 0;
+         i = roadmap_hash_get_next (gAlertsHash, i))
+        if (gAlertsTable.alert[i]->iID == iID)
+            return i;
+
+    return -1;
+}
+
+/**
+ * Re-register all the alerts in the hash, after the table was reordered
+ * @param None
+ * @return None
+ */
+static void RTAlerts_Rebuild_Hash(void)
+{
+    int i;
+
+    roadmap_hash_clean (gAlertsHash);
+
+    for (i=0; i<gAlertsTable.iCount; i++)
+        roadmap_hash_add (gAlertsHash, gAlertsTable.alert[i]->iID, i);
+}
+
 /**
  * Retrieve an alert from table by alert ID
  * @param iID - The id of the alert to retrieve
@@ -576,16 +621,12 @@ RTAlert * RTAlerts_Get(int record)
  */
 RTAlert *RTAlerts_Get_By_ID(int iID)
 {
-    int i;
+    int i = RTAlerts_Index_By_ID(iID);
 
-    //   Find alert:
-    for (i=0; i< gAlertsTable.iCount; i++)
-        if (gAlertsTable.alert[i]->iID == iID)
-        {
-            return (gAlertsTable.alert[i]);
-        }
+    if (i < 0)
+        return NULL;
 
-    return NULL;
+    return (gAlertsTable.alert[i]);
 }
 
 /**
@@ -622,6 +663,9 @@ void RTAlerts_Clear_All()
         gAlertsTable.alert[i] = NULL;
     }
 
+    if (gAlertsHash != NULL)
+        roadmap_hash_clean (gAlertsHash);
+
     OnAlertRemove();
 
     gAlertsTable.iCount = 0;
@@ -902,6 +946,7 @@ BOOL RTAlerts_Add(RTAlert *pAlert)
    if (pAlert->bArchive)
       gAlertsTable.iArchiveCount++;
 
+    roadmap_hash_add (gAlertsHash, pAlert->iID, gAlertsTable.iCount);
     gAlertsTable.iCount++;
 
     OnAlertAdd(gAlertsTable.alert[gAlertsTable.iCount-1]);
@@ -1056,7 +1101,9 @@ void RTAlerts_Delete_All_Comments(RTAlert *pAlert)
  */
 BOOL RTAlerts_Remove(int iID)
 {
-    BOOL bFound= FALSE;
+    RTAlert *pAlert;
+    int i;
+    int last;
 
     //   Are we empty?
     if ( 0 == gAlertsTable.iCount){
@@ -1064,81 +1111,57 @@ BOOL RTAlerts_Remove(int iID)
        return TRUE;
     }
 
-    if (gAlertsTable.alert[gAlertsTable.iCount-1]->iID == iID)
-    {
-      DeleteAlertObject(gAlertsTable.alert[gAlertsTable.iCount-1]);
-        RTAlerts_Delete_All_Comments(gAlertsTable.alert[gAlertsTable.iCount-1]);
-        if (gAlertsTable.alert[gAlertsTable.iCount-1]->pAlertTitle)
-           free(gAlertsTable.alert[gAlertsTable.iCount-1]->pAlertTitle);
+    i = RTAlerts_Index_By_ID(iID);
+    if (i < 0){
+       roadmap_log( ROADMAP_DEBUG, "RemoveAlert() - Failed. ID %d not found", iID);
+       return TRUE;
+    }
 
-        if (gAlertsTable.alert[gAlertsTable.iCount-1]->pIconName)
-            free(gAlertsTable.alert[gAlertsTable.iCount-1]->pIconName);
+    pAlert = gAlertsTable.alert[i];
 
-        if (gAlertsTable.alert[gAlertsTable.iCount-1]->pMapIconName)
-            free(gAlertsTable.alert[gAlertsTable.iCount-1]->pMapIconName);
+    DeleteAlertObject(pAlert);
+    RTAlerts_Delete_All_Comments(pAlert);
 
-        if (gAlertsTable.alert[gAlertsTable.iCount-1]->pMapAddOnName)
-            free(gAlertsTable.alert[gAlertsTable.iCount-1]->pMapAddOnName);
+    if (pAlert->pAlertTitle)
+       free(pAlert->pAlertTitle);
 
-        if (gAlertsTable.alert[gAlertsTable.iCount-1]->pMenuAddOnName)
-            free(gAlertsTable.alert[gAlertsTable.iCount-1]->pMenuAddOnName);
+    if (pAlert->pIconName)
+        free(pAlert->pIconName);
 
-        if (gAlertsTable.alert[gAlertsTable.iCount-1]->iGroupRelevance != GROUP_RELEVANCE_NONE ){
-              gAlertsTable.iGroupCount--;
-        }
+    if (pAlert->pMapIconName)
+        free(pAlert->pMapIconName);
 
-       if (gAlertsTable.alert[gAlertsTable.iCount-1]->bArchive ){
-          gAlertsTable.iArchiveCount--;
-       }
+    if (pAlert->pMapAddOnName)
+        free(pAlert->pMapAddOnName);
 
-        free(gAlertsTable.alert[gAlertsTable.iCount-1]);
-        bFound = TRUE;
-    }
-    else
-    {
-        int i;
+    if (pAlert->pMenuAddOnName)
+        free(pAlert->pMenuAddOnName);
 
-        for (i=0; i<(gAlertsTable.iCount-1); i++)
-        {
-            if (bFound)
-                gAlertsTable.alert[i] = gAlertsTable.alert[i+1];
-            else
-            {
-                if (gAlertsTable.alert[i]->iID == iID)
-                {
-               DeleteAlertObject(gAlertsTable.alert[i]);
-                    RTAlerts_Delete_All_Comments(gAlertsTable.alert[i]);
+    if (pAlert->iGroupRelevance != GROUP_RELEVANCE_NONE )
+       gAlertsTable.iGroupCount--;
 
-                    if ((gAlertsTable.alert[i]->iGroupRelevance != GROUP_RELEVANCE_NONE ))
-                       gAlertsTable.iGroupCount--;
+    if (pAlert->bArchive )
+       gAlertsTable.iArchiveCount--;
 
-                   if (gAlertsTable.alert[i]->bArchive ){
-                      gAlertsTable.iArchiveCount--;
-                   }
+    if (gAlertsTable.iGroupCount == 0)
+       gGroupState = STATE_OLD;
 
-                    if (gAlertsTable.iGroupCount == 0)
-                       gGroupState = STATE_OLD;
+    free(pAlert);
 
-                    free(gAlertsTable.alert[i]);
-                    gAlertsTable.alert[i] = gAlertsTable.alert[i+1];
-                    bFound = TRUE;
-                }
-            }
-        }
-    }
+    // Move the last alert into the free slot
+    gAlertsTable.iCount--;
+    last = gAlertsTable.iCount;
 
-    if (bFound)
+    roadmap_hash_remove (gAlertsHash, iID, i);
+    if (i != last)
     {
-        gAlertsTable.iCount--;
-
-        gAlertsTable.alert[gAlertsTable.iCount] = NULL;
-
-        OnAlertRemove();
+        roadmap_hash_remove (gAlertsHash, gAlertsTable.alert[last]->iID, last);
+        gAlertsTable.alert[i] = gAlertsTable.alert[last];
+        roadmap_hash_add (gAlertsHash, gAlertsTable.alert[i]->iID, i);
     }
+    gAlertsTable.alert[last] = NULL;
 
-    if (!bFound){
-       roadmap_log( ROADMAP_DEBUG, "RemoveAlert() - Failed. ID %d not found", iID);
-    }
+    OnAlertRemove();
 
     return TRUE;
 }
@@ -2211,6 +2234,8 @@ static void CreateAlertObject(RTAlert *pAlert)
 static void OnAlertAdd(RTAlert *pAlert)
 {
 
+    roadmap_alerter_index_invalidate (&RoadmapRealTimeAlertProvider);
+
     if (pAlert->bPingWazer && Realtime_AllowPing() && (!pAlert->bArchive)){
        RTAlerts_popup_PingWazer(pAlert);
     }
@@ -2234,6 +2259,7 @@ static void OnAlertAdd(RTAlert *pAlert)
  */
 static void OnAlertRemove(void)
 {
+    roadmap_alerter_index_invalidate (&RoadmapRealTimeAlertProvider);
 }
 
 
@@ -2607,6 +2633,9 @@ void RTAlerts_Sort_List(alert_sort_method sort_method)
     	qsort((void *) &gAlertsTable.alert[0], gAlertsTable.iCount, sizeof(void *), compare_recency);
     else if (sort_method == sort_priority)
       qsort((void *) &gAlertsTable.alert[0], gAlertsTable.iCount, sizeof(void *), compare_priority);
+
+    RTAlerts_Rebuild_Hash();
+    roadmap_alerter_index_invalidate (&RoadmapRealTimeAlertProvider);
 #endif
 }
 
@@ -3505,7 +3534,7 @@ static void update_popup(SsdWidget popup, RTAlert *pAlert, int iCenterAround){
    ssd_widget_reset_cache(popup);
    ssd_widget_reset_position(popup);
    if (!roadmap_screen_refresh()){
-      roadmap_screen_redraw();
+      roadmap_screen_damage(NULL);
    }
 }
 
@@ -3592,7 +3621,7 @@ static void update_ping_wazer_popup(SsdWidget popup, RTAlert *pAlert){
    ssd_widget_reset_position(popup);
 
    if (!roadmap_screen_refresh()){
-      roadmap_screen_redraw();
+      roadmap_screen_damage(NULL);
    }
 }
 
@@ -4077,7 +4106,7 @@ static void RTAlerts_popup_alert(int alertId, int iCenterAround)
 
    ssd_dialog_activate("AlertPopUPDlg", NULL);
    if (!roadmap_screen_refresh()){
-      roadmap_screen_redraw();
+      roadmap_screen_damage(NULL);
    }
 
 }
@@ -4336,7 +4365,7 @@ static void RTAlerts_popup_PingWazer(RTAlert *pAlert)
 
     ssd_dialog_activate("PingWazerPopUPDlg", NULL);
     if (!roadmap_screen_refresh()){
-      roadmap_screen_redraw();
+      roadmap_screen_damage(NULL);
     }
 
 }
@@ -37,6 +37,7 @@
 #include "../roadmap_line.h"
 #include "../roadmap_line_route.h"
 #include "../roadmap_alerter.h"
+#include "../roadmap_alerter_index.h"
 #include "../roadmap_ticker.h"
 #include "../roadmap_res.h"
 #include "../roadmap_navigate.h"
@@ -277,6 +278,7 @@ void RealtimeBonus_RemoveFromTable (int iID) {
          for (j = i; j < MAX_ADD_ONS-1; j++) {
                gBonusTable.bonus[j] = gBonusTable.bonus[j+1];
          }
+         roadmap_alerter_index_invalidate (&RoadmapRealTimeMapbonusnsProvider);
          return;
       }
    }
@@ -855,6 +857,7 @@ BOOL RealtimeBonus_Add (RTBonus *pbonus) {
    gBonusTable.bonus[index]->collected = FALSE;
    RealtimeBonus_CreateGUIID (gBonusTable.bonus[index]);
    gBonusTable.iCount++;
+   roadmap_alerter_index_invalidate (&RoadmapRealTimeMapbonusnsProvider);
 
    if (gBonusTable.bonus[index]->bIsCustomeBonus){
       if (gBonusTable.bonus[index]->iNumPoints != 0)
@@ -1345,6 +1348,7 @@ void RealtimeBonus_Term (void) {
    }
 
    gBonusTable.iCount = 0;
+   roadmap_alerter_index_invalidate (&RoadmapRealTimeMapbonusnsProvider);
 
    // Delete all templates
    for (i = 0; i < MAX_BONUS_TEMPLATES; i++) {
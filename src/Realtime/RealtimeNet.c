@@ -203,47 +203,6 @@ static int wst_flags_for_commnand (const char* command) {
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
-#define  MEGA               (1000000)
-void convert_int_coordinate_to_float_string(char* buffer, int value)
-{
-   /* Buffer minimum size is COORDINATE_VALUE_STRING_MAXSIZE  */
-
-   int   precision_part;
-   int   integer_part;
-   BOOL  negative = FALSE;
-
-   if( !value)
-   {
-      strcpy( buffer, "0");
-      return;
-   }
-
-   if( value < 0)
-   {
-      negative = TRUE;
-      value   *= -1;
-   }
-
-   precision_part= value%MEGA;
-   integer_part  = value/MEGA;
-
-   if( negative)
-      sprintf( buffer, "-%d.%06d", integer_part, precision_part);
-   else
-      sprintf( buffer,  "%d.%06d", integer_part, precision_part);
-}
-
-
-void format_RoadMapPosition_string( char* buffer, const RoadMapPosition* position)
-{
-   char  float_string[COORDINATE_VALUE_STRING_MAXSIZE+1];
-
-   convert_int_coordinate_to_float_string( float_string, position->longitude);
-   sprintf( buffer, "%s,", float_string);
-   convert_int_coordinate_to_float_string( float_string, position->latitude);
-   strcat( buffer, float_string);
-}
-
 void format_RoadMapGpsPosition_string( char* buffer, const RoadMapGpsPosition* position)
 {
    /* Buffer minimum size is RoadMapGpsPosition_STRING_MAXSIZE */
@@ -456,6 +415,10 @@ static BOOL RTNet_LoadParams()
       //   Copy server v2 suffix
       strncpy_safe( gs_WebServiceV2Suffix, RT_GetWebServiceV2Suffix(), sizeof (gs_WebServiceV2Suffix));
 
+      //   Resolve the servers in the background, before the first connection:
+      roadmap_net_prefetch( gs_WebServiceAddress);
+      roadmap_net_prefetch( gs_WebServiceSecuredAddressResolved);
+
       gs_WebServiceParamsLoaded = TRUE;
    }
 
@@ -512,6 +475,9 @@ BOOL RTNet_Login( LPRTConnectionInfo   pCI,
    else
       pCI->UserNk[0] = '\0';
 
+   //   Until the response tells what this server accepts, send what all servers do:
+   pCI->iServerCapabilities = 0;
+
   // Perform WebService Transaction:
    if( wst_start_trans( gs_WST,
                         wst_flags,
@@ -612,7 +578,10 @@ BOOL RTNet_GuestLogin( LPRTConnectionInfo pCI, CB_OnWSTCompleted pfnOnCompleted)
       Additional task:
 
       Prefix packet with session-ID:
-         "UID,123,abc\r\n"...                                     */
+         "UID,123,abc\r\n"...
+
+      While the session is busy, queued requests with the same parsers are
+      merged into a single packet when they are sent (see wstq_coalesce()). */
 static BOOL wst_start_session_trans( const wst_parser_ptr parsers,       // Array of 1..n data parsers
                               int                  parsers_count, // Parsers count
                               int                  type,          // Type of request
@@ -661,6 +630,9 @@ static BOOL wst_start_session_trans( const wst_parser_ptr parsers,       // Arra
    wst_flags = wst_flags_for_commnand(command);
    free(command);
 
+   //Queued session commands may be sent together, under a single session-ID line.
+   wst_flags |= WEBSVC_FLAG_COALESCE;
+
    snprintf(Header,
             CUSTOM_HEADER_MAX_SIZE,
             "UID,%d,%s\r\n",
@@ -877,54 +849,6 @@ BOOL RTNet_CreateNewRoads( LPRTConnectionInfo   pCI,
 }
 
 
-void RTNet_GPSPath_BuildCommand( char*             Packet,
-                                 LPGPSPointInTime  points,
-                                 int               count,
-                                 BOOL					end_track)
-{
-   int      i;
-   char     temp[RTNET_GPSPATH_BUFFERSIZE_single_row+1];
-
-   if( (count >= 2) && (RTTRK_GPSPATH_MAX_POINTS >= count))
-   {
-	   sprintf( Packet, "GPSPath,%u,%u", (uint32_t)points->GPS_time, (3 * count));
-
-	   for( i=0; i<count; i++)
-	   {
-	      char  gps_point[RoadMapPosition_STRING_MAXSIZE+1];
-	      int   seconds_gap = 0;
-
-	      if( i)
-	         seconds_gap = (int)(points[i].GPS_time - points[i-1].GPS_time);
-
-	      assert( !GPSPOINTINTIME_IS_INVALID(points[i]));
-/*
-	      if (points[i].Position.longitude < 20000000 ||
-	      	 points[i].Position.longitude > 40000000 ||
-	      	 points[i].Position.latitude < 20000000 ||
-	      	 points[i].Position.latitude > 40000000 ||
-	      	 seconds_gap < 0 ||
-	      	 seconds_gap > 1000) {
-
-	      	roadmap_log (ROADMAP_ERROR, "Invalid GPS sequence: %d,%d,%d",
-	      					 points[i].Position.longitude,
-	      					 points[i].Position.latitude,
-	      					 seconds_gap);
-	      }
-*/
-	      format_RoadMapPosition_string( gps_point, &(points[i].Position));
-	      sprintf( temp, ",%s,%d,%d", gps_point, points[i].altitude, seconds_gap);
-	      strcat( Packet, temp);
-	   }
-	   strcat( Packet, "\n");
-   }
-
-   if (end_track)
-   {
-   	strcat( Packet, "GPSDisconnect\n");
-   }
-}
-
 BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
                      time_t               period_begin,
                      LPGPSPointInTime     points,
@@ -936,11 +860,14 @@ BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
    char*    GPSPathBuffer = NULL;
    int      iRangeBegin;
    BOOL     bRes;
+   BOOL     bCompact;
    int      i;
 
    if( count < 2)
       return FALSE;
 
+   bCompact = RTNET_SERVER_HAS_CAPABILITY( pCI, RTNET_SERVER_CAPABILITY_COMPACT_PATH);
+
    ebuffer_init( &Packet);
 
    if( RTTRK_GPSPATH_MAX_POINTS < count) {
@@ -967,7 +894,10 @@ BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
          roadmap_log(ROADMAP_DEBUG,
                      "RTNet_GPSPath(GPS-DISCONNECTION TAG) - Adding %d points to packet. Range offset: %d",
                      iPointsCount, iRangeBegin);
-         RTNet_GPSPath_BuildCommand( Buffer, FirstPoint, iPointsCount, TRUE);
+         if( bCompact)
+            RTNet_GPSPath_BuildCompactCommand( Buffer, FirstPoint, iPointsCount, TRUE);
+         else
+            RTNet_GPSPath_BuildCommand( Buffer, FirstPoint, iPointsCount, TRUE);
          iRangeBegin = i+1;
       }
    }
@@ -981,7 +911,10 @@ BOOL RTNet_GPSPath(  LPRTConnectionInfo   pCI,
       roadmap_log(ROADMAP_DEBUG,
                   "RTNet_GPSPath() - Adding range to packet. Range begin: %d; Range end: %d (count-1)",
                   iRangeBegin, (count - 1));
-      RTNet_GPSPath_BuildCommand( Buffer, FirstPoint, iPointsCount, FALSE);
+      if( bCompact)
+         RTNet_GPSPath_BuildCompactCommand( Buffer, FirstPoint, iPointsCount, FALSE);
+      else
+         RTNet_GPSPath_BuildCommand( Buffer, FirstPoint, iPointsCount, FALSE);
    }
 
    assert(*GPSPathBuffer);
@@ -1048,34 +981,41 @@ BOOL RTNet_NodePath( LPRTConnectionInfo   pCI,
    NodePathBuffer = ebuffer_alloc( &Packet, RTNET_GPSPATH_BUFFERSIZE__dynamic(count));
 
    memset( NodePathBuffer, 0, sizeof(NodePathBuffer));
-   sprintf( NodePathBuffer, "NodePath,%d,", (unsigned int)period_begin);//(period_end-period_begin));
-   sprintf( temp, "%d", 2 * count);
-   strcat( NodePathBuffer, temp);
 
-   for( i=0; i<count; i++)
+   if( RTNET_SERVER_HAS_CAPABILITY( pCI, RTNET_SERVER_CAPABILITY_COMPACT_PATH))
+      RTNet_NodePath_BuildCompactCommand( NodePathBuffer, period_begin, nodes, count,
+                                          bAddUserPoints? user_points: NULL);
+   else
    {
-      int   seconds_gap = 0;
-
-      if( i)
-         seconds_gap = (int)(nodes[i].GPS_time - nodes[i-1].GPS_time);
-
-      sprintf( temp, ",%d,%d", nodes[i].node, seconds_gap);
-      strcat( NodePathBuffer, temp);
-   }
-
-   if (bAddUserPoints) {
-      sprintf( temp, ",%d", EDITOR_POINT_TYPE_MUNCHING);
+      sprintf( NodePathBuffer, "NodePath,%d,", (unsigned int)period_begin);//(period_end-period_begin));
+      sprintf( temp, "%d", 2 * count);
       strcat( NodePathBuffer, temp);
 
       for( i=0; i<count; i++)
       {
-         int version_gap = user_points[i].version;
+         int   seconds_gap = 0;
 
          if( i)
-            version_gap = user_points[i].version - user_points[i-1].version;
+            seconds_gap = (int)(nodes[i].GPS_time - nodes[i-1].GPS_time);
+
+         sprintf( temp, ",%d,%d", nodes[i].node, seconds_gap);
+         strcat( NodePathBuffer, temp);
+      }
 
-         sprintf( temp, ",%d,%d", user_points[i].points, version_gap);
+      if (bAddUserPoints) {
+         sprintf( temp, ",%d", EDITOR_POINT_TYPE_MUNCHING);
          strcat( NodePathBuffer, temp);
+
+         for( i=0; i<count; i++)
+         {
+            int version_gap = user_points[i].version;
+
+            if( i)
+               version_gap = user_points[i].version - user_points[i-1].version;
+
+            sprintf( temp, ",%d,%d", user_points[i].points, version_gap);
+            strcat( NodePathBuffer, temp);
+         }
       }
    }
 
@@ -147,6 +147,29 @@ BOOL  RTNet_NodePath(     LPRTConnectionInfo   pCI,
                            CB_OnWSTCompleted pfnOnCompleted,
                            char*                packet_only);
 
+//   RealtimeNetPath.c
+void  convert_int_coordinate_to_float_string( char* buffer, int value);
+void  format_RoadMapPosition_string( char* buffer, const RoadMapPosition* position);
+
+void  RTNet_GPSPath_BuildCommand(
+                           char*                Packet,
+                           LPGPSPointInTime     points,
+                           int                  count,
+                           BOOL                 end_track);
+
+void  RTNet_GPSPath_BuildCompactCommand(
+                           char*                Packet,
+                           LPGPSPointInTime     points,
+                           int                  count,
+                           BOOL                 end_track);
+
+void  RTNet_NodePath_BuildCompactCommand(
+                           char*                Packet,
+                           time_t               period_begin,
+                           LPNodeInTime         nodes,
+                           int                  count,
+                           LPUserPointsVer      user_points);
+
 BOOL  RTNet_ExternalPoiDisplayed(     LPRTConnectionInfo   pCI,
                            CB_OnWSTCompleted pfnOnCompleted,
                            char*                packet_only);
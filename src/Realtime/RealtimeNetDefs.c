@@ -64,6 +64,7 @@ void RTConnectionInfo_ResetLogin( LPRTConnectionInfo this)
 /* 7*/memset( &(this->LastMapPosSent), 0, sizeof(RoadMapArea));
 /* 8*/RTUsers_Reset( &(this->Users));
 /* 9*/RTTrafficInfo_Reset();
+/*23*/this->iServerCapabilities = 0;
 
 
       RTConnectionInfo_ResetTransaction( this);
@@ -41,6 +41,12 @@
                MESSAGE_MAX_SIZE__AllTogether__dynamic(_GPSPointsCount_,_NodesPointsCount_)
 
 //efine  RTNET_HTTP_STATUS_STRING_MAXSIZE       (63)
+
+//   Server capabilities, from the login response (0 until it is read):
+#define  RTNET_SERVER_CAPABILITY_COMPACT_PATH   (0x00000001)   /* Server accepts 'GPSPathC' and 'NodePathC' */
+#define  RTNET_SERVER_HAS_CAPABILITY(_pCI_,_capability_)                      \
+               ((_pCI_)->bLoggedIn && ((_pCI_)->iServerCapabilities & (_capability_)))
+
 #define  RTTRK_GPSPATH_MAX_POINTS               (100)
 #define  RTTRK_NODEPATH_MAX_POINTS              (60)
 #define  RTTRK_CREATENEWROADS_MAX_TOGGLES       (40)
@@ -238,6 +244,7 @@ typedef struct tagRTConnectionInfo
 /*20*/   int                  iServerMaxProtocol;
 /*21*/   char                 serverVersion[MAX_SERVER_VERSION];
 /*22*/   int                  iInboxCount;
+/*23*/   int                  iServerCapabilities;
 }  RTConnectionInfo, *LPRTConnectionInfo;
 
 void RTConnectionInfo_Init             ( LPRTConnectionInfo this, PFN_ONUSER pfnOnAddUser, PFN_ONUSER pfnOnMoveUser, PFN_ONUSER pfnOnRemoveUser);
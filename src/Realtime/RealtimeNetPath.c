@@ -0,0 +1,226 @@
+/* RealtimeNetPath.c - Text of the GPS and node path commands.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2008 PazO
+ *
+ *   RoadMap is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License V2 as published by
+ *   the Free Software Foundation.
+ *
+ *   RoadMap is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with RoadMap; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The command builders of RealtimeNet.c that only format their input,
+ *   kept apart so they can be linked without the rest of Realtime
+ *   (see gtk2/roadmap_rtpath_test.c).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "RealtimeNet.h"
+#include "../editor/db/editor_point.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+#define  MEGA               (1000000)
+void convert_int_coordinate_to_float_string(char* buffer, int value)
+{
+   /* Buffer minimum size is COORDINATE_VALUE_STRING_MAXSIZE  */
+
+   int   precision_part;
+   int   integer_part;
+   BOOL  negative = FALSE;
+
+   if( !value)
+   {
+      strcpy( buffer, "0");
+      return;
+   }
+
+   if( value < 0)
+   {
+      negative = TRUE;
+      value   *= -1;
+   }
+
+   precision_part= value%MEGA;
+   integer_part  = value/MEGA;
+
+   if( negative)
+      sprintf( buffer, "-%d.%06d", integer_part, precision_part);
+   else
+      sprintf( buffer,  "%d.%06d", integer_part, precision_part);
+}
+
+
+void format_RoadMapPosition_string( char* buffer, const RoadMapPosition* position)
+{
+   char  float_string[COORDINATE_VALUE_STRING_MAXSIZE+1];
+
+   convert_int_coordinate_to_float_string( float_string, position->longitude);
+   sprintf( buffer, "%s,", float_string);
+   convert_int_coordinate_to_float_string( float_string, position->latitude);
+   strcat( buffer, float_string);
+}
+
+
+//   Compact path encoding:
+//   Each value is written as the zig-zag varint of its delta from the previous
+//   point, in 5-bit digits offset by 63 (as in the polyline encoding). All
+//   digits are in the printable range '?'..'~', so the command is still a
+//   single text line, without separators between the values.
+static char* RTNet_EncodeCompactValue( char* buffer, int value)
+{
+   unsigned int zigzag = ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+
+   while( zigzag >= 0x20)
+   {
+      *buffer++ = (char)((0x20 | (zigzag & 0x1f)) + 63);
+      zigzag  >>= 5;
+   }
+   *buffer++ = (char)(zigzag + 63);
+
+   return buffer;
+}
+
+//   GPSPathC,<time>,<count>,{<longitude>,<latitude>,<altitude>,<seconds gap>}*
+void RTNet_GPSPath_BuildCompactCommand( char*             Packet,
+                                        LPGPSPointInTime  points,
+                                        int               count,
+                                        BOOL              end_track)
+{
+   int   i;
+   char* next;
+
+   if( (count >= 2) && (RTTRK_GPSPATH_MAX_POINTS >= count))
+   {
+      next = Packet + sprintf( Packet, "GPSPathC,%u,%d,", (uint32_t)points->GPS_time, count);
+
+      for( i=0; i<count; i++)
+      {
+         assert( !GPSPOINTINTIME_IS_INVALID(points[i]));
+
+         if( i)
+         {
+            next = RTNet_EncodeCompactValue( next, points[i].Position.longitude - points[i-1].Position.longitude);
+            next = RTNet_EncodeCompactValue( next, points[i].Position.latitude  - points[i-1].Position.latitude);
+            next = RTNet_EncodeCompactValue( next, points[i].altitude           - points[i-1].altitude);
+            next = RTNet_EncodeCompactValue( next, (int)(points[i].GPS_time     - points[i-1].GPS_time));
+         }
+         else
+         {
+            next = RTNet_EncodeCompactValue( next, points[i].Position.longitude);
+            next = RTNet_EncodeCompactValue( next, points[i].Position.latitude);
+            next = RTNet_EncodeCompactValue( next, points[i].altitude);
+            next = RTNet_EncodeCompactValue( next, 0);
+         }
+      }
+
+      strcpy( next, "\n");
+   }
+
+   if (end_track)
+   {
+   	strcat( Packet, "GPSDisconnect\n");
+   }
+}
+
+void RTNet_GPSPath_BuildCommand( char*             Packet,
+                                 LPGPSPointInTime  points,
+                                 int               count,
+                                 BOOL					end_track)
+{
+   int      i;
+   char     temp[RTNET_GPSPATH_BUFFERSIZE_single_row+1];
+
+   if( (count >= 2) && (RTTRK_GPSPATH_MAX_POINTS >= count))
+   {
+	   sprintf( Packet, "GPSPath,%u,%u", (uint32_t)points->GPS_time, (3 * count));
+
+	   for( i=0; i<count; i++)
+	   {
+	      char  gps_point[RoadMapPosition_STRING_MAXSIZE+1];
+	      int   seconds_gap = 0;
+
+	      if( i)
+	         seconds_gap = (int)(points[i].GPS_time - points[i-1].GPS_time);
+
+	      assert( !GPSPOINTINTIME_IS_INVALID(points[i]));
+/*
+	      if (points[i].Position.longitude < 20000000 ||
+	      	 points[i].Position.longitude > 40000000 ||
+	      	 points[i].Position.latitude < 20000000 ||
+	      	 points[i].Position.latitude > 40000000 ||
+	      	 seconds_gap < 0 ||
+	      	 seconds_gap > 1000) {
+
+	      	roadmap_log (ROADMAP_ERROR, "Invalid GPS sequence: %d,%d,%d",
+	      					 points[i].Position.longitude,
+	      					 points[i].Position.latitude,
+	      					 seconds_gap);
+	      }
+*/
+	      format_RoadMapPosition_string( gps_point, &(points[i].Position));
+	      sprintf( temp, ",%s,%d,%d", gps_point, points[i].altitude, seconds_gap);
+	      strcat( Packet, temp);
+	   }
+	   strcat( Packet, "\n");
+   }
+
+   if (end_track)
+   {
+   	strcat( Packet, "GPSDisconnect\n");
+   }
+}
+
+
+//   NodePathC,<time>,<count>,{<node>,<seconds gap>}*[,<type>,{<points>,<version gap>}*]
+void RTNet_NodePath_BuildCompactCommand( char*             Packet,
+                                         time_t            period_begin,
+                                         LPNodeInTime      nodes,
+                                         int               count,
+                                         LPUserPointsVer   user_points)
+{
+   int   i;
+   char* next = Packet + sprintf( Packet, "NodePathC,%d,%d,", (unsigned int)period_begin, count);
+
+   for( i=0; i<count; i++)
+   {
+      if( i)
+      {
+         next = RTNet_EncodeCompactValue( next, nodes[i].node - nodes[i-1].node);
+         next = RTNet_EncodeCompactValue( next, (int)(nodes[i].GPS_time - nodes[i-1].GPS_time));
+      }
+      else
+      {
+         next = RTNet_EncodeCompactValue( next, nodes[i].node);
+         next = RTNet_EncodeCompactValue( next, 0);
+      }
+   }
+
+   if( user_points)
+   {
+      next += sprintf( next, ",%d,", EDITOR_POINT_TYPE_MUNCHING);
+
+      for( i=0; i<count; i++)
+      {
+         int version_gap = user_points[i].version;
+
+         if( i)
+            version_gap = user_points[i].version - user_points[i-1].version;
+
+         next = RTNet_EncodeCompactValue( next, user_points[i].points);
+         next = RTNet_EncodeCompactValue( next, version_gap);
+      }
+   }
+
+   *next = '\0';
+}
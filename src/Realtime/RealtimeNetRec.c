@@ -451,7 +451,7 @@ const char* OnLoginResponse(  /* IN  */   const char*       pNext,
                pCI->serverVersion,   // [out,opt]Output buffer
                &iBufferSize,        // [in,out] Buffer size / Size of extracted string
                ",\r\n",              // [in]     Array of chars to terminate the copy operation
-               TRIM_ALL_CHARS);     // [in]     Remove additional termination chars
+               DO_NOT_TRIM);        // [in]     Remove additional termination chars
    if( !pNext)
    {
       roadmap_log( ROADMAP_ERROR, "RTNet::OnLoginResponse(case 2) - Did not find server-version");
@@ -459,6 +459,31 @@ const char* OnLoginResponse(  /* IN  */   const char*       pNext,
       return NULL;   //   Quit the 'receive' loop
    }
 
+   //   Server capabilities - are optional (none if the server does not send them):
+   pCI->iServerCapabilities = 0;
+   if( ',' == (*pNext))
+   {
+      pNext++;   //   Jump over the comma (,)
+
+      pLast = pNext;
+      pNext = ReadIntFromString( pNext,            //   [in]      Source string
+                                 ",\r\n",           //   [in,opt]  Value termination
+                                 NULL,             //   [in,opt]  Allowed padding
+                                 &pCI->iServerCapabilities,  //   [out]     Put it here
+                                 TRIM_ALL_CHARS);  //   [in]      Remove additional termination chars
+      if( !pNext)
+      {
+         roadmap_log( ROADMAP_ERROR, "RTNet::OnLoginResponse() - Failed to read server capabilities (%s)", pLast);
+         (*rc) = err_parser_unexpected_data;
+         return NULL;   //   Quit the 'receive' loop
+      }
+   }
+   else
+      pNext = EatChars( pNext, ",\r\n", TRIM_ALL_CHARS);
+
+   roadmap_log( ROADMAP_DEBUG, "RTNet::OnLoginResponse() - Server protocol %d, capabilities 0x%x",
+               pCI->iServerMaxProtocol, pCI->iServerCapabilities);
+
    //   Done
    editor_points_set_old_points(pCI->iMyTotalPoints, pCI->iPointsTimeStamp);
 
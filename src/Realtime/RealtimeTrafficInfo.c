@@ -63,6 +63,8 @@
 
 static RTTrafficInfos gTrafficInfoTable;
 static RTTrafficLines gRTTrafficInfoLinesTable;
+static RoadMapHash *gTrafficInfoHash = NULL;       // info id -> record
+static RoadMapHash *gTrafficInfoLinesHash = NULL;  // info id -> its lines
 static RoadMapTileCallback 		TileCbNext = NULL;
 static RoadMapUnitChangeCallback sNextUnitChangeCb = NULL;
 
@@ -123,6 +125,11 @@ void RTTrafficInfo_Init()
 		gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i] = NULL;
 	}
 
+   if (gTrafficInfoHash == NULL) {
+      gTrafficInfoHash = roadmap_hash_new ("RTTrafficInfo", RT_TRAFFIC_INFO_MAXIMUM_TRAFFIC_INFO_COUNT);
+      gTrafficInfoLinesHash = roadmap_hash_new ("RTTrafficInfoLines", RT_TRAFFIC_INFO_MAX_LINES);
+   }
+
    TileCbNext = roadmap_tile_register_callback( RTTrafficInfo_TileReceivedCb );
 
    RealtimeTrafficInfoPluginInit();
@@ -185,6 +192,10 @@ void RTTrafficInfo_ClearAll()
    	gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i] = NULL;
    }
 
+   if (gTrafficInfoHash != NULL) {
+      roadmap_hash_clean (gTrafficInfoHash);
+      roadmap_hash_clean (gTrafficInfoLinesHash);
+   }
 }
 
 /**
@@ -206,21 +217,39 @@ int RTTrafficInfo_Count(void)
     return gTrafficInfoTable.iCount;
 }
 
+/**
+ * The position of a TrafficInfo record in the table
+ * @param iInfoID - the id of the traffic info
+ * @return the index of the record, -1 if not found
+ */
+static int RTTrafficInfo_IndexByID(int iInfoID){
+	 int i;
+
+    if (gTrafficInfoHash == NULL)
+       return -1;
+
+    // other ids may share the hash list
+    for (i = roadmap_hash_get_first (gTrafficInfoHash, iInfoID);
+         i >= 0;
+         i = roadmap_hash_get_next (gTrafficInfoHash, i))
+        if (gTrafficInfoTable.pTrafficInfo[i]->iID == iInfoID)
+            return i;
+
+    return -1;
+}
+
 /**
  * Retrieves a TrafficInfo record by its ID
  * @param iInfoID - the id of the traffic info
  * @return a pointer to the roud inf, NULL if not found
  */
 RTTrafficInfo *RTTrafficInfo_RecordByID(int iInfoID){
-	 int i;
+	 int i = RTTrafficInfo_IndexByID (iInfoID);
 
-    for (i=0; i< gTrafficInfoTable.iCount; i++)
-        if (gTrafficInfoTable.pTrafficInfo[i]->iID == iInfoID)
-        {
-            return (gTrafficInfoTable.pTrafficInfo[i]);
-        }
+    if (i < 0)
+       return NULL;
 
-    return NULL;
+    return (gTrafficInfoTable.pTrafficInfo[i]);
 }
 
 /**
@@ -342,6 +371,7 @@ BOOL RTTrafficInfo_AddSegments( int iTrafficInfoID, int iSquare, int iVersion, i
 		{
 			gRTTrafficInfoLinesTable.pRTTrafficInfoLines[index] = malloc( sizeof(RTTrafficInfoLines));
 		}
+		roadmap_hash_add (gTrafficInfoLinesHash, iTrafficInfoID, index);
 		pLine = gRTTrafficInfoLinesTable.pRTTrafficInfoLines[index];
 
 		pLine->iSquare = iSquare;
@@ -412,7 +442,8 @@ BOOL RTTrafficInfo_AddSegments( int iTrafficInfoID, int iSquare, int iVersion, i
  * @return TRUE operation was successful
  */
 static BOOL RTTraficInfo_DeleteSegments(int iTrafficInfoID){
-	 int i = 0;
+	 int i;
+	 int last;
 	 BOOL found = FALSE;
 	 RTTrafficInfoLines *tmp;
 
@@ -420,16 +451,32 @@ static BOOL RTTraficInfo_DeleteSegments(int iTrafficInfoID){
     if ( 0 == gRTTrafficInfoLinesTable.iCount)
         return FALSE;
 
-    while (i< gRTTrafficInfoLinesTable.iCount){
-    	if (gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iTrafficInfoId == iTrafficInfoID){
-    		gRTTrafficInfoLinesTable.iCount--;
+    i = roadmap_hash_get_first (gTrafficInfoLinesHash, iTrafficInfoID);
+    while (i >= 0){
+    	if (gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iTrafficInfoId != iTrafficInfoID){
+    		// another id in the same hash list
+    		i = roadmap_hash_get_next (gTrafficInfoLinesHash, i);
+    		continue;
+    	}
+
+    	// preserve the allocated space, and move the last line into the free slot
+    	gRTTrafficInfoLinesTable.iCount--;
+    	last = gRTTrafficInfoLinesTable.iCount;
+
+    	roadmap_hash_remove (gTrafficInfoLinesHash, iTrafficInfoID, i);
+    	if (i != last) {
+    		roadmap_hash_remove (gTrafficInfoLinesHash,
+    		                     gRTTrafficInfoLinesTable.pRTTrafficInfoLines[last]->iTrafficInfoId, last);
     		tmp = gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i];
-    		gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i] = gRTTrafficInfoLinesTable.pRTTrafficInfoLines[gRTTrafficInfoLinesTable.iCount];
-    		gRTTrafficInfoLinesTable.pRTTrafficInfoLines[gRTTrafficInfoLinesTable.iCount] = tmp;
-    		found = TRUE;
+    		gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i] = gRTTrafficInfoLinesTable.pRTTrafficInfoLines[last];
+    		gRTTrafficInfoLinesTable.pRTTrafficInfoLines[last] = tmp;
+    		roadmap_hash_add (gTrafficInfoLinesHash,
+    		                  gRTTrafficInfoLinesTable.pRTTrafficInfoLines[i]->iTrafficInfoId, i);
     	}
-    	else
-    		i++;
+    	found = TRUE;
+
+    	// the list changed, start over
+    	i = roadmap_hash_get_first (gTrafficInfoLinesHash, iTrafficInfoID);
     }
 
 	return found;
@@ -558,6 +605,7 @@ BOOL RTTrafficInfo_Add(RTTrafficInfo *pTrafficInfo)
     		sprintf(gTrafficInfoTable.pTrafficInfo[gTrafficInfoTable.iCount]->sDescription,roadmap_lang_get("%s between %s and %s"), gTrafficInfoTable.pTrafficInfo[gTrafficInfoTable.iCount]->sStreet, gTrafficInfoTable.pTrafficInfo[gTrafficInfoTable.iCount]->sStart, gTrafficInfoTable.pTrafficInfo[gTrafficInfoTable.iCount]->sEnd );
     }
 
+    roadmap_hash_add (gTrafficInfoHash, pTrafficInfo->iID, gTrafficInfoTable.iCount);
     gTrafficInfoTable.iCount++;
 
     if (pTrafficInfo->iUserContribution != 0){
@@ -574,29 +622,31 @@ BOOL RTTrafficInfo_Add(RTTrafficInfo *pTrafficInfo)
  */
 BOOL RTTrafficInfo_Remove(int iID)
 {
-   int i;
+   int i = RTTrafficInfo_IndexByID (iID);
+   int last;
    RTTrafficInfo *tmp;
 
-	for (i = 0; i < gTrafficInfoTable.iCount; i++)
-	{
-		if (gTrafficInfoTable.pTrafficInfo[i]->iID != iID) continue;
+   if (i < 0) return FALSE;
 
-      gTrafficInfoTable.iCount--;
+   gTrafficInfoTable.iCount--;
+   last = gTrafficInfoTable.iCount;
 
-      // preserve the allocated space for later use
-		tmp = gTrafficInfoTable.pTrafficInfo[i];
-		gTrafficInfoTable.pTrafficInfo[i] = gTrafficInfoTable.pTrafficInfo[gTrafficInfoTable.iCount];
-		gTrafficInfoTable.pTrafficInfo[gTrafficInfoTable.iCount] = tmp;
+   // preserve the allocated space for later use
+   roadmap_hash_remove (gTrafficInfoHash, iID, i);
+   if (i != last) {
+      roadmap_hash_remove (gTrafficInfoHash, gTrafficInfoTable.pTrafficInfo[last]->iID, last);
+      tmp = gTrafficInfoTable.pTrafficInfo[i];
+      gTrafficInfoTable.pTrafficInfo[i] = gTrafficInfoTable.pTrafficInfo[last];
+      gTrafficInfoTable.pTrafficInfo[last] = tmp;
+      roadmap_hash_add (gTrafficInfoHash, gTrafficInfoTable.pTrafficInfo[i]->iID, i);
+   }
 
 #ifndef J2ME
-      RTTraficInfo_DeleteSegments(iID);
+   RTTraficInfo_DeleteSegments(iID);
 #endif
-      RTTrafficInfo_DeleteAlert (iID);
+   RTTrafficInfo_DeleteAlert (iID);
 
-      return TRUE;
-	}
-
-	return FALSE;
+   return TRUE;
 }
 
 
@@ -128,6 +128,11 @@ void RTUsers_Init(LPRTUsers   this,
    for( i=0; i<RL_MAXIMUM_USERS_COUNT; i++)
       RTUserLocation_Init( &(this->Users[i]));
 
+   if( !this->pHash)
+      this->pHash = roadmap_hash_new( "RTUsers", RL_MAXIMUM_USERS_COUNT);
+   else
+      roadmap_hash_clean( this->pHash);
+
    this->iCount      = 0;
    gs_pfnOnAddUser   = pfnOnAddUser;
    gs_pfnOnMoveUser  = pfnOnMoveUser;
@@ -141,12 +146,22 @@ void RTUsers_Reset(LPRTUsers   this)
    for( i=0; i<RL_MAXIMUM_USERS_COUNT; i++)
       RTUserLocation_Init( &(this->Users[i]));
 
+   if( this->pHash)
+      roadmap_hash_clean( this->pHash);
+
    this->iCount = 0;
 }
 
 void RTUsers_Term( LPRTUsers this)
 {
    RTUsers_ClearAll( this);
+
+   if( this->pHash)
+   {
+      roadmap_hash_free( this->pHash);
+      this->pHash = NULL;
+   }
+
    gs_pfnOnAddUser     = NULL;
    gs_pfnOnMoveUser    = NULL;
    gs_pfnOnRemoveUser  = NULL;
@@ -187,12 +202,30 @@ BOOL RTUsers_Add( LPRTUsers this, LPRTUserLocation pUser)
    }
    this->Users[this->iCount]   = (*pUser);
    this->Users[this->iCount].bWasUpdated= TRUE;
+   roadmap_hash_add( this->pHash, pUser->iID, this->iCount);
    this->iCount++;
    gs_pfnOnAddUser( pUser);
 
    return TRUE;
 }
 
+static int RTUsers_IndexByID( LPRTUsers this, int iUserID)
+{
+   int i;
+
+   if( !this->pHash)
+      return -1;
+
+   //   Find user (other IDs may share the hash list):
+   for( i = roadmap_hash_get_first( this->pHash, iUserID);
+        i >= 0;
+        i = roadmap_hash_get_next( this->pHash, i))
+      if( this->Users[i].iID == iUserID)
+         return i;
+
+   return -1;
+}
+
 BOOL RTUsers_Update( LPRTUsers this, LPRTUserLocation pUser)
 {
    LPRTUserLocation pUI = RTUsers_UserByID( this, pUser->iID);
@@ -225,7 +258,7 @@ BOOL RTUsers_UpdateOrAdd( LPRTUsers this, LPRTUserLocation pUser)
 
 BOOL  RTUsers_RemoveByIndex( LPRTUsers this, int iIndex)
 {
-   int i;
+   int iLast;
 
    assert(gs_pfnOnRemoveUser);
 
@@ -235,8 +268,15 @@ BOOL  RTUsers_RemoveByIndex( LPRTUsers this, int iIndex)
 
    gs_pfnOnRemoveUser( &(this->Users[iIndex]));
 
-   for( i=iIndex; i<(this->iCount-1); i++)
-      this->Users[i] = this->Users[i+1];
+   //   Move the last user into the free slot:
+   iLast = this->iCount - 1;
+   roadmap_hash_remove( this->pHash, this->Users[iIndex].iID, iIndex);
+   if( iIndex != iLast)
+   {
+      roadmap_hash_remove( this->pHash, this->Users[iLast].iID, iLast);
+      this->Users[iIndex] = this->Users[iLast];
+      roadmap_hash_add( this->pHash, this->Users[iIndex].iID, iIndex);
+   }
 
    this->iCount--;
    RTUserLocation_Init( &(this->Users[this->iCount]));
@@ -246,20 +286,12 @@ BOOL  RTUsers_RemoveByIndex( LPRTUsers this, int iIndex)
 
 BOOL RTUsers_RemoveByID( LPRTUsers this, int iUserID)
 {
-   int   i;
+   int   i = RTUsers_IndexByID( this, iUserID);
 
-   //   Are we empty?
-   if( 0 == this->iCount)
+   if( i < 0)
       return FALSE;
 
-   for( i=0; i<this->iCount; i++)
-      if( this->Users[i].iID == iUserID)
-      {
-         RTUsers_RemoveByIndex( this, i);
-         return TRUE;
-      }
-
-   return FALSE;
+   return RTUsers_RemoveByIndex( this, i);
 }
 
 BOOL RTUsers_Exists( LPRTUsers this, int iUserID)
@@ -285,6 +317,9 @@ void RTUsers_ClearAll( LPRTUsers this)
       RTUserLocation_Init( pUI);
    }
 
+   if( this->pHash)
+      roadmap_hash_clean( this->pHash);
+
    this->iCount = 0;
 
 }
@@ -335,14 +370,12 @@ LPRTUserLocation RTUsers_User( LPRTUsers this, int iIndex)
 
 LPRTUserLocation RTUsers_UserByID( LPRTUsers this, int iUserID)
 {
-   int i;
+   int i = RTUsers_IndexByID( this, iUserID);
 
-   //   Find user:
-   for( i=0; i<this->iCount; i++)
-      if( this->Users[i].iID == iUserID)
-         return &(this->Users[i]);
+   if( i < 0)
+      return NULL;
 
-   return NULL;
+   return &(this->Users[i]);
 }
 
 
@@ -22,6 +22,8 @@
 #define	__FREEMAP_REALTIMEUSERS_H__
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
+#include "roadmap_hash.h"
+
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 #define  RT_USERNM_MAXSIZE             (63)
@@ -87,6 +89,7 @@ typedef struct tagRTUsers
 {
    RTUserLocation Users[RL_MAXIMUM_USERS_COUNT];
    int            iCount;
+   RoadMapHash*   pHash;                        // User ID -> index in Users
 
 }  RTUsers, *LPRTUsers;
 
@@ -56,6 +56,10 @@
 #include <fribidi.h>
 #endif
 
+#ifdef AGG_SAVE_PNG
+#include <png.h>
+#endif
+
 extern "C" {
 #include "../roadmap.h"
 #include "../roadmap_types.h"
@@ -67,6 +71,7 @@ extern "C" {
 #include "../roadmap_config.h"
 #include "../roadmap_path.h"
 #include "../roadmap_file.h"
+#include "../roadmap_performance.h"
 }
 #include "../roadmap_canvas_agg.h"
 
@@ -139,6 +144,239 @@ static RoadMapPen CurrentPen;
 static int        RoadMapCanvasFontLoaded = 0;
 static int        RoadMapCanvasNormalFontLoaded = 0;
 
+#ifdef AGG_RASTER_THREADS
+/* Map lines are not rasterized when drawn: they are queued, and the queue
+ * is rasterized by a pool of threads, each thread owning one horizontal
+ * band of the frame buffer. The bands never overlap and each band replays
+ * the lines in their original order, so the result is the same as drawing
+ * on the main thread. Every other drawing primitive flushes the queue first
+ * to preserve the drawing order.
+ */
+#include <pthread.h>
+#include <unistd.h>
+
+#define RASTER_MAX_BANDS      8
+#define RASTER_MIN_BAND_ROWS  64
+#define RASTER_MIN_POINTS     1024
+
+struct roadmap_canvas_raster_line {
+   agg::rgba8 color;
+   const agg::line_profile_aa *profile;
+   int fast_draw;
+   int first_point;
+   int count;
+   int miny;
+   int maxy;
+};
+
+static agg::pod_bvector<roadmap_canvas_raster_line> RasterLines;
+static agg::pod_bvector<RoadMapGuiPoint>            RasterPoints;
+
+static int             RasterBands = -1;
+static int             RasterActiveBands;
+static int             RasterPending;
+static unsigned int    RasterGeneration;
+static pthread_mutex_t RasterLock  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  RasterStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  RasterDone  = PTHREAD_COND_INITIALIZER;
+
+
+static void roadmap_canvas_raster_band (int band, int band_count) {
+
+   int height = agg_renb.height();
+   int miny = height * band / band_count;
+   int maxy = height * (band + 1) / band_count - 1;
+   unsigned int i;
+   int j;
+
+   renbase_type renb(agg_pixf);
+   agg::renderer_outline_aa<renbase_type> ren(renb, def_profile);
+   agg::rasterizer_outline_aa< agg::renderer_outline_aa<renbase_type> > rasterizer(ren);
+   agg::path_storage path;
+
+   /* Stay within the clipping area of the canvas, if any. */
+   if (miny < agg_renb.ymin()) miny = agg_renb.ymin();
+   if (maxy > agg_renb.ymax()) maxy = agg_renb.ymax();
+   renb.clip_box(agg_renb.xmin(), miny, agg_renb.xmax(), maxy);
+
+   for (i = 0; i < RasterLines.size(); i++) {
+
+      const roadmap_canvas_raster_line &line = RasterLines[i];
+
+      if ((line.maxy < miny) || (line.miny > maxy)) continue;
+
+      ren.profile(*line.profile);
+      ren.color(line.color);
+
+      if (!line.fast_draw) {
+         rasterizer.round_cap(true);
+         rasterizer.line_join(agg::outline_miter_accurate_join);
+      } else {
+         rasterizer.round_cap(false);
+         rasterizer.line_join(agg::outline_no_join);
+      }
+
+      path.move_to(RasterPoints[line.first_point].x,
+                   RasterPoints[line.first_point].y);
+      for (j = 1; j < line.count; j++) {
+         path.line_to(RasterPoints[line.first_point + j].x,
+                      RasterPoints[line.first_point + j].y);
+      }
+
+      rasterizer.add_path(path);
+      path.remove_all ();
+   }
+}
+
+
+static void *roadmap_canvas_raster_worker (void *context) {
+
+   int band = (int)(long)context;
+   unsigned int generation = 0;
+   int band_count;
+
+   pthread_mutex_lock (&RasterLock);
+
+   for (;;) {
+
+      while (generation == RasterGeneration) {
+         pthread_cond_wait (&RasterStart, &RasterLock);
+      }
+      generation = RasterGeneration;
+
+      band_count = RasterActiveBands;
+      if (band >= band_count) continue;
+
+      pthread_mutex_unlock (&RasterLock);
+      roadmap_canvas_raster_band (band, band_count);
+      pthread_mutex_lock (&RasterLock);
+
+      if (--RasterPending == 0) pthread_cond_signal (&RasterDone);
+   }
+
+   return NULL;
+}
+
+
+static void roadmap_canvas_raster_initialize (void) {
+
+   long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+   pthread_t thread;
+
+   if (cpus > RASTER_MAX_BANDS) cpus = RASTER_MAX_BANDS;
+
+   /* The main thread always rasterizes the first band. */
+   RasterBands = 1;
+
+   while (RasterBands < cpus) {
+
+      if (pthread_create (&thread, NULL,
+               roadmap_canvas_raster_worker, (void *)(long)RasterBands) != 0) {
+         roadmap_log (ROADMAP_ERROR, "cannot create rasterizer thread %d",
+                      RasterBands);
+         break;
+      }
+      pthread_detach (thread);
+      RasterBands++;
+   }
+
+   roadmap_log (ROADMAP_INFO, "rasterizing map lines with %d threads",
+                RasterBands);
+}
+
+
+static void roadmap_canvas_raster_add (int count, int *lines,
+                                       RoadMapGuiPoint *points, int fast_draw) {
+
+   const agg::renderer_outline_aa<renbase_type> &current = reno;
+   const agg::line_profile_aa &profile = current.profile();
+   int margin =
+      ((profile.subpixel_width() + agg::line_subpixel_mask) >>
+         agg::line_subpixel_shift) + 2;
+   int i;
+   int j;
+
+   for (i = 0; i < count; ++i) {
+
+      int count_of_points = lines[i];
+
+      if (count_of_points >= 2) {
+
+         roadmap_canvas_raster_line line;
+
+         line.color = current.color();
+         line.profile = &profile;
+         line.fast_draw = fast_draw;
+         line.first_point = RasterPoints.size();
+         line.count = count_of_points;
+         line.miny = points->y;
+         line.maxy = points->y;
+
+         for (j = 0; j < count_of_points; j++) {
+
+            if (points[j].y < line.miny) line.miny = points[j].y;
+            else if (points[j].y > line.maxy) line.maxy = points[j].y;
+
+            RasterPoints.add (points[j]);
+         }
+
+         line.miny -= margin;
+         line.maxy += margin;
+
+         RasterLines.add (line);
+      }
+
+      points += count_of_points;
+   }
+}
+
+
+static void roadmap_canvas_raster_flush (void) {
+
+   int bands;
+
+   if (RasterLines.size() == 0) return;
+
+   /* Small batches are not worth waking up the pool. */
+   bands = agg_renb.height() / RASTER_MIN_BAND_ROWS;
+   if (bands > RasterBands) bands = RasterBands;
+   if ((bands < 1) || (RasterPoints.size() < RASTER_MIN_POINTS)) bands = 1;
+
+   if (bands > 1) {
+      pthread_mutex_lock (&RasterLock);
+      RasterActiveBands = bands;
+      RasterPending = bands - 1;
+      RasterGeneration++;
+      pthread_cond_broadcast (&RasterStart);
+      pthread_mutex_unlock (&RasterLock);
+   }
+
+   roadmap_canvas_raster_band (0, bands);
+
+   if (bands > 1) {
+      pthread_mutex_lock (&RasterLock);
+      while (RasterPending > 0) {
+         pthread_cond_wait (&RasterDone, &RasterLock);
+      }
+      pthread_mutex_unlock (&RasterLock);
+   }
+
+   RasterLines.remove_all ();
+   RasterPoints.remove_all ();
+}
+
+#else
+
+static inline void roadmap_canvas_raster_flush (void) {}
+
+#endif // AGG_RASTER_THREADS
+
+
+void roadmap_canvas_agg_flush (void) {
+
+   roadmap_canvas_raster_flush ();
+}
+
 /* The canvas callbacks: all callbacks are initialized to do-nothing
  * functions, so that we don't care checking if one has been setup.
  */
@@ -267,12 +505,12 @@ RoadMapPen roadmap_canvas_select_pen (RoadMapPen pen)
       return NULL;
 
    RoadMapPen old_pen = CurrentPen;
-   dbg_time_start(DBG_TIME_SELECT_PEN);
+   roadmap_performance_begin(PERF_SELECT_PEN);
    reno.profile(*pen->profile);
    reno.color(pen->color);
    CurrentPen = pen;
 
-   dbg_time_end(DBG_TIME_SELECT_PEN);
+   roadmap_performance_end(PERF_SELECT_PEN);
 
    return old_pen;
 }
@@ -347,12 +585,16 @@ void roadmap_canvas_set_opacity (int opacity) {
 
 void roadmap_canvas_erase (void) {
 
+   roadmap_canvas_raster_flush ();
+
    agg_renb.clear(CurrentPen->color);
 }
 
 
 void roadmap_canvas_erase_area (const RoadMapGuiRect *rect) {
 
+   roadmap_canvas_raster_flush ();
+
    renderer_pr ren_pr(agg_renb);
    ren_pr.fill_color (CurrentPen->color);
    ren_pr.solid_rectangle(rect->minx, rect->miny, rect->maxx, rect->maxy);
@@ -448,6 +690,8 @@ void roadmap_canvas_draw_multiple_points (int count, RoadMapGuiPoint *points) {
 
    int i;
 
+   roadmap_canvas_raster_flush ();
+
    for (i=0; i<count; i++) {
 
       agg_renb.copy_pixel(points[i].x, points[i].y, CurrentPen->color);
@@ -457,6 +701,8 @@ void roadmap_canvas_draw_multiple_points (int count, RoadMapGuiPoint *points) {
 #if !defined(ANDROID) && !defined(WIN32)// Linkage fails
 void roadmap_canvas_draw_rounded_rect(RoadMapGuiPoint *bottom, RoadMapGuiPoint *top, int radius){
 
+   roadmap_canvas_raster_flush ();
+
 	rounded r = agg::rounded_rect(bottom->x, bottom->y, top->x, top->y, 10);
    r.normalize_radius();
    agg::conv_stroke<agg::rounded_rect> p(r);
@@ -472,7 +718,7 @@ void roadmap_canvas_draw_multiple_lines (int count, int *lines,
    int count_of_points;
 
 
-   dbg_time_start(DBG_TIME_DRAW_LINES);
+   roadmap_performance_begin(PERF_DRAW_LINES);
 #ifdef WIN32_PROFILE
    ResumeCAPAll();
 #endif
@@ -482,6 +728,17 @@ void roadmap_canvas_draw_multiple_lines (int count, int *lines,
       roadmap_canvas_native_draw_multiple_lines (count, lines, points,
          CurrentPen->color.r, CurrentPen->color.g, CurrentPen->color.b,
          CurrentPen->thickness);
+      roadmap_performance_end(PERF_DRAW_LINES);
+      return;
+   }
+#endif
+
+#ifdef AGG_RASTER_THREADS
+   if (RasterBands < 0) roadmap_canvas_raster_initialize ();
+
+   if (RasterBands > 1) {
+      roadmap_canvas_raster_add (count, lines, points, fast_draw);
+      roadmap_performance_end(PERF_DRAW_LINES);
       return;
    }
 #endif
@@ -506,7 +763,7 @@ void roadmap_canvas_draw_multiple_lines (int count, int *lines,
 
       if (count_of_points < 2) continue;
 
-      dbg_time_start(DBG_TIME_CREATE_PATH);
+      roadmap_performance_begin(PERF_CREATE_PATH);
 
       for (int j=0; j<count_of_points; j++) {
 
@@ -520,8 +777,8 @@ void roadmap_canvas_draw_multiple_lines (int count, int *lines,
          points++;
       }
 
-      dbg_time_end(DBG_TIME_CREATE_PATH);
-      dbg_time_start(DBG_TIME_ADD_PATH);
+      roadmap_performance_end(PERF_CREATE_PATH);
+      roadmap_performance_begin(PERF_ADD_PATH);
 
 #if 0
       if (fast_draw) {
@@ -536,7 +793,7 @@ void roadmap_canvas_draw_multiple_lines (int count, int *lines,
       //}
 
       path.remove_all ();
-      dbg_time_end(DBG_TIME_ADD_PATH);
+      roadmap_performance_end(PERF_ADD_PATH);
 
       lines += 1;
    }
@@ -546,14 +803,17 @@ void roadmap_canvas_draw_multiple_lines (int count, int *lines,
    SuspendCAPAll();
 #endif
 
+   roadmap_performance_end(PERF_DRAW_LINES);
+}
 
+int roadmap_canvas_draw_triangles
+         (int count, RoadMapGuiPoint *points, int fast_draw) {
 
-	return;
-
-
-   dbg_time_end(DBG_TIME_DRAW_LINES);
+   /* The scanline rasterizer fills polygons directly. */
+   return 0;
 }
 
+
 void roadmap_canvas_draw_multiple_polygons
          (int count, int *polygons, RoadMapGuiPoint *points, int filled,
           int fast_draw) {
@@ -563,6 +823,8 @@ void roadmap_canvas_draw_multiple_polygons
 
    static agg::path_storage path;
 
+   roadmap_canvas_raster_flush ();
+
    for (i = 0; i < count; ++i) {
 
       count_of_points = *polygons;
@@ -615,6 +877,8 @@ void roadmap_canvas_draw_multiple_circles
 
    static agg::path_storage path;
 
+   roadmap_canvas_raster_flush ();
+
    for (i = 0; i < count; ++i) {
 
       int r = radius[i];
@@ -686,9 +950,142 @@ int roadmap_canvas_height (void) {
 }
 
 
+#ifdef AGG_SAVE_PNG
+void roadmap_canvas_save_screenshot (const char* filename) {
+
+   int width = agg_renb.width();
+   int height = agg_renb.height();
+   png_structp png;
+   png_infop info;
+   png_bytep row;
+   FILE *file;
+   int x;
+   int y;
+
+   roadmap_canvas_raster_flush ();
+
+   file = fopen (filename, "wb");
+   if (!file) {
+      roadmap_log (ROADMAP_ERROR, "cannot create screenshot %s", filename);
+      return;
+   }
+
+   png = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   info = png ? png_create_info_struct (png) : NULL;
+   row = (png_bytep) malloc (3 * width);
+
+   if (!info || !row || setjmp (png_jmpbuf (png))) {
+      roadmap_log (ROADMAP_ERROR, "failed to write screenshot %s", filename);
+      png_destroy_write_struct (&png, info ? &info : NULL);
+      free (row);
+      fclose (file);
+      return;
+   }
+
+   png_init_io (png, file);
+   png_set_IHDR (png, info, width, height, 8, PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+   png_write_info (png, info);
+
+   for (y = 0; y < height; y++) {
+      for (x = 0; x < width; x++) {
+         agg::rgba8 color = agg_pixf.pixel (x, y);
+         row[3 * x]     = color.r;
+         row[3 * x + 1] = color.g;
+         row[3 * x + 2] = color.b;
+      }
+      png_write_row (png, row);
+   }
+
+   png_write_end (png, NULL);
+   png_destroy_write_struct (&png, &info);
+   free (row);
+   fclose (file);
+}
+#else
 void roadmap_canvas_save_screenshot (const char* filename) {
    /* NOT IMPLEMENTED. */
 }
+#endif
+
+
+/* A copy of the frame buffer as it was after the map was drawn, so that a
+ * repaint which only changes the overlays does not need to redraw the map.
+ */
+static unsigned char *RoadMapCanvasMap = NULL;
+static int            RoadMapCanvasMapSize = 0;
+static int            RoadMapCanvasMapValid = 0;
+
+int roadmap_canvas_save_map (void) {
+
+   int row_size = agg_renb.width() * pixfmt::pix_width;
+   int size = row_size * agg_renb.height();
+   int y;
+
+   if (size <= 0) return 0;
+
+   roadmap_canvas_raster_flush ();
+
+   if (size > RoadMapCanvasMapSize) {
+      RoadMapCanvasMap = (unsigned char *) realloc (RoadMapCanvasMap, size);
+      roadmap_check_allocated (RoadMapCanvasMap);
+      RoadMapCanvasMapSize = size;
+   }
+
+   for (y = 0; y < (int)agg_renb.height(); y++) {
+      memcpy (RoadMapCanvasMap + y * row_size, agg_rbuf.row_ptr(y), row_size);
+   }
+
+   RoadMapCanvasMapValid = 1;
+   return 1;
+}
+
+
+int roadmap_canvas_restore_map (const RoadMapGuiRect *rect) {
+
+   int row_size = agg_renb.width() * pixfmt::pix_width;
+   int minx = 0;
+   int miny = 0;
+   int maxx = agg_renb.width() - 1;
+   int maxy = agg_renb.height() - 1;
+   int y;
+
+   if (!RoadMapCanvasMapValid) return 0;
+
+   roadmap_canvas_raster_flush ();
+
+   if (rect) {
+      if (rect->minx > minx) minx = rect->minx;
+      if (rect->miny > miny) miny = rect->miny;
+      if (rect->maxx < maxx) maxx = rect->maxx;
+      if (rect->maxy < maxy) maxy = rect->maxy;
+      if ((minx > maxx) || (miny > maxy)) return 1;
+   }
+
+   for (y = miny; y <= maxy; y++) {
+      memcpy (agg_rbuf.row_ptr(y) + minx * pixfmt::pix_width,
+              RoadMapCanvasMap + y * row_size + minx * pixfmt::pix_width,
+              (maxx - minx + 1) * pixfmt::pix_width);
+   }
+
+   return 1;
+}
+
+
+void roadmap_canvas_set_clip (const RoadMapGuiRect *rect) {
+
+   roadmap_canvas_raster_flush ();
+
+   if (rect) {
+      agg_renb.clip_box(rect->minx, rect->miny, rect->maxx, rect->maxy);
+      ras.clip_box(agg_renb.xmin(), agg_renb.ymin(),
+                   agg_renb.xmax(), agg_renb.ymax());
+   } else {
+      agg_renb.reset_clipping(true);
+      ras.clip_box(0, 0, agg_renb.width() - 1, agg_renb.height() - 1);
+   }
+}
 
 
 /*
@@ -746,6 +1143,8 @@ void roadmap_canvas_draw_formated_string_angle (const RoadMapGuiPoint *position,
    font_engine_type  *feng;
    font_engine_type  *image_feng;
 
+   roadmap_canvas_raster_flush ();
+
    if ((font_type & FONT_TYPE_NORMAL) && (!RoadMapCanvasNormalFontLoaded))
       font_type = FONT_TYPE_BOLD;
 
@@ -767,12 +1166,16 @@ void roadmap_canvas_draw_formated_string_angle (const RoadMapGuiPoint *position,
    if ((font_type & FONT_TYPE_BOLD) && (RoadMapCanvasFontLoaded != 1)) return;
 
 
-   dbg_time_start(DBG_TIME_TEXT_FULL);
-   dbg_time_start(DBG_TIME_TEXT_CNV);
+   roadmap_performance_begin(PERF_TEXT_FULL);
+   roadmap_performance_begin(PERF_TEXT_CNV);
 
    wchar_t wstr[255];
    int length = roadmap_canvas_agg_to_wchar (text, wstr, 255);
-   if (length <=0) return;
+   if (length <=0) {
+      roadmap_performance_end(PERF_TEXT_CNV);
+      roadmap_performance_end(PERF_TEXT_FULL);
+      return;
+   }
 
 #ifdef USE_FRIBIDI
    wchar_t *bidi_text = bidi_string(wstr);
@@ -782,7 +1185,7 @@ void roadmap_canvas_draw_formated_string_angle (const RoadMapGuiPoint *position,
 #endif
 
    ren_solid.color(CurrentPen->color);
-   dbg_time_end(DBG_TIME_TEXT_CNV);
+   roadmap_performance_end(PERF_TEXT_CNV);
 
    double x  = 0;
    double y  = 0;
@@ -833,10 +1236,10 @@ void roadmap_canvas_draw_formated_string_angle (const RoadMapGuiPoint *position,
    }
 
    while(*p) {
-      dbg_time_start(DBG_TIME_TEXT_ONE_LETTER);
-      dbg_time_start(DBG_TIME_TEXT_GET_GLYPH);
+      roadmap_performance_begin(PERF_TEXT_ONE_LETTER);
+      roadmap_performance_begin(PERF_TEXT_GET_GLYPH);
       const agg::glyph_cache* glyph = fman->glyph(*p);
-      dbg_time_end(DBG_TIME_TEXT_GET_GLYPH);
+      roadmap_performance_end(PERF_TEXT_GET_GLYPH);
 
       if(glyph) {
          fman->init_embedded_adaptors(glyph, x, y);
@@ -863,7 +1266,7 @@ void roadmap_canvas_draw_formated_string_angle (const RoadMapGuiPoint *position,
          //agg::conv_stroke< agg::conv_contour<agg::conv_transform<font_manager_type::path_adaptor_type> > > stroke(contour);
          //agg::conv_stroke< agg::conv_transform<font_manager_type::path_adaptor_type> > stroke(tr);
 
-         dbg_time_start(DBG_TIME_TEXT_ONE_RAS);
+         roadmap_performance_begin(PERF_TEXT_ONE_RAS);
 
 #ifdef WIN32_PROFILE
          ResumeCAPAll();
@@ -883,12 +1286,12 @@ void roadmap_canvas_draw_formated_string_angle (const RoadMapGuiPoint *position,
          SuspendCAPAll();
 #endif
 
-         dbg_time_end(DBG_TIME_TEXT_ONE_RAS);
+         roadmap_performance_end(PERF_TEXT_ONE_RAS);
 
          // increment pen position
          x += glyph->advance_x;
          y += glyph->advance_y;
-         dbg_time_end(DBG_TIME_TEXT_ONE_LETTER);
+         roadmap_performance_end(PERF_TEXT_ONE_LETTER);
       }
       ++p;
    }
@@ -897,7 +1300,7 @@ void roadmap_canvas_draw_formated_string_angle (const RoadMapGuiPoint *position,
    free(bidi_text);
 #endif
 
-   dbg_time_end(DBG_TIME_TEXT_FULL);
+   roadmap_performance_end(PERF_TEXT_FULL);
 }
 
 void roadmap_canvas_draw_string_angle (const RoadMapGuiPoint *position,
@@ -926,7 +1329,9 @@ static int roadmap_canvas_agg_get_screen_type( int width, int height )
 void roadmap_canvas_agg_configure (unsigned char *buf, int width, int height, int stride) {
 
    roadmap_log( ROADMAP_ERROR, "roadmap_canvas_agg_configure, height =%d width=%d",height, width);
+   roadmap_canvas_raster_flush ();
    agg_rbuf.attach(buf, width, height, stride);
+   RoadMapCanvasMapValid = 0;
 
    agg_renb.attach(agg_pixf);
    agg_renb.reset_clipping(true);
@@ -1223,6 +1628,7 @@ void roadmap_canvas_draw_image (RoadMapImage image, const RoadMapGuiPoint *pos,
       opacity = 255;
    }
 
+   roadmap_canvas_raster_flush ();
    agg_renb.blend_from(image->pixfmt, 0, pos->x, pos->y, opacity);
 
    if (mode == IMAGE_SELECTED) {
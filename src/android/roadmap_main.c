@@ -1164,12 +1164,6 @@ void roadmap_main_message_dispatcher( int aMsg )
 		int itemId = aMsg & ANDROID_MSG_ID_MASK;
 		roadmap_androidmenu_handler( itemId );
 	}
-   // DNS resolver message
-   if ( aMsg & ANDROID_MSG_CATEGORY_RESOLVER )
-   {
-      int itemId = aMsg & ANDROID_MSG_ID_MASK;
-//      resolver_handler( itemId );
-   }
 }
 
 void roadmap_main_set_status (const char *text) {}
@@ -1477,12 +1471,6 @@ void roadmap_main_show_gps_disabled_warning()
 	roadmap_messagebox_timeout( "Your phone's GPS is  turned OFF", "Waze requires GPS connection. Please turn on your GPS from Menu > Settings > Security & Location > Enable GPS satellites", 5 );
 }
 
-void roadmap_main_post_resolver_result( int entry_id )
-{
-   int msg = ( ANDROID_MSG_CATEGORY_RESOLVER | ( entry_id & ANDROID_MSG_ID_MASK ) );
-   FreeMapNativeManager_PostNativeMessage ( msg );
-}
-
 RoadMapMenu roadmap_main_new_menu (void) { return NULL; }
 
 
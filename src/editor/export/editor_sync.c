@@ -47,6 +47,8 @@
 #include "roadmap_main.h"
 #include "roadmap_messagebox.h"
 #include "roadmap_label.h"
+#include "roadmap_line_index.h"
+#include "roadmap_screen.h"
 #include "roadmap_warning.h"
 
 #include "editor_download.h"
@@ -372,6 +374,8 @@ int export_sync (void) {
 
 	roadmap_label_clear (-1);
 	navigate_graph_clear (-1);
+	roadmap_line_index_clear (-1);
+	roadmap_screen_cache_clear (-1);
 	
    roadmap_main_flush ();
 #ifndef J2ME
@@ -0,0 +1,462 @@
+/* roadmap_bench.c - Headless render benchmark.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The application without a window: the AGG canvas draws in memory, the
+ *   main loop never runs (no timer nor input is ever called) and the views
+ *   listed in a script are drawn one after the other. Each view is drawn
+ *   a number of times and the frame is written as a PNG file, so that the
+ *   frames of two builds can be compared pixel by pixel.
+ *
+ *   The script has one view per line ('#' starts a comment):
+ *
+ *      name longitude latitude zoom orientation 2d|3d
+ *
+ *   where the position is in millionths of a degree.
+ *
+ * SYNOPSYS:
+ *
+ *   gtkroadmap-bench --bench-script=FILE [--bench-maps=DIR]
+ *                    [--bench-output=DIR] [--bench-reference=DIR]
+ *                    [--bench-size=WIDTHxHEIGHT] [--bench-repeat=N]
+ *                    [roadmap options]
+ *
+ *   The exit code is 1 if a frame differs from its reference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "roadmap.h"
+#include "roadmap_path.h"
+#include "roadmap_start.h"
+#include "roadmap_screen.h"
+#include "roadmap_canvas.h"
+#include "roadmap_libpng.h"
+
+#include "roadmap_main.h"
+
+
+#define BENCH_MAX_VIEWS    256
+#define BENCH_MAX_REPEAT   100
+
+typedef struct {
+   char            name[64];
+   RoadMapPosition center;
+   int             zoom;
+   int             orientation;
+   int             view_mode;
+} BenchView;
+
+static BenchView BenchViews[BENCH_MAX_VIEWS];
+static int       BenchViewCount = 0;
+
+static const char *BenchScript    = NULL;
+static const char *BenchMaps      = NULL;
+static const char *BenchOutput    = ".";
+static const char *BenchReference = NULL;
+static int         BenchWidth     = 480;
+static int         BenchHeight    = 800;
+static int         BenchRepeat    = 10;
+
+
+struct roadmap_main_timer {
+   RoadMapCallback callback;
+};
+
+#define ROADMAP_MAX_TIMER 32
+static struct roadmap_main_timer RoadMapMainPeriodicTimer[ROADMAP_MAX_TIMER];
+
+int USING_PHONE_KEYPAD = 0;
+
+
+/* The GUI, without a window. ---------------------------------------------- */
+
+void roadmap_main_toggle_full_screen (void) {}
+
+void roadmap_main_new (const char *title, int width, int height) {}
+
+void roadmap_main_set_keyboard (struct RoadMapFactoryKeyMap *bindings,
+                                RoadMapKeyInput callback) {}
+
+RoadMapMenu roadmap_main_new_menu (void) {
+
+   return NULL;
+}
+
+void roadmap_main_free_menu (RoadMapMenu menu) {}
+
+void roadmap_main_add_menu (RoadMapMenu menu, const char *label) {}
+
+void roadmap_main_add_menu_item (RoadMapMenu menu,
+                                 const char *label,
+                                 const char *tip,
+                                 RoadMapCallback callback) {}
+
+void roadmap_main_popup_menu (RoadMapMenu menu, int x, int y) {}
+
+void roadmap_main_add_separator (RoadMapMenu menu) {}
+
+void roadmap_main_add_tool (const char *label,
+                            const char *icon,
+                            const char *tip,
+                            RoadMapCallback callback) {}
+
+void roadmap_main_add_tool_space (void) {}
+
+void roadmap_main_add_canvas (void) {}
+
+void roadmap_main_add_status (void) {}
+
+void roadmap_main_show (void) {}
+
+void roadmap_main_set_input (RoadMapIO *io, RoadMapInput callback) {}
+
+void roadmap_main_remove_input (RoadMapIO *io) {}
+
+void roadmap_main_set_output (RoadMapIO *io, RoadMapInput callback, BOOL is_connected) {}
+
+RoadMapIO *roadmap_main_output_timedout (time_t timeout) {
+
+   return NULL;
+}
+
+void roadmap_main_set_periodic (int interval, RoadMapCallback callback) {
+
+   int index;
+   struct roadmap_main_timer *timer = NULL;
+
+   for (index = 0; index < ROADMAP_MAX_TIMER; ++index) {
+
+      if (RoadMapMainPeriodicTimer[index].callback == callback) {
+         return;
+      }
+      if (timer == NULL) {
+         if (RoadMapMainPeriodicTimer[index].callback == NULL) {
+            timer = RoadMapMainPeriodicTimer + index;
+         }
+      }
+   }
+
+   if (timer == NULL) {
+      roadmap_log (ROADMAP_FATAL, "Timer table saturated");
+   }
+
+   timer->callback = callback;
+}
+
+void roadmap_main_remove_periodic (RoadMapCallback callback) {
+
+   int index;
+
+   for (index = 0; index < ROADMAP_MAX_TIMER; ++index) {
+
+      if (RoadMapMainPeriodicTimer[index].callback == callback) {
+         RoadMapMainPeriodicTimer[index].callback = NULL;
+         return;
+      }
+   }
+}
+
+void roadmap_gui_minimize (void) {}
+
+void roadmap_gui_maximize (void) {}
+
+void roadmap_main_minimize (void) {}
+
+BOOL roadmap_horizontal_screen_orientation () {
+
+   return BenchWidth > BenchHeight;
+}
+
+void roadmap_main_set_status (const char *text) {}
+
+void roadmap_main_flush (void) {}
+
+void roadmap_main_exit (void) {
+
+   static int exit_done;
+
+   if (!exit_done++) {
+      roadmap_start_exit ();
+   }
+}
+
+void roadmap_main_set_cursor (int cursor) {}
+
+
+/* The benchmark. ---------------------------------------------------------- */
+
+static double bench_now (void) {
+
+   struct timeval now;
+
+   gettimeofday (&now, NULL);
+   return now.tv_sec * 1000.0 + now.tv_usec / 1000.0;
+}
+
+
+static int bench_compare_double (const void *a, const void *b) {
+
+   double da = *(const double *)a;
+   double db = *(const double *)b;
+
+   return (da > db) - (da < db);
+}
+
+
+static int bench_load_script (const char *file_name) {
+
+   FILE *file = fopen (file_name, "r");
+   char line[256];
+   int line_number = 0;
+
+   if (file == NULL) {
+      roadmap_log (ROADMAP_ERROR, "cannot open the script %s", file_name);
+      return 0;
+   }
+
+   while (fgets (line, sizeof(line), file) != NULL) {
+
+      BenchView *view = BenchViews + BenchViewCount;
+      char mode[8];
+      char *comment = strchr (line, '#');
+
+      line_number += 1;
+
+      if (comment != NULL) *comment = 0;
+      if (strspn (line, " \t\r\n") == strlen (line)) continue;
+
+      if (BenchViewCount >= BENCH_MAX_VIEWS) {
+         roadmap_log (ROADMAP_ERROR, "%s: too many views", file_name);
+         break;
+      }
+
+      if (sscanf (line, "%63s %d %d %d %d %7s",
+                  view->name,
+                  &view->center.longitude,
+                  &view->center.latitude,
+                  &view->zoom,
+                  &view->orientation,
+                  mode) != 6) {
+         roadmap_log (ROADMAP_ERROR, "%s:%d: invalid view", file_name, line_number);
+         continue;
+      }
+
+      view->view_mode = strcasecmp (mode, "3d") ? VIEW_MODE_2D : VIEW_MODE_3D;
+      BenchViewCount += 1;
+   }
+
+   fclose (file);
+
+   return BenchViewCount;
+}
+
+
+/* Returns the number of pixels that differ from the reference frame, or -1
+ * if there is no usable reference.
+ */
+static int bench_compare (const char *frame_name, const char *reference_name) {
+
+   int width, height, stride;
+   int ref_width, ref_height, ref_stride;
+   unsigned char *frame;
+   unsigned char *reference;
+   int pixel_size;
+   int differences = 0;
+   int x;
+   int y;
+
+   reference = read_png_file (reference_name, &ref_width, &ref_height, &ref_stride);
+   if (reference == NULL) return -1;
+
+   frame = read_png_file (frame_name, &width, &height, &stride);
+   if (frame == NULL ||
+       width != ref_width || height != ref_height || stride != ref_stride) {
+      free (frame);
+      free (reference);
+      return -1;
+   }
+
+   pixel_size = stride / width;
+
+   for (y = 0; y < height; y++) {
+      for (x = 0; x < width; x++) {
+         if (memcmp (frame + y * stride + pixel_size * x,
+                     reference + y * stride + pixel_size * x, pixel_size)) {
+            differences += 1;
+         }
+      }
+   }
+
+   free (frame);
+   free (reference);
+
+   return differences;
+}
+
+
+static int bench_run (void) {
+
+   double timings[BENCH_MAX_REPEAT];
+   double total = 0;
+   int failures = 0;
+   int i;
+   int j;
+
+   printf ("%-24s %9s %9s %9s  %s\n", "view", "min ms", "median ms", "max ms",
+           BenchReference ? "diff" : "");
+
+   for (i = 0; i < BenchViewCount; i++) {
+
+      BenchView *view = BenchViews + i;
+      char *frame_name;
+      char file_name[80];
+
+      for (j = 0; j < BenchRepeat; j++) {
+
+         double start = bench_now ();
+
+         roadmap_screen_draw_view (&view->center, view->zoom,
+                                   view->orientation, view->view_mode);
+
+         timings[j] = bench_now () - start;
+         total += timings[j];
+      }
+
+      qsort (timings, BenchRepeat, sizeof(timings[0]), bench_compare_double);
+
+      snprintf (file_name, sizeof(file_name), "%s.png", view->name);
+      frame_name = roadmap_path_join (BenchOutput, file_name);
+      roadmap_canvas_save_screenshot (frame_name);
+
+      printf ("%-24s %9.2f %9.2f %9.2f",
+              view->name,
+              timings[0], timings[BenchRepeat / 2], timings[BenchRepeat - 1]);
+
+      if (BenchReference != NULL) {
+
+         char *reference_name = roadmap_path_join (BenchReference, file_name);
+         int differences = bench_compare (frame_name, reference_name);
+
+         if (differences < 0) {
+            printf ("  no reference");
+         } else {
+            printf ("  %d pixels", differences);
+            if (differences > 0) failures += 1;
+         }
+         roadmap_path_free (reference_name);
+      }
+
+      printf ("\n");
+      roadmap_path_free (frame_name);
+   }
+
+   printf ("%d views, %d frames, %.2f ms per frame\n",
+           BenchViewCount, BenchViewCount * BenchRepeat,
+           total / (BenchViewCount * BenchRepeat));
+
+   return failures;
+}
+
+
+static void roadmap_start_event (int event) {
+   switch (event) {
+   case ROADMAP_START_INIT:
+      /* Roadmap_start() has set the maps path from the configuration. */
+      if (BenchMaps != NULL) {
+         roadmap_path_set ("maps", BenchMaps);
+      }
+      break;
+   }
+}
+
+
+/* Take out the benchmark's own options, the others go to roadmap_start(). */
+static int bench_options (int argc, char **argv) {
+
+   int i;
+   int count = 1;
+
+   for (i = 1; i < argc; i++) {
+
+      const char *option = argv[i];
+
+      if (!strncmp (option, "--bench-script=", 15)) {
+         BenchScript = option + 15;
+      } else if (!strncmp (option, "--bench-maps=", 13)) {
+         BenchMaps = option + 13;
+      } else if (!strncmp (option, "--bench-output=", 15)) {
+         BenchOutput = option + 15;
+      } else if (!strncmp (option, "--bench-reference=", 18)) {
+         BenchReference = option + 18;
+      } else if (!strncmp (option, "--bench-size=", 13)) {
+         if (sscanf (option + 13, "%dx%d", &BenchWidth, &BenchHeight) != 2 ||
+             BenchWidth <= 0 || BenchHeight <= 0) {
+            fprintf (stderr, "invalid size %s\n", option + 13);
+            exit (1);
+         }
+      } else if (!strncmp (option, "--bench-repeat=", 15)) {
+         BenchRepeat = atoi (option + 15);
+         if (BenchRepeat < 1) BenchRepeat = 1;
+         if (BenchRepeat > BENCH_MAX_REPEAT) BenchRepeat = BENCH_MAX_REPEAT;
+      } else {
+         argv[count++] = argv[i];
+      }
+   }
+
+   return count;
+}
+
+
+int main (int argc, char **argv) {
+
+   int failures;
+
+   argc = bench_options (argc, argv);
+
+   if (BenchScript == NULL) {
+      fprintf (stderr, "usage: %s --bench-script=FILE [--bench-maps=DIR] "
+                       "[--bench-output=DIR] [--bench-reference=DIR] "
+                       "[--bench-size=WIDTHxHEIGHT] [--bench-repeat=N]\n",
+                       argv[0]);
+      return 1;
+   }
+
+   if (!bench_load_script (BenchScript)) {
+      return 1;
+   }
+
+   roadmap_start_subscribe (roadmap_start_event);
+   roadmap_start (argc, argv);
+
+   roadmap_canvas_headless_configure (BenchWidth, BenchHeight);
+
+   failures = bench_run ();
+
+   roadmap_main_exit ();
+
+   return failures ? 1 : 0;
+}
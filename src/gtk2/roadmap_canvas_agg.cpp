@@ -63,6 +63,7 @@ extern "C" {
 
 #include "roadmap_canvas.h"
 #include "roadmap_gtkcanvas.h"
+#include "roadmap_gtkmain.h"
 }
 
 #include "roadmap_libpng.h"
@@ -72,8 +73,12 @@ extern "C" {
 #define GetGValue(x) x.green
 #define GetBValue(x) x.blue
 
+#ifndef ROADMAP_HEADLESS
 static GtkWidget  *RoadMapDrawingArea;
 static GdkImage   *RoadMapDrawingBuffer;
+#else
+static unsigned char *RoadMapDrawingBuffer;
+#endif
 
 int roadmap_canvas_agg_to_wchar (const char *text, wchar_t *output, int size) {
 
@@ -103,7 +108,14 @@ agg::rgba8 roadmap_canvas_agg_parse_color (const char *color) {
 	}
 
    gdk_color_parse (color, &native_color);
+#ifndef ROADMAP_HEADLESS
    gdk_color_alloc (gdk_colormap_get_system(), &native_color);
+#else
+   /* No colormap without a display: keep the 8 high bits of each component. */
+   native_color.red >>= 8;
+   native_color.green >>= 8;
+   native_color.blue >>= 8;
+#endif
 
    return agg::rgba8(GetRValue(native_color), GetGValue(native_color),
             GetBValue(native_color));
@@ -193,6 +205,7 @@ void roadmap_canvas_agg_free_image (RoadMapImage image) {
 }
 
 
+#ifndef ROADMAP_HEADLESS
 static gint roadmap_canvas_configure
                (GtkWidget *widget, GdkEventConfigure *event) {
 
@@ -232,6 +245,8 @@ static gint roadmap_canvas_configure
 
 static gint roadmap_canvas_expose (GtkWidget *widget, GdkEventExpose *event) {
 
+   roadmap_canvas_agg_flush ();
+
    gdk_draw_image (widget->window,
                     widget->style->fg_gc[GTK_WIDGET_STATE(widget)],
                     RoadMapDrawingBuffer,
@@ -265,6 +280,8 @@ void roadmap_canvas_refresh (void) {
 
    GdkRectangle update;
 
+   roadmap_canvas_agg_flush ();
+
    update.x = 0;
    update.y = 0;
    update.width  = RoadMapDrawingArea->allocation.width;
@@ -315,6 +332,29 @@ GtkWidget *roadmap_canvas_new (void) {
 
    return RoadMapDrawingArea;
 }
+#else
+
+void roadmap_canvas_headless_configure (int width, int height) {
+
+   free (RoadMapDrawingBuffer);
+   RoadMapDrawingBuffer = (unsigned char *) calloc (width * height, 4);
+   roadmap_check_allocated (RoadMapDrawingBuffer);
+
+   roadmap_canvas_agg_configure (RoadMapDrawingBuffer, width, height, width * 4);
+
+   (*RoadMapCanvasConfigure) ();
+}
+
+
+void roadmap_canvas_refresh (void) {
+
+   roadmap_canvas_agg_flush ();
+}
+
+
+/* The GTK dialogs are linked in, but there is no window to size. */
+void roadmap_main_set_window_size (GtkWidget *w, int width, int height) {}
+#endif // ROADMAP_HEADLESS
 
 // stubs yet
 void roadmap_canvas_draw_image_stretch( RoadMapImage image, const RoadMapGuiPoint *top_left_pos, const RoadMapGuiPoint *bottom_right_pos,
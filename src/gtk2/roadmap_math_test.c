@@ -0,0 +1,233 @@
+/* roadmap_math_test.c - Check the batch transforms against the scalar code.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   roadmap_math_coordinates(), roadmap_math_rotate_coordinates() and
+ *   roadmap_math_project_coordinates() use the SSE2 or NEON kernels when
+ *   the build has them. On random views (center, zoom, orientation, with
+ *   and without the 3D projection) and random positions, their results
+ *   must be bit for bit those of the scalar code: roadmap_math_coordinate()
+ *   and a rotation of one point at a time, which is shorter than a vector
+ *   and so never goes through a kernel.
+ *
+ *   The positions are mostly around the center, some far off the screen
+ *   so that the products wrap around in 32 bits.
+ *
+ * SYNOPSYS:
+ *
+ *   gtkroadmap-mathtest [--math-views=N] [--math-seed=N]
+ *
+ *   The exit code is 1 if a result differs.
+ *
+ *   Only roadmap_math.c is under test: what it calls in the rest of RoadMap
+ *   is stubbed below, for a plain screen without configuration or map.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_config.h"
+#include "roadmap_state.h"
+#include "roadmap_screen.h"
+#include "roadmap_square.h"
+#include "roadmap_shape.h"
+#include "roadmap_bar.h"
+#include "roadmap_math.h"
+
+
+#define MATH_TEST_POINTS      1027  /* Not a multiple of the vector size */
+#define MATH_TEST_MAX_REPORT  10
+
+static int MathTestViews = 1000;
+static unsigned int MathTestSeed = 1;
+
+static int MathTestMismatches = 0;
+
+
+static int math_test_random (int low, int high) {
+
+   return low + (int) ((double) rand () / ((double) RAND_MAX + 1) * (high - low + 1));
+}
+
+
+static void math_test_random_view (void) {
+
+   RoadMapPosition center;
+
+   center.longitude = math_test_random (-179000000, 179000000);
+   center.latitude  = math_test_random (-80000000, 80000000);
+
+   roadmap_math_set_center (&center);
+   roadmap_math_zoom_set (math_test_random (1, 20000));
+
+   if (math_test_random (0, 3) == 0) {
+      roadmap_math_set_horizon (math_test_random (-300, -50), PROJECTION_MODE_3D_NON_OGL);
+   } else {
+      roadmap_math_set_horizon (0, PROJECTION_MODE_NONE);
+   }
+
+   /* A full turn from zero: a small change would not be applied. */
+   roadmap_math_set_orientation (0);
+   roadmap_math_set_orientation (math_test_random (0, 359));
+}
+
+
+static void math_test_random_positions (RoadMapPosition *positions, int count) {
+
+   RoadMapArea area;
+   int span_x;
+   int span_y;
+   int i;
+
+   roadmap_math_screen_edges (&area);
+
+   span_x = area.east - area.west + 1;
+   span_y = area.north - area.south + 1;
+
+   for (i = 0; i < count; ++i) {
+
+      if (math_test_random (0, 9) == 0) {
+         positions[i].longitude = math_test_random (-180000000, 180000000);
+         positions[i].latitude  = math_test_random (-90000000, 90000000);
+      } else {
+         positions[i].longitude = area.west  + math_test_random (-span_x, 2 * span_x);
+         positions[i].latitude  = area.south + math_test_random (-span_y, 2 * span_y);
+      }
+   }
+}
+
+
+static void math_test_compare (const char *name,
+                               const RoadMapPosition *positions,
+                               const RoadMapGuiPoint *expected,
+                               const RoadMapGuiPoint *result,
+                               int count) {
+
+   int i;
+
+   for (i = 0; i < count; ++i) {
+
+      if (expected[i].x == result[i].x && expected[i].y == result[i].y) continue;
+
+      if (++MathTestMismatches <= MATH_TEST_MAX_REPORT) {
+         printf ("%s: position %d,%d gives %d,%d instead of %d,%d\n",
+                 name,
+                 positions[i].longitude, positions[i].latitude,
+                 result[i].x, result[i].y,
+                 expected[i].x, expected[i].y);
+      }
+   }
+}
+
+
+static void math_test_view (void) {
+
+   static RoadMapPosition positions[MATH_TEST_POINTS];
+   static RoadMapGuiPoint upright[MATH_TEST_POINTS];
+   static RoadMapGuiPoint expected[MATH_TEST_POINTS];
+   static RoadMapGuiPoint result[MATH_TEST_POINTS];
+   int i;
+
+   math_test_random_view ();
+   math_test_random_positions (positions, MATH_TEST_POINTS);
+
+   for (i = 0; i < MATH_TEST_POINTS; ++i) {
+      roadmap_math_coordinate (positions + i, upright + i);
+   }
+
+   roadmap_math_coordinates (MATH_TEST_POINTS, positions, result);
+   math_test_compare ("coordinates", positions, upright, result, MATH_TEST_POINTS);
+
+   memcpy (expected, upright, sizeof(expected));
+   for (i = 0; i < MATH_TEST_POINTS; ++i) {
+      roadmap_math_rotate_coordinates (1, expected + i);
+   }
+
+   memcpy (result, upright, sizeof(result));
+   roadmap_math_rotate_coordinates (MATH_TEST_POINTS, result);
+   math_test_compare ("rotate", positions, expected, result, MATH_TEST_POINTS);
+
+   roadmap_math_project_coordinates (MATH_TEST_POINTS, positions, result);
+   math_test_compare ("project", positions, expected, result, MATH_TEST_POINTS);
+}
+
+
+void roadmap_config_declare (const char *file, RoadMapConfigDescriptor *descriptor,
+                             const char *default_value, int *is_new) {}
+
+int roadmap_config_get_integer (RoadMapConfigDescriptor *descriptor) { return 0; }
+
+void roadmap_config_set_integer (RoadMapConfigDescriptor *descriptor, int x) {}
+
+void roadmap_state_add (const char *name, RoadMapStateFn state_fn) {}
+
+int roadmap_screen_fast_refresh (void) { return 0; }
+
+int roadmap_screen_is_hd_screen (void) { return 0; }
+
+int roadmap_screen_get_screen_scale (void) { return 100; }
+
+void roadmap_square_adjust_scale (int zoom_factor) {}
+
+int roadmap_square_scale (int square) { return 0; }
+
+int roadmap_square_at_current_scale (int square) { return 1; }
+
+void roadmap_shape_get_position (int shape, RoadMapPosition *position) {}
+
+int roadmap_bar_top_height (void) { return 0; }
+
+int roadmap_bar_bottom_height (void) { return 0; }
+
+
+int main (int argc, char **argv) {
+
+   int i;
+
+   for (i = 1; i < argc; i++) {
+      if (!strncmp (argv[i], "--math-views=", 13)) {
+         MathTestViews = atoi (argv[i] + 13);
+      } else if (!strncmp (argv[i], "--math-seed=", 12)) {
+         MathTestSeed = (unsigned int) atoi (argv[i] + 12);
+      } else {
+         fprintf (stderr, "usage: %s [--math-views=N] [--math-seed=N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   srand (MathTestSeed);
+
+   roadmap_math_initialize ();
+   roadmap_math_set_size (480, 800);
+
+   for (i = 0; i < MathTestViews; ++i) {
+      math_test_view ();
+   }
+
+   printf ("%d views, %d positions each, %d mismatches\n",
+           MathTestViews, MATH_TEST_POINTS, MathTestMismatches);
+
+   return MathTestMismatches ? 1 : 0;
+}
@@ -0,0 +1,358 @@
+/* roadmap_nmea_test.c - NMEA decoder throughput and fuzz test.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The sentences of captured NMEA logs (e.g. the GPS logs written by
+ *   roadmap_driver.c) are fed to roadmap_nmea_decode(), with a listener
+ *   subscribed to every sentence it knows:
+ *
+ *   - Throughput: all the sentences are decoded a number of times, and the
+ *     time per sentence is printed.
+ *
+ *   - Fuzz: sentences of the logs are mutated at random (bytes changed,
+ *     fields added or removed, truncation, no checksum) and decoded. Half
+ *     of them get a valid checksum again, so that the mutations reach the
+ *     decoders of the fields. A bad sentence must be rejected, never crash
+ *     or overrun: build with -fsanitize=address to catch the overruns.
+ *
+ * SYNOPSYS:
+ *
+ *   gtkroadmap-nmeatest [--nmea-repeat=N] [--nmea-fuzz=N] [--nmea-seed=N]
+ *                       FILE...
+ *
+ *   The exit code is 1 if no sentence of the logs could be decoded.
+ *   nmea_capture.txt is a log of a few minutes of driving.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "roadmap.h"
+#include "roadmap_nmea.h"
+
+
+#define NMEA_TEST_MAX_LENGTH  256   /* Longer lines are not NMEA */
+#define NMEA_TEST_MAX_REPEAT  1000
+
+static char **NmeaTestLines     = NULL;
+static int    NmeaTestLineCount = 0;
+static long   NmeaTestBytes     = 0;
+
+static int          NmeaTestRepeat = 10;
+static int          NmeaTestFuzz   = 100000;
+static unsigned int NmeaTestSeed   = 1;
+
+static int NmeaTestReceived = 0;
+
+
+static const struct {
+   const char *vendor;
+   const char *sentence;
+} NmeaTestSentences[] = {
+   {NULL,  "RMC"},
+   {NULL,  "GGA"},
+   {NULL,  "GSA"},
+   {NULL,  "GSV"},
+   {NULL,  "GLL"},
+   {NULL,  "VTG"},
+   {"GRM", "E"},
+   {"GRM", "M"},
+   {"GRM", "Z"},
+   {"XRM", "ADD"},
+   {"XRM", "MOV"},
+   {"XRM", "DEL"},
+   {"XRM", "SUB"},
+   {"XRM", "CFG"},
+};
+
+
+static double nmea_test_now (void) {
+
+   struct timeval now;
+
+   gettimeofday (&now, NULL);
+   return now.tv_sec * 1000.0 + now.tv_usec / 1000.0;
+}
+
+
+static int nmea_test_random (int range) {
+
+   return (int) ((double) rand () / ((double) RAND_MAX + 1) * range);
+}
+
+
+static void nmea_test_listener (void *context, const RoadMapNmeaFields *fields) {
+
+   NmeaTestReceived++;
+}
+
+
+static int nmea_test_load (const char *file_name) {
+
+   FILE *file = fopen (file_name, "r");
+   char line[NMEA_TEST_MAX_LENGTH];
+   static int size = 0;
+
+   if (file == NULL) {
+      fprintf (stderr, "cannot open %s\n", file_name);
+      return 0;
+   }
+
+   while (fgets (line, sizeof(line), file) != NULL) {
+
+      if (strchr (line, '$') == NULL) continue;
+
+      if (NmeaTestLineCount >= size) {
+         size = size ? 2 * size : 4096;
+         NmeaTestLines = realloc (NmeaTestLines, size * sizeof(char *));
+         roadmap_check_allocated (NmeaTestLines);
+      }
+      NmeaTestLines[NmeaTestLineCount] = strdup (line);
+      roadmap_check_allocated (NmeaTestLines[NmeaTestLineCount]);
+
+      NmeaTestBytes += strlen (line);
+      NmeaTestLineCount++;
+   }
+
+   fclose (file);
+   return 1;
+}
+
+
+/* The decoder cuts the sentence in place: it gets a copy. */
+static int nmea_test_decode (RoadMapNmeaAccount account, const char *line) {
+
+   char sentence[NMEA_TEST_MAX_LENGTH];
+   int length = strlen (line);
+
+   memcpy (sentence, line, length + 1);
+
+   return roadmap_nmea_decode (NULL, account, sentence, length);
+}
+
+
+static int nmea_test_throughput (RoadMapNmeaAccount account) {
+
+   double start;
+   double elapsed;
+   int decoded = 0;
+   int repeat;
+   int i;
+
+   start = nmea_test_now ();
+
+   for (repeat = 0; repeat < NmeaTestRepeat; ++repeat) {
+      for (i = 0; i < NmeaTestLineCount; ++i) {
+         decoded += nmea_test_decode (account, NmeaTestLines[i]);
+      }
+   }
+
+   elapsed = nmea_test_now () - start;
+
+   printf ("%d sentences (%ld bytes), %d decoded, %.3f us per sentence, %.1f MB/s\n",
+           NmeaTestLineCount, NmeaTestBytes, decoded / NmeaTestRepeat,
+           elapsed * 1000.0 / ((double) NmeaTestLineCount * NmeaTestRepeat),
+           elapsed > 0 ?
+              (double) NmeaTestBytes * NmeaTestRepeat / 1000.0 / elapsed : 0.0);
+
+   return decoded / NmeaTestRepeat;
+}
+
+
+/* Put a valid checksum after the mutated sentence. */
+static void nmea_test_checksum (char *sentence, int size) {
+
+   char *p = strchr (sentence, '$');
+   unsigned char checksum = 0;
+
+   if (p == NULL) return;
+
+   for (++p; *p != 0 && *p != '*' && *p >= ' '; ++p) {
+      checksum ^= *p;
+   }
+
+   if (p + 5 < sentence + size) {
+      sprintf (p, "*%02X\r\n", checksum);
+   }
+}
+
+
+static void nmea_test_mutate (char *sentence, int size) {
+
+   static const char alphabet[] = "$*,.-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ \t\r\n\377";
+   int length = strlen (sentence);
+   int mutations = 1 + nmea_test_random (4);
+   int i;
+
+   for (i = 0; i < mutations && length > 0; ++i) {
+
+      int position = nmea_test_random (length);
+
+      switch (nmea_test_random (6)) {
+
+      case 0: /* Change a byte */
+         sentence[position] = alphabet[nmea_test_random (sizeof(alphabet) - 1)];
+         break;
+
+      case 1: /* Any byte at all */
+         sentence[position] = (char) nmea_test_random (256);
+         if (sentence[position] == 0) length = position;
+         break;
+
+      case 2: /* Truncate */
+         sentence[position] = 0;
+         length = position;
+         break;
+
+      case 3: /* Insert commas: empty fields, or too many of them */
+         {
+            int count = 1 + nmea_test_random (40);
+
+            if (length + count >= size) count = size - 1 - length;
+            memmove (sentence + position + count, sentence + position,
+                     length - position + 1);
+            memset (sentence + position, ',', count);
+            length += count;
+         }
+         break;
+
+      case 4: /* Remove a part */
+         {
+            int count = nmea_test_random (length - position) + 1;
+
+            memmove (sentence + position, sentence + position + count,
+                     length - position - count + 1);
+            length -= count;
+         }
+         break;
+
+      case 5: /* Repeat a part */
+         {
+            int count = nmea_test_random (length - position) + 1;
+
+            if (length + count >= size) count = size - 1 - length;
+            memmove (sentence + position + count, sentence + position,
+                     length - position + 1);
+            length += count;
+         }
+         break;
+      }
+   }
+
+   if (nmea_test_random (2)) {
+      nmea_test_checksum (sentence, size);
+   }
+}
+
+
+static void nmea_test_fuzz (RoadMapNmeaAccount account) {
+
+   int decoded = 0;
+   int i;
+
+   for (i = 0; i < NmeaTestFuzz; ++i) {
+
+      /* Room for the mutations to grow the sentence. */
+      char sentence[4 * NMEA_TEST_MAX_LENGTH];
+      char *copy;
+      int length;
+
+      strcpy (sentence, NmeaTestLines[nmea_test_random (NmeaTestLineCount)]);
+      nmea_test_mutate (sentence, sizeof(sentence));
+
+      /* An exact size copy, so that an overrun shows. */
+      length = strlen (sentence);
+      copy = malloc (length + 1);
+      roadmap_check_allocated (copy);
+      memcpy (copy, sentence, length + 1);
+
+      decoded += roadmap_nmea_decode (NULL, account, copy, length);
+
+      free (copy);
+   }
+
+   printf ("%d mutated sentences, %d decoded\n", NmeaTestFuzz, decoded);
+}
+
+
+int main (int argc, char **argv) {
+
+   RoadMapNmeaAccount account;
+   int files = 0;
+   int i;
+
+   for (i = 1; i < argc; i++) {
+
+      const char *option = argv[i];
+
+      if (!strncmp (option, "--nmea-repeat=", 14)) {
+         NmeaTestRepeat = atoi (option + 14);
+         if (NmeaTestRepeat < 1) NmeaTestRepeat = 1;
+         if (NmeaTestRepeat > NMEA_TEST_MAX_REPEAT) NmeaTestRepeat = NMEA_TEST_MAX_REPEAT;
+      } else if (!strncmp (option, "--nmea-fuzz=", 12)) {
+         NmeaTestFuzz = atoi (option + 12);
+      } else if (!strncmp (option, "--nmea-seed=", 12)) {
+         NmeaTestSeed = (unsigned int) atoi (option + 12);
+      } else if (option[0] == '-') {
+         files = 0;
+         break;
+      } else if (nmea_test_load (option)) {
+         files++;
+      } else {
+         return 1;
+      }
+   }
+
+   if (files == 0) {
+      fprintf (stderr, "usage: %s [--nmea-repeat=N] [--nmea-fuzz=N] "
+                       "[--nmea-seed=N] FILE...\n", argv[0]);
+      return 1;
+   }
+
+   if (NmeaTestLineCount == 0) {
+      fprintf (stderr, "no NMEA sentence in the logs\n");
+      return 1;
+   }
+
+   srand (NmeaTestSeed);
+
+   account = roadmap_nmea_create ("nmeatest");
+
+   for (i = 0; i < (int) (sizeof(NmeaTestSentences) / sizeof(NmeaTestSentences[0])); ++i) {
+      roadmap_nmea_subscribe (NmeaTestSentences[i].vendor,
+                              NmeaTestSentences[i].sentence,
+                              nmea_test_listener,
+                              account);
+   }
+
+   if (nmea_test_throughput (account) == 0) {
+      fprintf (stderr, "no sentence of the logs could be decoded\n");
+      return 1;
+   }
+
+   nmea_test_fuzz (account);
+
+   return 0;
+}
@@ -0,0 +1,338 @@
+/* roadmap_rtpath_test.c - Round trip of the compact GPS and node paths.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Random GPS tracks and node paths are encoded into the GPSPathC and
+ *   NodePathC commands (see RealtimeNet.c), decoded here as the server
+ *   does, and compared with the original values. The tracks are mostly
+ *   driving-like (small steps, one second apart), with some jumps across
+ *   the world, long gaps and the extreme coordinates.
+ *
+ *   The commands are built in buffers of the size RealtimeNet.c allocates
+ *   for them, and must be single text lines: only '?'..'~' in the values.
+ *
+ *   The size of the text GPSPath commands is printed for comparison.
+ *
+ * SYNOPSYS:
+ *
+ *   gtkroadmap-rtpathtest [--rtpath-count=N] [--rtpath-seed=N]
+ *
+ *   The exit code is 1 if a path did not come back the same.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "Realtime/RealtimeNet.h"
+#include "editor/db/editor_point.h"
+
+
+#define RTPATH_TEST_MAX_REPORT  10
+
+static int          RtPathTestCount = 10000;
+static unsigned int RtPathTestSeed  = 1;
+
+static int  RtPathTestMismatches = 0;
+static long RtPathTestCompactSize = 0;
+static long RtPathTestTextSize = 0;
+
+
+static int rtpath_test_random (int low, int high) {
+
+   return low + (int) ((double) rand () / ((double) RAND_MAX + 1) * ((double) high - low + 1));
+}
+
+
+static void rtpath_test_fail (const char *name, int index, const char *packet) {
+
+   if (++RtPathTestMismatches <= RTPATH_TEST_MAX_REPORT) {
+      printf ("%s: bad value %d in '%.60s...'\n", name, index, packet);
+   }
+}
+
+
+/* Decode one value; NULL if the digits are not those of a value. */
+static const char *rtpath_test_decode_value (const char *next, int *value) {
+
+   unsigned int zigzag = 0;
+   int shift = 0;
+
+   for (;;) {
+
+      int digit = *next - 63;
+
+      if (digit < 0 || digit > 63 || shift > 30) return NULL;
+      next++;
+
+      zigzag |= (unsigned int) (digit & 0x1f) << shift;
+      shift += 5;
+
+      if (!(digit & 0x20)) break;
+   }
+
+   *value = (int) ((zigzag >> 1) ^ (0 - (zigzag & 1)));
+
+   return next;
+}
+
+
+/* Decode 'count' values; returns the end of the values. */
+static const char *rtpath_test_decode_values (const char *next,
+                                              int count, int *values) {
+
+   int i;
+
+   for (i = 0; i < count && next != NULL; ++i) {
+      next = rtpath_test_decode_value (next, values + i);
+   }
+
+   return next;
+}
+
+
+/* The first value is absolute, the others are deltas (wrapping around). */
+static int rtpath_test_add (int value, int delta) {
+
+   return (int) ((unsigned int) value + (unsigned int) delta);
+}
+
+
+static void rtpath_test_random_track (GPSPointInTime *points, int count) {
+
+   int i;
+
+   points[0].Position.longitude = rtpath_test_random (-180000000, 180000000);
+   points[0].Position.latitude  = rtpath_test_random (-90000000, 90000000);
+   points[0].altitude           = rtpath_test_random (-400, 9000);
+   points[0].GPS_time           = 1280000000 + rtpath_test_random (0, 100000000);
+
+   for (i = 1; i < count; ++i) {
+
+      points[i] = points[i-1];
+
+      switch (rtpath_test_random (0, 19)) {
+
+      case 0: /* Anywhere */
+         points[i].Position.longitude = rtpath_test_random (-180000000, 180000000);
+         points[i].Position.latitude  = rtpath_test_random (-90000000, 90000000);
+         points[i].GPS_time += rtpath_test_random (0, 30 * 24 * 3600);
+         break;
+
+      case 1: /* The extremes */
+         points[i].Position.longitude = rtpath_test_random (0, 1) ? 180000000 : -180000000;
+         points[i].Position.latitude  = rtpath_test_random (0, 1) ? 90000000 : -90000000;
+         points[i].altitude = rtpath_test_random (-100000, 100000);
+         break;
+
+      default: /* Driving, up to 200 km/h */
+         points[i].Position.longitude += rtpath_test_random (-700, 700);
+         points[i].Position.latitude  += rtpath_test_random (-500, 500);
+         points[i].altitude += rtpath_test_random (-5, 5);
+         points[i].GPS_time += rtpath_test_random (0, 3);
+         break;
+      }
+
+      /* Not the invalid position. */
+      if (points[i].Position.longitude == INVALID_COORDINATE) {
+         points[i].Position.longitude = 0;
+      }
+      if (points[i].Position.latitude == INVALID_COORDINATE) {
+         points[i].Position.latitude = 0;
+      }
+   }
+}
+
+
+static void rtpath_test_gps (int count, BOOL end_track) {
+
+   static GPSPointInTime points[RTTRK_GPSPATH_MAX_POINTS];
+   static int values[4 * RTTRK_GPSPATH_MAX_POINTS];
+   char *packet;
+   const char *next;
+   int longitude = 0;
+   int latitude  = 0;
+   int altitude  = 0;
+   int header;
+   int i;
+
+   rtpath_test_random_track (points, count);
+
+   packet = malloc (RTNET_GPSPATH_BUFFERSIZE__dynamic(count));
+   roadmap_check_allocated (packet);
+
+   RTNet_GPSPath_BuildCommand (packet, points, count, end_track);
+   RtPathTestTextSize += strlen (packet);
+
+   RTNet_GPSPath_BuildCompactCommand (packet, points, count, end_track);
+   RtPathTestCompactSize += strlen (packet);
+
+   if (sscanf (packet, "GPSPathC,%*u,%d,%n", &i, &header) != 1 || i != count) {
+      rtpath_test_fail ("GPSPathC", -1, packet);
+      free (packet);
+      return;
+   }
+
+   next = rtpath_test_decode_values (packet + header, 4 * count, values);
+
+   if (next == NULL ||
+       strcmp (next, end_track ? "\nGPSDisconnect\n" : "\n")) {
+      rtpath_test_fail ("GPSPathC", -1, packet);
+      free (packet);
+      return;
+   }
+
+   for (i = 0; i < count; ++i) {
+
+      int gap = i ? (int) (points[i].GPS_time - points[i-1].GPS_time) : 0;
+
+      longitude = rtpath_test_add (longitude, values[4*i]);
+      latitude  = rtpath_test_add (latitude,  values[4*i+1]);
+      altitude  = rtpath_test_add (altitude,  values[4*i+2]);
+
+      if (longitude != points[i].Position.longitude ||
+          latitude  != points[i].Position.latitude ||
+          altitude  != points[i].altitude ||
+          values[4*i+3] != gap) {
+         rtpath_test_fail ("GPSPathC", i, packet);
+         break;
+      }
+   }
+
+   free (packet);
+}
+
+
+static void rtpath_test_node (int count, BOOL with_points) {
+
+   static NodeInTime nodes[RTTRK_NODEPATH_MAX_POINTS];
+   static UserPointsVer user_points[RTTRK_NODEPATH_MAX_POINTS];
+   static int values[2 * RTTRK_NODEPATH_MAX_POINTS];
+   char *packet;
+   const char *next;
+   int node = 0;
+   int version = 0;
+   int header;
+   int type;
+   int i;
+
+   for (i = 0; i < count; ++i) {
+
+      nodes[i].node = rtpath_test_random (0, 0x7fffffff);
+      nodes[i].GPS_time = (i ? nodes[i-1].GPS_time : 1280000000) + rtpath_test_random (0, 600);
+
+      user_points[i].points  = rtpath_test_random (0, 1000000);
+      user_points[i].version = rtpath_test_random (-1, 100000);
+   }
+
+   packet = malloc (RTNET_GPSPATH_BUFFERSIZE__dynamic(count));
+   roadmap_check_allocated (packet);
+
+   RTNet_NodePath_BuildCompactCommand (packet, 1280000000, nodes, count,
+                                       with_points ? user_points : NULL);
+
+   if (sscanf (packet, "NodePathC,%*d,%d,%n", &i, &header) != 1 || i != count) {
+      rtpath_test_fail ("NodePathC", -1, packet);
+      free (packet);
+      return;
+   }
+
+   next = rtpath_test_decode_values (packet + header, 2 * count, values);
+
+   for (i = 0; next != NULL && i < count; ++i) {
+
+      int gap = i ? (int) (nodes[i].GPS_time - nodes[i-1].GPS_time) : 0;
+
+      node = rtpath_test_add (node, values[2*i]);
+
+      if (node != nodes[i].node || values[2*i+1] != gap) {
+         rtpath_test_fail ("NodePathC", i, packet);
+         free (packet);
+         return;
+      }
+   }
+
+   if (next != NULL && with_points) {
+
+      if (sscanf (next, ",%d,%n", &type, &header) != 1 ||
+          type != EDITOR_POINT_TYPE_MUNCHING) {
+         next = NULL;
+      } else {
+         next = rtpath_test_decode_values (next + header, 2 * count, values);
+      }
+
+      /* The versions are sent as deltas, the points are not. */
+      for (i = 0; next != NULL && i < count; ++i) {
+
+         version = rtpath_test_add (version, values[2*i+1]);
+
+         if (values[2*i] != user_points[i].points ||
+             version != user_points[i].version) {
+            rtpath_test_fail ("NodePathC points", i, packet);
+            free (packet);
+            return;
+         }
+      }
+   }
+
+   if (next == NULL || *next != 0) {
+      rtpath_test_fail ("NodePathC", -1, packet);
+   }
+
+   free (packet);
+}
+
+
+int main (int argc, char **argv) {
+
+   int i;
+
+   for (i = 1; i < argc; i++) {
+      if (!strncmp (argv[i], "--rtpath-count=", 15)) {
+         RtPathTestCount = atoi (argv[i] + 15);
+      } else if (!strncmp (argv[i], "--rtpath-seed=", 14)) {
+         RtPathTestSeed = (unsigned int) atoi (argv[i] + 14);
+      } else {
+         fprintf (stderr, "usage: %s [--rtpath-count=N] [--rtpath-seed=N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   srand (RtPathTestSeed);
+
+   for (i = 0; i < RtPathTestCount; ++i) {
+
+      rtpath_test_gps (rtpath_test_random (2, RTTRK_GPSPATH_MAX_POINTS),
+                       rtpath_test_random (0, 3) == 0);
+
+      rtpath_test_node (rtpath_test_random (1, RTTRK_NODEPATH_MAX_POINTS),
+                        rtpath_test_random (0, 1));
+   }
+
+   printf ("%d GPS and node paths, GPSPathC %ld bytes (GPSPath %ld bytes), %d mismatches\n",
+           RtPathTestCount, RtPathTestCompactSize, RtPathTestTextSize,
+           RtPathTestMismatches);
+
+   return RtPathTestMismatches ? 1 : 0;
+}
@@ -0,0 +1,63 @@
+/* roadmap_test_log.c - The log for the drivers linked without roadmap_log.c.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The unit checks and the websvc drivers are linked with the code they
+ *   exercise only (see the Makefile), not with the log and its files.
+ *
+ *   The log goes to stderr: warnings and up, or all of it if
+ *   ROADMAP_TEST_DEBUG is set. A fatal error exits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "roadmap.h"
+
+
+void roadmap_log (int level, const char *source, int line, const char *format, ...) {
+
+   va_list ap;
+
+   if (level < ROADMAP_MESSAGE_WARNING && getenv ("ROADMAP_TEST_DEBUG") == NULL) return;
+
+   fprintf (stderr, "%s:%d ", source, line);
+
+   va_start (ap, format);
+   vfprintf (stderr, format, ap);
+   va_end (ap);
+
+   fputc ('\n', stderr);
+
+   if (level >= ROADMAP_MESSAGE_FATAL) exit (1);
+}
+
+
+void roadmap_check_allocated_with_source_line (const char *source, int line,
+                                               const void *allocated) {
+
+   if (allocated == NULL) {
+      roadmap_log (ROADMAP_MESSAGE_FATAL, source, line, "no more memory");
+   }
+}
@@ -0,0 +1,288 @@
+/* roadmap_tts_replay.c - Replay a route and report the TTS prefetch.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The application on the headless main loop, driven along a fixed route:
+ *   the GPS source is an object that this driver moves from one position
+ *   of the route to the next, once per second of the route. After the
+ *   first fixes, the last position is set as the destination and the
+ *   navigation starts. When the route is over, the street prompt prefetch
+ *   statistics of the navigation are printed (see navigate_tts.c).
+ *
+ *   The route has one position per line, one second apart ('#' starts a
+ *   comment):
+ *
+ *      longitude latitude speed
+ *
+ *   where the position is in millionths of a degree and the speed in km/h.
+ *
+ *   The navigation route comes from the routing server, which needs the
+ *   login. To run offline, the route can be read from a file instead: the
+ *   route commands of a server response (RoutingResponseCode,
+ *   RoutingResponse, RoutePoints, RouteSegments), one per line, e.g. saved
+ *   from an online run of the same drive (see navigate_route_trans.h). The
+ *   map tiles of the route must then be in the cache.
+ *
+ * SYNOPSYS:
+ *
+ *   gtkroadmap-ttsreplay --replay-route=FILE [--replay-navigation=FILE]
+ *                        [--replay-rate=N] [roadmap options]
+ *
+ *   The route is replayed N times faster than it was driven (default 1).
+ *   The exit code is 1 if no street prompt was announced. replay_route.txt
+ *   is a short drive in Tel Aviv.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_math.h"
+#include "roadmap_gps.h"
+#include "roadmap_trip.h"
+#include "roadmap_object.h"
+#include "roadmap_string.h"
+#include "roadmap_start.h"
+#include "roadmap_canvas.h"
+#include "navigate/navigate_main.h"
+#include "navigate/navigate_route.h"
+#include "navigate/navigate_route_trans.h"
+#include "navigate/navigate_tts.h"
+
+#include "roadmap_main.h"
+#include "unix/roadmap_main_epoll.h"
+
+
+#define REPLAY_OBJECT        "TtsReplay"
+#define REPLAY_MAX_RATE      20
+#define REPLAY_NAVIGATE_AT   3     /* Fixes before the navigation starts */
+#define REPLAY_KNOTS(kmh)    ((kmh) * 1000 / 1852)
+
+static RoadMapGpsPosition *ReplayRoute      = NULL;
+static int                 ReplayRouteCount = 0;
+static int                 ReplayIndex      = 0;
+
+static const char *ReplayFile = NULL;
+static const char *ReplayNavigationFile = NULL;
+static int         ReplayRate = 1;
+
+static RoadMapDynamicString ReplayObject;
+
+static int ReplayAnnounced = 0;
+
+
+static int replay_load_route (const char *file_name) {
+
+   FILE *file = fopen (file_name, "r");
+   char line[256];
+   int size = 0;
+
+   if (file == NULL) {
+      fprintf (stderr, "cannot open %s\n", file_name);
+      return 0;
+   }
+
+   while (fgets (line, sizeof(line), file) != NULL) {
+
+      RoadMapGpsPosition position;
+      char *comment = strchr (line, '#');
+      int speed;
+
+      if (comment != NULL) *comment = 0;
+
+      memset (&position, 0, sizeof(position));
+
+      if (sscanf (line, "%d %d %d",
+                  &position.longitude, &position.latitude, &speed) != 3) {
+         continue;
+      }
+      position.speed = REPLAY_KNOTS (speed);
+
+      if (ReplayRouteCount >= size) {
+         size = size ? 2 * size : 1024;
+         ReplayRoute = realloc (ReplayRoute, size * sizeof(RoadMapGpsPosition));
+         roadmap_check_allocated (ReplayRoute);
+      }
+      ReplayRoute[ReplayRouteCount++] = position;
+   }
+
+   fclose (file);
+
+   if (ReplayRouteCount <= REPLAY_NAVIGATE_AT) {
+      fprintf (stderr, "%s: the route is too short\n", file_name);
+      return 0;
+   }
+
+   return 1;
+}
+
+
+/* The steering is the direction to the next position of the route. */
+static void replay_set_steering (void) {
+
+   int i;
+
+   for (i = 0; i < ReplayRouteCount; ++i) {
+
+      RoadMapPosition from;
+      RoadMapPosition to;
+      int next = (i + 1 < ReplayRouteCount) ? i + 1 : i;
+      int previous = (next == i) ? i - 1 : i;
+
+      from.longitude = ReplayRoute[previous].longitude;
+      from.latitude  = ReplayRoute[previous].latitude;
+      to.longitude   = ReplayRoute[next].longitude;
+      to.latitude    = ReplayRoute[next].latitude;
+
+      ReplayRoute[i].steering = roadmap_math_azymuth (&from, &to);
+   }
+}
+
+
+static void replay_report (void) {
+
+   NavTtsPrefetchStats stats;
+
+   navigate_tts_prefetch_stats (&stats);
+
+   ReplayAnnounced = stats.hits + stats.misses;
+
+   printf ("%d positions, %d streets requested, %d of %d street prompts ready",
+           ReplayRouteCount, stats.requested, stats.hits, ReplayAnnounced);
+   if (ReplayAnnounced > 0) {
+      printf (" (%d%%)", stats.hits * 100 / ReplayAnnounced);
+   }
+   if (stats.first_audio >= 0) {
+      printf (", first prompt after %d ms", stats.first_audio);
+   } else {
+      printf (", no prompt ready");
+   }
+   printf (", %d bytes of audio (at most %d ahead)\n",
+           stats.audio_bytes, stats.ahead_bytes_max);
+}
+
+
+static void replay_step (void) {
+
+   if (ReplayIndex >= ReplayRouteCount) {
+
+      roadmap_main_remove_periodic (replay_step);
+
+      replay_report ();
+      roadmap_main_exit ();
+      return;
+   }
+
+   roadmap_object_move (ReplayObject, ReplayRoute + ReplayIndex);
+
+   if (++ReplayIndex == REPLAY_NAVIGATE_AT) {
+
+      RoadMapPosition destination;
+
+      destination.longitude = ReplayRoute[ReplayRouteCount-1].longitude;
+      destination.latitude  = ReplayRoute[ReplayRouteCount-1].latitude;
+
+      roadmap_trip_set_point ("Destination", &destination);
+      navigate_main_route (NAV_ROUTE_FLAGS_NONE);
+   }
+}
+
+
+/* Take out the driver's own options, the others go to roadmap_start(). */
+static int replay_options (int argc, char **argv) {
+
+   int i;
+   int count = 1;
+
+   for (i = 1; i < argc; i++) {
+
+      const char *option = argv[i];
+
+      if (!strncmp (option, "--replay-route=", 15)) {
+         ReplayFile = option + 15;
+      } else if (!strncmp (option, "--replay-navigation=", 20)) {
+         ReplayNavigationFile = option + 20;
+      } else if (!strncmp (option, "--replay-rate=", 14)) {
+         ReplayRate = atoi (option + 14);
+         if (ReplayRate < 1) ReplayRate = 1;
+         if (ReplayRate > REPLAY_MAX_RATE) ReplayRate = REPLAY_MAX_RATE;
+      } else {
+         argv[count++] = argv[i];
+      }
+   }
+
+   return count;
+}
+
+
+int main (int argc, char **argv) {
+
+   char **start_argv;
+   int i;
+
+   argc = replay_options (argc, argv);
+
+   if (ReplayFile == NULL) {
+      fprintf (stderr, "usage: %s --replay-route=FILE [--replay-navigation=FILE] "
+                       "[--replay-rate=N] [roadmap options]\n", argv[0]);
+      return 1;
+   }
+
+   if (!replay_load_route (ReplayFile)) {
+      return 1;
+   }
+
+   /* The GPS positions come from the replay object. */
+   start_argv = malloc ((argc + 2) * sizeof(char *));
+   roadmap_check_allocated (start_argv);
+
+   for (i = 0; i < argc; ++i) {
+      start_argv[i] = argv[i];
+   }
+   start_argv[argc++] = "--gps=object:" REPLAY_OBJECT;
+   start_argv[argc] = NULL;
+
+   roadmap_main_headless_initialize ();
+
+   roadmap_start (argc, start_argv);
+
+   roadmap_canvas_headless_configure (480, 800);
+
+   if (ReplayNavigationFile != NULL) {
+      navigate_route_set_response_file (ReplayNavigationFile);
+   }
+
+   replay_set_steering ();
+
+   /* Adding the object opens the GPS on it. */
+   ReplayObject = roadmap_string_new (REPLAY_OBJECT);
+   roadmap_object_add (ReplayObject, ReplayObject, ReplayObject, NULL, NULL,
+                       ReplayRoute, NULL, 0, NULL);
+
+   roadmap_main_set_periodic (1000 / ReplayRate, replay_step);
+
+   roadmap_main_headless_run ();
+
+   return ReplayAnnounced > 0 ? 0 : 1;
+}
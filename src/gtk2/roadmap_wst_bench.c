@@ -0,0 +1,473 @@
+/* roadmap_wst_bench.c - Time the parsing of recorded websvc responses.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   A local HTTP server runs in a thread and answers each request with one
+ *   of the recorded responses, in turn. A websvc session sends it the
+ *   transactions one after the other, on the headless main loop, with the
+ *   tags of the realtime session (general_parser in RealtimeNet.c). The
+ *   parsers only skip their line, so that the time is that of the tag
+ *   lookup and of the line handling in OnCustomResponse().
+ *
+ *   A recorded response is the body of a realtime response, one line per
+ *   command (e.g. "AddAlert,..."), as written in the log at debug level.
+ *
+ * SYNOPSYS:
+ *
+ *   gtkroadmap-wstbench [--wst-bench-repeat=N] FILE...
+ *
+ *   Every response is parsed N times (default 20). The exit code is 1 if
+ *   a transaction failed. wst_response.txt is the response to a map
+ *   display in a busy area (users, alerts, comments and road info).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "roadmap.h"
+#include "roadmap_net.h"
+#include "websvc_trans/websvc_trans.h"
+
+#include "roadmap_main.h"
+#include "unix/roadmap_main_epoll.h"
+
+
+#define WST_BENCH_MAX_FILES   64
+#define WST_BENCH_MAX_REPEAT  10000
+#define WST_BENCH_TIMEOUT     60000
+
+static char *WstBenchResponse[WST_BENCH_MAX_FILES];
+static int   WstBenchResponseSize[WST_BENCH_MAX_FILES];
+static int   WstBenchResponseLines[WST_BENCH_MAX_FILES];
+static int   WstBenchFiles = 0;
+
+static int   WstBenchRepeat = 20;
+
+static int   WstBenchPort;
+static char  WstBenchService[64];
+
+static int   WstBenchServed;      /* Responses sent by the server */
+static int   WstBenchTransactions;
+static int   WstBenchCompleted;
+static long  WstBenchExpected;    /* Lines in the responses sent */
+static long  WstBenchParsed;      /* Lines parsed by the session */
+static int   WstBenchFailed;
+
+static double WstBenchStart;
+static double WstBenchElapsed;
+
+static wst_handle WstBenchSession;
+
+
+static double wst_bench_now (void) {
+
+   struct timeval now;
+
+   gettimeofday (&now, NULL);
+   return now.tv_sec * 1000.0 + now.tv_usec / 1000.0;
+}
+
+
+static int wst_bench_load (const char *file_name) {
+
+   FILE *file;
+   char *data;
+   long size;
+   int lines = 0;
+   int empty;
+   int i;
+
+   if (WstBenchFiles >= WST_BENCH_MAX_FILES) {
+      fprintf (stderr, "too many files, %d max\n", WST_BENCH_MAX_FILES);
+      return 0;
+   }
+
+   file = fopen (file_name, "rb");
+   if (file == NULL) {
+      fprintf (stderr, "cannot open %s\n", file_name);
+      return 0;
+   }
+
+   fseek (file, 0, SEEK_END);
+   size = ftell (file);
+   fseek (file, 0, SEEK_SET);
+
+   /* Room for a missing end of line. */
+   data = malloc (size + 2);
+   roadmap_check_allocated (data);
+
+   if (size <= 0 || fread (data, 1, size, file) != (size_t) size) {
+      fprintf (stderr, "cannot read %s\n", file_name);
+      fclose (file);
+      free (data);
+      return 0;
+   }
+   fclose (file);
+
+   /* Each command of a response ends with a '\n'. */
+   if (data[size-1] != '\n') data[size++] = '\n';
+   data[size] = 0;
+
+   /* The empty lines are skipped, they are not commands. */
+   for (i = 0, empty = 1; i < size; ++i) {
+      if (data[i] == '\n') {
+         if (!empty) lines++;
+         empty = 1;
+      } else if (data[i] != '\r') {
+         empty = 0;
+      }
+   }
+
+   WstBenchResponse[WstBenchFiles] = data;
+   WstBenchResponseSize[WstBenchFiles] = (int) size;
+   WstBenchResponseLines[WstBenchFiles] = lines;
+   WstBenchFiles++;
+
+   return 1;
+}
+
+
+/* The server. ------------------------------------------------------------- */
+
+/* Read one request; returns 0 when the client closed the connection. */
+static int wst_bench_read_request (int fd, char *request, int size) {
+
+   int length = 0;
+   int content_length = 0;
+   char *header_end = NULL;
+   char *field;
+
+   while (header_end == NULL ||
+          length < (header_end + 4 - request) + content_length) {
+
+      int received;
+
+      if (length >= size - 1) return -1;
+
+      received = read (fd, request + length, size - 1 - length);
+      if (received <= 0) return received;
+
+      length += received;
+      request[length] = '\0';
+
+      if (header_end == NULL) {
+         header_end = strstr (request, "\r\n\r\n");
+         if (header_end != NULL) {
+            field = strstr (request, "Content-Length:");
+            if (field != NULL && field < header_end) {
+               content_length = atoi (field + 15);
+            }
+         }
+      }
+   }
+
+   return length;
+}
+
+
+static void wst_bench_serve (int fd) {
+
+   char request[4096];
+   char header[256];
+
+   while (wst_bench_read_request (fd, request, sizeof(request)) > 0) {
+
+      int file = WstBenchServed++ % WstBenchFiles;
+      int length;
+
+      length = snprintf (header, sizeof(header),
+                         "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: text/plain\r\n"
+                         "Content-Length: %d\r\n"
+                         "Connection: keep-alive\r\n"
+                         "\r\n",
+                         WstBenchResponseSize[file]);
+
+      if (write (fd, header, length) != length ||
+          write (fd, WstBenchResponse[file], WstBenchResponseSize[file])
+             != WstBenchResponseSize[file]) {
+         return;
+      }
+   }
+}
+
+
+static void *wst_bench_server (void *context) {
+
+   int listener = *(int *) context;
+
+   for (;;) {
+
+      int fd = accept (listener, NULL, NULL);
+      if (fd < 0) break;
+
+      wst_bench_serve (fd);
+      close (fd);
+   }
+
+   return NULL;
+}
+
+
+static int wst_bench_listen (void) {
+
+   static int listener;
+   struct sockaddr_in addr;
+   socklen_t addr_size = sizeof(addr);
+   pthread_t thread;
+
+   listener = socket (AF_INET, SOCK_STREAM, 0);
+   if (listener < 0) return 0;
+
+   memset (&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+   addr.sin_port = 0;
+
+   if (bind (listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+       listen (listener, 4) < 0 ||
+       getsockname (listener, (struct sockaddr *) &addr, &addr_size) < 0) {
+      close (listener);
+      return 0;
+   }
+
+   WstBenchPort = ntohs (addr.sin_port);
+
+   if (pthread_create (&thread, NULL, wst_bench_server, &listener) != 0) {
+      close (listener);
+      return 0;
+   }
+   pthread_detach (thread);
+
+   return 1;
+}
+
+
+/* The session. ------------------------------------------------------------ */
+
+static const char *wst_bench_parser (const char *data,
+                                     void *context,
+                                     BOOL *more_data_needed,
+                                     roadmap_result *rc) {
+
+   (*more_data_needed) = FALSE;
+   (*rc) = succeeded;
+
+   WstBenchParsed++;
+
+   return strchr (data, '\n');
+}
+
+/* The tags of general_parser in RealtimeNet.c, in the same order. The last
+ * parser takes the lines of the other sessions' tags.
+ */
+static wst_parser WstBenchParsers[] = {
+   { "RC",                       wst_bench_parser },
+   { "AddUser",                  wst_bench_parser },
+   { "AddAlert",                 wst_bench_parser },
+   { "AddAlertComment",          wst_bench_parser },
+   { "RmAlert",                  wst_bench_parser },
+   { "SystemMessage",            wst_bench_parser },
+   { "UpgradeClient",            wst_bench_parser },
+   { "AddRoadInfo",              wst_bench_parser },
+   { "RoadInfoGeom",             wst_bench_parser },
+   { "RoadInfoSegments",         wst_bench_parser },
+   { "RmRoadInfo",               wst_bench_parser },
+   { "BridgeToRes",              wst_bench_parser },
+   { "ReportAlertRes",           wst_bench_parser },
+   { "ReportTrafficRes",         wst_bench_parser },
+   { "PostAlertCommentRes",      wst_bench_parser },
+   { "MapUpdateTime",            wst_bench_parser },
+   { "GeoLocation",              wst_bench_parser },
+   { "UpdateUserPoints",         wst_bench_parser },
+   { "RoutingResponseCode",      wst_bench_parser },
+   { "RoutingResponse",          wst_bench_parser },
+   { "RoutePoints",              wst_bench_parser },
+   { "RouteSegments",            wst_bench_parser },
+   { "EventOnRoute",             wst_bench_parser },
+   { "SuggestReroute",           wst_bench_parser },
+   { "GeoServerConfig",          wst_bench_parser },
+   { "ServerConfig",             wst_bench_parser },
+   { "AddCustomBonus",           wst_bench_parser },
+   { "AddBonus",                 wst_bench_parser },
+   { "RmBonus",                  wst_bench_parser },
+   { "CollectBonusRes",          wst_bench_parser },
+   { "OpenMessageTicker",        wst_bench_parser },
+   { "UpdateConfig",             wst_bench_parser },
+   { "UserGroups",               wst_bench_parser },
+   { "OpenMoodSelection",        wst_bench_parser },
+   { "AddExternalPoiType",       wst_bench_parser },
+   { "AddExternalPoi",           wst_bench_parser },
+   { "RmExternalPoi",            wst_bench_parser },
+   { "SetExternalPoiDrawOrder",  wst_bench_parser },
+   { "ThumbsUpRes",              wst_bench_parser },
+   { "UpdateAlert",              wst_bench_parser },
+   { "UpdateInboxCount",         wst_bench_parser },
+   { "ThumbsUpReceived",         wst_bench_parser },
+   { "AddBonusTemplate",         wst_bench_parser },
+   { NULL,                       wst_bench_parser }
+};
+
+
+static void wst_bench_timeout (void);
+
+static void wst_bench_done (void) {
+
+   WstBenchElapsed = wst_bench_now () - WstBenchStart;
+
+   roadmap_main_remove_periodic (wst_bench_timeout);
+   roadmap_main_headless_stop ();
+}
+
+
+static void wst_bench_timeout (void) {
+
+   fprintf (stderr, "timed out after %d transactions\n", WstBenchCompleted);
+   WstBenchFailed = 1;
+   wst_bench_done ();
+}
+
+
+static BOOL wst_bench_send (void);
+
+static void wst_bench_completed (void *context, roadmap_result res) {
+
+   if (res != succeeded) {
+      fprintf (stderr, "transaction %d failed, result %d\n", WstBenchCompleted + 1, res);
+      WstBenchFailed = 1;
+      wst_bench_done ();
+      return;
+   }
+
+   WstBenchExpected += WstBenchResponseLines[WstBenchCompleted % WstBenchFiles];
+
+   if (++WstBenchCompleted == WstBenchTransactions) {
+      wst_bench_done ();
+      return;
+   }
+
+   if (!wst_bench_send ()) {
+      WstBenchFailed = 1;
+      wst_bench_done ();
+   }
+}
+
+
+static BOOL wst_bench_send (void) {
+
+   return wst_start_trans (WstBenchSession,
+                           0,
+                           "Bench",
+                           -1,
+                           WstBenchParsers,
+                           sizeof(WstBenchParsers) / sizeof(WstBenchParsers[0]),
+                           wst_bench_completed,
+                           NULL,
+                           "Request,%d\n",
+                           WstBenchCompleted + 1);
+}
+
+
+int main (int argc, char **argv) {
+
+   long bytes = 0;
+   int i;
+
+   for (i = 1; i < argc; i++) {
+
+      const char *option = argv[i];
+
+      if (!strncmp (option, "--wst-bench-repeat=", 19)) {
+         WstBenchRepeat = atoi (option + 19);
+         if (WstBenchRepeat < 1) WstBenchRepeat = 1;
+         if (WstBenchRepeat > WST_BENCH_MAX_REPEAT) WstBenchRepeat = WST_BENCH_MAX_REPEAT;
+      } else if (option[0] == '-') {
+         WstBenchFiles = 0;
+         break;
+      } else if (!wst_bench_load (option)) {
+         return 1;
+      }
+   }
+
+   if (WstBenchFiles == 0) {
+      fprintf (stderr, "usage: %s [--wst-bench-repeat=N] FILE...\n", argv[0]);
+      return 1;
+   }
+
+   WstBenchTransactions = WstBenchFiles * WstBenchRepeat;
+
+   roadmap_main_headless_initialize ();
+
+   roadmap_net_initialize ();
+
+   if (!wst_bench_listen ()) {
+      fprintf (stderr, "cannot start the local server\n");
+      return 1;
+   }
+
+   snprintf (WstBenchService, sizeof(WstBenchService), "http://127.0.0.1:%d/wstbench", WstBenchPort);
+
+   WstBenchSession = wst_init (WstBenchService, NULL, NULL, NULL, "binary/octet-stream");
+
+   WstBenchStart = wst_bench_now ();
+
+   if (WstBenchSession == INVALID_WEBSVC_HANDLE || !wst_bench_send ()) {
+      fprintf (stderr, "cannot start a transaction\n");
+      return 1;
+   }
+
+   roadmap_main_set_periodic (WST_BENCH_TIMEOUT, wst_bench_timeout);
+
+   roadmap_main_headless_run ();
+
+   wst_term (WstBenchSession);
+   roadmap_net_shutdown ();
+
+   for (i = 0; i < WstBenchFiles; ++i) {
+      bytes += WstBenchResponseSize[i];
+   }
+
+   printf ("%d responses (%ld bytes), %d transactions, %ld of %ld lines parsed\n",
+           WstBenchFiles, bytes, WstBenchCompleted, WstBenchParsed, WstBenchExpected);
+
+   if (WstBenchCompleted > 0 && WstBenchParsed > 0) {
+      printf ("%.3f ms per response, %.3f us per line\n",
+              WstBenchElapsed / WstBenchCompleted,
+              WstBenchElapsed * 1000.0 / WstBenchParsed);
+   }
+
+   if (!WstBenchFailed && WstBenchParsed != WstBenchExpected) {
+      fprintf (stderr, "some lines were not parsed\n");
+      WstBenchFailed = 1;
+   }
+
+   return WstBenchFailed ? 1 : 0;
+}
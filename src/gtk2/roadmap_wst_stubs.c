@@ -0,0 +1,108 @@
+/* roadmap_wst_stubs.c - What the websvc drivers need outside of websvc_trans.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   roadmap_wst_test.c and roadmap_wst_bench.c are linked with the websvc
+ *   code, the network and the epoll main loop only (see the Makefile).
+ *   These are the few other RoadMap functions that code calls.
+ *
+ *   There is no configuration, no language, no SSL and no screen. The log
+ *   is that of roadmap_test_log.c.
+ */
+
+#include <stdio.h>
+#include <strings.h>
+
+#include "roadmap.h"
+#include "roadmap_io.h"
+#include "roadmap_file.h"
+#include "roadmap_path.h"
+#include "roadmap_lang.h"
+#include "roadmap_message.h"
+#include "roadmap_screen.h"
+#include "roadmap_ssl.h"
+#include "roadmap_start.h"
+#include "roadmap_string.h"
+
+
+/* Only sockets here: see roadmap_io.c for the other subsystems. */
+int roadmap_io_same (RoadMapIO *io1, RoadMapIO *io2) {
+
+   if (io1->subsystem != io2->subsystem) return 0;
+
+   if (io1->subsystem == ROADMAP_IO_NET) {
+      return io1->os.socket == io2->os.socket;
+   }
+
+   return io1->os.file == io2->os.file;
+}
+
+
+int roadmap_file_exists (const char *path, const char *name) { return 0; }
+
+FILE *roadmap_file_fopen (const char *path, const char *name, const char *mode) {
+   return NULL;
+}
+
+const char *roadmap_path_config (void) { return "/tmp"; }
+
+const char *roadmap_path_first (const char *name) { return NULL; }
+
+const char *roadmap_path_next (const char *name, const char *current) {
+   return NULL;
+}
+
+const char *roadmap_lang_get (const char *name) { return name; }
+
+int roadmap_lang_rtl (void) { return 0; }
+
+void roadmap_message_set (char parameter, const char *format, ...) {}
+
+void roadmap_message_unset (char parameter) {}
+
+const char *roadmap_result_string (int res) { return "error"; }
+
+void roadmap_screen_redraw (void) {}
+
+int roadmap_ssl_open (RoadMapSocket s, void *data,
+                      RoadMapNetSslConnectCallback callback) {
+   return -1;
+}
+
+void roadmap_ssl_close (void *context) {}
+
+int roadmap_ssl_read (void *context, void *buffer, int buffer_size) {
+   return -1;
+}
+
+int roadmap_ssl_send (RoadMapSslIO io, const void *data, int length) {
+   return -1;
+}
+
+void roadmap_start_exit (void) {}
+
+const char *roadmap_start_version (void) { return "wst"; }
+
+int roadmap_string_compare_ignore_case (const char *str1, const char *str2) {
+   return strcasecmp (str1, str2);
+}
@@ -0,0 +1,402 @@
+/* roadmap_wst_test.c - Check that the websvc connections are kept alive.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   A local HTTP server runs in a thread, and a websvc session sends it a
+ *   number of transactions one after the other, on the headless main loop.
+ *   The server answers keep-alive with a Content-Length, and gzip encodes
+ *   the response when the request asks for it, as the real servers do.
+ *   The compressed body is written in two parts, so that it does not
+ *   arrive whole.
+ *
+ *   Network compression is enabled: the check passes if all the
+ *   transactions succeeded on one connection, with gzip responses, and
+ *   all the response lines were parsed. Responses of many lines (see
+ *   --wst-lines) decompress to more than the session reads at once.
+ *
+ * SYNOPSYS:
+ *
+ *   gtkroadmap-wsttest [--wst-requests=N] [--wst-lines=N]
+ *
+ *   The exit code is 1 if the check failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <zlib.h>
+
+#include "roadmap.h"
+#include "roadmap_net.h"
+#include "websvc_trans/websvc_trans.h"
+
+#include "roadmap_main.h"
+#include "unix/roadmap_main_epoll.h"
+
+
+#define WST_TEST_MAX_REQUESTS 100
+#define WST_TEST_MAX_LINES    10000
+#define WST_TEST_TIMEOUT      10000
+
+static int  WstTestRequests = 5;
+static int  WstTestLines    = 10;
+
+static int  WstTestPort;
+static char WstTestService[64];
+
+static int  WstTestConnections;  /* Accepted by the server */
+static int  WstTestServed;       /* Requests answered by the server */
+static int  WstTestGzipped;      /* ... with a compressed body */
+static int  WstTestCompleted;    /* Transactions completed by the session */
+static int  WstTestParsed;       /* Response lines parsed by the session */
+static int  WstTestFailed;
+
+static wst_handle WstTestSession;
+
+
+/* The server. ------------------------------------------------------------- */
+
+static int wst_test_gzip (const char *data, int size, char *out, int out_size) {
+
+   z_stream z;
+   int result;
+
+   memset (&z, 0, sizeof(z));
+
+   /* 16 + MAX_WBITS: a gzip header and trailer. */
+   if (deflateInit2 (&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return -1;
+   }
+
+   z.next_in = (Bytef *) data;
+   z.avail_in = size;
+   z.next_out = (Bytef *) out;
+   z.avail_out = out_size;
+
+   result = deflate (&z, Z_FINISH);
+   deflateEnd (&z);
+
+   return result == Z_STREAM_END ? (int) z.total_out : -1;
+}
+
+
+/* Read one request; returns 0 when the client closed the connection. */
+static int wst_test_read_request (int fd, char *request, int size) {
+
+   int length = 0;
+   int content_length = 0;
+   char *header_end = NULL;
+   char *field;
+
+   while (header_end == NULL ||
+          length < (header_end + 4 - request) + content_length) {
+
+      int received;
+
+      if (length >= size - 1) return -1;
+
+      received = read (fd, request + length, size - 1 - length);
+      if (received <= 0) return received;
+
+      length += received;
+      request[length] = '\0';
+
+      if (header_end == NULL) {
+         header_end = strstr (request, "\r\n\r\n");
+         if (header_end != NULL) {
+            field = strstr (request, "Content-Length:");
+            if (field != NULL && field < header_end) {
+               content_length = atoi (field + 15);
+            }
+         }
+      }
+   }
+
+   return length;
+}
+
+
+static void wst_test_serve (int fd) {
+
+   static char body[WST_TEST_MAX_LINES * 16];
+   static char encoded[WST_TEST_MAX_LINES * 16];
+   char request[4096];
+   char response[512];
+   const char *content;
+   int content_size;
+   int gzip;
+   int length;
+   int i;
+
+   while (wst_test_read_request (fd, request, sizeof(request)) > 0) {
+
+      gzip = (strstr (request, "Accept-Encoding: gzip") != NULL);
+
+      ++WstTestServed;
+
+      content = body;
+      content_size = 0;
+      for (i = 0; i < WstTestLines; ++i) {
+         content_size += snprintf (body + content_size, sizeof(body) - content_size,
+                                   "Served,%d\n", WstTestServed);
+      }
+
+      if (gzip) {
+         content_size = wst_test_gzip (body, content_size, encoded, sizeof(encoded));
+         if (content_size < 0) return;
+         content = encoded;
+         WstTestGzipped++;
+      }
+
+      length = snprintf (response, sizeof(response),
+                         "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: text/plain\r\n"
+                         "Content-Length: %d\r\n"
+                         "%s"
+                         "Connection: keep-alive\r\n"
+                         "\r\n",
+                         content_size,
+                         gzip ? "Content-Encoding: gzip\r\n" : "");
+
+      if (write (fd, response, length) != length ||
+          write (fd, content, content_size / 2) != content_size / 2) {
+         return;
+      }
+
+      usleep (10000);
+
+      if (write (fd, content + content_size / 2, content_size - content_size / 2) !=
+             content_size - content_size / 2) {
+         return;
+      }
+   }
+}
+
+
+static void *wst_test_server (void *context) {
+
+   int listener = *(int *) context;
+
+   for (;;) {
+
+      int fd = accept (listener, NULL, NULL);
+      if (fd < 0) break;
+
+      WstTestConnections++;
+      wst_test_serve (fd);
+      close (fd);
+   }
+
+   return NULL;
+}
+
+
+static int wst_test_listen (void) {
+
+   static int listener;
+   struct sockaddr_in addr;
+   socklen_t addr_size = sizeof(addr);
+   pthread_t thread;
+
+   listener = socket (AF_INET, SOCK_STREAM, 0);
+   if (listener < 0) return 0;
+
+   memset (&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+   addr.sin_port = 0;
+
+   if (bind (listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+       listen (listener, 4) < 0 ||
+       getsockname (listener, (struct sockaddr *) &addr, &addr_size) < 0) {
+      close (listener);
+      return 0;
+   }
+
+   WstTestPort = ntohs (addr.sin_port);
+
+   if (pthread_create (&thread, NULL, wst_test_server, &listener) != 0) {
+      close (listener);
+      return 0;
+   }
+   pthread_detach (thread);
+
+   return 1;
+}
+
+
+/* The session. ------------------------------------------------------------ */
+
+static const char *wst_test_parser (const char *data,
+                                    void *context,
+                                    BOOL *more_data_needed,
+                                    roadmap_result *rc) {
+
+   const char *end = strchr (data, '\n');
+
+   (*more_data_needed) = FALSE;
+   (*rc) = succeeded;
+
+   if (strncmp (data, "Served,", 7)) {
+      fprintf (stderr, "unexpected response: %s\n", data);
+      (*rc) = err_parser_unexpected_data;
+      return NULL;
+   }
+
+   WstTestParsed++;
+
+   return end + 1;
+}
+
+static wst_parser WstTestParsers[] = {
+   { NULL, wst_test_parser }
+};
+
+
+static void wst_test_timeout (void);
+
+static void wst_test_done (void) {
+
+   roadmap_main_remove_periodic (wst_test_timeout);
+   roadmap_main_headless_stop ();
+}
+
+
+static void wst_test_timeout (void) {
+
+   fprintf (stderr, "timed out after %d transactions\n", WstTestCompleted);
+   WstTestFailed = 1;
+   wst_test_done ();
+}
+
+
+static BOOL wst_test_send (void);
+
+static void wst_test_completed (void *context, roadmap_result res) {
+
+   if (res != succeeded) {
+      fprintf (stderr, "transaction %d failed, result %d\n", WstTestCompleted + 1, res);
+      WstTestFailed = 1;
+      wst_test_done ();
+      return;
+   }
+
+   if (++WstTestCompleted == WstTestRequests) {
+      wst_test_done ();
+      return;
+   }
+
+   if (!wst_test_send ()) {
+      WstTestFailed = 1;
+      wst_test_done ();
+   }
+}
+
+
+static BOOL wst_test_send (void) {
+
+   return wst_start_trans (WstTestSession,
+                           0,
+                           "Test",
+                           -1,
+                           WstTestParsers,
+                           sizeof(WstTestParsers) / sizeof(WstTestParsers[0]),
+                           wst_test_completed,
+                           NULL,
+                           "Request,%d\n",
+                           WstTestCompleted + 1);
+}
+
+
+int main (int argc, char **argv) {
+
+   int i;
+
+   for (i = 1; i < argc; i++) {
+      if (!strncmp (argv[i], "--wst-requests=", 15)) {
+         WstTestRequests = atoi (argv[i] + 15);
+         if (WstTestRequests < 2) WstTestRequests = 2;
+         if (WstTestRequests > WST_TEST_MAX_REQUESTS) WstTestRequests = WST_TEST_MAX_REQUESTS;
+      } else if (!strncmp (argv[i], "--wst-lines=", 12)) {
+         WstTestLines = atoi (argv[i] + 12);
+         if (WstTestLines < 1) WstTestLines = 1;
+         if (WstTestLines > WST_TEST_MAX_LINES) WstTestLines = WST_TEST_MAX_LINES;
+      } else {
+         fprintf (stderr, "usage: %s [--wst-requests=N] [--wst-lines=N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   roadmap_main_headless_initialize ();
+
+   roadmap_net_initialize ();
+   roadmap_net_set_compress_enabled (TRUE);
+
+   if (!wst_test_listen ()) {
+      fprintf (stderr, "cannot start the local server\n");
+      return 1;
+   }
+
+   snprintf (WstTestService, sizeof(WstTestService), "http://127.0.0.1:%d/wsttest", WstTestPort);
+
+   WstTestSession = wst_init (WstTestService, NULL, NULL, NULL, "binary/octet-stream");
+   if (WstTestSession == INVALID_WEBSVC_HANDLE || !wst_test_send ()) {
+      fprintf (stderr, "cannot start a transaction\n");
+      return 1;
+   }
+
+   roadmap_main_set_periodic (WST_TEST_TIMEOUT, wst_test_timeout);
+
+   roadmap_main_headless_run ();
+
+   wst_term (WstTestSession);
+   roadmap_net_shutdown ();
+
+   printf ("%d transactions, %d response lines parsed, %d gzip responses, %d connections\n",
+           WstTestCompleted, WstTestParsed, WstTestGzipped, WstTestConnections);
+
+   if (!WstTestFailed && WstTestConnections != 1) {
+      fprintf (stderr, "the connection was not kept\n");
+      WstTestFailed = 1;
+   }
+
+   if (!WstTestFailed && WstTestGzipped != WstTestServed) {
+      fprintf (stderr, "the responses were not compressed\n");
+      WstTestFailed = 1;
+   }
+
+   if (!WstTestFailed && WstTestParsed != WstTestCompleted * WstTestLines) {
+      fprintf (stderr, "response lines were lost\n");
+      WstTestFailed = 1;
+   }
+
+   return WstTestFailed ? 1 : 0;
+}
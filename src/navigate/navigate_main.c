@@ -260,6 +260,7 @@ static char NavigateDescription[256] = {0};
 static int NavigateNumInstSegments = 0;
 static int NavigateCurrentSegment = 0;
 static int NavigateCurrentRequestSegment = 0;
+static int NavigateTtsPrefetchSegment = 0;
 static NavigateSegment *NavigateDetour;
 static int NavigateDetourSize = 0;
 static int NavigateDetourEnd = 0;
@@ -391,6 +392,57 @@ int navigate_main_tts_prepare_route( void )
     return count;
 }
 
+/*
+ * Prepares the streets of the route ahead of the current segment, up to
+ * lookahead meters (from the start of the current segment) and at most
+ * max_count streets. Resumes where the previous call stopped. The walk
+ * stops at the first segment that is not instrumented yet: its street
+ * is prepared by a later call, once its tile arrives.
+ */
+int navigate_main_tts_prefetch_route( int lookahead, int max_count )
+{
+   NavigateSegment *segment;
+   int num_segments = navigate_num_segments ();
+   int segment_idx;
+   int group_id = -1;
+   int distance = 0;
+   int count = 0;
+
+   if ( !NavigateTrackEnabled )
+       return 0;
+
+   if ( NavigateTtsPrefetchSegment < NavigateCurrentSegment )
+      NavigateTtsPrefetchSegment = NavigateCurrentSegment;
+
+   for ( segment_idx = NavigateCurrentSegment; segment_idx < num_segments; ++segment_idx ) {
+
+       segment = navigate_segment( segment_idx );
+
+       if ( segment_idx >= NavigateTtsPrefetchSegment ) {
+
+          if ( distance > lookahead || count >= max_count || !segment->is_instrumented )
+             break;
+
+          /* Same choice of streets as navigate_main_tts_prepare_route() */
+          if ( segment_idx == NavigateCurrentSegment ||
+               ( segment->context != SEG_ROUNDABOUT && segment->group_id != group_id ) ) {
+
+             if ( navigate_tts_prepare_street( segment ) )
+                count++;
+          }
+
+          NavigateTtsPrefetchSegment = segment_idx + 1;
+       }
+
+       if ( segment_idx == NavigateCurrentSegment || segment->context != SEG_ROUNDABOUT )
+          group_id = segment->group_id;
+
+       distance += segment->distance;
+   }
+
+   return count;
+}
+
 BOOL navigate_main_ETA_enabled(){
 
    if (roadmap_config_match(&NavigateConfigEtaEnabled, "yes"))
@@ -701,6 +753,13 @@ static int navigate_find_track_points (PluginLine *from_line, int *from_point,
 }
 
 
+/* Routes come from the server, or from the route file that stands for it. */
+static int navigate_main_server_routing (void) {
+
+   return RealTimeLoginState () || navigate_route_is_offline ();
+}
+
+
 static int navigate_find_track_points_in_scale (PluginLine *from_line, int *from_point,
                                        			PluginLine *to_line, int *to_point,
                                        			int *from_direction, int recalc_route, int scale, int find_from) {
@@ -1241,6 +1300,7 @@ void navigate_main_on_route (int flags, int length, int track_time,
 	NavigateDetourEnd = 0;
    NavigateCurrentSegment = 0;
    NavigateCurrentRequestSegment = 0;
+   NavigateTtsPrefetchSegment = 0;
    if (description){
       strncpy_safe (NavigateDescription, description, sizeof(NavigateDescription));
    }
@@ -1455,7 +1515,7 @@ static int navigate_main_recalc_route (int delay_message) {
 
    if (NavigateIsByServer &&
        timeNow < NavigateOfftrackTime + 60 &&
-       !RealTimeLoginState ()) {
+       !navigate_main_server_routing ()) {
       if (from_point == -1) {
          if (navigate_find_track_points_in_scale
              (&from_line, &from_point,
@@ -1484,7 +1544,7 @@ static int navigate_main_recalc_route (int delay_message) {
 
 
 	if (track_time < 0) {
-	   if (RealTimeLoginState () /*&& (!NavigateIsAlternativeRoute)*/) {
+	   if (navigate_main_server_routing () /*&& (!NavigateIsAlternativeRoute)*/) {
 	   	NavigateIsByServer = 1;
 	   	NavigateIsAlternativeRoute = 0;
    		roadmap_log (ROADMAP_INFO, "Requesting reroute..");
@@ -1544,6 +1604,7 @@ static int navigate_main_recalc_route (int delay_message) {
    navigate_bar_set_mode (NavigateTrackEnabled);
    NavigateCurrentSegment = 0;
    NavigateCurrentRequestSegment = 0;
+   NavigateTtsPrefetchSegment = 0;
 	roadmap_log (ROADMAP_DEBUG, "NavigateCurrentSegment = %d", NavigateCurrentSegment);
    return 0;
 }
@@ -3159,7 +3220,7 @@ void navigate_main_prepare_for_request (void) {
 
    const RoadMapPosition * depPos;
 
-   if (RealTimeLoginState()) {
+   if (navigate_main_server_routing ()) {
       NavigateIsByServer = 1;
    }
 
@@ -3264,7 +3325,7 @@ int navigate_main_calc_route ( int add_flags  /* additional flags */ ) {
    }
 
    if (navigate_find_track_points_in_scale
-         (&from_line, &from_point, &NavigateDestination, &NavigateDestPoint, &from_direction, 0, 0, !RealTimeLoginState ())) {
+         (&from_line, &from_point, &NavigateDestination, &NavigateDestPoint, &from_direction, 0, 0, !navigate_main_server_routing ())) {
       return -1;
    }
 
@@ -3278,7 +3339,7 @@ int navigate_main_calc_route ( int add_flags  /* additional flags */ ) {
    for (i = 0; i < MAX_ALT_ROUTES; i++)
       NavigateNumOutlinePoints[i] = 0;
 
-   if (RealTimeLoginState ()) {
+   if (navigate_main_server_routing ()) {
    	roadmap_log (ROADMAP_INFO, "Requesting new route..");
    	CalculatingRoute = TRUE;
    	NavigateRerouteTime = 0;
@@ -4027,7 +4088,11 @@ static int navigate_main_list_call_back (SsdWidget widget, const char *new_value
 //////////////////////////////////////////////////
 void navigate_main_on_instrumented_segment( const NavigateSegment *segment )
 {
-   navigate_tts_prepare_street( segment );
+   /*
+    * Nothing to do here: the streets are prepared ahead of the current
+    * position by the TTS prefetch (see navigate_main_tts_prefetch_route),
+    * instead of the whole route at once.
+    */
 }
 
 ///////////////////////////////////////////////////
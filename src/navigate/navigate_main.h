@@ -205,6 +205,7 @@ void navigate_main_alt_recalculate_route(void);
 
 void navigate_main_start_navigating (void);
 int navigate_main_tts_prepare_route( void );
+int navigate_main_tts_prefetch_route( int lookahead, int max_count );
 void navigate_main_override_nav_settings( void );
 
 char *navigate_main_get_dest_str(void);
@@ -22,8 +22,10 @@
  *
  */
 
+#include <stdio.h>
 #include <string.h>
 #include "roadmap_main.h"
+#include "roadmap_file.h"
 #include "navigate_route_trans.h"
 #include "navigate_route_events.h"
 #include "roadmap_time.h"
@@ -85,6 +87,8 @@ typedef struct {
 
 static NavigateRoutingContext		RoutingContext;
 
+static char								*RouteResponseFile = NULL;
+
 static int 								TileCbRegistered = 0;
 static RoadMapTileCallback 		TileCbNext = NULL;
 
@@ -1707,6 +1711,127 @@ const char *on_route_segments (/* IN  */   const char*       data,
    return data;
 }
 
+/* The route commands of the server, as it sends them in its response:
+ *    <command>,<route_id>,...\n
+ * The recorded route_id is replaced with that of the current request.
+ */
+static const wst_parser RouteResponseParsers[] = {
+   { "RoutingResponseCode",	on_routing_response_code },
+   { "RoutingResponse",			on_routing_response },
+   { "RoutePoints",				on_route_points },
+   { "RouteSegments",			on_route_segments },
+   { "EventOnRoute",			   on_route_events }
+};
+
+static BOOL navigate_route_read_response (void)
+{
+   int   size = roadmap_file_length (NULL, RouteResponseFile);
+   FILE  *file;
+   char  *buffer;
+   char  *command;
+   char  *line;
+   char  *next;
+   BOOL  bRes = TRUE;
+
+   if (size <= 0) {
+      roadmap_log (ROADMAP_ERROR, "navigate_route - cannot read %s", RouteResponseFile);
+      return FALSE;
+   }
+
+   file = roadmap_file_fopen (NULL, RouteResponseFile, "r");
+   if (!file) return FALSE;
+
+   buffer = malloc (size + 1);
+   roadmap_check_allocated (buffer);
+   size = fread (buffer, 1, size, file);
+   buffer[size] = 0;
+   fclose (file);
+
+   // Room for a line with a longer route_id
+   command = malloc (size + 16);
+   roadmap_check_allocated (command);
+
+   for (line = buffer; bRes && *line; line = next) {
+
+      const char     *fields;
+      const char     *end;
+      BOOL           more_data_needed = FALSE;
+      roadmap_result rc = succeeded;
+      int            i;
+
+      next = strchr (line, '\n');
+      if (next) {
+         *next++ = 0;
+      } else {
+         next = line + strlen (line);
+      }
+
+      fields = strchr (line, ',');
+      if (!fields || *line == '#') continue;
+
+      for (i = 0; i < (int)(sizeof(RouteResponseParsers) / sizeof(RouteResponseParsers[0])); i++) {
+         if (!strncmp (line, RouteResponseParsers[i].tag, fields - line) &&
+             !RouteResponseParsers[i].tag[fields - line]) {
+            break;
+         }
+      }
+
+      if (i == (int)(sizeof(RouteResponseParsers) / sizeof(RouteResponseParsers[0]))) {
+         roadmap_log (ROADMAP_WARNING, "navigate_route - ignoring '%.*s' in %s",
+                      (int)(fields - line), line, RouteResponseFile);
+         continue;
+      }
+
+      // Skip the recorded route_id
+      fields = strchr (fields + 1, ',');
+      if (!fields) fields = "";
+
+      sprintf (command, "%d%s\n", RoutingContext.route_id, fields);
+
+      end = RouteResponseParsers[i].parser (command, NULL, &more_data_needed, &rc);
+      if (!end || rc != succeeded) {
+         roadmap_log (ROADMAP_ERROR, "navigate_route - bad %s in %s",
+                      RouteResponseParsers[i].tag, RouteResponseFile);
+         bRes = FALSE;
+      }
+   }
+
+   free (command);
+   free (buffer);
+
+   return bRes;
+}
+
+/* The response comes from the main loop, as that of the server would. */
+static void navigate_route_response_periodic (void)
+{
+   roadmap_main_remove_periodic (navigate_route_response_periodic);
+
+   if (!navigate_route_read_response ()) {
+		RoutingContext.rc = 520;
+		RoutingContext.route_rc = route_server_error;
+		routing_error ("Failed to read the route file", RoutingContext.rc);
+   }
+}
+
+void navigate_route_set_response_file (const char *file_name)
+{
+   if (RouteResponseFile) {
+      free (RouteResponseFile);
+      RouteResponseFile = NULL;
+   }
+
+   if (file_name) {
+      RouteResponseFile = strdup (file_name);
+      roadmap_check_allocated (RouteResponseFile);
+   }
+}
+
+BOOL navigate_route_is_offline (void)
+{
+   return RouteResponseFile != NULL;
+}
+
 void navigate_route_request (const PluginLine *from_line,
                              int from_point,
                              const PluginLine *to_line,
@@ -1937,6 +2062,11 @@ void navigate_route_request (const PluginLine *from_line,
       location_info.last_pos_lon = location_info.last_pos_lat = last_pos->steering = -1;
    }
 
+   if (RouteResponseFile) {
+      roadmap_main_set_periodic (100, navigate_route_response_periodic);
+      return;
+   }
+
    bRes = Realtime_RequestRoute (RoutingContext.route_id,	       //iRoute
                                  route_type,						       //iType
                                  trip_id,							       //iTripId
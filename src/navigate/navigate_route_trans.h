@@ -144,6 +144,16 @@ void navigate_route_request (const PluginLine *from_line,
 
 void navigate_route_cancel_request (void);
 
+/* Answer the route requests with the route commands recorded in a file
+ * (RoutingResponseCode, RoutingResponse, RoutePoints, RouteSegments and
+ * EventOnRoute lines, as the server sends them) instead of the routing
+ * server; NULL goes back to the server. The map tiles of the route must
+ * already be in the cache.
+ */
+void navigate_route_set_response_file (const char *file_name);
+
+BOOL navigate_route_is_offline (void);
+
 void navigate_route_select (int alt_id);
 
 #endif //__NAVIGATE_ROUTE_TRANS_H
@@ -33,11 +33,16 @@
 #include "roadmap_lang.h"
 #include "roadmap_math.h"
 #include "roadmap_warning.h"
+#include "roadmap_main.h"
+#include "roadmap_time.h"
 #include "Realtime/Realtime.h"
 
 //======================== Local defines ========================
 #define NAV_TTS_CFG_CATEGORY                    ("TTS Navigate")
 #define NAV_TTS_CFG_PREFIX_FILTER_LIST          ("Prefix Filter List")
+#define NAV_TTS_CFG_PREFETCH_DISTANCE           ("Prefetch Distance")
+#define NAV_TTS_CFG_PREFETCH_BUDGET             ("Prefetch Budget")
+#define NAV_TTS_CFG_PREFETCH_BYTES              ("Prefetch Bytes")
 #define NAV_TTS_CFG_LIST_DELIM                  ("|")
 #define NAV_TTS_LOCAL_PARSING_ENABLED           (1)
 #define NAV_TTS_CTX_INITIALIZER                 { FALSE, NULL, NULL, NULL, NULL, NULL };
@@ -46,6 +51,9 @@
 
 #define NAV_TTS_LOGSTR( str )                   ( "Navigate TTS. " str )
 #define NAV_TTS_SYLLABLE_PRONOUNCE_TIME         150            // Estimation in ms of time needed to pronounce one syllable
+#define NAV_TTS_PREFETCH_INTERVAL               500            // Period (ms) of the route-ahead prefetch
+#define NAV_TTS_PREFETCH_STATS_INITIALIZER      { 0, 0, 0, -1, 0, 0 }
+#define NAV_TTS_PREFETCH_AUDIO_MAXNUM           64             // Prefetched texts waiting for their announcement
 #if !defined(INLINE_DEC)
 #define INLINE_DEC
 #endif
@@ -68,6 +76,12 @@ typedef struct
    int                    total_count;
    char                   voice_id[TTS_VOICE_MAXLEN];
  } NavTtsVoicePrepareCtx;
+
+typedef struct
+{
+   char*                  text;
+   int                    size;
+} NavTtsPrefetchAudio;
    //======================== Globals ========================
 
 static const char* sgNavTtsCommon[] = {
@@ -114,6 +128,24 @@ static RoadMapConfigDescriptor sgNavTtsCfgPrefixList =
 static const char* sgFilterPrefixList[NAV_TTS_FILTER_PREFIX_MAXNUM] = {NULL};
 static int sgFilterPrefixCount = 0;
 
+static RoadMapConfigDescriptor sgNavTtsCfgPrefetchDistance =
+      ROADMAP_CONFIG_ITEM( NAV_TTS_CFG_CATEGORY, NAV_TTS_CFG_PREFETCH_DISTANCE );
+
+static RoadMapConfigDescriptor sgNavTtsCfgPrefetchBudget =
+      ROADMAP_CONFIG_ITEM( NAV_TTS_CFG_CATEGORY, NAV_TTS_CFG_PREFETCH_BUDGET );
+
+static RoadMapConfigDescriptor sgNavTtsCfgPrefetchBytes =
+      ROADMAP_CONFIG_ITEM( NAV_TTS_CFG_CATEGORY, NAV_TTS_CFG_PREFETCH_BYTES );
+
+static NavTtsPrefetchStats sgPrefetchStats = NAV_TTS_PREFETCH_STATS_INITIALIZER;
+static uint32_t sgPrefetchStartTime = 0;
+static BOOL sgPrefetchActive = FALSE;
+
+// The audio received by the prefetch and not announced yet, in the order of the route
+static NavTtsPrefetchAudio sgPrefetchAudio[NAV_TTS_PREFETCH_AUDIO_MAXNUM];
+static int sgPrefetchAudioCount = 0;
+static int sgPrefetchAudioBytes = 0;
+
 
 //======================== Local Declarations ========================
 
@@ -131,11 +163,20 @@ static NavSmallValue _get_state_instruction( const NavTtsState* state );
 static int _prepare_nav_voice( const char* voice_id );
 static const char* _get_destination_name( const char* street, const char* street_num );
 INLINE_DEC _format_street_text( const char* street_name, BOOL add_at, char buf_out[], int buf_size );
+static void _prefetch_start( void );
+static void _prefetch_stop( void );
+static void _prefetch( void );
+static void _prefetch_cb( const void* user_context, int res_status, const char* text );
+static void _prefetch_audio_release( int count );
+static void _prefetch_audio_announced( const char* text );
 
 void navigate_tts_initialize( void )
 {
 // TODO: Reduce the default. Assign ""
    roadmap_config_declare( "preferences", &sgNavTtsCfgPrefixList, "to ", NULL );
+   roadmap_config_declare( "preferences", &sgNavTtsCfgPrefetchDistance, "5000", NULL );
+   roadmap_config_declare( "preferences", &sgNavTtsCfgPrefetchBudget, "16", NULL );
+   roadmap_config_declare( "preferences", &sgNavTtsCfgPrefetchBytes, "524288", NULL );
    sgOnLoginNextCallback = Realtime_NotifyOnLogin ( initialize_on_login );
 }
 
@@ -342,6 +383,8 @@ void navigate_tts_prepare_context( void )
    sgCtx.request_cb = NULL;
    sgCtx.request_cb_ctx = NULL;
    sgCtx.sound_list = NULL;
+
+   _prefetch_start();
 }
 
 /*
@@ -351,6 +394,8 @@ void navigate_tts_finish_route( void )
 {
    roadmap_log( ROADMAP_INFO, NAV_TTS_LOGSTR( "Finishing route" ) );
 
+   _prefetch_stop();
+
    if ( sgCtx.voice_id )
       free( sgCtx.voice_id );
    sgCtx = (NavTtsContext) NAV_TTS_CTX_INITIALIZER;
@@ -629,6 +674,185 @@ void navigate_tts_commit( void )
    }
 }
 
+/*
+ ******************************************************************************
+ */
+void navigate_tts_prefetch_stats( NavTtsPrefetchStats* stats )
+{
+   *stats = sgPrefetchStats;
+}
+
+/*
+ ******************************************************************************
+ * Starts the route-ahead prefetch of the street names. The prompts of the
+ * streets within the prefetch distance are requested step by step from the
+ * main loop, keeping at most "Prefetch Budget" texts pending in the TTS
+ * queue, so that a long route neither overflows the queue nor stalls the UI.
+ * The prefetch also pauses while the audio it received for the streets not
+ * announced yet exceeds "Prefetch Bytes".
+ * Auxiliary
+ */
+static void _prefetch_start( void )
+{
+   if ( sgPrefetchActive )
+      _prefetch_stop();
+
+   sgPrefetchStats = (NavTtsPrefetchStats) NAV_TTS_PREFETCH_STATS_INITIALIZER;
+   sgPrefetchStartTime = roadmap_time_get_millis();
+   _prefetch_audio_release( sgPrefetchAudioCount );
+
+   if ( !sgCtx.tts_available )
+      return;
+
+   sgPrefetchActive = TRUE;
+   roadmap_main_set_periodic( NAV_TTS_PREFETCH_INTERVAL, _prefetch );
+
+   // The first maneuvers are needed right away
+   _prefetch();
+}
+
+/*
+ ******************************************************************************
+ * Auxiliary
+ */
+static void _prefetch_stop( void )
+{
+   int announced = sgPrefetchStats.hits + sgPrefetchStats.misses;
+
+   if ( !sgPrefetchActive )
+      return;
+
+   roadmap_main_remove_periodic( _prefetch );
+   sgPrefetchActive = FALSE;
+   _prefetch_audio_release( sgPrefetchAudioCount );
+
+   roadmap_log( ROADMAP_INFO, NAV_TTS_LOGSTR( "Prefetch: %d streets requested. Hit rate: %d/%d. First audio in %d ms. Audio: %d bytes, at most %d ahead" ),
+         sgPrefetchStats.requested, sgPrefetchStats.hits, announced, sgPrefetchStats.first_audio,
+         sgPrefetchStats.audio_bytes, sgPrefetchStats.ahead_bytes_max );
+}
+
+/*
+ ******************************************************************************
+ * One step of the prefetch
+ * Auxiliary
+ */
+static void _prefetch( void )
+{
+   TtsRequestCompletedCb request_cb = sgCtx.request_cb;
+   void* request_cb_ctx = sgCtx.request_cb_ctx;
+   int room;
+   int count;
+
+   if ( !sgCtx.tts_available )
+      return;
+
+   room = roadmap_config_get_integer( &sgNavTtsCfgPrefetchBudget ) - tts_pending_count();
+   if ( room <= 0 )
+      return;
+
+   if ( sgPrefetchAudioBytes >= roadmap_config_get_integer( &sgNavTtsCfgPrefetchBytes ) )
+      return;
+
+   // Up to two texts per street ( see navigate_tts_prepare_street )
+   sgCtx.request_cb = _prefetch_cb;
+   sgCtx.request_cb_ctx = NULL;
+
+   count = navigate_main_tts_prefetch_route( roadmap_config_get_integer( &sgNavTtsCfgPrefetchDistance ),
+                                             ( room + 1 ) / 2 );
+
+   sgCtx.request_cb = request_cb;
+   sgCtx.request_cb_ctx = request_cb_ctx;
+
+   if ( count > 0 )
+   {
+      sgPrefetchStats.requested += count;
+      navigate_tts_commit();
+   }
+}
+
+/*
+ ******************************************************************************
+ * Auxiliary
+ */
+static void _prefetch_cb( const void* user_context, int res_status, const char* text )
+{
+   int size;
+
+   if ( !( res_status & TTS_RES_STATUS_SUCCESS ) )
+      return;
+
+   if ( sgPrefetchStats.first_audio < 0 )
+   {
+      sgPrefetchStats.first_audio = (int) ( roadmap_time_get_millis() - sgPrefetchStartTime );
+   }
+
+   if ( !sgPrefetchActive || !text )
+      return;
+
+   if ( sgPrefetchAudioCount == NAV_TTS_PREFETCH_AUDIO_MAXNUM )
+      _prefetch_audio_release( 1 );
+
+   size = tts_text_size( text, sgCtx.voice_id );
+
+   sgPrefetchAudio[sgPrefetchAudioCount].text = strdup( text );
+   sgPrefetchAudio[sgPrefetchAudioCount].size = size;
+   sgPrefetchAudioCount++;
+
+   sgPrefetchAudioBytes += size;
+   sgPrefetchStats.audio_bytes += size;
+   if ( sgPrefetchAudioBytes > sgPrefetchStats.ahead_bytes_max )
+      sgPrefetchStats.ahead_bytes_max = sgPrefetchAudioBytes;
+}
+
+/*
+ ******************************************************************************
+ * Forgets the first (oldest) entries of the prefetched audio
+ * Auxiliary
+ */
+static void _prefetch_audio_release( int count )
+{
+   int i;
+
+   for ( i = 0; i < count; ++i )
+   {
+      sgPrefetchAudioBytes -= sgPrefetchAudio[i].size;
+      free( sgPrefetchAudio[i].text );
+   }
+
+   sgPrefetchAudioCount -= count;
+   memmove( sgPrefetchAudio, sgPrefetchAudio + count, sgPrefetchAudioCount * sizeof( sgPrefetchAudio[0] ) );
+}
+
+/*
+ ******************************************************************************
+ * The text is announced: its audio and the audio prefetched before it ( the
+ * streets behind ) are no longer ahead. The TTS engine reports the texts with
+ * '|' replaced by spaces ( see tts.c )
+ * Auxiliary
+ */
+static void _prefetch_audio_announced( const char* text )
+{
+   int i;
+
+   for ( i = 0; i < sgPrefetchAudioCount; ++i )
+   {
+      const char* a = sgPrefetchAudio[i].text;
+      const char* b = text;
+
+      while ( *a && ( *a == *b || ( *a == ' ' && *b == '|' ) ) )
+      {
+         a++;
+         b++;
+      }
+
+      if ( !*a && !*b )
+      {
+         _prefetch_audio_release( i + 1 );
+         return;
+      }
+   }
+}
+
 /*
  ******************************************************************************
  * TODO:: Redesign and rewrite this !
@@ -714,11 +938,14 @@ static void playlist_add_atstreet( const NavigateSegment *prev_segment, const Na
 
         if ( tts_text_available( street_text, sgCtx.voice_id )  )
         {
+           sgPrefetchStats.hits++;
+           _prefetch_audio_announced( street_text );
 //           _add_playlist( NAV_TTS_TEXT_AT, TRUE );
            _add_playlist( street_text, FALSE );
         }
         else
         {
+           sgPrefetchStats.misses++;
            roadmap_log( ROADMAP_WARNING, NAV_TTS_LOGSTR( "Unable to add street name '%s'. Not cached." ), street_name );
         }
      }
@@ -48,6 +48,17 @@ typedef struct
 } NavTtsState;
 
 #define NAV_TTS_STATE_INITIALIZER         { NAV_ANNOUNCE_STATE_UNDEFINED, NULL, NULL, NULL, NULL }
+
+typedef struct
+{
+   int requested;                // Streets requested by the prefetch
+   int hits;                     // Street prompts ready when announced
+   int misses;                   // Street prompts not ready when announced
+   int first_audio;              // Time (ms) from the route start till the first prompt was ready. -1 if none yet
+   int audio_bytes;              // Audio received by the prefetch
+   int ahead_bytes_max;          // Most audio received and not yet announced at once
+} NavTtsPrefetchStats;
+
 /*
  * Navigate TTS initialization
  * Params:  void
@@ -139,6 +150,14 @@ void navigate_tts_prepare_context( void );
  */
 void navigate_tts_finish_route( void );
 
+/*
+ * Returns the prefetch statistics of the current (or the last) route
+ * Params:  stats - the statistics to fill
+ *
+ * Returns: void
+ */
+void navigate_tts_prefetch_stats( NavTtsPrefetchStats* stats );
+
 
 /*
  * Submits TTS request for the prepared TTS items till the call time.
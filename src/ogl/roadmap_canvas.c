@@ -2179,6 +2179,37 @@ void roadmap_canvas_draw_multiple_polygons (int count, int *polygons, RoadMapGui
 #endif //_WIN32
 
 
+int roadmap_canvas_draw_triangles (int count, RoadMapGuiPoint *points, int fast_draw) {
+
+   GLfloat glpoints[1020*3];
+   int chunk;
+
+   if (count <= 0) return 1;
+
+   if (!set_state(CANVAS_GL_STATE_GEOMETRY, 0))
+      return 1;
+
+   set_fast_draw (fast_draw);
+
+   while (count > 0) {
+      chunk = count * 3 > 1020 ? 1020 : count * 3;
+
+      roadmap_canvas_convert_points (glpoints, points, chunk);
+      glVertexPointer(3, GL_FLOAT, 0, glpoints);
+      roadmap_canvas_color_fix();	/* Android only. Empty for others */
+      glDrawArrays(GL_TRIANGLES, 0, chunk);
+      check_gl_error();
+
+      points += chunk;
+      count -= chunk / 3;
+   }
+
+   end_fast_draw (fast_draw);
+
+   return 1;
+}
+
+
 void roadmap_canvas_draw_multiple_circles (int count, RoadMapGuiPoint *centers, int *radius,
 									int filled, int fast_draw) {
 //roadmap_log (ROADMAP_INFO, "\n\nroadmap_canvas_draw_multiple_circles");
@@ -2281,6 +2312,20 @@ void roadmap_canvas_save_screenshot (const char* filename) {
 
 }
 
+/* The whole scene is redrawn by the GPU on every frame, and the back
+ * buffer is not preserved after a swap: there is no map to keep.
+ */
+int roadmap_canvas_save_map (void) {
+   return 0;
+}
+
+int roadmap_canvas_restore_map (const RoadMapGuiRect *rect) {
+   return 0;
+}
+
+void roadmap_canvas_set_clip (const RoadMapGuiRect *rect) {
+}
+
 void roadmap_canvas_set_global_opacity (int opacity) {
    GlobalCanvasAlpha = opacity/255.0;
 }
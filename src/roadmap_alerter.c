@@ -51,6 +51,7 @@
 #include "roadmap_sound.h"
 #include "roadmap_alert.h"
 #include "roadmap_alerter.h"
+#include "roadmap_alerter_index.h"
 #include "roadmap_lang.h"
 #include "roadmap_softkeys.h"
 #include "roadmap_messagebox.h"
@@ -320,12 +321,14 @@ static BOOL is_alert_in_range_provider(roadmap_alert_provider* provider,
       const RoadMapGpsPosition *gps_position, const PluginLine* line,
       int * pAlert_index, int * pDistance, const char* cur_street_name){
    int i;
+   int k;
    int steering;
    RoadMapPosition pos;
    int azymuth;
    int delta;
    int square_current;
    int count = 0;
+   const int *alerts;
    const char *street_name;
    roadmap_alerter_location_info location_info;
    roadmap_alerter_location_info * pAlert_location_info = NULL;
@@ -333,15 +336,21 @@ static BOOL is_alert_in_range_provider(roadmap_alert_provider* provider,
    gps_pos.latitude = gps_position->latitude;
    gps_pos.longitude = gps_position->longitude;
    square_current = roadmap_square_active ();
-   count =  (* (provider->count)) ();
+
+   // only the alerts around us
+   count = roadmap_alerter_index_query (provider,
+                                        (* (provider->is_square_dependent))() ? square_current : -1,
+                                        &gps_pos, &alerts);
 
    // no alerts for this provider
    if (count == 0) {
+      roadmap_square_set_current (square_current);
       return FALSE;
    }
 
-   for (i=0; i<count; i++) {
+   for (k=0; k<count; k++) {
 
+      i = alerts[k];
       roadmap_square_set_current (square_current);
       // if the alert is not alertable, continue. (dummy speed cams, etc.)
       if (!(* (provider->is_alertable))(i)) {
@@ -819,7 +828,7 @@ static void update_button(void){
    ssd_dialog_refresh_current_softkeys();
 #endif
    if (!roadmap_screen_refresh())
-      roadmap_screen_redraw();
+      roadmap_screen_damage(NULL);
 }
 
 void hide_alert_timeout(void){
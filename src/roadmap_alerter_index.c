@@ -0,0 +1,354 @@
+/* roadmap_alerter_index.c - spatial index of the alert providers.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The alerter used to compute the distance to every alert of every
+ *   provider on each GPS fix. Here the alert positions are registered in
+ *   a hashed grid of fixed size cells, so that a query only looks at the
+ *   few cells around the GPS position.
+ *
+ *   There is one grid per provider, and per square for the square
+ *   dependent providers (the alerts of the map tiles). The grid of a
+ *   square is rebuilt when the square's version changes. The other
+ *   providers tell when their alerts change, since the index of an alert
+ *   moves when an alert before it is removed.
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_alerter_index.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_math.h"
+#include "roadmap_square.h"
+
+#include "roadmap_alerter_index.h"
+
+
+#define ALERTER_INDEX_CACHE_SIZE  16
+#define ALERTER_INDEX_CELL_SHIFT  13    /* about 900 meters */
+#define ALERTER_INDEX_MIN_BUCKETS 16
+
+typedef struct {
+   int alert;
+   RoadMapPosition position;
+} AlertIndexEntry;
+
+typedef struct {
+   roadmap_alert_provider *provider;
+   int square;
+   int version;
+   unsigned int last_access;
+
+   int count;
+   int max_distance;
+
+   int bucket_mask;
+   int *bucket_first;   /* bucket_mask + 2 entries */
+   AlertIndexEntry *entries;
+} AlertIndex;
+
+static AlertIndex    AlertIndexEntries[ALERTER_INDEX_CACHE_SIZE];
+static int           AlertIndexCount = 0;
+static unsigned int  AlertIndexAccess = 0;
+
+static int          *AlertIndexResult = NULL;
+static int           AlertIndexResultSize = 0;
+
+
+static int alerter_index_bucket (int cell_x, int cell_y, int mask) {
+
+   return ((unsigned int)cell_x * 73856093U ^ (unsigned int)cell_y * 19349663U) & mask;
+}
+
+
+static void alerter_index_release (AlertIndex *index) {
+
+   free (index->bucket_first);
+   free (index->entries);
+
+   index->provider = NULL;
+   index->bucket_first = NULL;
+   index->entries = NULL;
+   index->count = 0;
+}
+
+
+static void alerter_index_build (AlertIndex *index) {
+
+   roadmap_alert_provider *provider = index->provider;
+   int *cursor;
+   int buckets;
+   int i;
+
+   free (index->bucket_first);
+   free (index->entries);
+
+   index->count = (*provider->count) ();
+   index->max_distance = 0;
+
+   for (buckets = ALERTER_INDEX_MIN_BUCKETS; buckets < index->count; buckets *= 2) ;
+   index->bucket_mask = buckets - 1;
+
+   index->bucket_first = calloc (buckets + 1, sizeof(int));
+   roadmap_check_allocated (index->bucket_first);
+
+   index->entries = malloc ((index->count + 1) * sizeof(AlertIndexEntry));
+   roadmap_check_allocated (index->entries);
+
+   cursor = malloc ((index->count + 1) * sizeof(int));
+   roadmap_check_allocated (cursor);
+
+   /* Count the alerts of each bucket, and keep their bucket in cursor */
+   for (i = 0; i < index->count; ++i) {
+
+      RoadMapPosition position;
+      int steering;
+      int distance;
+
+      (*provider->get_position) (i, &position, &steering);
+
+      index->entries[i].alert = i;
+      index->entries[i].position = position;
+
+      cursor[i] = alerter_index_bucket (position.longitude >> ALERTER_INDEX_CELL_SHIFT,
+                                        position.latitude >> ALERTER_INDEX_CELL_SHIFT,
+                                        index->bucket_mask);
+      index->bucket_first[cursor[i] + 1]++;
+
+      distance = (*provider->get_distance) (i);
+      if (distance > index->max_distance) index->max_distance = distance;
+   }
+
+   for (i = 1; i <= buckets; ++i) {
+      index->bucket_first[i] += index->bucket_first[i - 1];
+   }
+
+   /* Place the alerts in their bucket, which keeps them in increasing order */
+   {
+      AlertIndexEntry *sorted = malloc ((index->count + 1) * sizeof(AlertIndexEntry));
+      int *next = malloc ((buckets + 1) * sizeof(int));
+
+      roadmap_check_allocated (sorted);
+      roadmap_check_allocated (next);
+
+      memcpy (next, index->bucket_first, buckets * sizeof(int));
+
+      for (i = 0; i < index->count; ++i) {
+         sorted[next[cursor[i]]++] = index->entries[i];
+      }
+
+      free (next);
+      free (index->entries);
+      index->entries = sorted;
+   }
+
+   free (cursor);
+}
+
+
+static AlertIndex *alerter_index_get (roadmap_alert_provider *provider, int square) {
+
+   AlertIndex *index = NULL;
+   AlertIndex *oldest = NULL;
+   int version = 0;
+   int i;
+
+   if (square >= 0) {
+      version = roadmap_square_version (square);
+      roadmap_square_set_current (square);
+   }
+
+   for (i = 0; i < AlertIndexCount; ++i) {
+
+      AlertIndex *entry = AlertIndexEntries + i;
+
+      if ((entry->provider == provider) && (entry->square == square)) {
+         index = entry;
+         break;
+      }
+      if ((oldest == NULL) || (entry->last_access < oldest->last_access)) {
+         oldest = entry;
+      }
+   }
+
+   if (index == NULL) {
+
+      if (AlertIndexCount < ALERTER_INDEX_CACHE_SIZE) {
+         index = AlertIndexEntries + AlertIndexCount++;
+         index->bucket_first = NULL;
+         index->entries = NULL;
+      } else {
+         index = oldest;
+         alerter_index_release (index);
+      }
+
+      index->provider = provider;
+      index->square = square;
+      alerter_index_build (index);
+
+   } else if ((index->version != version) ||
+              (index->count != (*provider->count) ())) {
+
+      alerter_index_build (index);
+   }
+
+   index->version = version;
+   index->last_access = ++AlertIndexAccess;
+
+   return index;
+}
+
+
+static int alerter_index_compare (const void *a, const void *b) {
+
+   return *(const int *)a - *(const int *)b;
+}
+
+
+typedef struct {
+   RoadMapPosition position;
+   float unit_per_longitude;
+   float unit_per_latitude;
+   float radius;
+} AlertIndexQuery;
+
+
+static int alerter_index_accept (const AlertIndexQuery *query,
+                                 const AlertIndexEntry *entry) {
+
+   float x = (entry->position.longitude - query->position.longitude) *
+                query->unit_per_longitude;
+   float y = (entry->position.latitude - query->position.latitude) *
+                query->unit_per_latitude;
+
+   return x * x + y * y <= query->radius * query->radius;
+}
+
+
+int roadmap_alerter_index_query (roadmap_alert_provider *provider,
+                                 int square,
+                                 const RoadMapPosition *position,
+                                 const int **alerts) {
+
+   AlertIndex *index = alerter_index_get (provider, square);
+   AlertIndexQuery query;
+   RoadMapPosition reference;
+   int delta_longitude;
+   int delta_latitude;
+   int x0, x1, y0, y1;
+   int count = 0;
+   int i;
+
+   if (AlertIndexResultSize < index->count) {
+      AlertIndexResultSize = index->count;
+      AlertIndexResult = realloc (AlertIndexResult, AlertIndexResultSize * sizeof(int));
+      roadmap_check_allocated (AlertIndexResult);
+   }
+
+   *alerts = AlertIndexResult;
+
+   if (index->count == 0) return 0;
+
+   /* The distance units of roadmap_math_distance() around the position */
+   query.position = *position;
+   reference = *position;
+   reference.longitude += 100000;
+   query.unit_per_longitude = roadmap_math_distance (position, &reference) / 100000.0F;
+   reference = *position;
+   reference.latitude += 100000;
+   query.unit_per_latitude = roadmap_math_distance (position, &reference) / 100000.0F;
+
+   if ((query.unit_per_longitude <= 0) || (query.unit_per_latitude <= 0)) return 0;
+
+   /* roadmap_math_distance() truncates, hence the extra unit */
+   query.radius = (float) index->max_distance + 1;
+
+   delta_longitude = (int) (query.radius / query.unit_per_longitude) + 1;
+   delta_latitude = (int) (query.radius / query.unit_per_latitude) + 1;
+
+   x0 = (position->longitude - delta_longitude) >> ALERTER_INDEX_CELL_SHIFT;
+   x1 = (position->longitude + delta_longitude) >> ALERTER_INDEX_CELL_SHIFT;
+   y0 = (position->latitude - delta_latitude) >> ALERTER_INDEX_CELL_SHIFT;
+   y1 = (position->latitude + delta_latitude) >> ALERTER_INDEX_CELL_SHIFT;
+
+   if ((x1 - x0 + 1) * (y1 - y0 + 1) > index->bucket_mask + 1) {
+
+      /* More cells than buckets (a very long alert distance): scan it all */
+      for (i = 0; i < index->count; ++i) {
+         if (alerter_index_accept (&query, index->entries + i)) {
+            AlertIndexResult[count++] = index->entries[i].alert;
+         }
+      }
+
+   } else {
+
+      int cell_x;
+      int cell_y;
+
+      for (cell_x = x0; cell_x <= x1; ++cell_x) {
+         for (cell_y = y0; cell_y <= y1; ++cell_y) {
+
+            int bucket = alerter_index_bucket (cell_x, cell_y, index->bucket_mask);
+            int last = index->bucket_first[bucket + 1];
+
+            for (i = index->bucket_first[bucket]; i < last; ++i) {
+
+               const AlertIndexEntry *entry = index->entries + i;
+
+               /* Different cells may share a bucket */
+               if (((entry->position.longitude >> ALERTER_INDEX_CELL_SHIFT) != cell_x) ||
+                   ((entry->position.latitude >> ALERTER_INDEX_CELL_SHIFT) != cell_y)) {
+                  continue;
+               }
+
+               if (alerter_index_accept (&query, entry)) {
+                  AlertIndexResult[count++] = entry->alert;
+               }
+            }
+         }
+      }
+   }
+
+   if (count > 1) {
+      qsort (AlertIndexResult, count, sizeof(int), alerter_index_compare);
+   }
+
+   return count;
+}
+
+
+void roadmap_alerter_index_invalidate (roadmap_alert_provider *provider) {
+
+   int i;
+
+   for (i = 0; i < AlertIndexCount; ++i) {
+      if (AlertIndexEntries[i].provider == provider) {
+         alerter_index_release (AlertIndexEntries + i);
+         AlertIndexEntries[i].last_access = 0;
+      }
+   }
+}
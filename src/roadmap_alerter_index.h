@@ -0,0 +1,45 @@
+/* roadmap_alerter_index.h - spatial index of the alert providers.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ROADMAP_ALERTER_INDEX__H_
+#define _ROADMAP_ALERTER_INDEX__H_
+
+#include "roadmap_types.h"
+#include "roadmap_alerter.h"
+
+/* Get the alerts of a provider that may be in range of the position: no
+ * further than the largest alert distance of the provider. The square is
+ * the active square for the square dependent providers, -1 otherwise.
+ * Returns the number of alerts, listed in increasing order.
+ */
+int  roadmap_alerter_index_query (roadmap_alert_provider *provider,
+                                  int square,
+                                  const RoadMapPosition *position,
+                                  const int **alerts);
+
+/* To be called by the providers that are not square dependent, when an
+ * alert is added or removed.
+ */
+void roadmap_alerter_index_invalidate (roadmap_alert_provider *provider);
+
+#endif // _ROADMAP_ALERTER_INDEX__H_
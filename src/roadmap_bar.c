@@ -537,6 +537,23 @@ static BarObject *roadmap_bar_by_pos (RoadMapGuiPoint *point, BarObjectTable_s *
    return NULL;
 }
 
+
+/* Only the object changed: the map under the bar needs no redraw. */
+static void roadmap_bar_damage (BarObject *object) {
+
+   RoadMapGuiPoint pos;
+   RoadMapGuiRect rect;
+
+   roadmap_bar_pos (object, &pos);
+
+   rect.minx = pos.x + object->bbox.minx;
+   rect.miny = pos.y + object->bbox.miny;
+   rect.maxx = pos.x + object->bbox.maxx;
+   rect.maxy = pos.y + object->bbox.maxy;
+
+   roadmap_screen_damage (&rect);
+}
+
 static void roadmap_bar_load (const char *data, int size, BarObjectTable_s *BarObjectTable) {
 
    int argc;
@@ -994,16 +1011,17 @@ int roadmap_bar_drag_motion (RoadMapGuiPoint *point)
         new_bar_object = roadmap_bar_by_pos(point, &BottomBarObjectTable);
         if (!new_bar_object){
            SelectedBarObject->image_state = IMAGE_STATE_NORMAL;
-           roadmap_screen_redraw();
+           roadmap_bar_damage (SelectedBarObject);
            return 1;
         }
    }
 
    if (new_bar_object != SelectedBarObject){
         SelectedBarObject->image_state = IMAGE_STATE_NORMAL;
+        roadmap_bar_damage (SelectedBarObject);
         SelectedBarObject = new_bar_object;
         new_bar_object->image_state = IMAGE_STATE_SELECTED;
-        roadmap_screen_redraw();
+        roadmap_bar_damage (new_bar_object);
         return 1;
    }
    return 1;
@@ -1034,7 +1052,7 @@ int roadmap_bar_obj_pressed (RoadMapGuiPoint *point)
    roadmap_pointer_register_drag_motion
       (roadmap_bar_drag_motion, POINTER_HIGHEST);
 
-   roadmap_screen_redraw();
+   roadmap_bar_damage (object);
 
    return 1;
 }
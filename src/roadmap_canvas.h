@@ -180,6 +180,12 @@ void roadmap_canvas_draw_multiple_polygons
          (int count, int *polygons, RoadMapGuiPoint *points, int filled,
                 int fast_draw);
 
+/* Fill triangles, three points each. Returns 0 if the canvas cannot, in
+ * which case polygons should be drawn as such.
+ */
+int roadmap_canvas_draw_triangles
+         (int count, RoadMapGuiPoint *points, int fast_draw);
+
 void roadmap_canvas_draw_multiple_circles
         (int count, RoadMapGuiPoint *centers, int *radius, int filled,
                 int fast_draw);
@@ -196,6 +202,20 @@ void roadmap_canvas_refresh (void);
 
 void roadmap_canvas_save_screenshot (const char* filename);
 
+/* Draw in memory, without a window (the AGG canvas, built with
+ * ROADMAP_HEADLESS).
+ */
+void roadmap_canvas_headless_configure (int width, int height);
+
+/* Keep a copy of the drawing buffer once the map is drawn, and paste it
+ * back (all of it, or only the given rectangle) to draw new overlays over
+ * the same map. Both return 0 if the canvas does not support it.
+ * roadmap_canvas_set_clip() limits all drawing to a rectangle (NULL: none).
+ */
+int  roadmap_canvas_save_map    (void);
+int  roadmap_canvas_restore_map (const RoadMapGuiRect *rect);
+void roadmap_canvas_set_clip    (const RoadMapGuiRect *rect);
+
 int  roadmap_canvas_image_width  (const RoadMapImage image);
 int  roadmap_canvas_image_height (const RoadMapImage image);
 
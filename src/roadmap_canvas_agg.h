@@ -49,6 +49,9 @@ extern RoadMapCanvasConfigureHandler RoadMapCanvasConfigure;
 
 void roadmap_canvas_agg_configure (unsigned char *buf, int width, int height, int stride);
 
+/* Complete any deferred drawing before the buffer is displayed. */
+void roadmap_canvas_agg_flush (void);
+
 /* GUI specific implementation */
 int roadmap_canvas_agg_to_wchar (const char *text, wchar_t *output, int size);
 agg::rgba8 roadmap_canvas_agg_parse_color (const char *color);
@@ -64,6 +64,7 @@
 #include "roadmap_messagebox.h"
 
 #include "roadmap_gps.h"
+#include "roadmap_gps_kalman.h"
 
 #ifdef J2ME
 #include "roadmap_gpsj2me.h"
@@ -141,10 +142,14 @@ static time_t RoadMapGpsConnectedSince = -1;
 
 static int RoadMapGpsShowRawGps;
 static BOOL RoadMapGpsCsvTrackerEnabled = FALSE;
+static BOOL RoadMapGpsKalmanEnabled = FALSE;
 static BOOL RoadMapGpsWarningInit = TRUE;
 
 
 #define ROADMAP_GPS_CLIENTS 16
+
+#define GPS_DEAD_RECKONING_DELAY 2 /* seconds without a fix */
+
 static roadmap_gps_listener RoadMapGpsListeners[ROADMAP_GPS_CLIENTS] = {NULL};
 static roadmap_fix_listener RoadMapFixListeners[ROADMAP_GPS_CLIENTS] = {NULL};
 static roadmap_gps_monitor  RoadMapGpsMonitors[ROADMAP_GPS_CLIENTS] = {NULL};
@@ -441,10 +446,24 @@ static void roadmap_gps_accept_fix (void)
 }
 
 
-static void roadmap_gps_process_position (void) {
+static void roadmap_gps_call_listeners (time_t gps_time,
+                                        const RoadMapGpsPosition *position) {
 
    int i;
 
+   for (i = 0; i < ROADMAP_GPS_CLIENTS; ++i) {
+
+      if (RoadMapGpsListeners[i] == NULL) break;
+
+      (RoadMapGpsListeners[i]) (gps_time, &RoadMapGpsQuality, position);
+   }
+}
+
+
+static void roadmap_gps_process_position (void) {
+
+   RoadMapGpsPosition position;
+
    if (RoadMapGpsShowRawGps) {
       roadmap_gps_raw(RoadMapGpsReceivedTime,
                       RoadMapGpsReceivedPosition.longitude,
@@ -487,16 +506,19 @@ static void roadmap_gps_process_position (void) {
    roadmap_gps_fine_fix_focus();
    roadmap_gps_update_reception ();
 
-   for (i = 0; i < ROADMAP_GPS_CLIENTS; ++i) {
-
-      if (RoadMapGpsListeners[i] == NULL) break;
+   /*
+    * The listeners get the filtered estimate, with the standard deviation
+    * of the position as its accuracy.
+    */
+   position = RoadMapGpsReceivedPosition;
 
-      (RoadMapGpsListeners[i])
-           (RoadMapGpsReceivedTime,
-            &RoadMapGpsQuality,
-            &RoadMapGpsReceivedPosition);
+   if (RoadMapGpsKalmanEnabled) {
+      roadmap_gps_kalman_update
+         (RoadMapGpsReceivedTime, &position, roadmap_gps_speed_accuracy ());
    }
 
+   roadmap_gps_call_listeners (RoadMapGpsReceivedTime, &position);
+
    if (roadmap_gps_have_reception() && (roadmap_verbosity () <= ROADMAP_MESSAGE_DEBUG) && (roadmap_gps_show_coordinats()))
       roadmap_display_text("DEBUG_LOC","%d.%06d, %d.%06d", (RoadMapGpsReceivedPosition.longitude)/1000000, abs(RoadMapGpsReceivedPosition.longitude)%1000000, (RoadMapGpsReceivedPosition.latitude)/1000000, abs(RoadMapGpsReceivedPosition.latitude)%1000000);
 }
@@ -531,6 +553,31 @@ static void roadmap_gps_call_loggers (const char *data) {
 }
 
 
+/*
+ * Keep the vehicle moving on the filtered course when the fixes stop for a
+ * few seconds (tunnels, urban canyons), until the coarse location takes over.
+ */
+static void roadmap_gps_dead_reckoning (void) {
+
+   RoadMapGpsPosition position;
+   int age;
+
+   if ((RoadMapGpsLatestFineFix == 0) || RoadMapGpsCoarseLocationMode) return;
+
+   age = (int) (time (NULL) - RoadMapGpsLatestFineFix);
+   if (age < GPS_DEAD_RECKONING_DELAY) return;
+
+   position = RoadMapGpsReceivedPosition;
+
+   if (!roadmap_gps_kalman_predict
+          (RoadMapGpsReceivedTime + age, &position, roadmap_gps_speed_accuracy ())) {
+      return;
+   }
+
+   roadmap_gps_call_listeners (RoadMapGpsReceivedTime + age, &position);
+}
+
+
 static void roadmap_gps_keep_alive (void)
 {
    int coarse_switch_timeout = roadmap_config_get_integer( &RoadMapConfigGpsCoarseSwitchTO );
@@ -1051,6 +1098,10 @@ void roadmap_gps_initialize (void) {
     	   roadmap_gps_csv_tracker_initialize();
        }
 
+#ifdef CSV_GPS
+       roadmap_gps_csv_initialize ();
+#endif
+
       roadmap_config_declare
          ("preferences", &RoadMapConfigGPSSpeedAccuracy, "4", NULL);
       roadmap_config_declare
@@ -1060,6 +1111,13 @@ void roadmap_gps_initialize (void) {
       roadmap_config_declare
          ("preferences", &RoadMapConfigGpsAcceptCoarseFixSeconds, "10", NULL);
 
+      roadmap_gps_kalman_initialize ();
+      RoadMapGpsKalmanEnabled = roadmap_gps_kalman_enabled ();
+
+      if (RoadMapGpsKalmanEnabled) {
+         roadmap_main_set_periodic (1000, roadmap_gps_dead_reckoning);
+      }
+
 
 #if defined (_WIN32) && !defined (__SYMBIAN32__)
 
@@ -1150,6 +1208,12 @@ void roadmap_gps_shutdown (void) {
 
    roadmap_gps_csv_tracker_shutdown();
 
+#ifdef CSV_GPS
+   if (RoadMapGpsProtocol == ROADMAP_GPS_CSV) {
+      roadmap_gps_csv_shutdown ();
+   }
+#endif
+
 #ifdef __SYMBIAN32__
    roadmap_gpssymbian_shutdown();
 #endif
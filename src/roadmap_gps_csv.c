@@ -0,0 +1,272 @@
+/* roadmap_gps_csv.c - replay a GPS track recorded in a csv file.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The track is read at once, so that the file I/O does not weigh on
+ *   the replay. Each line holds, as written by roadmap_gps_csv_tracker():
+ *
+ *      time, status, longitude, latitude, steering, speed, accuracy, satellites
+ *
+ *   The fixes are replayed with their recorded time, from a periodic timer,
+ *   at the "GPS" / "Replay Speed" rate: 1 for the recorded pace, N for N
+ *   times faster, and 0 for as fast as possible. The time spent handling
+ *   the fixes is logged when the replay ends, to profile the whole per fix
+ *   pipeline (map matching, navigation, alerts...).
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_gps_csv.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "roadmap.h"
+#include "roadmap_config.h"
+#include "roadmap_file.h"
+#include "roadmap_path.h"
+#include "roadmap_main.h"
+#include "roadmap_time.h"
+#include "roadmap_nmea.h"
+
+#include "roadmap_gps_csv.h"
+
+
+static RoadMapConfigDescriptor RoadMapConfigGpsCsvSpeed =
+                        ROADMAP_CONFIG_ITEM("GPS", "Replay Speed");
+
+#define CSV_TICK        10  /* ms */
+#define CSV_FAST_SLICE  50  /* ms of replay per tick, as fast as possible */
+
+typedef struct {
+   int  gps_time;
+   char status;
+   int  longitude;
+   int  latitude;
+   int  steering;
+   int  speed;
+   int  accuracy;
+   int  satellites;
+} RoadMapGpsCsvFix;
+
+static RoadMapGpsCsvFix *RoadMapGpsCsvFixes = NULL;
+static int RoadMapGpsCsvCount = 0;
+static int RoadMapGpsCsvSize = 0;
+static int RoadMapGpsCsvNext = 0;
+
+static int      RoadMapGpsCsvSpeed = 0;
+static int      RoadMapGpsCsvStartTime;
+static uint32_t RoadMapGpsCsvStartMillis;
+static uint32_t RoadMapGpsCsvWorkMillis;
+static uint32_t RoadMapGpsCsvMaxMillis;
+
+static RoadMapGpsdNavigation RoadMapGpsCsvNavigationListener = NULL;
+static RoadMapGpsdSatellite  RoadMapGpsCsvSatelliteListener = NULL;
+static RoadMapGpsdDilution   RoadMapGpsCsvDilutionListener = NULL;
+
+
+void roadmap_gps_csv_subscribe_to_navigation (RoadMapGpsdNavigation navigation) {
+
+   RoadMapGpsCsvNavigationListener = navigation;
+}
+
+
+void roadmap_gps_csv_subscribe_to_satellites (RoadMapGpsdSatellite satellite) {
+
+   RoadMapGpsCsvSatelliteListener = satellite;
+}
+
+
+void roadmap_gps_csv_subscribe_to_dilution (RoadMapGpsdDilution dilution) {
+
+   RoadMapGpsCsvDilutionListener = dilution;
+}
+
+
+static int roadmap_gps_csv_load (const char *name) {
+
+   const char *path = roadmap_path_is_full_path (name) ? NULL : roadmap_path_gps ();
+   FILE *file = roadmap_file_fopen (path, name, "r");
+   char line[256];
+
+   if (file == NULL) return -1;
+
+   RoadMapGpsCsvCount = 0;
+
+   while (fgets (line, sizeof(line), file) != NULL) {
+
+      RoadMapGpsCsvFix fix;
+
+      /* The header line only has the time and 'S'. */
+      if (sscanf (line, "%d, %c, %d, %d, %d, %d, %d, %d",
+                  &fix.gps_time, &fix.status, &fix.longitude, &fix.latitude,
+                  &fix.steering, &fix.speed, &fix.accuracy, &fix.satellites) != 8) {
+         continue;
+      }
+
+      if (RoadMapGpsCsvCount >= RoadMapGpsCsvSize) {
+         RoadMapGpsCsvSize = RoadMapGpsCsvSize ? RoadMapGpsCsvSize * 2 : 1024;
+         RoadMapGpsCsvFixes =
+            realloc (RoadMapGpsCsvFixes, RoadMapGpsCsvSize * sizeof(RoadMapGpsCsvFix));
+         roadmap_check_allocated (RoadMapGpsCsvFixes);
+      }
+
+      RoadMapGpsCsvFixes[RoadMapGpsCsvCount++] = fix;
+   }
+
+   fclose (file);
+
+   return RoadMapGpsCsvCount > 0 ? 0 : -1;
+}
+
+
+static void roadmap_gps_csv_replay (const RoadMapGpsCsvFix *fix) {
+
+   int i;
+
+   if (fix->status == 'L') {
+      /* A cell/wifi location. */
+      roadmap_gps_coarse_fix (fix->latitude, fix->longitude, fix->accuracy,
+                              (time_t) fix->gps_time);
+      return;
+   }
+
+   if (RoadMapGpsCsvSatelliteListener && fix->satellites > 0) {
+
+      int count = fix->satellites;
+
+      if (count > ROADMAP_NMEA_MAX_SATELLITE) count = ROADMAP_NMEA_MAX_SATELLITE;
+
+      for (i = 1; i <= count; ++i) {
+         (*RoadMapGpsCsvSatelliteListener) (i, i, 0, 0, 0, 1);
+      }
+      (*RoadMapGpsCsvSatelliteListener) (0, 0, 0, 0, 0, 0);
+   }
+
+   if (RoadMapGpsCsvNavigationListener) {
+      (*RoadMapGpsCsvNavigationListener) (fix->status,
+                                          fix->gps_time,
+                                          fix->latitude,
+                                          fix->longitude,
+                                          ROADMAP_NO_VALID_DATA,
+                                          fix->speed,
+                                          fix->steering,
+                                          fix->accuracy);
+   }
+}
+
+
+static void roadmap_gps_csv_tick (void) {
+
+   uint32_t now = roadmap_time_get_millis ();
+   int target = 0;
+
+   if (RoadMapGpsCsvSpeed > 0) {
+      target = RoadMapGpsCsvStartTime +
+                  (int)((now - RoadMapGpsCsvStartMillis) * RoadMapGpsCsvSpeed / 1000);
+   }
+
+   while (RoadMapGpsCsvNext < RoadMapGpsCsvCount) {
+
+      const RoadMapGpsCsvFix *fix = RoadMapGpsCsvFixes + RoadMapGpsCsvNext;
+      uint32_t before;
+      uint32_t spent;
+
+      if (RoadMapGpsCsvSpeed > 0) {
+         if (fix->gps_time > target) break;
+      } else {
+         if (roadmap_time_get_millis () - now >= CSV_FAST_SLICE) break;
+      }
+
+      before = roadmap_time_get_millis ();
+
+      RoadMapGpsCsvNext++;
+      roadmap_gps_csv_replay (fix);
+
+      spent = roadmap_time_get_millis () - before;
+      RoadMapGpsCsvWorkMillis += spent;
+      if (spent > RoadMapGpsCsvMaxMillis) RoadMapGpsCsvMaxMillis = spent;
+   }
+
+   if (RoadMapGpsCsvNext >= RoadMapGpsCsvCount) {
+
+      roadmap_main_remove_periodic (roadmap_gps_csv_tick);
+
+      roadmap_log (ROADMAP_INFO,
+                   "csv replay done: %d fixes in %u ms, %u ms handling them (avg %u, max %u)",
+                   RoadMapGpsCsvCount,
+                   roadmap_time_get_millis () - RoadMapGpsCsvStartMillis,
+                   RoadMapGpsCsvWorkMillis,
+                   RoadMapGpsCsvWorkMillis / RoadMapGpsCsvCount,
+                   RoadMapGpsCsvMaxMillis);
+   }
+}
+
+
+void roadmap_gps_csv_initialize (void) {
+
+#ifdef CSV_REALTIME
+   roadmap_config_declare ("preferences", &RoadMapConfigGpsCsvSpeed, "1", NULL);
+#else
+   roadmap_config_declare ("preferences", &RoadMapConfigGpsCsvSpeed, "0", NULL);
+#endif
+}
+
+
+int roadmap_gps_csv_connect (const char *name) {
+
+   roadmap_gps_csv_shutdown ();
+
+   if (roadmap_gps_csv_load (name) != 0) {
+      roadmap_log (ROADMAP_ERROR, "no GPS fix in csv file %s", name);
+      return -1;
+   }
+
+   RoadMapGpsCsvSpeed = roadmap_config_get_integer (&RoadMapConfigGpsCsvSpeed);
+   if (RoadMapGpsCsvSpeed < 0) RoadMapGpsCsvSpeed = 0;
+
+   RoadMapGpsCsvNext = 0;
+   RoadMapGpsCsvStartTime = RoadMapGpsCsvFixes[0].gps_time;
+   RoadMapGpsCsvStartMillis = roadmap_time_get_millis ();
+   RoadMapGpsCsvWorkMillis = 0;
+   RoadMapGpsCsvMaxMillis = 0;
+
+   roadmap_log (ROADMAP_INFO, "replaying %d GPS fixes from %s (speed %d)",
+                RoadMapGpsCsvCount, name, RoadMapGpsCsvSpeed);
+
+   roadmap_main_set_periodic (CSV_TICK, roadmap_gps_csv_tick);
+
+   return 0;
+}
+
+
+void roadmap_gps_csv_shutdown (void) {
+
+   if (RoadMapGpsCsvNext < RoadMapGpsCsvCount) {
+      roadmap_main_remove_periodic (roadmap_gps_csv_tick);
+   }
+
+   RoadMapGpsCsvCount = 0;
+   RoadMapGpsCsvNext = 0;
+}
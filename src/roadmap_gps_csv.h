@@ -0,0 +1,50 @@
+/* roadmap_gps_csv.h - replay a GPS track recorded in a csv file.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * DESCRIPTION:
+ *
+ *   This module reads back the GPS_track_*.csv files written by the GPS
+ *   csv tracker, and replays their fixes as a GPS source ("csv://file").
+ */
+
+#ifndef INCLUDE__ROADMAP_GPS_CSV__H
+#define INCLUDE__ROADMAP_GPS_CSV__H
+
+#include "roadmap_gps.h"
+
+
+void roadmap_gps_csv_subscribe_to_navigation (RoadMapGpsdNavigation navigation);
+
+void roadmap_gps_csv_subscribe_to_satellites (RoadMapGpsdSatellite satellite);
+
+void roadmap_gps_csv_subscribe_to_dilution   (RoadMapGpsdDilution dilution);
+
+
+void roadmap_gps_csv_initialize (void);
+
+/* Load the track and start the replay. Returns 0 on success. */
+int  roadmap_gps_csv_connect (const char *name);
+
+void roadmap_gps_csv_shutdown (void);
+
+#endif // INCLUDE__ROADMAP_GPS_CSV__H
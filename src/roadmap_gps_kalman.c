@@ -0,0 +1,307 @@
+/* roadmap_gps_kalman.c - smooth the GPS fixes with a Kalman filter.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   A constant velocity model, in meters east and north of a reference
+ *   point. The two axes are filtered separately, each with a position and
+ *   velocity state, which keeps the kernels to a few multiplications:
+ *
+ *   - the fix position is measured with the GPS accuracy;
+ *   - the GPS speed and steering give a velocity measurement, when the
+ *     vehicle moves fast enough for the steering to be meaningful.
+ *
+ *   The filter restarts after a long gap or a jump it cannot explain.
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_gps_kalman.h
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "roadmap.h"
+#include "roadmap_config.h"
+
+#include "roadmap_gps_kalman.h"
+
+
+static RoadMapConfigDescriptor RoadMapConfigGpsKalman =
+                        ROADMAP_CONFIG_ITEM("GPS", "Kalman Filter");
+
+#define KALMAN_ACCELERATION     3.0    /* m/s2, process noise */
+#define KALMAN_MIN_ACCURACY     5.0    /* m */
+#define KALMAN_SPEED_ERROR      1.0    /* m/s */
+#define KALMAN_MAX_GAP          10     /* s */
+#define KALMAN_MAX_JUMP         5.0    /* standard deviations */
+#define KALMAN_MIN_JUMP         50.0   /* m */
+#define KALMAN_MAX_PREDICTION   10     /* s */
+
+#define KALMAN_METERS_PER_UNIT  0.11112 /* meters per latitude unit */
+#define KALMAN_MS_PER_KNOT      0.514444
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+   double x;   /* m */
+   double v;   /* m/s */
+   double p00;
+   double p01;
+   double p11;
+} KalmanAxis;
+
+static KalmanAxis KalmanEast;
+static KalmanAxis KalmanNorth;
+
+static int    KalmanValid = 0;
+static time_t KalmanTime;
+static int    KalmanSteering;
+
+static RoadMapPosition KalmanReference;
+static double KalmanMetersPerLongitude;
+
+
+static void kalman_axis_init (KalmanAxis *axis, double x, double v,
+                              double position_variance, double speed_variance) {
+
+   axis->x = x;
+   axis->v = v;
+   axis->p00 = position_variance;
+   axis->p01 = 0;
+   axis->p11 = speed_variance;
+}
+
+
+static void kalman_axis_predict (KalmanAxis *axis, double dt) {
+
+   double q = KALMAN_ACCELERATION * KALMAN_ACCELERATION;
+   double dt2 = dt * dt;
+
+   axis->x += axis->v * dt;
+
+   axis->p00 += dt * (2 * axis->p01 + dt * axis->p11) + q * dt2 * dt2 / 4;
+   axis->p01 += dt * axis->p11 + q * dt2 * dt / 2;
+   axis->p11 += q * dt2;
+}
+
+
+static void kalman_axis_measure_position (KalmanAxis *axis, double z, double r) {
+
+   double s = axis->p00 + r;
+   double k0 = axis->p00 / s;
+   double k1 = axis->p01 / s;
+   double y = z - axis->x;
+
+   axis->x += k0 * y;
+   axis->v += k1 * y;
+
+   axis->p11 -= k1 * axis->p01;
+   axis->p00 *= 1 - k0;
+   axis->p01 *= 1 - k0;
+}
+
+
+static void kalman_axis_measure_speed (KalmanAxis *axis, double z, double r) {
+
+   double s = axis->p11 + r;
+   double k0 = axis->p01 / s;
+   double k1 = axis->p11 / s;
+   double y = z - axis->v;
+
+   axis->x += k0 * y;
+   axis->v += k1 * y;
+
+   axis->p00 -= k0 * axis->p01;
+   axis->p01 *= 1 - k1;
+   axis->p11 *= 1 - k1;
+}
+
+
+static void kalman_to_meters (const RoadMapGpsPosition *position, double *east, double *north) {
+
+   *east = (position->longitude - KalmanReference.longitude) * KalmanMetersPerLongitude;
+   *north = (position->latitude - KalmanReference.latitude) * KALMAN_METERS_PER_UNIT;
+}
+
+
+static void kalman_output (const KalmanAxis *east, const KalmanAxis *north,
+                           RoadMapGpsPosition *position, int speed_accuracy) {
+
+   double speed = sqrt (east->v * east->v + north->v * north->v);
+   double variance = east->p00 > north->p00 ? east->p00 : north->p00;
+
+   position->longitude = KalmanReference.longitude +
+                            (int) floor (east->x / KalmanMetersPerLongitude + 0.5);
+   position->latitude = KalmanReference.latitude +
+                            (int) floor (north->x / KALMAN_METERS_PER_UNIT + 0.5);
+
+   position->speed = (int) (speed / KALMAN_MS_PER_KNOT + 0.5);
+
+   if (position->speed >= speed_accuracy) {
+      int steering = (int) (atan2 (east->v, north->v) * 180 / M_PI + 0.5);
+      if (steering < 0) steering += 360;
+      position->steering = steering % 360;
+   } else {
+      position->steering = KalmanSteering;
+   }
+
+   position->accuracy = (int) ceil (sqrt (variance));
+   if (position->accuracy < 1) position->accuracy = 1;
+}
+
+
+static void kalman_start (time_t gps_time, const RoadMapGpsPosition *position) {
+
+   double accuracy = position->accuracy;
+   double speed = position->speed * KALMAN_MS_PER_KNOT;
+   double angle = 0;
+
+   if (accuracy < KALMAN_MIN_ACCURACY) accuracy = KALMAN_MIN_ACCURACY;
+
+   KalmanReference.longitude = position->longitude;
+   KalmanReference.latitude = position->latitude;
+   KalmanMetersPerLongitude =
+      KALMAN_METERS_PER_UNIT * cos (position->latitude / 1000000.0 * M_PI / 180);
+
+   if (position->steering < 360) {
+      angle = position->steering * M_PI / 180;
+   } else {
+      speed = 0;
+   }
+
+   kalman_axis_init (&KalmanEast, 0, speed * sin (angle),
+                     accuracy * accuracy, KALMAN_SPEED_ERROR * KALMAN_SPEED_ERROR);
+   kalman_axis_init (&KalmanNorth, 0, speed * cos (angle),
+                     accuracy * accuracy, KALMAN_SPEED_ERROR * KALMAN_SPEED_ERROR);
+
+   KalmanTime = gps_time;
+   KalmanValid = 1;
+}
+
+
+void roadmap_gps_kalman_update (time_t gps_time,
+                                RoadMapGpsPosition *position,
+                                int speed_accuracy) {
+
+   double accuracy = position->accuracy;
+   double r;
+   double east;
+   double north;
+   double jump;
+   double limit;
+
+   if (accuracy < KALMAN_MIN_ACCURACY) accuracy = KALMAN_MIN_ACCURACY;
+   r = accuracy * accuracy;
+
+   if (position->steering < 360) KalmanSteering = position->steering;
+
+   if (!KalmanValid ||
+       (gps_time < KalmanTime) ||
+       (gps_time - KalmanTime > KALMAN_MAX_GAP)) {
+      kalman_start (gps_time, position);
+      kalman_output (&KalmanEast, &KalmanNorth, position, speed_accuracy);
+      return;
+   }
+
+   if (gps_time > KalmanTime) {
+      double dt = (double) (gps_time - KalmanTime);
+      kalman_axis_predict (&KalmanEast, dt);
+      kalman_axis_predict (&KalmanNorth, dt);
+      KalmanTime = gps_time;
+   }
+
+   kalman_to_meters (position, &east, &north);
+
+   jump = sqrt ((east - KalmanEast.x) * (east - KalmanEast.x) +
+                (north - KalmanNorth.x) * (north - KalmanNorth.x));
+   limit = KALMAN_MAX_JUMP * sqrt (KalmanEast.p00 + KalmanNorth.p00 + 2 * r);
+   if (limit < KALMAN_MIN_JUMP) limit = KALMAN_MIN_JUMP;
+
+   if (jump > limit) {
+      roadmap_log (ROADMAP_DEBUG, "GPS jump of %d meters, restarting the filter", (int) jump);
+      kalman_start (gps_time, position);
+      kalman_output (&KalmanEast, &KalmanNorth, position, speed_accuracy);
+      return;
+   }
+
+   kalman_axis_measure_position (&KalmanEast, east, r);
+   kalman_axis_measure_position (&KalmanNorth, north, r);
+
+   if ((position->speed >= speed_accuracy) && (position->steering < 360)) {
+
+      double speed = position->speed * KALMAN_MS_PER_KNOT;
+      double angle = position->steering * M_PI / 180;
+      double rv = KALMAN_SPEED_ERROR * KALMAN_SPEED_ERROR;
+
+      kalman_axis_measure_speed (&KalmanEast, speed * sin (angle), rv);
+      kalman_axis_measure_speed (&KalmanNorth, speed * cos (angle), rv);
+   }
+
+   kalman_output (&KalmanEast, &KalmanNorth, position, speed_accuracy);
+}
+
+
+int roadmap_gps_kalman_predict (time_t gps_time,
+                                RoadMapGpsPosition *position,
+                                int speed_accuracy) {
+
+   KalmanAxis east = KalmanEast;
+   KalmanAxis north = KalmanNorth;
+   double dt;
+
+   if (!KalmanValid) return 0;
+
+   dt = (double) (gps_time - KalmanTime);
+   if ((dt <= 0) || (dt > KALMAN_MAX_PREDICTION)) return 0;
+
+   kalman_axis_predict (&east, dt);
+   kalman_axis_predict (&north, dt);
+
+   kalman_output (&east, &north, position, speed_accuracy);
+
+   return position->speed >= speed_accuracy;
+}
+
+
+void roadmap_gps_kalman_reset (void) {
+
+   KalmanValid = 0;
+}
+
+
+int roadmap_gps_kalman_enabled (void) {
+
+   return roadmap_config_match (&RoadMapConfigGpsKalman, "yes");
+}
+
+
+void roadmap_gps_kalman_initialize (void) {
+
+   roadmap_config_declare_enumeration
+      ("preferences", &RoadMapConfigGpsKalman, NULL, "no", "yes", NULL);
+
+   KalmanSteering = 0;
+   roadmap_gps_kalman_reset ();
+}
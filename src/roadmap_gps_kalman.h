@@ -0,0 +1,53 @@
+/* roadmap_gps_kalman.h - smooth the GPS fixes with a Kalman filter.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ROADMAP_GPS_KALMAN__H_
+#define _ROADMAP_GPS_KALMAN__H_
+
+#include <time.h>
+
+#include "roadmap_gps.h"
+
+void roadmap_gps_kalman_initialize (void);
+
+/* True when the "GPS" / "Kalman Filter" preference is set. */
+int  roadmap_gps_kalman_enabled (void);
+
+void roadmap_gps_kalman_reset (void);
+
+/* Filter a fix: the position, speed and steering are replaced by the
+ * estimate, and the accuracy by the standard deviation of the estimated
+ * position, in meters.
+ */
+void roadmap_gps_kalman_update (time_t gps_time,
+                                RoadMapGpsPosition *position,
+                                int speed_accuracy);
+
+/* Extrapolate the last estimate to gps_time, for a moving vehicle only.
+ * Returns 0 if there is no reliable estimate.
+ */
+int  roadmap_gps_kalman_predict (time_t gps_time,
+                                 RoadMapGpsPosition *position,
+                                 int speed_accuracy);
+
+#endif // _ROADMAP_GPS_KALMAN__H_
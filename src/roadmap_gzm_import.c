@@ -0,0 +1,292 @@
+/* roadmap_gzm_import.c - Stream a gzm map file into the tile storage.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_gzm_import.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "roadmap.h"
+#include "roadmap_gzm.h"
+#include "roadmap_gzm_import.h"
+#include "roadmap_tile_storage.h"
+#include "roadmap_dbread.h"
+#include "roadmap_file.h"
+#include "roadmap_main.h"
+#include "roadmap_screen.h"
+#include "roadmap_time.h"
+
+#define GZM_IMPORT_TICK_INTERVAL    10    // msec between batches
+#define GZM_IMPORT_BATCH_TIME       250   // msec budget of one batch
+#define GZM_IMPORT_BATCH_MAX_TILES  2000
+#define GZM_IMPORT_MAX_FAILURES     3     // failed runs at the same tile before giving up
+
+static int  ImportFips = -1;
+static int  ImportGzmId = -1;
+static int  ImportNextTile = 0;
+static int  ImportFirstTile = 0;    // first tile of this run (> 0 when resumed)
+static int  ImportFailures = 0;     // failed runs in a row, see import_fail()
+static uint32_t ImportStartTime = 0;
+static RoadMapGzmImportStats ImportStats;
+static RoadMapGzmImportCallback ImportCallback = NULL;
+
+static void import_tick (void);
+
+
+static const char *import_progress_name (int fips) {
+
+   static char name[32];
+
+   snprintf (name, sizeof (name), "map%05d.imp", fips);
+   return name;
+}
+
+
+/* The progress file holds the next tile to import and the count of the
+ * runs that failed in a row (the count may be missing).
+ */
+static int import_progress_load (int fips, int *failures) {
+
+   FILE *file;
+   int next_tile = 0;
+
+   *failures = 0;
+
+   file = roadmap_file_fopen (roadmap_db_map_path (), import_progress_name (fips), "r");
+   if (file) {
+      int count = fscanf (file, "%d %d", &next_tile, failures);
+      if (count < 1 || next_tile < 0) {
+         next_tile = 0;
+      }
+      if (count < 2 || *failures < 0) {
+         *failures = 0;
+      }
+      fclose (file);
+   }
+
+   return next_tile;
+}
+
+
+static void import_progress_save (int fips, int next_tile, int failures) {
+
+   char data[32];
+
+   snprintf (data, sizeof (data), "%d %d\n", next_tile, failures);
+   roadmap_file_save (roadmap_db_map_path (), import_progress_name (fips), data, strlen (data));
+}
+
+
+static void import_finish (BOOL success) {
+
+   RoadMapGzmImportCallback callback = ImportCallback;
+   int elapsed_sec;
+
+   roadmap_main_remove_periodic (import_tick);
+
+   if (ImportGzmId >= 0) {
+      roadmap_gzm_close (ImportGzmId);
+      ImportGzmId = -1;
+   }
+
+   if (success) {
+      roadmap_file_remove (roadmap_db_map_path (), import_progress_name (ImportFips));
+   }
+
+   elapsed_sec = ImportStats.elapsed_ms / 1000;
+   if (elapsed_sec <= 0) elapsed_sec = 1;
+   roadmap_log (ROADMAP_INFO,
+                "gzm import of %d %s: %d/%d tiles, %d KB in %d ms (%d tiles/sec, %d KB/sec)",
+                ImportFips, success ? "complete" : "stopped",
+                ImportStats.tiles_done, ImportStats.tiles_total,
+                ImportStats.bytes_done / 1024, ImportStats.elapsed_ms,
+                (ImportStats.tiles_done - ImportFirstTile) / elapsed_sec,
+                ImportStats.bytes_done / 1024 / elapsed_sec);
+
+   ImportFips = -1;
+   ImportCallback = NULL;
+
+   if (callback) {
+      callback (success, &ImportStats);
+   }
+}
+
+
+/* A failed run is resumed at the next locator open, but a tile that
+ * always fails would be retried forever: the import is dropped after
+ * GZM_IMPORT_MAX_FAILURES failed runs in a row.
+ */
+static void import_fail (void) {
+
+   if (++ImportFailures >= GZM_IMPORT_MAX_FAILURES) {
+      roadmap_log (ROADMAP_ERROR, "gzm import of %d failed %d times at tile %d - giving up",
+                   ImportFips, ImportFailures, ImportNextTile);
+      roadmap_file_remove (roadmap_db_map_path (), import_progress_name (ImportFips));
+   } else {
+      import_progress_save (ImportFips, ImportNextTile, ImportFailures);
+   }
+
+   import_finish (FALSE);
+}
+
+
+static void import_tick (void) {
+
+   uint32_t batch_start = roadmap_time_get_millis ();
+   int n_tiles = ImportStats.tiles_total;
+   int n_batch = 0;
+   BOOL success = TRUE;
+
+   if (roadmap_tile_store_batch_begin (ImportFips) != 0) {
+      import_fail ();
+      return;
+   }
+
+   while (ImportNextTile < n_tiles && n_batch < GZM_IMPORT_BATCH_MAX_TILES) {
+
+      int tile_id = roadmap_map_get_tile_id (ImportGzmId, ImportNextTile);
+      void *section;
+      int length;
+
+      if (roadmap_gzm_get_section (ImportGzmId, tile_id, &section, &length) != 0) {
+         success = FALSE;
+         break;
+      }
+
+      /* Drop a stale in-memory copy, the stored tile replaces it */
+      roadmap_db_close (ImportFips, tile_id);
+      roadmap_screen_cache_clear (tile_id);
+
+      if (roadmap_tile_store_batch (ImportFips, tile_id, section, length) != 0) {
+         roadmap_gzm_free_section (ImportGzmId, section);
+         success = FALSE;
+         break;
+      }
+      roadmap_gzm_free_section (ImportGzmId, section);
+
+      ImportNextTile++;
+      ImportStats.bytes_done += length;
+      n_batch++;
+
+      if ((n_batch & 15) == 0 &&
+          roadmap_time_get_millis () - batch_start >= GZM_IMPORT_BATCH_TIME) {
+         break;
+      }
+   }
+
+   if (roadmap_tile_store_batch_end (ImportFips, success) != 0) {
+      success = FALSE;
+   }
+
+   ImportStats.elapsed_ms = roadmap_time_get_millis () - ImportStartTime;
+
+   if (!success) {
+      /* The batch was rolled back: resume from the last committed tile */
+      ImportNextTile = ImportStats.tiles_done;
+      import_fail ();
+      return;
+   }
+
+   if (n_batch > 0) {
+      ImportFailures = 0;
+   }
+
+   ImportStats.tiles_done = ImportNextTile;
+   import_progress_save (ImportFips, ImportNextTile, ImportFailures);
+
+   if (ImportNextTile >= n_tiles) {
+      import_finish (TRUE);
+   }
+}
+
+
+BOOL roadmap_gzm_import_start (int fips, RoadMapGzmImportCallback callback) {
+
+   char gzm_name[256];
+
+   if (ImportFips >= 0) {
+      roadmap_log (ROADMAP_ERROR, "gzm import of %d is already running", ImportFips);
+      return FALSE;
+   }
+
+   snprintf (gzm_name, sizeof (gzm_name), "map%05d%s", fips, ROADMAP_GZM_TYPE);
+   ImportGzmId = roadmap_gzm_open (gzm_name);
+   if (ImportGzmId < 0) {
+      roadmap_log (ROADMAP_ERROR, "gzm import: cannot open %s", gzm_name);
+      return FALSE;
+   }
+
+   ImportFips = fips;
+   ImportCallback = callback;
+   ImportStartTime = roadmap_time_get_millis ();
+
+   memset (&ImportStats, 0, sizeof (ImportStats));
+   ImportStats.tiles_total = roadmap_map_get_num_tiles (ImportGzmId);
+
+   ImportNextTile = import_progress_load (fips, &ImportFailures);
+   if (ImportNextTile > ImportStats.tiles_total) {
+      ImportNextTile = 0;
+   }
+   ImportStats.tiles_done = ImportNextTile;
+   ImportFirstTile = ImportNextTile;
+
+   if (ImportNextTile > 0) {
+      roadmap_log (ROADMAP_INFO, "gzm import of %d resumed at tile %d/%d",
+                   fips, ImportNextTile, ImportStats.tiles_total);
+   } else {
+      import_progress_save (fips, 0, ImportFailures);
+   }
+
+   roadmap_main_set_periodic (GZM_IMPORT_TICK_INTERVAL, import_tick);
+   return TRUE;
+}
+
+
+void roadmap_gzm_import_cancel (void) {
+
+   if (ImportFips < 0) return;
+
+   /* The progress file is kept - the next start resumes the import */
+   import_finish (FALSE);
+}
+
+
+BOOL roadmap_gzm_import_active (void) {
+
+   return (ImportFips >= 0);
+}
+
+
+BOOL roadmap_gzm_import_pending (int fips) {
+
+   return roadmap_file_exists (roadmap_db_map_path (), import_progress_name (fips));
+}
+
+
+const RoadMapGzmImportStats *roadmap_gzm_import_stats (void) {
+
+   return &ImportStats;
+}
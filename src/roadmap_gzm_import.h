@@ -0,0 +1,55 @@
+/* roadmap_gzm_import.h - Stream a gzm map file into the tile storage.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The import runs from the main loop: every tick reads the next gzm
+ *   sections sequentially and writes them to the tile storage in one batch.
+ *   The position of the last committed batch is kept in a progress file,
+ *   so an interrupted import continues from that point when restarted.
+ */
+
+#ifndef INCLUDE__ROADMAP_GZM_IMPORT__H
+#define INCLUDE__ROADMAP_GZM_IMPORT__H
+
+#include "roadmap.h"
+
+typedef struct {
+
+   int tiles_done;
+   int tiles_total;
+   int bytes_done;
+   int elapsed_ms;
+
+} RoadMapGzmImportStats;
+
+typedef void (*RoadMapGzmImportCallback) (BOOL success, const RoadMapGzmImportStats *stats);
+
+BOOL roadmap_gzm_import_start (int fips, RoadMapGzmImportCallback callback);
+void roadmap_gzm_import_cancel (void);
+
+BOOL roadmap_gzm_import_active (void);
+BOOL roadmap_gzm_import_pending (int fips);
+
+const RoadMapGzmImportStats *roadmap_gzm_import_stats (void);
+
+#endif // INCLUDE__ROADMAP_GZM_IMPORT__H
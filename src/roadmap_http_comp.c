@@ -24,6 +24,7 @@
 
 #include "stdlib.h"
 #include "string.h"
+#include "strings.h"
 #include "zlib.h"
 #include "roadmap_http_comp.h"
 
@@ -34,6 +35,7 @@
 #define STATE_DEFLATE_READ_HEADER 4
 #define STATE_COMPRESSION_FLOW    5
 #define STATE_SEND_ACK            6
+#define STATE_SKIP_TRAILER        7
 
 static const char deflate_magic[2] = {'\037', '\213' };
 
@@ -53,26 +55,57 @@ struct roadmap_http_comp_t {
    int read_ptr;
    int read_size;
 
+   /* Bytes of the body not read yet, as sent; -1 if there is no
+    * Content-Length. The response ends there, and the connection may
+    * carry the next one.
+    */
+   int body_left;
+
    z_stream stream;
    unsigned int crc;
 };
 
 static const int ZLIB_WIN_SIZE = 15;
 
+/* The value of the header field 'name', if it is in 'headers' */
+static const char *find_header (const char *headers, const char *end, const char *name) {
+
+   int length = strlen(name);
+   const char *line = headers;
+
+   while (line != NULL && line < end) {
+
+      if (!strncasecmp(line, name, length)) return line + length;
+
+      line = strstr(line, "\r\n");
+      if (line != NULL) line += 2;
+   }
+
+   return NULL;
+}
+
 /* process http headers and see if we got a compressed response.
  * NOTE: we assume that the whole header can fit our buffer
  */
 static void process_headers (RoadMapHttpCompCtx ctx) {
    char *ptr;
+   const char *value;
    if ((ptr = strstr(ctx->buffer, "\r\n\r\n")) != NULL) {
 
       /* We got all the headers so we can now send to the consumer */
       ctx->state = STATE_SEND_HEADERS;
       ctx->read_size = ptr - ctx->buffer + 4;
 
-      if (strstr(ctx->buffer, "Content-Encoding: gzip") != NULL) {
+      if ((value = find_header(ctx->buffer, ptr, "Content-Encoding:")) != NULL &&
+          !strncasecmp(value + strspn(value, " "), "gzip", 4)) {
          ctx->flags |= FLAG_COMPRESSED;
       }
+
+      ctx->body_left = -1;
+      if ((value = find_header(ctx->buffer, ptr, "Content-Length:")) != NULL) {
+         ctx->body_left = atoi(value);
+         if (ctx->body_left < 0) ctx->body_left = -1;
+      }
    } else if ((ptr = strstr(ctx->buffer, "ack\r\n")) != NULL) {
       
       /* We got ack so we can now send to the consumer */
@@ -82,6 +115,42 @@ static void process_headers (RoadMapHttpCompCtx ctx) {
 
 }
 
+/* The body is over: what is left in the buffer is the next response */
+static void end_body (RoadMapHttpCompCtx ctx) {
+
+   int left = ctx->buffer_ptr - ctx->read_ptr;
+
+   memmove(ctx->buffer, ctx->buffer + ctx->read_ptr, left);
+   ctx->buffer_ptr = left;
+   ctx->buffer[left] = '\0';
+   ctx->read_ptr = 0;
+   ctx->read_size = 0;
+
+   ctx->flags &= ~FLAG_COMPRESSED;
+   ctx->body_left = -1;
+   inflateReset(&ctx->stream);
+
+   ctx->state = STATE_READ_HEADERS;
+   process_headers(ctx);
+}
+
+/* Drop the rest of the body: the gzip trailer */
+static void skip_trailer (RoadMapHttpCompCtx ctx) {
+
+   int skip = ctx->buffer_ptr - ctx->read_ptr;
+
+   if (skip > ctx->body_left) skip = ctx->body_left;
+
+   ctx->read_ptr += skip;
+   ctx->body_left -= skip;
+
+   if (ctx->body_left == 0) {
+      end_body(ctx);
+   } else if (ctx->read_ptr == ctx->buffer_ptr) {
+      ctx->read_ptr = ctx->buffer_ptr = 0;
+   }
+}
+
 RoadMapHttpCompCtx roadmap_http_comp_init (void) {
 
    int res;
@@ -97,6 +166,7 @@ RoadMapHttpCompCtx roadmap_http_comp_init (void) {
    }
 
    ctx->state = STATE_READ_HEADERS;
+   ctx->body_left = -1;
 
    return ctx;
 }
@@ -128,9 +198,12 @@ void roadmap_http_comp_add_data (RoadMapHttpCompCtx ctx, int received) {
 int roadmap_http_comp_read (RoadMapHttpCompCtx ctx, void *data, int size) {
 
    int res;
+   int avail;
 
    if (ctx->flags & FLAG_ERROR) return -1;
 
+   if (size == 0) return 0;
+
    switch (ctx->state) {
 
       case STATE_READ_HEADERS:
@@ -148,7 +221,9 @@ int roadmap_http_comp_read (RoadMapHttpCompCtx ctx, void *data, int size) {
          if (ctx->read_ptr == ctx->read_size) {
             ctx->read_size = ctx->buffer_ptr;
 
-            if (! (ctx->flags & FLAG_COMPRESSED)) {
+            if (ctx->body_left == 0) {
+               end_body(ctx);
+            } else if (! (ctx->flags & FLAG_COMPRESSED)) {
                ctx->state = STATE_NO_COMPRESSION_FLOW;
             } else {
                ctx->state = STATE_DEFLATE_READ_HEADER;
@@ -176,9 +251,21 @@ int roadmap_http_comp_read (RoadMapHttpCompCtx ctx, void *data, int size) {
             if (size > (ctx->buffer_ptr - ctx->read_ptr)) {
                size = ctx->buffer_ptr - ctx->read_ptr;
             }
+            if ((ctx->body_left >= 0) && (size > ctx->body_left)) {
+               size = ctx->body_left;
+            }
 
             memcpy(data, ctx->buffer + ctx->read_ptr, size);
             ctx->read_ptr += size;
+
+            if (ctx->body_left >= 0) {
+               ctx->body_left -= size;
+               if (ctx->body_left == 0) {
+                  end_body(ctx);
+                  return size;
+               }
+            }
+
             if (ctx->read_ptr == ctx->buffer_ptr) {
                ctx->read_ptr = ctx->buffer_ptr = 0;
             }
@@ -204,8 +291,15 @@ int roadmap_http_comp_read (RoadMapHttpCompCtx ctx, void *data, int size) {
             return -1;
          }
             
+         if ((ctx->body_left >= 0) && (ctx->body_left <= 10)) {
+            roadmap_log(ROADMAP_ERROR, "Truncated gzip body.");
+            ctx->flags |= FLAG_ERROR;
+            return -1;
+         }
+
          /* Ok, eat the header! */
          ctx->read_ptr += 10;
+         if (ctx->body_left >= 0) ctx->body_left -= 10;
          ctx->state = STATE_COMPRESSION_FLOW;
 
          /* fall through to STATE_COMPRESSION_FLOW */
@@ -218,9 +312,14 @@ int roadmap_http_comp_read (RoadMapHttpCompCtx ctx, void *data, int size) {
             return 0;
          }
 
-         /* Decompress received data */
+         /* Decompress received data, up to the end of the body */
+         avail = ctx->buffer_ptr - ctx->read_ptr;
+         if ((ctx->body_left >= 0) && (avail > ctx->body_left)) {
+            avail = ctx->body_left;
+         }
+
          ctx->stream.next_in   = (unsigned char *) (ctx->buffer + ctx->read_ptr);
-         ctx->stream.avail_in  = ctx->buffer_ptr - ctx->read_ptr;
+         ctx->stream.avail_in  = avail;
          ctx->stream.next_out  = data;
          ctx->stream.avail_out = size;
 
@@ -230,7 +329,10 @@ int roadmap_http_comp_read (RoadMapHttpCompCtx ctx, void *data, int size) {
             /* We are not verifying CRC, ignoring data leftovers, etc.
              * Being lazy saves power :)
              */
-            ctx->read_ptr = ctx->buffer_ptr - ctx->stream.avail_in;
+            ctx->read_ptr += avail - ctx->stream.avail_in;
+            if (ctx->body_left >= 0) {
+               ctx->body_left -= avail - ctx->stream.avail_in;
+            }
             size = size - ctx->stream.avail_out;
          } else {
             roadmap_log(ROADMAP_ERROR, "Error in inflate - %d", res);
@@ -238,17 +340,68 @@ int roadmap_http_comp_read (RoadMapHttpCompCtx ctx, void *data, int size) {
             return -1;
          }
 
-         /* Ignore compressed stream trailer */
-         if (res == Z_STREAM_END) {
-            ctx->read_ptr = ctx->buffer_ptr;
+         if (ctx->body_left < 0) {
+
+            /* Ignore compressed stream trailer */
+            if (res == Z_STREAM_END) {
+               ctx->read_ptr = ctx->buffer_ptr;
+            }
+
+         } else if (res == Z_STREAM_END) {
+
+            /* The trailer may not all be there yet */
+            ctx->state = STATE_SKIP_TRAILER;
+            skip_trailer(ctx);
+
+         } else if (ctx->body_left == 0) {
+            end_body(ctx);
          }
 
          return size;
+
+      case STATE_SKIP_TRAILER:
+         skip_trailer(ctx);
+         return 0;
    }
 
    return -1;
 }
 
+int roadmap_http_comp_pending (RoadMapHttpCompCtx ctx) {
+
+   if (ctx->flags & FLAG_ERROR) return 0;
+
+   switch (ctx->state) {
+
+      case STATE_SEND_HEADERS:
+      case STATE_SEND_ACK:
+         return 1;
+
+      case STATE_NO_COMPRESSION_FLOW:
+      case STATE_COMPRESSION_FLOW:
+         return ctx->read_ptr < ctx->buffer_ptr;
+
+      case STATE_DEFLATE_READ_HEADER:
+         return (ctx->buffer_ptr - ctx->read_ptr) >= 10;
+   }
+
+   return 0;
+}
+
+int roadmap_http_comp_body_left (RoadMapHttpCompCtx ctx) {
+
+   switch (ctx->state) {
+
+      case STATE_NO_COMPRESSION_FLOW:
+      case STATE_DEFLATE_READ_HEADER:
+      case STATE_COMPRESSION_FLOW:
+      case STATE_SKIP_TRAILER:
+         return ctx->body_left;
+   }
+
+   return 0;
+}
+
 int roadmap_http_comp_avail (RoadMapHttpCompCtx ctx) {
    return ctx->stream.avail_out;
 }
@@ -32,6 +32,14 @@ int  roadmap_http_comp_read (RoadMapHttpCompCtx ctx, void *data, int size);
 void roadmap_http_comp_close(RoadMapHttpCompCtx ctx);
 
 int roadmap_http_comp_avail (RoadMapHttpCompCtx ctx);
+
+/* Data was received and can be read without waiting for more */
+int roadmap_http_comp_pending (RoadMapHttpCompCtx ctx);
+
+/* Bytes of the response body not received yet, as sent (compressed):
+ * 0 once the body is over, -1 if the response has no Content-Length.
+ */
+int roadmap_http_comp_body_left (RoadMapHttpCompCtx ctx);
 void roadmap_http_comp_get_buffer (RoadMapHttpCompCtx ctx,
       void **ctx_buffer, int *ctx_buffer_size);
 #endif   // __ROADMAP_HTTP_COMP_H__
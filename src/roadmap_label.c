@@ -64,6 +64,7 @@
 #include "roadmap_skin.h"
 #include "roadmap_layer.h"
 #include "roadmap_list.h"
+#include "roadmap_hash.h"
 #include "roadmap_line.h"
 #include "roadmap_label.h"
 #include "roadmap_square.h"
@@ -169,6 +170,31 @@ static int RoadMapLabelMinFeatSizeSq;
 
 static int MaxPlaceLabel;
 
+/* The labels placed by the current roadmap_label_draw_cache() call are
+ * indexed by screen cell and by text, so that each new label is only
+ * checked against the labels drawn around it.
+ */
+#define LABEL_GRID_CELL_SIZE  64
+#define LABEL_GRID_MAX_CELLS  1024
+#define LABEL_GRID_MAX_ITEMS  (MAX_LABELS * 8)
+#define LABEL_TEXT_HASH_SIZE  512
+
+typedef struct {
+   roadmap_label *label;
+   short cell_x; /* first cell covered by the label */
+   short cell_y;
+   int   next;
+} roadmap_label_grid_item;
+
+static int LabelGridCells[LABEL_GRID_MAX_CELLS];
+static int LabelTextHash[LABEL_TEXT_HASH_SIZE];
+static roadmap_label_grid_item LabelGridItems[LABEL_GRID_MAX_ITEMS];
+static int LabelGridCount;
+static int LabelGridOverflow;
+static int LabelGridCellSize;
+static int LabelGridWidth;
+static int LabelGridHeight;
+
 static int rect_overlap (RoadMapGuiRect *a, RoadMapGuiRect *b, int is_shield_a, int is_shield_b) {
    int space_x = 0;
    int space_y = 0;
@@ -236,6 +262,169 @@ static int poly_overlap (roadmap_label *c1, roadmap_label *c2) {
 }
 
 
+static void label_grid_reset (void) {
+
+   int width = roadmap_canvas_width ();
+   int height = roadmap_canvas_height ();
+
+   LabelGridCellSize = LABEL_GRID_CELL_SIZE;
+   do {
+      LabelGridWidth = width / LabelGridCellSize + 1;
+      LabelGridHeight = height / LabelGridCellSize + 1;
+      if (LabelGridWidth * LabelGridHeight <= LABEL_GRID_MAX_CELLS) break;
+      LabelGridCellSize *= 2;
+   } while (1);
+
+   memset (LabelGridCells, -1, sizeof(LabelGridCells));
+   memset (LabelTextHash, -1, sizeof(LabelTextHash));
+   LabelGridCount = 0;
+   LabelGridOverflow = 0;
+}
+
+
+static int label_grid_cell (int value, int limit) {
+
+   value /= LabelGridCellSize;
+
+   if (value < 0) return 0;
+   if (value >= limit) return limit - 1;
+
+   return value;
+}
+
+
+static int label_grid_text_key (const char *text) {
+
+   return abs (roadmap_hash_string (text) % LABEL_TEXT_HASH_SIZE);
+}
+
+
+static int label_grid_new_item (roadmap_label *c, int *head) {
+
+   int index;
+
+   if (LabelGridCount == LABEL_GRID_MAX_ITEMS) {
+      LabelGridOverflow = 1;
+      return -1;
+   }
+
+   index = LabelGridCount++;
+   LabelGridItems[index].label = c;
+   LabelGridItems[index].next = *head;
+   *head = index;
+
+   return index;
+}
+
+
+static void label_grid_add (roadmap_label *c) {
+
+   int minx = label_grid_cell (c->bbox.minx, LabelGridWidth);
+   int maxx = label_grid_cell (c->bbox.maxx, LabelGridWidth);
+   int miny = label_grid_cell (c->bbox.miny, LabelGridHeight);
+   int maxy = label_grid_cell (c->bbox.maxy, LabelGridHeight);
+   int x, y;
+   int index;
+
+   if (LabelGridOverflow) return;
+
+   if (label_grid_new_item
+         (c, &LabelTextHash[label_grid_text_key (c->text)]) < 0) return;
+
+   for (y = miny; y <= maxy; y++) {
+      for (x = minx; x <= maxx; x++) {
+
+         index = label_grid_new_item
+                     (c, &LabelGridCells[y * LabelGridWidth + x]);
+         if (index < 0) return;
+
+         LabelGridItems[index].cell_x = minx;
+         LabelGridItems[index].cell_y = miny;
+      }
+   }
+}
+
+
+static int label_is_duplicate (roadmap_label *c1, roadmap_label *c2) {
+
+   return ((c1->flags & LABEL_FLAG_PLACE) == (c2->flags & LABEL_FLAG_PLACE)) &&
+          !strcmp (c1->text, c2->text);
+}
+
+
+/* Returns 1 if the label collides with (or duplicates) a label that was
+ * already placed, 0 if not, and -1 if the index overflowed and cannot
+ * answer.
+ */
+static int label_grid_collides (roadmap_label *c) {
+
+   RoadMapGuiRect area = c->bbox;
+   int space_x = 2 * LABEL_SHIELD_MARGIN;
+   int space_y = 2 * LABEL_SHIELD_MARGIN;
+   int minx, maxx, miny, maxy;
+   int x, y;
+   int index;
+
+   if (LabelGridOverflow) return -1;
+
+   for (index = LabelTextHash[label_grid_text_key (c->text)]; index >= 0;
+        index = LabelGridItems[index].next) {
+
+      roadmap_label *other = LabelGridItems[index].label;
+
+      if ((other->gen == RoadMapLabelGeneration) &&
+          label_is_duplicate (c, other)) {
+         return 1;
+      }
+   }
+
+   /* Widen the search by the largest spacing rect_overlap() may apply. */
+   if (roadmap_screen_get_view_mode() != VIEW_MODE_2D) {
+      space_x += 20;
+      space_y += 30;
+   }
+
+   area.minx -= space_x;
+   area.maxx += space_x;
+   area.miny -= space_y;
+   area.maxy += space_y;
+
+   minx = label_grid_cell (area.minx, LabelGridWidth);
+   maxx = label_grid_cell (area.maxx, LabelGridWidth);
+   miny = label_grid_cell (area.miny, LabelGridHeight);
+   maxy = label_grid_cell (area.maxy, LabelGridHeight);
+
+   for (y = miny; y <= maxy; y++) {
+      for (x = minx; x <= maxx; x++) {
+
+         for (index = LabelGridCells[y * LabelGridWidth + x]; index >= 0;
+              index = LabelGridItems[index].next) {
+
+            roadmap_label_grid_item *item = LabelGridItems + index;
+
+            /* A label spanning several cells is only tested in the first
+             * cell shared with the searched area.
+             */
+            int first_x = MAX(item->cell_x, minx);
+            int first_y = MAX(item->cell_y, miny);
+
+            if ((x != first_x) || (y != first_y)) continue;
+
+            if (item->label->gen != RoadMapLabelGeneration) continue;
+
+            if (rect_overlap (&item->label->bbox, &c->bbox,
+                              (item->label->shield != NULL) ? 1 : 0,
+                              (c->shield != NULL) ? 1 : 0)) {
+               return 1;
+            }
+         }
+      }
+   }
+
+   return 0;
+}
+
+
 static void compute_bbox(RoadMapGuiPoint *poly, RoadMapGuiRect *bbox) {
 
    int i;
@@ -780,6 +969,7 @@ int roadmap_label_draw_cache (int angles, int full) {
 //printf(">> draw cache <<\n");
    ROADMAP_LIST_INIT(&undrawn_labels);
    roadmap_canvas_select_pen (RoadMapLabelPen);
+   label_grid_reset ();
 
    roadmap_math_get_context (&current_center, &current_zoom);
    current_orient = roadmap_math_get_orientation();
@@ -1104,6 +1294,13 @@ int roadmap_label_draw_cache (int angles, int full) {
 
          /* compare against already rendered labels */
          if (!cannot_label) {
+            cannot_label = label_grid_collides (cPtr);
+         }
+
+         /* the index is full: fall back to scanning all rendered labels */
+         if (cannot_label < 0) {
+             cannot_label = 0;
+
              if (whichlist == NEWLIST)
                 end = (RoadMapListItem *)&RoadMapLabelCache;
              else
@@ -1232,6 +1429,8 @@ int roadmap_label_draw_cache (int angles, int full) {
             if (currentLabelPen != NULL)
                roadmap_canvas_select_pen (RoadMapLabelPen);
 
+            label_grid_add (cPtr);
+
             if (whichlist == NEWLIST) {
                /* move the rendered label to the cache */
                roadmap_list_append
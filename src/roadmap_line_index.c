@@ -0,0 +1,408 @@
+/* roadmap_line_index.c - per square spatial index of the lines.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The closest line searches only consider the segments visible in the
+ *   focus, which is usually a small area around the GPS position, but used
+ *   to test every line of the square. Here the bounding box of each line,
+ *   shape points included, is registered in the cells of a grid over the
+ *   square, and only the lines of the cells overlapping the focus need
+ *   to be tested.
+ *
+ *   The grid is built the first time a square is searched, and kept until
+ *   the square's tile changes. Its cells are packed in a single array of
+ *   line ids, with the lines of each cell in increasing order.
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_line_index.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_hash.h"
+#include "roadmap_math.h"
+#include "roadmap_line.h"
+#include "roadmap_shape.h"
+#include "roadmap_square.h"
+
+#include "roadmap_line_index.h"
+
+
+#define LINE_INDEX_CACHE_SIZE     32
+
+#define LINE_INDEX_LINES_PER_CELL 4
+#define LINE_INDEX_MAX_SIDE       32
+
+typedef struct {
+   int square;
+   unsigned int last_access;
+
+   RoadMapArea edges;
+   int side;
+   int cell_width;
+   int cell_height;
+
+   int *cell_first;  /* side * side + 1 entries */
+   int  cell_size;
+
+   int *lines;
+   int  line_size;
+} LineIndex;
+
+static LineIndex     LineIndexEntries[LINE_INDEX_CACHE_SIZE];
+static int           LineIndexCount = 0;
+static unsigned int  LineIndexAccess = 0;
+static RoadMapHash  *LineIndexHash = NULL;
+
+/* The result of the last query, reused while the focus is the same */
+static int           LineIndexResultSquare = -1;
+static RoadMapArea   LineIndexResultFocus;
+static zoom_t        LineIndexResultZoom;
+static int           LineIndexResultCount = 0;
+
+/* Work buffers */
+static RoadMapArea  *LineIndexBoxes = NULL;
+static int          *LineIndexCursor = NULL;
+static unsigned int *LineIndexStamp = NULL;
+static int          *LineIndexResult = NULL;
+static int           LineIndexWorkSize = 0;
+static int           LineIndexCursorSize = 0;
+static unsigned int  LineIndexQuery = 0;
+
+
+static void line_index_release (int slot) {
+
+   LineIndex *index = LineIndexEntries + slot;
+
+   roadmap_hash_remove (LineIndexHash, index->square, slot);
+   index->square = -1;
+   index->side = 0;
+}
+
+
+static LineIndex *line_index_find (int square) {
+
+   int slot;
+
+   if (!LineIndexHash) return NULL;
+
+   for (slot = roadmap_hash_get_first (LineIndexHash, square);
+        slot >= 0;
+        slot = roadmap_hash_get_next (LineIndexHash, slot)) {
+
+      LineIndex *index = LineIndexEntries + slot;
+      if (index->square == square) {
+         index->last_access = ++LineIndexAccess;
+         return index;
+      }
+   }
+
+   return NULL;
+}
+
+
+static LineIndex *line_index_allocate (int square) {
+
+   int slot;
+   int i;
+   LineIndex *index;
+
+   if (!LineIndexHash) {
+      LineIndexHash = roadmap_hash_new ("LineIndex", LINE_INDEX_CACHE_SIZE);
+   }
+
+   if (LineIndexCount < LINE_INDEX_CACHE_SIZE) {
+      slot = LineIndexCount++;
+   } else {
+
+      /* Replace the least recently searched entry, or a cleared one */
+      slot = 0;
+      for (i = 0; i < LINE_INDEX_CACHE_SIZE; i++) {
+         if (LineIndexEntries[i].square == -1) {
+            slot = i;
+            break;
+         }
+         if (LineIndexEntries[i].last_access < LineIndexEntries[slot].last_access) {
+            slot = i;
+         }
+      }
+      if (LineIndexEntries[slot].square != -1) {
+         line_index_release (slot);
+      }
+   }
+
+   index = LineIndexEntries + slot;
+   index->square = square;
+   index->last_access = ++LineIndexAccess;
+
+   roadmap_hash_add (LineIndexHash, square, slot);
+
+   return index;
+}
+
+
+static void line_index_reserve (int count) {
+
+   if (count <= LineIndexWorkSize) return;
+
+   LineIndexWorkSize = count + 256;
+
+   LineIndexBoxes = realloc (LineIndexBoxes, LineIndexWorkSize * sizeof (RoadMapArea));
+   roadmap_check_allocated (LineIndexBoxes);
+   LineIndexStamp = realloc (LineIndexStamp, LineIndexWorkSize * sizeof (unsigned int));
+   roadmap_check_allocated (LineIndexStamp);
+   LineIndexResult = realloc (LineIndexResult, LineIndexWorkSize * sizeof (int));
+   roadmap_check_allocated (LineIndexResult);
+
+   memset (LineIndexStamp, 0, LineIndexWorkSize * sizeof (unsigned int));
+   LineIndexQuery = 0;
+}
+
+
+static void line_index_extend (RoadMapArea *box, const RoadMapPosition *position) {
+
+   if (position->longitude < box->west)  box->west  = position->longitude;
+   if (position->longitude > box->east)  box->east  = position->longitude;
+   if (position->latitude  < box->south) box->south = position->latitude;
+   if (position->latitude  > box->north) box->north = position->latitude;
+}
+
+
+static void line_index_cells (const LineIndex *index, const RoadMapArea *box,
+                              int *column0, int *column1, int *row0, int *row1) {
+
+   *column0 = (box->west  - index->edges.west)  / index->cell_width;
+   *column1 = (box->east  - index->edges.west)  / index->cell_width;
+   *row0    = (box->south - index->edges.south) / index->cell_height;
+   *row1    = (box->north - index->edges.south) / index->cell_height;
+}
+
+
+static void line_index_build (LineIndex *index, int square) {
+
+   int line_count = roadmap_line_count ();
+   int has_shapes = roadmap_square_has_shapes (square);
+   int cell_count;
+   int total;
+   int line;
+   int i;
+
+   line_index_reserve (line_count);
+
+   /* The bounding box of each line. */
+   for (line = 0; line < line_count; line++) {
+
+      RoadMapArea *box = LineIndexBoxes + line;
+      RoadMapPosition position;
+      int first_shape;
+      int last_shape;
+
+      roadmap_line_from (line, &position);
+      box->west = box->east = position.longitude;
+      box->south = box->north = position.latitude;
+
+      if (has_shapes && roadmap_line_shapes (line, &first_shape, &last_shape) > 0) {
+         /* Shape positions are relative to the previous point. */
+         for (i = first_shape; i <= last_shape; i++) {
+            roadmap_shape_get_position (i, &position);
+            line_index_extend (box, &position);
+         }
+      }
+
+      roadmap_line_to (line, &position);
+      line_index_extend (box, &position);
+
+      if (line == 0) {
+         index->edges = *box;
+      } else {
+         if (box->west  < index->edges.west)  index->edges.west  = box->west;
+         if (box->east  > index->edges.east)  index->edges.east  = box->east;
+         if (box->south < index->edges.south) index->edges.south = box->south;
+         if (box->north > index->edges.north) index->edges.north = box->north;
+      }
+   }
+
+   index->side = 1;
+   while (index->side < LINE_INDEX_MAX_SIDE &&
+          index->side * index->side * LINE_INDEX_LINES_PER_CELL < line_count) {
+      index->side++;
+   }
+   index->cell_width = (index->edges.east - index->edges.west) / index->side + 1;
+   index->cell_height = (index->edges.north - index->edges.south) / index->side + 1;
+
+   cell_count = index->side * index->side;
+   if (index->cell_size < cell_count + 1) {
+      index->cell_size = cell_count + 1;
+      index->cell_first = realloc (index->cell_first, index->cell_size * sizeof (int));
+      roadmap_check_allocated (index->cell_first);
+   }
+   if (LineIndexCursorSize < cell_count) {
+      LineIndexCursorSize = cell_count;
+      LineIndexCursor = realloc (LineIndexCursor, LineIndexCursorSize * sizeof (int));
+      roadmap_check_allocated (LineIndexCursor);
+   }
+
+   /* Count the entries of each cell, then fill them in line order. */
+   memset (index->cell_first, 0, (cell_count + 1) * sizeof (int));
+
+   for (line = 0; line < line_count; line++) {
+
+      int column0, column1, row0, row1;
+      int row;
+
+      line_index_cells (index, LineIndexBoxes + line, &column0, &column1, &row0, &row1);
+      for (row = row0; row <= row1; row++) {
+         for (i = column0; i <= column1; i++) {
+            index->cell_first[row * index->side + i + 1]++;
+         }
+      }
+   }
+
+   for (i = 0; i < cell_count; i++) {
+      index->cell_first[i + 1] += index->cell_first[i];
+      LineIndexCursor[i] = index->cell_first[i];
+   }
+
+   total = index->cell_first[cell_count];
+   if (index->line_size < total) {
+      index->line_size = total;
+      index->lines = realloc (index->lines, index->line_size * sizeof (int));
+      roadmap_check_allocated (index->lines);
+   }
+
+   for (line = 0; line < line_count; line++) {
+
+      int column0, column1, row0, row1;
+      int row;
+
+      line_index_cells (index, LineIndexBoxes + line, &column0, &column1, &row0, &row1);
+      for (row = row0; row <= row1; row++) {
+         for (i = column0; i <= column1; i++) {
+            index->lines[LineIndexCursor[row * index->side + i]++] = line;
+         }
+      }
+   }
+}
+
+
+static int line_index_compare (const void *a, const void *b) {
+
+   return *(const int *)a - *(const int *)b;
+}
+
+
+int roadmap_line_index_visible (const int **lines) {
+
+   int square = roadmap_square_active ();
+   LineIndex *index;
+   int cells = 0;
+   int row;
+   int column;
+
+   if (square < 0 || roadmap_line_count () <= 0) return -1;
+
+   /* The visibility margin depends on the zoom. */
+   if (square == LineIndexResultSquare &&
+       LineIndexResultZoom == RoadMapContext.zoom &&
+       !memcmp (&LineIndexResultFocus, &RoadMapContext.focus, sizeof (RoadMapArea))) {
+      *lines = LineIndexResult;
+      return LineIndexResultCount;
+   }
+
+   index = line_index_find (square);
+   if (!index) {
+      index = line_index_allocate (square);
+      line_index_build (index, square);
+   }
+
+   if (++LineIndexQuery == 0) {
+      memset (LineIndexStamp, 0, LineIndexWorkSize * sizeof (unsigned int));
+      LineIndexQuery = 1;
+   }
+
+   LineIndexResultCount = 0;
+
+   for (row = 0; row < index->side; row++) {
+
+      RoadMapArea area;
+
+      area.west = index->edges.west;
+      area.east = index->edges.west + index->side * index->cell_width;
+      area.south = index->edges.south + row * index->cell_height;
+      area.north = area.south + index->cell_height;
+
+      if (!roadmap_math_is_visible (&area)) continue;
+
+      for (column = 0; column < index->side; column++) {
+
+         int cell = row * index->side + column;
+         int i;
+
+         area.west = index->edges.west + column * index->cell_width;
+         area.east = area.west + index->cell_width;
+
+         if (!roadmap_math_is_visible (&area)) continue;
+
+         for (i = index->cell_first[cell]; i < index->cell_first[cell + 1]; i++) {
+            int line = index->lines[i];
+            if (LineIndexStamp[line] != LineIndexQuery) {
+               LineIndexStamp[line] = LineIndexQuery;
+               LineIndexResult[LineIndexResultCount++] = line;
+            }
+         }
+         cells++;
+      }
+   }
+
+   /* Each cell is sorted, the merge of several cells is not. */
+   if (cells > 1) {
+      qsort (LineIndexResult, LineIndexResultCount, sizeof (int), line_index_compare);
+   }
+
+   LineIndexResultSquare = square;
+   LineIndexResultFocus = RoadMapContext.focus;
+   LineIndexResultZoom = RoadMapContext.zoom;
+
+   *lines = LineIndexResult;
+   return LineIndexResultCount;
+}
+
+
+void roadmap_line_index_clear (int square) {
+
+   int slot;
+
+   for (slot = 0; slot < LineIndexCount; slot++) {
+      if (LineIndexEntries[slot].square != -1 &&
+          (square == -1 || LineIndexEntries[slot].square == square)) {
+         line_index_release (slot);
+      }
+   }
+
+   if (square == -1 || square == LineIndexResultSquare) {
+      LineIndexResultSquare = -1;
+   }
+}
@@ -0,0 +1,36 @@
+/* roadmap_line_index.h - per square spatial index of the lines.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ROADMAP_LINE_INDEX__H_
+#define _ROADMAP_LINE_INDEX__H_
+
+/* Get the lines of the active square that may have a segment visible in
+ * the current focus (see roadmap_math_set_focus()), in increasing order.
+ * The other lines are not visible. Returns the number of lines, or -1 if
+ * the square cannot be indexed.
+ */
+int  roadmap_line_index_visible (const int **lines);
+
+void roadmap_line_index_clear (int square); /* -1 for all squares */
+
+#endif // _ROADMAP_LINE_INDEX__H_
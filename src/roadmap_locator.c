@@ -57,6 +57,7 @@
 #include "roadmap_db_square.h"
 #include "roadmap_tile_manager.h"
 #include "roadmap_gzm.h"
+#include "roadmap_gzm_import.h"
 
 #include "roadmap_locator.h"
 
@@ -238,6 +239,13 @@ static int roadmap_locator_open (int fips) {
 
 	snprintf (gzm_name, sizeof(gzm_name), "map%05d%s", fips, ROADMAP_GZM_TYPE);
 	RoadMapCountyCache[oldest].gzm_id = roadmap_gzm_open (gzm_name);
+
+	/* Complete an interrupted import of the map into the tile storage */
+	if (RoadMapCountyCache[oldest].gzm_id >= 0 &&
+		 !roadmap_gzm_import_active () &&
+		 roadmap_gzm_import_pending (fips)) {
+		roadmap_gzm_import_start (fips, NULL);
+	}
 	
    RoadMapActiveCounty = fips;
    RoadMapActiveMap = RoadMapCountyCache[oldest].gzm_id;
@@ -60,7 +60,7 @@ typedef struct
 extern void roadmap_login_ssd_on_login_cb( BOOL bDetailsVerified, roadmap_result rc );
 
 //Where did you hear about waze (referrer)
-enum {
+typedef enum {
    login_referrer_none = -1,
    login_referrer_friend = 0,
    login_referrer_friend_tweet,
@@ -98,7 +98,6 @@ void roadmap_gui_maximize();
 void roadmap_main_minimize (void);
 BOOL roadmap_horizontal_screen_orientation();
 void roadmap_main_open_url (const char* url);
-void roadmap_main_post_resolver_result( int entry_id );
 
 #ifdef IPHONE
 
@@ -38,6 +38,7 @@
 #include "roadmap_lang.h"
 #include "roadmap_locator.h"
 #include "roadmap_tile_manager.h"
+#include "roadmap_gzm_import.h"
 #include "ssd/ssd_confirm_dialog.h"
 #include "ssd/ssd_dialog.h"
 #include "ssd/ssd_progress_msg_dialog.h"
@@ -112,12 +113,12 @@ void dl_map_cb(int exit_code ){
    roadmap_main_exit();
 }
 
-static void dlmap_update_tiles (void) {
+static void dlmap_import_done (BOOL success, const RoadMapGzmImportStats *stats) {
 
-	roadmap_main_remove_periodic (dlmap_update_tiles);	
-	roadmap_locator_close (DlFips);
-	roadmap_file_rename (DlMapTempFullName, DlMapFileFullName);
-	roadmap_locator_refresh (DlFips);
+	if (!success) {
+		/* Let the downloaded map supersede the stored tiles */
+		roadmap_locator_refresh (DlFips);
+	}
 	roadmap_tile_reset_session ();
 
 	ssd_progress_msg_dialog_hide ();
@@ -125,6 +126,17 @@ static void dlmap_update_tiles (void) {
 	roadmap_messagebox_cb ("Map Download Complete", "Please restart Waze", dl_map_cb);
 }
 
+static void dlmap_update_tiles (void) {
+
+	roadmap_main_remove_periodic (dlmap_update_tiles);	
+	roadmap_locator_close (DlFips);
+	roadmap_file_rename (DlMapTempFullName, DlMapFileFullName);
+
+	if (!roadmap_gzm_import_start (DlFips, dlmap_import_done)) {
+		dlmap_import_done (FALSE, NULL);
+	}
+}
+
 
 static void dlmap_close (int success) {
 
@@ -57,6 +57,19 @@
 #include "roadmap_canvas3d.h" // roadmap_canvas3_ogl_updateScale
 #endif// OPENGL
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ROADMAP_MATH_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ROADMAP_MATH_NEON
+#endif
+
+/* Number of points converted at once by roadmap_math_project_coordinates(),
+ * small enough for the block to stay in the L1 cache between passes.
+ */
+#define ROADMAP_MATH_BATCH 256
+
 
 #define MIN_ZOOM_IN     6
 
@@ -779,38 +792,263 @@ void roadmap_math_rotate_project_coordinate (RoadMapGuiPoint *point)
  * rotate the coordinates of a point on the screen, the center of
  * the rotation being the center of the screen.
  */
+static void roadmap_math_rotate_one (RoadMapGuiPoint *point) {
+
+   int x = point->x - RoadMapContext.center_x;
+   int y = RoadMapContext.center_y - point->y;
+
+   point->x =
+      RoadMapContext.center_x +
+      (((x * RoadMapContext.cos_orientation)
+        + (y * RoadMapContext.sin_orientation) + 16383) / 32768);
+
+   point->y =
+      RoadMapContext.center_y -
+      (((y * RoadMapContext.cos_orientation)
+        - (x * RoadMapContext.sin_orientation) + 16383) / 32768);
+}
+
+
+/* The vector kernels below compute exactly what roadmap_math_rotate_one()
+ * and roadmap_math_coordinate() compute, bit for bit: products are kept in
+ * 32 bits (with the same wrap around), the division by 32768 truncates
+ * toward zero like the C division does, and the division by the zoom is
+ * done in double precision, then corrected by the remainder (-ffast-math
+ * turns the division into a multiplication by the reciprocal, which can
+ * be one off). They return the number of points handled, the caller
+ * finishes the rest. gtkroadmap-mathtest checks them (see gtk2/Makefile).
+ */
+#if defined(ROADMAP_MATH_SSE2)
+
+static __m128i roadmap_math_sse2_mullo (__m128i a, __m128i b) {
+
+   /* SSE2 has no 32 bits multiply: combine the even and odd products. */
+   __m128i even = _mm_mul_epu32 (a, b);
+   __m128i odd  = _mm_mul_epu32 (_mm_srli_si128 (a, 4), _mm_srli_si128 (b, 4));
+
+   return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+                              _mm_shuffle_epi32 (odd,  _MM_SHUFFLE (0, 0, 2, 0)));
+}
+
+
+static __m128i roadmap_math_sse2_div32768 (__m128i value) {
+
+   __m128i bias =
+      _mm_and_si128 (_mm_srai_epi32 (value, 31), _mm_set1_epi32 (32767));
+
+   return _mm_srai_epi32 (_mm_add_epi32 (value, bias), 15);
+}
+
+
+static int roadmap_math_rotate_simd (int count, RoadMapGuiPoint *points) {
+
+   int i;
+   __m128i center_x = _mm_set1_epi32 (RoadMapContext.center_x);
+   __m128i center_y = _mm_set1_epi32 (RoadMapContext.center_y);
+   __m128i cos_o    = _mm_set1_epi32 (RoadMapContext.cos_orientation);
+   __m128i sin_o    = _mm_set1_epi32 (RoadMapContext.sin_orientation);
+   __m128i round    = _mm_set1_epi32 (16383);
+
+   for (i = 0; i + 4 <= count; i += 4) {
+
+      __m128i lo = _mm_loadu_si128 ((__m128i *)(points + i));
+      __m128i hi = _mm_loadu_si128 ((__m128i *)(points + i + 2));
+
+      __m128i x = _mm_castps_si128
+                     (_mm_shuffle_ps (_mm_castsi128_ps (lo), _mm_castsi128_ps (hi),
+                                      _MM_SHUFFLE (2, 0, 2, 0)));
+      __m128i y = _mm_castps_si128
+                     (_mm_shuffle_ps (_mm_castsi128_ps (lo), _mm_castsi128_ps (hi),
+                                      _MM_SHUFFLE (3, 1, 3, 1)));
+      __m128i rx;
+      __m128i ry;
+
+      x = _mm_sub_epi32 (x, center_x);
+      y = _mm_sub_epi32 (center_y, y);
+
+      rx = _mm_add_epi32 (_mm_add_epi32 (roadmap_math_sse2_mullo (x, cos_o),
+                                         roadmap_math_sse2_mullo (y, sin_o)),
+                          round);
+      ry = _mm_add_epi32 (_mm_sub_epi32 (roadmap_math_sse2_mullo (y, cos_o),
+                                         roadmap_math_sse2_mullo (x, sin_o)),
+                          round);
+
+      rx = _mm_add_epi32 (center_x, roadmap_math_sse2_div32768 (rx));
+      ry = _mm_sub_epi32 (center_y, roadmap_math_sse2_div32768 (ry));
+
+      _mm_storeu_si128 ((__m128i *)(points + i),     _mm_unpacklo_epi32 (rx, ry));
+      _mm_storeu_si128 ((__m128i *)(points + i + 2), _mm_unpackhi_epi32 (rx, ry));
+   }
+
+   return i;
+}
+
+
+#ifndef OPENGL
+/* Fix a quotient truncated toward zero that may be one off. */
+static __m128i roadmap_math_sse2_div_fix (__m128i quotient,
+                                          __m128i dividend,
+                                          __m128i divisor) {
+
+   __m128i zero      = _mm_setzero_si128 ();
+   __m128i one       = _mm_set1_epi32 (1);
+   __m128i remainder = _mm_sub_epi32 (dividend, roadmap_math_sse2_mullo (quotient, divisor));
+   __m128i negative  = _mm_cmplt_epi32 (dividend, zero);
+
+   /* 0 <= remainder < divisor, or -divisor < remainder <= 0 if negative. */
+   __m128i too_low =
+      _mm_or_si128 (_mm_andnot_si128 (negative,
+                                      _mm_cmpgt_epi32 (remainder,
+                                                       _mm_sub_epi32 (divisor, one))),
+                    _mm_and_si128 (negative, _mm_cmpgt_epi32 (remainder, zero)));
+   __m128i too_high =
+      _mm_or_si128 (_mm_andnot_si128 (negative, _mm_cmplt_epi32 (remainder, zero)),
+                    _mm_and_si128 (negative,
+                                   _mm_cmplt_epi32 (remainder,
+                                                    _mm_sub_epi32 (one, divisor))));
+
+   /* The masks are -1 where true. */
+   return _mm_add_epi32 (_mm_sub_epi32 (quotient, too_low), too_high);
+}
+
+
+static int roadmap_math_coordinates_simd (int count,
+                                          const RoadMapPosition *positions,
+                                          RoadMapGuiPoint *points) {
+
+   int i;
+   __m128i origin = _mm_set_epi32 (RoadMapContext.upright_screen.north,
+                                   RoadMapContext.upright_screen.west,
+                                   RoadMapContext.upright_screen.north,
+                                   RoadMapContext.upright_screen.west);
+   __m128i negate = _mm_set_epi32 (-1, 0, -1, 0);
+   __m128d zoom   = _mm_set_pd ((double)RoadMapContext.zoom_y,
+                                (double)RoadMapContext.zoom_x);
+   __m128i zoom_i = _mm_set_epi32 (RoadMapContext.zoom_y,
+                                   RoadMapContext.zoom_x,
+                                   RoadMapContext.zoom_y,
+                                   RoadMapContext.zoom_x);
+
+   for (i = 0; i + 2 <= count; i += 2) {
+
+      __m128i delta = _mm_loadu_si128 ((const __m128i *)(positions + i));
+      __m128i first;
+      __m128i second;
+
+      /* longitude - west, and north - latitude (as -(latitude - north)) */
+      delta = _mm_sub_epi32 (delta, origin);
+      delta = _mm_sub_epi32 (_mm_xor_si128 (delta, negate), negate);
+
+      first  = _mm_cvttpd_epi32
+                  (_mm_div_pd (_mm_cvtepi32_pd (delta), zoom));
+      second = _mm_cvttpd_epi32
+                  (_mm_div_pd (_mm_cvtepi32_pd (_mm_unpackhi_epi64 (delta, delta)),
+                               zoom));
+
+      _mm_storeu_si128 ((__m128i *)(points + i),
+                        roadmap_math_sse2_div_fix
+                           (_mm_unpacklo_epi64 (first, second), delta, zoom_i));
+   }
+
+   return i;
+}
+#endif // !OPENGL
+
+#elif defined(ROADMAP_MATH_NEON)
+
+static int roadmap_math_rotate_simd (int count, RoadMapGuiPoint *points) {
+
+   int i;
+   int32x4_t center_x = vdupq_n_s32 (RoadMapContext.center_x);
+   int32x4_t center_y = vdupq_n_s32 (RoadMapContext.center_y);
+   int32x4_t cos_o    = vdupq_n_s32 (RoadMapContext.cos_orientation);
+   int32x4_t sin_o    = vdupq_n_s32 (RoadMapContext.sin_orientation);
+   int32x4_t round    = vdupq_n_s32 (16383);
+   int32x4_t mask     = vdupq_n_s32 (32767);
+
+   for (i = 0; i + 4 <= count; i += 4) {
+
+      int32x4x2_t p = vld2q_s32 ((const int32_t *)(points + i));
+      int32x4_t x = vsubq_s32 (p.val[0], center_x);
+      int32x4_t y = vsubq_s32 (center_y, p.val[1]);
+      int32x4_t rx;
+      int32x4_t ry;
+
+      rx = vaddq_s32 (vmlaq_s32 (vmulq_s32 (x, cos_o), y, sin_o), round);
+      ry = vaddq_s32 (vmlsq_s32 (vmulq_s32 (y, cos_o), x, sin_o), round);
+
+      rx = vaddq_s32 (rx, vandq_s32 (vshrq_n_s32 (rx, 31), mask));
+      ry = vaddq_s32 (ry, vandq_s32 (vshrq_n_s32 (ry, 31), mask));
+
+      p.val[0] = vaddq_s32 (center_x, vshrq_n_s32 (rx, 15));
+      p.val[1] = vsubq_s32 (center_y, vshrq_n_s32 (ry, 15));
+
+      vst2q_s32 ((int32_t *)(points + i), p);
+   }
+
+   return i;
+}
+
+#endif
+
+
 void roadmap_math_rotate_coordinates (int count, RoadMapGuiPoint *points) {
 
    int i;
-   int x;
-   int y;
 
 
    if (!RoadMapContext.orientation && RoadMapContext._is3D_projection != PROJECTION_MODE_3D_NON_OGL) return;
 
-   for (i = count; i > 0; --i) {
+   if (RoadMapContext.orientation) {
 
-      if (RoadMapContext.orientation) {
-         x = points->x - RoadMapContext.center_x;
-         y = RoadMapContext.center_y - points->y;
+      i = 0;
+#if defined(ROADMAP_MATH_SSE2) || defined(ROADMAP_MATH_NEON)
+      i = roadmap_math_rotate_simd (count, points);
+#endif
+      for (; i < count; ++i) {
+         roadmap_math_rotate_one (points + i);
+      }
+   }
 
-         points->x =
-            RoadMapContext.center_x +
-            (((x * RoadMapContext.cos_orientation)
-              + (y * RoadMapContext.sin_orientation) + 16383) / 32768);
+   if (RoadMapContext._is3D_projection == PROJECTION_MODE_3D_NON_OGL) {
 
-         points->y =
-            RoadMapContext.center_y -
-            (((y * RoadMapContext.cos_orientation)
-              - (x * RoadMapContext.sin_orientation) + 16383) / 32768);
+      for (i = 0; i < count; ++i) {
+         roadmap_math_project (points + i);
       }
+   }
+}
 
-      if (RoadMapContext._is3D_projection == PROJECTION_MODE_3D_NON_OGL) {
 
-         roadmap_math_project (points);
-      }
+void roadmap_math_coordinates (int count,
+                               const RoadMapPosition *positions,
+                               RoadMapGuiPoint *points) {
 
-      points += 1;
+   int i = 0;
+
+#if defined(ROADMAP_MATH_SSE2) && !defined(OPENGL)
+   i = roadmap_math_coordinates_simd (count, positions, points);
+#endif
+
+   for (; i < count; ++i) {
+      roadmap_math_coordinate (positions + i, points + i);
+   }
+}
+
+
+void roadmap_math_project_coordinates (int count,
+                                       const RoadMapPosition *positions,
+                                       RoadMapGuiPoint *points) {
+
+   while (count > 0) {
+
+      int size = (count > ROADMAP_MATH_BATCH) ? ROADMAP_MATH_BATCH : count;
+
+      roadmap_math_coordinates (size, positions, points);
+      roadmap_math_rotate_coordinates (size, points);
+
+      positions += size;
+      points += size;
+      count -= size;
    }
 }
 
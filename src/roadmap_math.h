@@ -342,6 +342,17 @@ int roadmap_math_get_visible_coordinates (const RoadMapPosition *from,
 
 void roadmap_math_coordinate  (const RoadMapPosition *position,
                                RoadMapGuiPoint *point);
+
+/* Batch versions: convert count positions at once, the second one also
+ * applies the screen rotation and projection (same result as calling
+ * roadmap_math_coordinate() then roadmap_math_rotate_coordinates()).
+ */
+void roadmap_math_coordinates (int count,
+                               const RoadMapPosition *positions,
+                               RoadMapGuiPoint *points);
+void roadmap_math_project_coordinates (int count,
+                                       const RoadMapPosition *positions,
+                                       RoadMapGuiPoint *points);
 void roadmap_math_to_position (const RoadMapGuiPoint *point,
                                RoadMapPosition *position,
                                int projected);
@@ -57,6 +57,7 @@
 #include "editor/editor_cleanup.h"
 
 #include "roadmap_navigate.h"
+#include "roadmap_navigate_hmm.h"
 #include "roadmap_plugin.h"
 
 static RoadMapConfigDescriptor RoadMapNavigateMinMobileSpeedCfg =
@@ -895,9 +896,31 @@ int roadmap_navigate_is_jammed (PluginLine *line, int *direction) {
 
 
 
+/* Move the candidate chosen by the HMM matcher to the first place. */
+static void roadmap_navigate_promote_candidate (RoadMapNavCandidates *candidates,
+                                                const RoadMapNavCandidates *matched) {
+
+   int i;
+
+   for (i = 0; i < 3; i++) {
+      if (candidates[i].found && candidates[i].index == matched->index) break;
+   }
+
+   if (i == 0) return;
+   if (i == 3) i = 2; /* not ranked: drop the third one */
+
+   memmove (candidates + 1, candidates, i * sizeof (RoadMapNavCandidates));
+   candidates[0] = *matched;
+}
+
+
 void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps_time) {
 
    RoadMapNavCandidates candidates[ROADMAP_NEIGHBOURHOUD];
+   RoadMapNavCandidates hmm_candidates[ROADMAP_NEIGHBOURHOUD];
+   int hmm_directions[ROADMAP_NEIGHBOURHOUD];
+   BOOL hmm = roadmap_navigate_hmm_enabled ();
+   BOOL hmm_corrected = FALSE;
    BOOL candidate_in_route;
    BOOL current_in_route = FALSE;
 
@@ -1068,9 +1091,11 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps
    roadmap_trip_set_mobile ("GPS_LOCATE", &RoadMapLatestGpsPosition); //AviR: debug
 #endif
 
-   if (RoadMapConfirmedStreet.valid) {
+   if (RoadMapConfirmedStreet.valid && !hmm) {
 
-      /* We have an existing street match: check it is still valid. */
+      /* We have an existing street match: check it is still valid.
+       * The HMM matcher needs to see every fix, so it skips this.
+       */
 
       RoadMapFuzzy before = RoadMapConfirmedStreet.cur_fuzzyfied;
       RoadMapFuzzy current_fuzzy;
@@ -1203,6 +1228,19 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps
              candidate_in_route = 0;
           }
 
+      if (hmm) {
+         hmm_candidates[i].found = TRUE;
+         hmm_candidates[i].in_route = candidate_in_route;
+         hmm_candidates[i].index = i;
+         hmm_candidates[i].result = result;
+         hmm_candidates[i].tracking = candidate;
+         if (result == roadmap_fuzzy_false ()) {
+            hmm_directions[i] = ROUTE_DIRECTION_NONE;
+         } else {
+            hmm_directions[i] = candidate.line_direction;
+         }
+      }
+
       if (!candidates[0].found ||
           (result > candidates[0].result && (candidate_in_route == candidates[0].in_route ||
                                              candidate_in_route ||
@@ -1243,6 +1281,28 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps
 
    }
 
+   if (hmm) {
+      int corrected;
+      int matched = roadmap_navigate_hmm_step (&RoadMapLatestPosition,
+                                               gps_time,
+                                               RoadMapLatestGpsPosition.accuracy,
+                                               RoadMapLatestGpsPosition.steering,
+                                               RoadMapLatestGpsPosition.speed,
+                                               RoadMapNeighbourhood,
+                                               hmm_directions,
+                                               count,
+                                               &corrected);
+      if (matched >= 0) {
+         roadmap_navigate_promote_candidate (candidates, hmm_candidates + matched);
+
+         /* The later fixes ruled out the line we are on: follow the
+          * corrected path, even if this fix alone does not make the
+          * matched line acceptable.
+          */
+         hmm_corrected = (corrected > 0);
+      }
+   }
+
 #ifdef DEBUG_PRINTS
 
    printf("current: %d (%d)",
@@ -1292,7 +1352,7 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps
    }
 #endif
    
-   if (RoadMapConfirmedStreet.valid && editor_ignore_new_roads()) {
+   if (RoadMapConfirmedStreet.valid && editor_ignore_new_roads() && !hmm_corrected) {
       if ((!candidates[0].found || !roadmap_fuzzy_is_acceptable(candidates[0].result)  &&
            (roadmap_fuzzy_false() != roadmap_fuzzy_or(RoadMapConfirmedStreet.cur_fuzzyfied, confidence)))/* ||
           ((!candidates[0].in_route && current_in_route) &&
@@ -1329,7 +1389,8 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps
       }
    }
    
-   if ((RoadMapConfirmedStreet.valid && candidates[0].found && roadmap_fuzzy_is_acceptable (candidates[0].result)) ||
+   if ((RoadMapConfirmedStreet.valid && candidates[0].found &&
+        (hmm_corrected || roadmap_fuzzy_is_acceptable (candidates[0].result))) ||
        (!RoadMapConfirmedStreet.valid && candidates[0].found && roadmap_fuzzy_is_certain (candidates[0].result))){
 
       /* found alternative street */
@@ -1349,7 +1410,12 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps
       nominated_index = candidates[0].index;
       nominated_result = candidates[0].result;
 
-      if (confidence == roadmap_fuzzy_false()) {
+      if (hmm_corrected) {
+         confidence = candidates[0].result;
+#ifdef DEBUG_PRINTS
+         printf("confidence reset, map matching corrected\n");
+#endif
+      } else if (confidence == roadmap_fuzzy_false()) {
          if (RoadMapConfirmedStreet.valid)
             confidence = candidates[0].result;
          else
@@ -1428,8 +1494,8 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps
 
       //handle some special cases:
       //
-      //special case: lost route
-      if (current_in_route && !candidates[0].in_route) {
+      //special case: lost route (the HMM matcher already weighs the history)
+      if (!hmm && current_in_route && !candidates[0].in_route) {
          if (time(NULL) - lost_route_time < 30) {
             //It is better to reset the location based only on distance and direction if we recalc too often
             int candidate_0_confidence = 0;
@@ -1474,7 +1540,7 @@ void roadmap_navigate_locate (const RoadMapGpsPosition *gps_position, time_t gps
       }
 
       //special case: first line - prefer major road
-      if (!RoadMapConfirmedStreet.valid && !candidates[0].in_route &&
+      if (!hmm && !RoadMapConfirmedStreet.valid && !candidates[0].in_route &&
           RoadMapNeighbourhood[candidates[0].index].line.cfcc >= ROADMAP_ROAD_RAMP) {
          if (RoadMapNeighbourhood[candidates[1].index].line.cfcc < ROADMAP_ROAD_RAMP &&
              roadmap_fuzzy_is_good(candidates[1].result) &&
@@ -1676,6 +1742,8 @@ void roadmap_navigate_initialize (void) {
 
     roadmap_fuzzy_reset_cycle ();
 
+    roadmap_navigate_hmm_initialize ();
+
     roadmap_config_declare_enumeration
         ("session", &RoadMapNavigateFlag, NULL, "yes", "no", NULL);
     roadmap_config_declare
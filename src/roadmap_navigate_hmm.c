@@ -0,0 +1,528 @@
+/* roadmap_navigate_hmm.c - hidden Markov model map matching.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The fuzzy matcher judges each fix mostly on its own, so a few bad fixes
+ *   (e.g. between tall buildings) are enough to jump to a parallel street.
+ *   Here each candidate line and travel direction is a state of a hidden
+ *   Markov model, and the most likely sequence of states is kept up to date
+ *   with one Viterbi step per fix:
+ *
+ *   - the emission score favors lines close to the fix, relative to the
+ *     GPS accuracy, and aligned with the GPS steering;
+ *   - the transition score favors moves where the route distance between
+ *     the two lines, driven through the road graph in the allowed
+ *     directions, is close to the straight distance between the two fixes.
+ *     A parallel street that cannot be reached within that distance is
+ *     only reached through a costly jump.
+ *
+ *   The work per fix is bounded by the number of states kept per fix, and
+ *   by the number of lines each route search visits. The last fixes are
+ *   kept, with the back pointers of their states, so that the best path
+ *   can be traced back over a fixed lag window. Where it no longer goes
+ *   through the line matched at the time, the match is corrected, and the
+ *   caller is told so that it follows the corrected path.
+ *
+ *   Scores are log probabilities, in thousandths.
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_navigate_hmm.h
+ */
+
+#include <stdlib.h>
+
+#include "roadmap.h"
+#include "roadmap_config.h"
+#include "roadmap_gps.h"
+#include "roadmap_math.h"
+#include "roadmap_line_route.h"
+#include "roadmap_plugin.h"
+#include "roadmap_square.h"
+#include "roadmap_line.h"
+#include "roadmap_point.h"
+#include "roadmap_street.h"
+#include "navigate/navigate_graph.h"
+
+#include "roadmap_navigate_hmm.h"
+
+
+static RoadMapConfigDescriptor RoadMapNavigateMatchingCfg =
+                        ROADMAP_CONFIG_ITEM("Navigation", "Map Matching");
+
+#define HMM_WINDOW          8   /* fixes */
+#define HMM_MAX_STATES      8   /* states kept per fix */
+
+#define HMM_MIN_SIGMA       10  /* meters */
+#define HMM_MAX_SIGMA       50  /* meters */
+#define HMM_HEADING_SIGMA   45  /* degrees */
+#define HMM_BETA            15  /* meters */
+#define HMM_UTURN_DISTANCE  100 /* meters */
+#define HMM_MAX_DISTANCE    1000 /* meters from the fix, for the emission */
+#define HMM_JUMP_COST       8000
+#define HMM_MIN_SCORE       -1000000
+#define HMM_MAX_GAP         10  /* seconds */
+#define HMM_ROUTE_LINES     32  /* lines visited per route search */
+#define HMM_SUCCESSORS      16  /* lines leaving a node */
+
+/* Past this route distance, the jump costs less than the drive. */
+#define HMM_ROUTE_LIMIT(straight) ((straight) + HMM_JUMP_COST * HMM_BETA / 1000)
+
+typedef struct {
+   PluginLine line;
+   int direction;
+   int neighbour;
+   RoadMapPosition projection;
+   RoadMapPosition entry;
+   RoadMapPosition exit;
+   int exit_node; /* -1 if the line is not in the road graph */
+   int score;
+   int back; /* state index in the previous fix, -1 for none */
+} HmmState;
+
+/* A line reached by a route search, with the distance driven to its
+ * start, in its travel direction.
+ */
+typedef struct {
+   int square;
+   int line;
+   int reversed;
+   int end_node;
+   int distance;
+   int done;
+} HmmReach;
+
+typedef struct {
+   int count;
+   HmmReach lines[HMM_ROUTE_LINES];
+} HmmRoutes;
+
+typedef struct {
+   time_t gps_time;
+   RoadMapPosition position;
+   int count;
+   int reported;
+   HmmState states[HMM_MAX_STATES];
+} HmmFix;
+
+static HmmFix HmmWindow[HMM_WINDOW];
+static int    HmmHead = -1;
+static int    HmmLength = 0;
+
+
+static int hmm_angle_delta (int a, int b) {
+
+   int delta = abs (a - b) % 360;
+
+   if (delta > 180) delta = 360 - delta;
+
+   return delta;
+}
+
+
+static int hmm_emission (const RoadMapNeighbour *neighbour, int direction,
+                         int accuracy, int steering, int speed) {
+
+   int sigma = accuracy / 2;
+   int distance = neighbour->distance;
+   int score;
+
+   if (sigma < HMM_MIN_SIGMA) sigma = HMM_MIN_SIGMA;
+   if (sigma > HMM_MAX_SIGMA) sigma = HMM_MAX_SIGMA;
+
+   /* Square a bounded distance: farther lines are out of the question
+    * anyway, and the product must fit in an int.
+    */
+   if (distance > HMM_MAX_DISTANCE) distance = HMM_MAX_DISTANCE;
+
+   score = - (distance * distance * 500) / (sigma * sigma);
+
+   if ((steering != INVALID_STEERING) && (speed > roadmap_gps_speed_accuracy ())) {
+
+      int azymuth;
+      int delta;
+
+      if (direction == ROUTE_DIRECTION_AGAINST_LINE) {
+         azymuth = roadmap_math_azymuth (&neighbour->to, &neighbour->from);
+      } else {
+         azymuth = roadmap_math_azymuth (&neighbour->from, &neighbour->to);
+      }
+
+      delta = hmm_angle_delta (azymuth, steering);
+      score -= (delta * delta * 500) / (HMM_HEADING_SIGMA * HMM_HEADING_SIGMA);
+   }
+
+   return score;
+}
+
+
+/* Add a line to a route search, or shorten the distance to it. */
+static void hmm_routes_add (HmmRoutes *routes, const struct successor *line,
+                            int distance) {
+
+   int i;
+
+   for (i = 0; i < routes->count; i++) {
+
+      HmmReach *reach = routes->lines + i;
+
+      if ((reach->square == line->square_id) &&
+          (reach->line == line->line_id) &&
+          (reach->reversed == line->reversed)) {
+
+         if (!reach->done && (distance < reach->distance)) {
+            reach->distance = distance;
+         }
+         return;
+      }
+   }
+
+   if (routes->count < HMM_ROUTE_LINES) {
+
+      HmmReach *reach = routes->lines + routes->count++;
+
+      reach->square = line->square_id;
+      reach->line = line->line_id;
+      reach->reversed = line->reversed;
+      reach->end_node = line->to_point;
+      reach->distance = distance;
+      reach->done = 0;
+   }
+}
+
+
+/* Find the lines that can be driven to from a state, within the limit:
+ * a shortest path search through the road graph, with the directions and
+ * the turn restrictions of the routing, that visits a bounded number of
+ * lines.
+ */
+static void hmm_routes_search (const HmmState *from, int limit, HmmRoutes *routes) {
+
+   struct successor successors[HMM_SUCCESSORS];
+   int square = from->line.square;
+   int line = from->line.line_id;
+   int reversed = (from->direction == ROUTE_DIRECTION_AGAINST_LINE);
+   int node = from->exit_node;
+   int distance = roadmap_math_distance (&from->projection, &from->exit);
+
+   routes->count = 0;
+
+   if (node < 0) return;
+
+   for (;;) {
+
+      HmmReach *next = NULL;
+      int count;
+      int i;
+
+      if (distance <= limit) {
+
+         count = get_connected_segments (square, line, reversed, node,
+                                         successors, HMM_SUCCESSORS, 1, 1);
+
+         for (i = 0; i < count; i++) {
+            hmm_routes_add (routes, successors + i, distance);
+         }
+      }
+
+      /* Drive on from the closest line not driven yet. */
+      for (i = 0; i < routes->count; i++) {
+         HmmReach *reach = routes->lines + i;
+         if (!reach->done && ((next == NULL) || (reach->distance < next->distance))) {
+            next = reach;
+         }
+      }
+
+      if ((next == NULL) || (next->distance > limit)) break;
+
+      next->done = 1;
+      square = next->square;
+      line = next->line;
+      reversed = next->reversed;
+      node = next->end_node;
+
+      roadmap_square_set_current (square);
+      distance = next->distance + roadmap_line_length (line);
+   }
+}
+
+
+/* The distance driven from one state to the next, or -1 if the next line
+ * was not reached by the route search from the first one.
+ */
+static int hmm_route_distance (const HmmState *from, const HmmRoutes *routes,
+                               const HmmState *to) {
+
+   int i;
+
+   if (roadmap_plugin_same_db_line (&from->line, &to->line)) {
+
+      int distance = roadmap_math_distance (&from->projection, &to->projection);
+
+      if (from->direction != to->direction) distance += HMM_UTURN_DISTANCE;
+
+      return distance;
+   }
+
+   if (to->line.plugin_id != ROADMAP_PLUGIN_ID) return -1;
+
+   for (i = 0; i < routes->count; i++) {
+
+      const HmmReach *reach = routes->lines + i;
+
+      if ((reach->square == to->line.square) &&
+          (reach->line == to->line.line_id) &&
+          (reach->reversed == (to->direction == ROUTE_DIRECTION_AGAINST_LINE))) {
+
+         return reach->distance + roadmap_math_distance (&to->entry, &to->projection);
+      }
+   }
+
+   return -1;
+}
+
+
+static int hmm_transition (const HmmState *from, const HmmRoutes *routes,
+                           const HmmState *to, int straight) {
+
+   int route = hmm_route_distance (from, routes, to);
+
+   if (route < 0) return -HMM_JUMP_COST;
+
+   return - (abs (route - straight) * 1000) / HMM_BETA;
+}
+
+
+/* The line ends and the graph node where the state leaves its line. */
+static void hmm_state_ends (HmmState *state) {
+
+   int from;
+   int to;
+
+   state->exit_node = -1;
+
+   if (state->line.plugin_id != ROADMAP_PLUGIN_ID) {
+      roadmap_street_extend_line_ends (&state->line, &state->entry, &state->exit,
+                                       FLAG_EXTEND_BOTH, NULL, NULL);
+      if (state->direction == ROUTE_DIRECTION_AGAINST_LINE) {
+         RoadMapPosition entry = state->entry;
+         state->entry = state->exit;
+         state->exit = entry;
+      }
+      return;
+   }
+
+   roadmap_square_set_current (state->line.square);
+   roadmap_line_points (state->line.line_id, &from, &to);
+
+   if (state->direction == ROUTE_DIRECTION_AGAINST_LINE) {
+      int swap = from;
+      from = to;
+      to = swap;
+   }
+
+   roadmap_point_position (from, &state->entry);
+   roadmap_point_position (to, &state->exit);
+   state->exit_node = to;
+}
+
+
+/* Follow the best path back over the window, and correct the fixes where
+ * it no longer goes through the state matched at the time. Returns the
+ * number of fixes corrected.
+ */
+static int hmm_correct (void) {
+
+   int fix = HmmHead;
+   int state = HmmWindow[HmmHead].reported;
+   int corrected = 0;
+   int i;
+
+   for (i = 1; i < HmmLength; i++) {
+
+      const HmmState *current = HmmWindow[fix].states + state;
+      int previous = (fix + HMM_WINDOW - 1) % HMM_WINDOW;
+
+      if (current->back < 0) break;
+
+      state = current->back;
+      fix = previous;
+
+      if (state != HmmWindow[fix].reported) {
+         roadmap_log (ROADMAP_DEBUG, "map matching corrected %d fixes back: line %d instead of %d",
+                      i, HmmWindow[fix].states[state].line.line_id,
+                      HmmWindow[fix].states[HmmWindow[fix].reported].line.line_id);
+         HmmWindow[fix].reported = state;
+         corrected++;
+      }
+   }
+
+   return corrected;
+}
+
+
+void roadmap_navigate_hmm_reset (void) {
+
+   HmmHead = -1;
+   HmmLength = 0;
+}
+
+
+int roadmap_navigate_hmm_step (const RoadMapPosition *position,
+                               time_t gps_time,
+                               int accuracy,
+                               int steering,
+                               int speed,
+                               const RoadMapNeighbour *neighbours,
+                               const int *directions,
+                               int count,
+                               int *corrected) {
+
+   static HmmRoutes routes[HMM_MAX_STATES];
+   HmmFix *previous = NULL;
+   HmmFix *fix;
+   int square = roadmap_square_active ();
+   int straight = 0;
+   int best;
+   int i;
+   int j;
+
+   *corrected = 0;
+
+   if (HmmLength > 0) {
+      previous = HmmWindow + HmmHead;
+      if ((gps_time < previous->gps_time) ||
+          (gps_time - previous->gps_time > HMM_MAX_GAP)) {
+         roadmap_navigate_hmm_reset ();
+         previous = NULL;
+      } else {
+         straight = roadmap_math_distance (&previous->position, position);
+      }
+   }
+
+   if (previous) {
+      for (j = 0; j < previous->count; j++) {
+         hmm_routes_search (previous->states + j, HMM_ROUTE_LIMIT (straight), routes + j);
+      }
+   }
+
+   fix = HmmWindow + (HmmHead + 1) % HMM_WINDOW;
+   fix->gps_time = gps_time;
+   fix->position = *position;
+   fix->count = 0;
+
+   for (i = 0; i < count; i++) {
+
+      HmmState state;
+      int emission;
+
+      if ((directions[i] != ROUTE_DIRECTION_WITH_LINE) &&
+          (directions[i] != ROUTE_DIRECTION_AGAINST_LINE)) continue;
+
+      state.line = neighbours[i].line;
+      state.direction = directions[i];
+      state.neighbour = i;
+      state.projection = neighbours[i].intersection;
+
+      hmm_state_ends (&state);
+
+      emission = hmm_emission (neighbours + i, state.direction, accuracy, steering, speed);
+
+      state.score = HMM_MIN_SCORE;
+      state.back = -1;
+
+      if (previous) {
+         for (j = 0; j < previous->count; j++) {
+            int score = previous->states[j].score +
+                        hmm_transition (previous->states + j, routes + j, &state, straight);
+            if (score > state.score) {
+               state.score = score;
+               state.back = j;
+            }
+         }
+         state.score += emission;
+      } else {
+         state.score = emission;
+      }
+
+      if (state.score < HMM_MIN_SCORE) state.score = HMM_MIN_SCORE;
+
+      /* Keep the best states only. */
+      if (fix->count < HMM_MAX_STATES) {
+         fix->states[fix->count++] = state;
+      } else {
+         int worst = 0;
+         for (j = 1; j < fix->count; j++) {
+            if (fix->states[j].score < fix->states[worst].score) worst = j;
+         }
+         if (state.score > fix->states[worst].score) {
+            fix->states[worst] = state;
+         }
+      }
+   }
+
+   roadmap_square_set_current (square);
+
+   if (fix->count == 0) {
+      /* No line around: the path is broken. */
+      roadmap_navigate_hmm_reset ();
+      return -1;
+   }
+
+   best = 0;
+   for (j = 1; j < fix->count; j++) {
+      if (fix->states[j].score > fix->states[best].score) best = j;
+   }
+
+   /* Keep the scores relative to the best path, so they stay bounded. */
+   for (j = 0; j < fix->count; j++) {
+      if (j != best) {
+         fix->states[j].score -= fix->states[best].score;
+         if (fix->states[j].score < HMM_MIN_SCORE) fix->states[j].score = HMM_MIN_SCORE;
+      }
+   }
+   fix->states[best].score = 0;
+   fix->reported = best;
+
+   HmmHead = (HmmHead + 1) % HMM_WINDOW;
+   if (HmmLength < HMM_WINDOW) HmmLength++;
+
+   *corrected = hmm_correct ();
+
+   return fix->states[best].neighbour;
+}
+
+
+int roadmap_navigate_hmm_enabled (void) {
+
+   return roadmap_config_match (&RoadMapNavigateMatchingCfg, "hmm");
+}
+
+
+void roadmap_navigate_hmm_initialize (void) {
+
+   roadmap_config_declare_enumeration
+      ("preferences", &RoadMapNavigateMatchingCfg, NULL, "fuzzy", "hmm", NULL);
+
+   roadmap_navigate_hmm_reset ();
+}
@@ -0,0 +1,56 @@
+/* roadmap_navigate_hmm.h - hidden Markov model map matching.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ROADMAP_NAVIGATE_HMM__H_
+#define _ROADMAP_NAVIGATE_HMM__H_
+
+#include <time.h>
+
+#include "roadmap_types.h"
+#include "roadmap_street.h"
+
+void roadmap_navigate_hmm_initialize (void);
+
+/* True when the "Map Matching" preference selects the HMM matcher. */
+int  roadmap_navigate_hmm_enabled (void);
+
+void roadmap_navigate_hmm_reset (void);
+
+/* Feed one GPS fix with its candidate lines. directions[i] is the travel
+ * direction on neighbours[i] (ROUTE_DIRECTION_WITH_LINE or AGAINST_LINE),
+ * or ROUTE_DIRECTION_NONE to ignore that candidate. Returns the index of
+ * the candidate at the end of the most likely path, or -1 if none.
+ * corrected is set to the number of past fixes that the most likely path
+ * now matches to another line than the one returned at the time.
+ */
+int  roadmap_navigate_hmm_step (const RoadMapPosition *position,
+                                time_t gps_time,
+                                int accuracy,
+                                int steering,
+                                int speed,
+                                const RoadMapNeighbour *neighbours,
+                                const int *directions,
+                                int count,
+                                int *corrected);
+
+#endif // _ROADMAP_NAVIGATE_HMM__H_
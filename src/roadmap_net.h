@@ -71,6 +71,17 @@ RoadMapSocket roadmap_net_connect(  const char*       protocol,
                                     int               flags,
                                     roadmap_result*   res); // Optional, can be NULL
 
+/* The request line and headers that roadmap_net_connect() sends for the
+ * "http" and "http_post" protocols, to send another request on a kept
+ * alive connection. Returns 0 if the address is invalid.
+ */
+int roadmap_net_http_header (const char *protocol,
+                             const char *name,
+                             time_t update_time,
+                             int flags,
+                             char *header,
+                             int size);
+
 // A-syncronious receive:
 void *roadmap_net_connect_async (const char *protocol,
                                 const char *name, 
@@ -85,10 +96,22 @@ void *roadmap_net_connect_async (const char *protocol,
  * a negative value (never 0).
  */
 int roadmap_net_receive (RoadMapSocket s, void *data, int size);
+
 int roadmap_net_send    (RoadMapSocket s, const void *data, int length,
                          int wait);
 int roadmap_net_send_async (RoadMapSocket s, const void *data, int length);
 
+/* A compressed response may decompress to more than was asked for: the
+ * rest is kept, and must be received without waiting for the socket.
+ */
+int roadmap_net_receive_pending (RoadMapSocket s);
+
+/* Bytes of the compressed response body that were not received yet, as
+ * counted by its Content-Length: 0 once it is over. -1 if unknown, or if
+ * the socket is not compressed.
+ */
+int roadmap_net_receive_left (RoadMapSocket s);
+
 RoadMapSocket roadmap_net_listen(int port);
 RoadMapSocket roadmap_net_accept(RoadMapSocket server_socket);
 
@@ -100,6 +123,14 @@ void roadmap_net_shutdown ( void );
 
 void roadmap_net_initialize( void );
 
+/* Resolve the host of the address (a URL, or host[:port]) in the background,
+ * so that a later connection does not wait for the DNS.
+ */
+void roadmap_net_prefetch (const char *address);
+
+/* The network has changed: refresh the cached host addresses. */
+void roadmap_net_refresh_hosts (void);
+
 void roadmap_net_set_compress_enabled( BOOL value );
 BOOL roadmap_net_get_compress_enabled( void );
 int roadmap_net_get_fd(RoadMapSocket s);
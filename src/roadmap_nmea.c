@@ -161,16 +161,43 @@ static time_t roadmap_nmea_decode_time (const char *hhmmss,
 }
 
 
+/* Decode a decimal number in a single pass, in fixed point: the
+ * fraction digits beyond the unit's precision are truncated, as
+ * the (int) cast used to do.
+ */
 static int roadmap_nmea_decode_numeric (char *value, int unit) {
 
-   int result;
+   int result = 0;
+   int negative = 0;
 
-   if (strchr (value, '.') != NULL) {
-      result = (int) (atof(value) * unit);
-   } else {
-      result = atoi (value) * unit;
+   if (*value == '-') {
+      negative = 1;
+      value += 1;
+   } else if (*value == '+') {
+      value += 1;
    }
-   return result;
+
+   while ((*value >= '0') && (*value <= '9')) {
+      int digit = *value - '0';
+      /* Not a GPS value: it would overflow, with room left for the fraction. */
+      if (result > (0x7fffffff / unit - 1 - digit) / 10) return 0;
+      result = (10 * result) + digit;
+      value += 1;
+   }
+   result *= unit;
+
+   if (*value == '.') {
+
+      int scale = unit;
+
+      for (value += 1; (*value >= '0') && (*value <= '9'); value += 1) {
+         scale /= 10;
+         if (scale == 0) break;
+         result += (*value - '0') * scale;
+      }
+   }
+
+   return negative ? 0 - result : result;
 }
 
 
@@ -195,6 +222,7 @@ static int roadmap_nmea_decode_coordinate
    result = 0;
    while (value < dot) {
       result = dec2bin(*value) + (10 * result);
+      if (result > 180) return 0;
       value += 1;
    }
    result *= TIGER_COORDINATE_UNIT;
@@ -227,6 +255,9 @@ static char *roadmap_nmea_decode_unit (const char *original) {
 
 typedef int (*RoadMapNmeaDecoder) (int argc, char *argv[]);
 
+#define NMEA_MAX_FIELDS   80
+#define NMEA_HASH_SIZE    64  /* Power of 2, well above the sentence count. */
+
 
 static int roadmap_nmea_rmc (int argc, char *argv[]) {
 
@@ -443,6 +474,12 @@ static int roadmap_nmea_gsv (int argc, char *argv[]) {
    end = RoadMapNmeaReceived.gsv.count
             - ((RoadMapNmeaReceived.gsv.index - 1) * 4);
 
+   if ((RoadMapNmeaReceived.gsv.index < 1) || (end < 0)) {
+      roadmap_log (ROADMAP_ERROR, "%d is an invalid GSV sentence index",
+                   RoadMapNmeaReceived.gsv.index);
+      return 0;
+   }
+
    if (end > 4) end = 4;
 
    if (argc <= (end * 4) + 3) {
@@ -639,6 +676,82 @@ static struct {
    { NULL, "", NULL}
 };
 
+/* Sentence id --> index in RoadMapNmeaPhrase + 1, 0 if empty. */
+static unsigned char RoadMapNmeaHash[NMEA_HASH_SIZE];
+static int RoadMapNmeaHashReady = 0;
+
+
+/* The id is the sentence name for the standard sentences (the talker
+ * is skipped), and the vendor followed by the sentence name for the
+ * proprietary ones (the 'P' is skipped).
+ */
+static unsigned int roadmap_nmea_hash_code (const char *vendor,
+                                            const char *sentence) {
+
+   unsigned int code = 0;
+
+   if (vendor != NULL) {
+      while (*vendor) code = (code * 31) + (unsigned char) *vendor++;
+   }
+   while (*sentence) code = (code * 31) + (unsigned char) *sentence++;
+
+   return code & (NMEA_HASH_SIZE - 1);
+}
+
+
+static void roadmap_nmea_hash_build (void) {
+
+   int i;
+
+   for (i = 0; RoadMapNmeaPhrase[i].decoder != NULL; ++i) {
+
+      unsigned int code = roadmap_nmea_hash_code (RoadMapNmeaPhrase[i].vendor,
+                                                  RoadMapNmeaPhrase[i].sentence);
+
+      while (RoadMapNmeaHash[code]) code = (code + 1) & (NMEA_HASH_SIZE - 1);
+
+      RoadMapNmeaHash[code] = (unsigned char) (i + 1);
+   }
+
+   RoadMapNmeaHashReady = 1;
+}
+
+
+static int roadmap_nmea_hash_find (const char *id, int proprietary) {
+
+   unsigned int code;
+   const char *sentence = id;
+
+   if (proprietary) {
+      if (strlen (id) < 4) return -1;
+      sentence = id + 3;
+   }
+
+   if (!RoadMapNmeaHashReady) roadmap_nmea_hash_build ();
+
+   for (code = roadmap_nmea_hash_code (NULL, id);
+        RoadMapNmeaHash[code];
+        code = (code + 1) & (NMEA_HASH_SIZE - 1)) {
+
+      int i = RoadMapNmeaHash[code] - 1;
+
+      if (proprietary) {
+         if ((RoadMapNmeaPhrase[i].vendor != NULL) &&
+             (strncmp (RoadMapNmeaPhrase[i].vendor, id, 3) == 0) &&
+             (strcmp (RoadMapNmeaPhrase[i].sentence, sentence) == 0)) {
+            return i;
+         }
+      } else {
+         if ((RoadMapNmeaPhrase[i].vendor == NULL) &&
+             (strcmp (RoadMapNmeaPhrase[i].sentence, sentence) == 0)) {
+            return i;
+         }
+      }
+   }
+
+   return -1;
+}
+
 
 RoadMapNmeaAccount  roadmap_nmea_create(const char *name) {
 
@@ -748,14 +861,14 @@ int roadmap_nmea_decode (void *user_context,
    char *p = sentence;
 
    int   count;
-   char *field[80];
+   char *field[NMEA_MAX_FIELDS];
 
    unsigned char checksum = 0;
 
 
    /* We skip any leftover from previous transmission problems,
-    * check that the '$' is really here, compute the checksum
-    * and then decode the "csv" format.
+    * check that the '$' is really here, then compute the checksum
+    * and split the "csv" format in place, in the same pass.
     */
    while ((*p != '$') && (*p >= ' ')) ++p;
 
@@ -763,16 +876,30 @@ int roadmap_nmea_decode (void *user_context,
 
    sentence = p++;
    //roadmap_log (ROADMAP_ERROR, "NMEA: '%s'", sentence);
+
+   field[0] = p;
+   count = 1;
+
    while ((*p != '*') && (*p >= ' ')) {
       checksum ^= *p;
+      if (*p == ',') {
+         if (count >= NMEA_MAX_FIELDS) return 0;
+         *p = 0;
+         field[count++] = p + 1;
+      }
       p += 1;
    }
 
    if (*p == '*') {
 
-      unsigned char mnea_checksum = hex2bin(p[1]) * 16 + hex2bin(p[2]);
+      unsigned char mnea_checksum;
+
+      if ((p[1] == 0) || (p[2] == 0)) return 0; /* Truncated checksum. */
+
+      mnea_checksum = hex2bin(p[1]) * 16 + hex2bin(p[2]);
 
       if (mnea_checksum != checksum) {
+         for (i = 1; i < count; ++i) field[i][-1] = ',';
          roadmap_log (ROADMAP_ERROR,
                "mnea checksum error for '%s' (nmea=%02x, calculated=%02x)",
                sentence,
@@ -784,12 +911,6 @@ int roadmap_nmea_decode (void *user_context,
    }
    *p = 0;
 
-   for (i = 0, p = sentence; p != NULL && *p != 0; ++i, p = strchr (p, ',')) {
-      *p = 0;
-      field[i] = ++p;
-   }
-   count = i;
-
 
    /* Now that we have separated each argument of the sentence, retrieve
     * the right decoder & listener functions and call them.
@@ -797,32 +918,19 @@ int roadmap_nmea_decode (void *user_context,
    if (*(field[0]) == 'P') {
 
       /* This is a proprietary sentence. */
+      i = roadmap_nmea_hash_find (field[0]+1, 1);
 
-      for (i = 0; RoadMapNmeaPhrase[i].decoder != NULL; ++i) {
-
-         /* Skip standard sentences. */
-         if (RoadMapNmeaPhrase[i].vendor == NULL) continue;
-
-         if ((strncmp(RoadMapNmeaPhrase[i].vendor, field[0]+1, 3) == 0) &&
-             (strcmp(RoadMapNmeaPhrase[i].sentence, field[0]+4) == 0)) {
-
-            return roadmap_nmea_call (user_context, account, i, count, field);
-         }
-      }
-   } else {
+   } else if (strlen (field[0]) > 2) {
 
       /* This is a standard sentence. */
+      i = roadmap_nmea_hash_find (field[0]+2, 0);
 
-      for (i = 0; RoadMapNmeaPhrase[i].decoder != NULL; ++i) {
-
-         /* Skip proprietary sentences. */
-         if (RoadMapNmeaPhrase[i].vendor != NULL) continue;
-
-         if (strcmp (RoadMapNmeaPhrase[i].sentence, field[0]+2) == 0) {
+   } else {
+      i = -1;
+   }
 
-            return roadmap_nmea_call (user_context, account, i, count, field);
-         }
-      }
+   if (i >= 0) {
+      return roadmap_nmea_call (user_context, account, i, count, field);
    }
 
    roadmap_log (ROADMAP_DEBUG, "unknown nmea sentence %s", field[0]);
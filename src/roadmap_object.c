@@ -30,8 +30,9 @@
  *   These objects are dynamic and not persistent (i.e. these are not points
  *   of interest).
  *
- *   The implementation is not terribly optimized: there should not be too
- *   many objects.
+ *   The objects are found by id through a hash of their (unique) id string.
+ *   Hit tests use a grid of the objects' bounding boxes on the screen, built
+ *   on the first test after the view or the objects changed.
  */
 
 #include <stdlib.h>
@@ -72,6 +73,9 @@ enum states {
 #define MAX_OBJ_IMAGES  10
 #define MAX_OBJ_TEXTS   4
 
+#define OBJECT_HASH_SIZE   1024
+#define OBJECT_GRID_CELL   64
+
 
 struct RoadMapObjectDescriptor {
 
@@ -118,6 +122,7 @@ struct RoadMapObjectDescriptor {
    struct RoadMapObjectDescriptor *next;
    struct RoadMapObjectDescriptor *previous;
    struct RoadMapObjectDescriptor *child;
+   struct RoadMapObjectDescriptor *hash_next;
    
    BOOL   check_overlapping;
 	int   scale_factor;
@@ -130,6 +135,36 @@ static BOOL short_click_enabled = TRUE;
 
 static RoadMapObject *RoadmapObjectList = NULL;
 
+static RoadMapObject *RoadmapObjectHash[OBJECT_HASH_SIZE];
+
+typedef struct {
+   RoadMapObject  *object;
+   RoadMapGuiRect  box;
+} ObjectGridEntry;
+
+/* The screen grid: each cell lists the entries whose box covers it,
+ * in the objects list order.
+ */
+static BOOL             ObjectGridValid = FALSE;
+static RoadMapPosition  ObjectGridCenter;
+static zoom_t           ObjectGridZoom;
+static int              ObjectGridOrientation;
+static int              ObjectGridViewMode;
+static int              ObjectGridWidth;
+static int              ObjectGridHeight;
+static int              ObjectGridColumns;
+static int              ObjectGridRows;
+
+static int             *ObjectGridCells = NULL;
+static int              ObjectGridCellSize = 0;
+static ObjectGridEntry *ObjectGridEntries = NULL;
+static int              ObjectGridEntryCount = 0;
+static int              ObjectGridEntrySize = 0;
+static int             *ObjectGridNodeEntry = NULL;
+static int             *ObjectGridNodeNext = NULL;
+static int              ObjectGridNodeCount = 0;
+static int              ObjectGridNodeSize = 0;
+
 static BOOL initialized = FALSE;
 
 static RoadMapObject *roadmap_object_by_pos (RoadMapGuiPoint *point, BOOL action_only, RoadMapObject *cursor);
@@ -619,13 +654,42 @@ static BOOL is_fully_visible(RoadMapObject *cursor) {
    return visible;
 }
 
+/* The dynamic strings are unique, so the id's descriptor is the key. */
+static int object_hash_code (RoadMapDynamicString id) {
+
+   return (int)(((size_t)id >> 3) % OBJECT_HASH_SIZE);
+}
+
+static void object_hash_add (RoadMapObject *cursor) {
+
+   int code = object_hash_code (cursor->id);
+
+   cursor->hash_next = RoadmapObjectHash[code];
+   RoadmapObjectHash[code] = cursor;
+}
+
+static void object_hash_remove (RoadMapObject *cursor) {
+
+   RoadMapObject **link = RoadmapObjectHash + object_hash_code (cursor->id);
+
+   while (*link != NULL) {
+      if (*link == cursor) {
+         *link = cursor->hash_next;
+         break;
+      }
+      link = &((*link)->hash_next);
+   }
+   cursor->hash_next = NULL;
+}
+
 static RoadMapObject *roadmap_object_search (RoadMapDynamicString id) {
 
    RoadMapObject *cursor;
 
-   for (cursor = RoadmapObjectList; cursor != NULL; cursor = cursor->next) {
+   for (cursor = RoadmapObjectHash[object_hash_code (id)];
+        cursor != NULL;
+        cursor = cursor->hash_next) {
       if (cursor->id == id) return cursor;
-      if (cursor->child && cursor->child->id == id) return cursor->child;
    }
 
    return NULL;
@@ -809,6 +873,7 @@ void roadmap_object_add_image (RoadMapDynamicString id, RoadMapDynamicString ima
    if (cursor != NULL && cursor->image_count < MAX_OBJ_IMAGES) {
       cursor->images[cursor->image_count++] = image;
       roadmap_string_lock(image);
+      ObjectGridValid = FALSE;
    }
 }
 
@@ -1027,6 +1092,8 @@ void roadmap_object_add_with_priority (RoadMapDynamicString origin,
       roadmap_string_lock(text);
 
       RoadmapObjectList = object_insert_sort(RoadmapObjectList, cursor);
+      object_hash_add (cursor);
+      ObjectGridValid = FALSE;
 
       if (position) {
 #ifdef OPENGL
@@ -1094,6 +1161,8 @@ static void roadmap_object_add_child (RoadMapDynamicString  parent_id,
       roadmap_string_lock(id);
       roadmap_string_lock(image);
       roadmap_string_lock(text);
+
+      object_hash_add (cursor);
       
 #ifdef OPENGL
       if (!is_visible(parent_object) &&
@@ -1124,6 +1193,7 @@ void roadmap_object_move (RoadMapDynamicString id,
           (cursor->position.speed     != position->speed)) {
 
          cursor->position = *position;
+         ObjectGridValid = FALSE;
          (*cursor->listener) (id, position);
       }
    }
@@ -1173,6 +1243,9 @@ void roadmap_object_stop_glow (RoadMapDynamicString id) {
 static void release_object (RoadMapObject *cursor) {
    int i;
    
+   object_hash_remove (cursor);
+   ObjectGridValid = FALSE;
+
    roadmap_string_release(cursor->origin);
    roadmap_string_release(cursor->id);
    roadmap_string_release(cursor->name);
@@ -1225,6 +1298,9 @@ void roadmap_object_iterate (RoadMapObjectAction action) {
    RoadMapObject *cursor;
    int scale_factor;
 
+   /* A new frame: the objects' boxes will be computed again if needed. */
+   ObjectGridValid = FALSE;
+
    for (cursor = RoadmapObjectList; cursor->next != NULL; cursor = cursor->next);
 
    for ( ; cursor != NULL ; cursor = cursor->previous) {
@@ -1371,49 +1447,192 @@ RoadMapObjectMonitor roadmap_object_register_monitor
    return previous;
 }
 
-static RoadMapObject *roadmap_object_by_pos (RoadMapGuiPoint *point, BOOL action_only, RoadMapObject *org_cursor) {
+static BOOL object_box (RoadMapObject *cursor, RoadMapGuiRect *box) {
+
+   int image_height;
+   int image_width;
+   RoadMapPosition cursor_position;
+   RoadMapGuiPoint pos;
+   RoadMapImage image;
+
+   cursor_position.latitude = cursor->position.latitude;
+   cursor_position.longitude = cursor->position.longitude;
+
+   roadmap_math_coordinate(&cursor_position, &pos);
+   roadmap_math_rotate_project_coordinate (&pos);
+
+   image = roadmap_res_get (RES_BITMAP, RES_SKIN, roadmap_string_get(cursor->images[0]));
+   if (!image) return FALSE;
+
+   image_height = roadmap_canvas_image_height(image);
+   image_width = roadmap_canvas_image_width(image);
+
+   box->minx = pos.x - image_width/2 + cursor->offset.x;
+   box->maxx = pos.x + image_width/2 + cursor->offset.x;
+   box->miny = pos.y - image_height/2 + cursor->offset.y;
+   box->maxy = pos.y + image_height/2 + cursor->offset.y;
+
+   return TRUE;
+}
+
+static BOOL object_hit (RoadMapObject *cursor, const RoadMapGuiRect *box,
+                        const RoadMapGuiPoint *point,
+                        BOOL action_only, RoadMapObject *org_cursor) {
+
+   if (action_only && !cursor->action) return FALSE;
+
+   if ((point->x < box->minx) || (point->x > box->maxx) ||
+       (point->y < box->miny) || (point->y > box->maxy)) {
+      return FALSE;
+   }
+
+   if (org_cursor) {
+      return (cursor != org_cursor) && (org_cursor->origin == cursor->origin);
+   }
+
+   return TRUE;
+}
+
+static BOOL object_grid_current (void) {
+
+   RoadMapPosition center;
+   zoom_t zoom;
+
+   if (!ObjectGridValid) return FALSE;
+
+   roadmap_math_get_context (&center, &zoom);
+
+   return (center.longitude == ObjectGridCenter.longitude) &&
+          (center.latitude == ObjectGridCenter.latitude) &&
+          (zoom == ObjectGridZoom) &&
+          (roadmap_math_get_orientation () == ObjectGridOrientation) &&
+          (roadmap_screen_get_view_mode () == ObjectGridViewMode) &&
+          (roadmap_canvas_width () == ObjectGridWidth) &&
+          (roadmap_canvas_height () == ObjectGridHeight);
+}
+
+static void object_grid_add_node (int cell, int entry) {
+
+   if (ObjectGridNodeCount == ObjectGridNodeSize) {
+      ObjectGridNodeSize = ObjectGridNodeSize ? 2 * ObjectGridNodeSize : 256;
+      ObjectGridNodeEntry = realloc (ObjectGridNodeEntry, ObjectGridNodeSize * sizeof(int));
+      roadmap_check_allocated(ObjectGridNodeEntry);
+      ObjectGridNodeNext = realloc (ObjectGridNodeNext, ObjectGridNodeSize * sizeof(int));
+      roadmap_check_allocated(ObjectGridNodeNext);
+   }
+
+   ObjectGridNodeEntry[ObjectGridNodeCount] = entry;
+   ObjectGridNodeNext[ObjectGridNodeCount] = ObjectGridCells[cell];
+   ObjectGridCells[cell] = ObjectGridNodeCount++;
+}
+
+static void object_grid_build (void) {
 
    RoadMapObject *cursor;
-   RoadMapGuiPoint touched_point = *point;
+   int cell_count;
+   int i;
+
+   roadmap_math_get_context (&ObjectGridCenter, &ObjectGridZoom);
+   ObjectGridOrientation = roadmap_math_get_orientation ();
+   ObjectGridViewMode = roadmap_screen_get_view_mode ();
+   ObjectGridWidth = roadmap_canvas_width ();
+   ObjectGridHeight = roadmap_canvas_height ();
+
+   ObjectGridColumns = (ObjectGridWidth + OBJECT_GRID_CELL - 1) / OBJECT_GRID_CELL;
+   ObjectGridRows = (ObjectGridHeight + OBJECT_GRID_CELL - 1) / OBJECT_GRID_CELL;
+   cell_count = ObjectGridColumns * ObjectGridRows;
+
+   if (cell_count > ObjectGridCellSize) {
+      ObjectGridCellSize = cell_count;
+      ObjectGridCells = realloc (ObjectGridCells, ObjectGridCellSize * sizeof(int));
+      roadmap_check_allocated(ObjectGridCells);
+   }
+   for (i = 0; i < cell_count; i++) {
+      ObjectGridCells[i] = -1;
+   }
+
+   ObjectGridEntryCount = 0;
+   ObjectGridNodeCount = 0;
 
    for (cursor = RoadmapObjectList; cursor != NULL; cursor = cursor->next) {
-	  int image_height;
-	  int image_width;
-	  RoadMapPosition cursor_position;
-      RoadMapGuiPoint pos;
-      RoadMapImage image;
 
-	  if ((!cursor->images[0]) ||
-         (action_only && !cursor->action) ||
-         out_of_zoom (cursor))
-        continue;
+      RoadMapGuiRect box;
 
+      if (!cursor->images[0] || out_of_zoom (cursor)) continue;
+      if (!object_box (cursor, &box)) continue;
 
-      cursor_position.latitude = cursor->position.latitude;
-      cursor_position.longitude = cursor->position.longitude;
+      if ((box.maxx < 0) || (box.minx >= ObjectGridWidth) ||
+          (box.maxy < 0) || (box.miny >= ObjectGridHeight)) {
+         continue;
+      }
 
+      if (ObjectGridEntryCount == ObjectGridEntrySize) {
+         ObjectGridEntrySize = ObjectGridEntrySize ? 2 * ObjectGridEntrySize : 128;
+         ObjectGridEntries = realloc (ObjectGridEntries, ObjectGridEntrySize * sizeof(ObjectGridEntry));
+         roadmap_check_allocated(ObjectGridEntries);
+      }
 
-      roadmap_math_coordinate(&cursor_position, &pos);
-      roadmap_math_rotate_project_coordinate (&pos);
+      ObjectGridEntries[ObjectGridEntryCount].object = cursor;
+      ObjectGridEntries[ObjectGridEntryCount].box = box;
+      ObjectGridEntryCount++;
+   }
 
-      image = roadmap_res_get (RES_BITMAP, RES_SKIN, roadmap_string_get(cursor->images[0]));
-      if (!image) continue;
+   /* Insert backward, so that each cell lists its entries in order. */
+   for (i = ObjectGridEntryCount - 1; i >= 0; i--) {
 
-      image_height = roadmap_canvas_image_height(image);
-	  image_width = roadmap_canvas_image_width(image);
+      const RoadMapGuiRect *box = &ObjectGridEntries[i].box;
+      int first_column = box->minx < 0 ? 0 : box->minx / OBJECT_GRID_CELL;
+      int last_column = box->maxx >= ObjectGridWidth ? ObjectGridColumns - 1 : box->maxx / OBJECT_GRID_CELL;
+      int first_row = box->miny < 0 ? 0 : box->miny / OBJECT_GRID_CELL;
+      int last_row = box->maxy >= ObjectGridHeight ? ObjectGridRows - 1 : box->maxy / OBJECT_GRID_CELL;
+      int row;
+      int column;
 
-      if ((touched_point.x >= (pos.x - image_width/2 + cursor->offset.x)) &&
-          (touched_point.x <= (pos.x + image_width/2 + cursor->offset.x)) &&
-          (touched_point.y >= (pos.y - image_height/2 + cursor->offset.y)) &&
-          (touched_point.y <= (pos.y + image_height/2 + cursor->offset.y))) {
-             if (org_cursor){
-                if ((cursor != org_cursor) && (org_cursor->origin == cursor->origin))
-                   return cursor;
-                else
-                   continue;
-             }
-             else
-                return cursor;
+      for (row = first_row; row <= last_row; row++) {
+         for (column = first_column; column <= last_column; column++) {
+            object_grid_add_node (row * ObjectGridColumns + column, i);
+         }
+      }
+   }
+
+   ObjectGridValid = TRUE;
+}
+
+static RoadMapObject *roadmap_object_by_pos (RoadMapGuiPoint *point, BOOL action_only, RoadMapObject *org_cursor) {
+
+   RoadMapObject *cursor;
+   int node;
+
+   if (!object_grid_current ()) object_grid_build ();
+
+   if ((point->x < 0) || (point->x >= ObjectGridWidth) ||
+       (point->y < 0) || (point->y >= ObjectGridHeight)) {
+
+      /* Off the screen: the grid does not cover it. */
+      for (cursor = RoadmapObjectList; cursor != NULL; cursor = cursor->next) {
+
+         RoadMapGuiRect box;
+
+         if (!cursor->images[0] || out_of_zoom (cursor)) continue;
+         if (!object_box (cursor, &box)) continue;
+
+         if (object_hit (cursor, &box, point, action_only, org_cursor)) {
+            return cursor;
+         }
+      }
+
+      return NULL;
+   }
+
+   for (node = ObjectGridCells[(point->y / OBJECT_GRID_CELL) * ObjectGridColumns +
+                               point->x / OBJECT_GRID_CELL];
+        node >= 0;
+        node = ObjectGridNodeNext[node]) {
+
+      ObjectGridEntry *entry = ObjectGridEntries + ObjectGridNodeEntry[node];
+
+      if (object_hit (entry->object, &entry->box, point, action_only, org_cursor)) {
+         return entry->object;
       }
    }
 
@@ -1512,6 +1731,8 @@ void roadmap_object_set_zoom (RoadMapDynamicString id, int min_zoom, int max_zoo
       object->min_zoom = min_zoom;
    if (max_zoom != -1)
       object->max_zoom = max_zoom;
+
+   ObjectGridValid = FALSE;
 }
 
 void roadmap_object_set_no_overlapping (RoadMapDynamicString id) {
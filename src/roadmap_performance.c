@@ -0,0 +1,418 @@
+/* roadmap_performance.c - frame time profiler.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   Profiling is enabled by the "Performance.Record" preference or while
+ *   the overlay is shown ("toggle_performance" action). The trace is
+ *   written to the debug directory by the "dump_performance" action.
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_performance.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include "roadmap.h"
+#include "roadmap_config.h"
+#include "roadmap_canvas.h"
+#include "roadmap_screen.h"
+#include "roadmap_bar.h"
+#include "roadmap_file.h"
+#include "roadmap_path.h"
+
+#include "roadmap_performance.h"
+
+
+#define PERF_FRAMES     128   /* frames kept for the statistics */
+#define PERF_EVENTS     4096  /* trace events kept */
+
+#define PERF_TRACE_FILE "frame_trace.json"
+
+static RoadMapConfigDescriptor RoadMapConfigPerformanceRecord =
+                        ROADMAP_CONFIG_ITEM("Performance", "Record");
+
+/* The fine grained scopes run thousands of times per frame: they are only
+ * accumulated, and appear in the trace as arguments of the frame event.
+ */
+static const struct {
+   const char *name;
+   int traced;
+} PerformanceScopes[PERF_SCOPE_COUNT] = {
+   {"frame",          1},
+   {"map_setup",      1},
+   {"square_view",    1},
+   {"layers",         0},
+   {"draw_map",       1},
+   {"draw_square",    0},
+   {"draw_one_line",  0},
+   {"add_segment",    0},
+   {"flush_lines",    0},
+   {"flush_points",   0},
+   {"labels",         1},
+   {"overlays",       1},
+   {"flip",           1},
+   {"select_pen",     0},
+   {"draw_lines",     0},
+   {"create_path",    0},
+   {"add_path",       0},
+   {"text_full",      0},
+   {"text_cnv",       0},
+   {"text_one_letter",0},
+   {"text_get_glyph", 0},
+   {"text_one_ras",   0}
+};
+
+typedef struct {
+   unsigned long start;
+   unsigned long time[PERF_SCOPE_COUNT];
+} PerformanceFrame;
+
+typedef struct {
+   int scope;
+   unsigned long start;
+   unsigned long duration;
+} PerformanceEvent;
+
+int RoadMapPerformanceEnabled = 0;
+
+static int PerformanceOverlay = 0;
+static int PerformanceInFrame = 0;
+static unsigned long PerformanceOrigin;
+static unsigned long PerformanceStart[PERF_SCOPE_COUNT];
+
+static PerformanceFrame PerformanceFrames[PERF_FRAMES];
+static int PerformanceFrameCurrent = 0;
+static int PerformanceFrameCount = 0;
+
+static PerformanceEvent PerformanceEvents[PERF_EVENTS];
+static int PerformanceEventNext = 0;
+static int PerformanceEventCount = 0;
+
+
+static unsigned long roadmap_performance_now (void) {
+
+#ifdef _WIN32
+   static LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+
+   if (!frequency.QuadPart) QueryPerformanceFrequency (&frequency);
+   if (!frequency.QuadPart) return GetTickCount () * 1000;
+
+   QueryPerformanceCounter (&counter);
+
+   return (unsigned long)
+      ((counter.QuadPart / frequency.QuadPart) * 1000000 +
+       (counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart);
+#else
+   struct timeval now;
+
+   gettimeofday (&now, NULL);
+
+   return (unsigned long)now.tv_sec * 1000000 + now.tv_usec;
+#endif
+}
+
+
+static void roadmap_performance_event (int scope,
+                                       unsigned long start,
+                                       unsigned long duration) {
+
+   PerformanceEvent *event = PerformanceEvents + PerformanceEventNext;
+
+   event->scope = scope;
+   event->start = start - PerformanceOrigin;
+   event->duration = duration;
+
+   PerformanceEventNext = (PerformanceEventNext + 1) % PERF_EVENTS;
+   if (PerformanceEventCount < PERF_EVENTS) PerformanceEventCount++;
+}
+
+
+static void roadmap_performance_update (void) {
+
+   int enabled = PerformanceOverlay ||
+      roadmap_config_match (&RoadMapConfigPerformanceRecord, "yes");
+
+   if (enabled && !RoadMapPerformanceEnabled) {
+      PerformanceOrigin = roadmap_performance_now ();
+      PerformanceFrameCount = 0;
+      PerformanceEventCount = 0;
+      PerformanceEventNext = 0;
+   }
+
+   RoadMapPerformanceEnabled = enabled;
+   PerformanceInFrame = 0;
+}
+
+
+void roadmap_performance_scope_begin (RoadMapPerformanceScope scope) {
+
+   if (!PerformanceInFrame) return;
+
+   PerformanceStart[scope] = roadmap_performance_now ();
+}
+
+
+void roadmap_performance_scope_end (RoadMapPerformanceScope scope) {
+
+   unsigned long duration;
+
+   if (!PerformanceInFrame) return;
+
+   duration = roadmap_performance_now () - PerformanceStart[scope];
+   PerformanceFrames[PerformanceFrameCurrent].time[scope] += duration;
+
+   if (PerformanceScopes[scope].traced) {
+      roadmap_performance_event (scope, PerformanceStart[scope], duration);
+   }
+}
+
+
+void roadmap_performance_frame_begin (void) {
+
+   PerformanceFrame *frame;
+
+   if (!RoadMapPerformanceEnabled) return;
+
+   frame = PerformanceFrames + PerformanceFrameCurrent;
+   memset (frame, 0, sizeof(*frame));
+
+   PerformanceInFrame = 1;
+
+   frame->start = roadmap_performance_now ();
+   PerformanceStart[PERF_FRAME] = frame->start;
+}
+
+
+void roadmap_performance_frame_end (void) {
+
+   if (!PerformanceInFrame) return;
+
+   roadmap_performance_scope_end (PERF_FRAME);
+   PerformanceInFrame = 0;
+
+   PerformanceFrameCurrent = (PerformanceFrameCurrent + 1) % PERF_FRAMES;
+   if (PerformanceFrameCount < PERF_FRAMES) PerformanceFrameCount++;
+}
+
+
+const char *roadmap_performance_name (RoadMapPerformanceScope scope) {
+
+   return PerformanceScopes[scope].name;
+}
+
+
+static int roadmap_performance_compare (const void *a, const void *b) {
+
+   unsigned long x = *(const unsigned long *)a;
+   unsigned long y = *(const unsigned long *)b;
+
+   if (x < y) return -1;
+   return (x > y);
+}
+
+
+int roadmap_performance_stats (RoadMapPerformanceScope scope,
+                               RoadMapPerformanceStats *stats) {
+
+   unsigned long values[PERF_FRAMES];
+   int count = 0;
+   int i;
+
+   for (i = 0; i < PerformanceFrameCount; i++) {
+
+      /* Skip the frame being drawn. */
+      if (PerformanceInFrame && (i == PerformanceFrameCurrent)) continue;
+
+      if (PerformanceFrames[i].time[scope]) {
+         values[count++] = PerformanceFrames[i].time[scope];
+      }
+   }
+
+   stats->count = count;
+
+   if (!count) {
+      stats->p50 = stats->p95 = stats->max = 0;
+      return 0;
+   }
+
+   qsort (values, count, sizeof(values[0]), roadmap_performance_compare);
+
+   stats->p50 = values[count / 2];
+   stats->p95 = values[(count * 95) / 100];
+   stats->max = values[count - 1];
+
+   return count;
+}
+
+
+void roadmap_performance_display (void) {
+
+   static RoadMapPen background = NULL;
+   static RoadMapPen foreground = NULL;
+
+   RoadMapPerformanceStats stats;
+   RoadMapGuiRect rect;
+   RoadMapGuiPoint pos;
+   char text[128];
+   int line_height = ADJ_SCALE(14);
+   int lines = 1;
+   int i;
+
+   if (!PerformanceOverlay) return;
+
+   if (!foreground) {
+      background = roadmap_canvas_create_pen ("Performance.Background");
+      roadmap_canvas_set_foreground ("#000000");
+      roadmap_canvas_set_opacity (160);
+
+      foreground = roadmap_canvas_create_pen ("Performance.Text");
+      roadmap_canvas_set_foreground ("#ffffff");
+   }
+
+   for (i = 0; i < PERF_SCOPE_COUNT; i++) {
+      if (roadmap_performance_stats (i, &stats)) lines++;
+   }
+
+   rect.minx = 0;
+   rect.miny = roadmap_bar_top_height ();
+   rect.maxx = ADJ_SCALE(230);
+   rect.maxy = rect.miny + lines * line_height + ADJ_SCALE(4);
+
+   roadmap_canvas_select_pen (background);
+   roadmap_canvas_erase_area (&rect);
+
+   roadmap_canvas_select_pen (foreground);
+
+   pos.x = ADJ_SCALE(4);
+   pos.y = rect.miny + ADJ_SCALE(2);
+
+   roadmap_canvas_draw_string_size
+      (&pos, ROADMAP_CANVAS_TOPLEFT, 10, "ms      p50    p95    max");
+
+   for (i = 0; i < PERF_SCOPE_COUNT; i++) {
+
+      if (!roadmap_performance_stats (i, &stats)) continue;
+
+      pos.y += line_height;
+      snprintf (text, sizeof(text), "%-15s %6.1f %6.1f %6.1f",
+                PerformanceScopes[i].name,
+                stats.p50 / 1000.0, stats.p95 / 1000.0, stats.max / 1000.0);
+      roadmap_canvas_draw_string_size (&pos, ROADMAP_CANVAS_TOPLEFT, 10, text);
+   }
+}
+
+
+void roadmap_performance_toggle (void) {
+
+   PerformanceOverlay = !PerformanceOverlay;
+   roadmap_performance_update ();
+
+   roadmap_screen_redraw ();
+}
+
+
+/* Chrome trace event format: the coarse scopes as complete events, and the
+ * per frame totals of all the scopes as the arguments of the frame events.
+ */
+int roadmap_performance_dump (const char *path, const char *name) {
+
+   FILE *file;
+   int first = 1;
+   int i;
+   int j;
+
+   file = roadmap_file_fopen (path, name, "w");
+   if (!file) {
+      roadmap_log (ROADMAP_ERROR, "cannot write the frame trace %s", name);
+      return -1;
+   }
+
+   fprintf (file, "{\"traceEvents\":[\n");
+
+   for (i = 0; i < PerformanceEventCount; i++) {
+
+      int index = (PerformanceEventNext - PerformanceEventCount + i + PERF_EVENTS) % PERF_EVENTS;
+      const PerformanceEvent *event = PerformanceEvents + index;
+
+      fprintf (file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                     "\"ts\":%lu,\"dur\":%lu",
+               first ? "" : ",\n",
+               PerformanceScopes[event->scope].name,
+               event->start, event->duration);
+      first = 0;
+
+      if (event->scope == PERF_FRAME) {
+
+         /* Find the totals of this frame, if still in the ring. */
+         for (j = 0; j < PerformanceFrameCount; j++) {
+            const PerformanceFrame *frame = PerformanceFrames + j;
+            int k;
+
+            if (frame->start - PerformanceOrigin != event->start) continue;
+
+            fprintf (file, ",\"args\":{");
+            for (k = 1; k < PERF_SCOPE_COUNT; k++) {
+               fprintf (file, "%s\"%s\":%lu", k > 1 ? "," : "",
+                        PerformanceScopes[k].name, frame->time[k]);
+            }
+            fprintf (file, "}");
+            break;
+         }
+      }
+
+      fprintf (file, "}");
+   }
+
+   fprintf (file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+   fclose (file);
+
+   roadmap_log (ROADMAP_INFO, "frame trace: %d events written to %s",
+                PerformanceEventCount, name);
+
+   return PerformanceEventCount;
+}
+
+
+void roadmap_performance_dump_trace (void) {
+
+   roadmap_performance_dump (roadmap_path_debug (), PERF_TRACE_FILE);
+}
+
+
+void roadmap_performance_initialize (void) {
+
+   roadmap_config_declare_enumeration
+      ("preferences", &RoadMapConfigPerformanceRecord, NULL, "no", "yes", NULL);
+
+   roadmap_performance_update ();
+}
@@ -124,5 +124,75 @@
 #endif
 
 
+/*
+ * Frame profiler
+ *
+ * The drawing code is instrumented with named scopes. Each scope adds its
+ * time to the current frame, and the last frames are kept in a ring buffer
+ * from which the p50/p95/max statistics are computed. The coarse scopes
+ * are also recorded as trace events, which can be written as a Chrome
+ * trace (chrome://tracing, Perfetto). A scope may be ended and begun again
+ * to leave out the time spent in a nested scope. Main thread only.
+ */
+
+typedef enum {
+   PERF_FRAME = 0,
+   PERF_MAP_SETUP,
+   PERF_SQUARE_VIEW,
+   PERF_LAYERS,
+   PERF_DRAW_MAP,
+   PERF_DRAW_SQUARE,
+   PERF_DRAW_ONE_LINE,
+   PERF_ADD_SEGMENT,
+   PERF_FLUSH_LINES,
+   PERF_FLUSH_POINTS,
+   PERF_LABELS,
+   PERF_OVERLAYS,
+   PERF_FLIP,
+   PERF_SELECT_PEN,
+   PERF_DRAW_LINES,
+   PERF_CREATE_PATH,
+   PERF_ADD_PATH,
+   PERF_TEXT_FULL,
+   PERF_TEXT_CNV,
+   PERF_TEXT_ONE_LETTER,
+   PERF_TEXT_GET_GLYPH,
+   PERF_TEXT_ONE_RAS,
+   PERF_SCOPE_COUNT
+} RoadMapPerformanceScope;
+
+typedef struct {
+   int count;             /* frames in which the scope was used */
+   unsigned long p50;     /* usec */
+   unsigned long p95;
+   unsigned long max;
+} RoadMapPerformanceStats;
+
+extern int RoadMapPerformanceEnabled;
+
+void roadmap_performance_initialize (void);
+
+void roadmap_performance_scope_begin (RoadMapPerformanceScope scope);
+void roadmap_performance_scope_end   (RoadMapPerformanceScope scope);
+
+#define roadmap_performance_begin(scope) \
+   do { if (RoadMapPerformanceEnabled) roadmap_performance_scope_begin (scope); } while (0)
+
+#define roadmap_performance_end(scope) \
+   do { if (RoadMapPerformanceEnabled) roadmap_performance_scope_end (scope); } while (0)
+
+void roadmap_performance_frame_begin (void);
+void roadmap_performance_frame_end   (void);
+
+const char *roadmap_performance_name (RoadMapPerformanceScope scope);
+int  roadmap_performance_stats (RoadMapPerformanceScope scope,
+                                RoadMapPerformanceStats *stats);
+
+void roadmap_performance_display (void);
+void roadmap_performance_toggle (void);
+
+int  roadmap_performance_dump (const char *path, const char *name);
+void roadmap_performance_dump_trace (void);
+
 #endif // INCLUDE__ROADMAP_PERFORMANCE__H
 
@@ -0,0 +1,363 @@
+/* roadmap_polygon_tess.c - cached triangulation of the area polygons.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The polygons (parks, water bodies...) are triangulated by ear clipping
+ *   when first drawn, in map coordinates, and the triangles are kept per
+ *   square until the square's tile changes. Drawing a polygon then only
+ *   needs to transform its triangles to the screen.
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_polygon_tess.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_hash.h"
+#include "roadmap_point.h"
+#include "roadmap_polygon.h"
+#include "roadmap_square.h"
+
+#include "roadmap_polygon_tess.h"
+
+
+#define TESS_CACHE_SIZE 64
+
+#define TESS_UNKNOWN   -1
+#define TESS_FAILED    -2
+
+typedef struct {
+   int first;  /* TESS_UNKNOWN: not triangulated yet */
+   int count;
+} TessPolygon;
+
+typedef struct {
+   int square;
+   unsigned int last_access;
+
+   int polygon_count;
+   TessPolygon *polygons;
+
+   int point_count;
+   int point_size;
+   RoadMapPosition *points;
+} TessCache;
+
+static TessCache     TessCacheEntries[TESS_CACHE_SIZE];
+static int           TessCacheCount = 0;
+static unsigned int  TessCacheAccess = 0;
+static RoadMapHash  *TessCacheHash = NULL;
+
+/* Work buffers */
+static int             *TessPointIds = NULL;
+static RoadMapPosition *TessInput = NULL;
+static int             *TessIndex = NULL;
+static int              TessInputSize = 0;
+
+
+static void tess_cache_release (int slot) {
+
+   TessCache *cache = TessCacheEntries + slot;
+
+   roadmap_hash_remove (TessCacheHash, cache->square, slot);
+   cache->square = -1;
+   cache->polygon_count = 0;
+   cache->point_count = 0;
+}
+
+
+static TessCache *tess_cache_find (int square) {
+
+   int slot;
+
+   if (!TessCacheHash) return NULL;
+
+   for (slot = roadmap_hash_get_first (TessCacheHash, square);
+        slot >= 0;
+        slot = roadmap_hash_get_next (TessCacheHash, slot)) {
+
+      TessCache *cache = TessCacheEntries + slot;
+      if (cache->square == square) {
+         cache->last_access = ++TessCacheAccess;
+         return cache;
+      }
+   }
+
+   return NULL;
+}
+
+
+static TessCache *tess_cache_allocate (int square) {
+
+   int slot;
+   int i;
+   TessCache *cache;
+   int polygon_count = roadmap_polygon_count ();
+
+   if (!TessCacheHash) {
+      TessCacheHash = roadmap_hash_new ("PolygonTess", TESS_CACHE_SIZE);
+   }
+
+   if (TessCacheCount < TESS_CACHE_SIZE) {
+      slot = TessCacheCount++;
+   } else {
+
+      /* Replace the least recently drawn entry, or a cleared one */
+      slot = 0;
+      for (i = 0; i < TESS_CACHE_SIZE; i++) {
+         if (TessCacheEntries[i].square == -1) {
+            slot = i;
+            break;
+         }
+         if (TessCacheEntries[i].last_access < TessCacheEntries[slot].last_access) {
+            slot = i;
+         }
+      }
+      if (TessCacheEntries[slot].square != -1) {
+         tess_cache_release (slot);
+      }
+   }
+
+   cache = TessCacheEntries + slot;
+   cache->square = square;
+   cache->last_access = ++TessCacheAccess;
+   cache->point_count = 0;
+
+   cache->polygons = realloc (cache->polygons, polygon_count * sizeof (TessPolygon));
+   roadmap_check_allocated (cache->polygons);
+   cache->polygon_count = polygon_count;
+   for (i = 0; i < polygon_count; i++) {
+      cache->polygons[i].first = TESS_UNKNOWN;
+   }
+
+   roadmap_hash_add (TessCacheHash, square, slot);
+
+   return cache;
+}
+
+
+static void tess_reserve (int count) {
+
+   if (count <= TessInputSize) return;
+
+   TessInputSize = count + 64;
+
+   TessPointIds = realloc (TessPointIds, TessInputSize * sizeof (int));
+   roadmap_check_allocated (TessPointIds);
+   TessInput = realloc (TessInput, TessInputSize * sizeof (RoadMapPosition));
+   roadmap_check_allocated (TessInput);
+   TessIndex = realloc (TessIndex, TessInputSize * sizeof (int));
+   roadmap_check_allocated (TessIndex);
+}
+
+
+static double tess_cross (const RoadMapPosition *a,
+                          const RoadMapPosition *b,
+                          const RoadMapPosition *c) {
+
+   return (double)(b->longitude - a->longitude) * (c->latitude - a->latitude) -
+          (double)(b->latitude - a->latitude) * (c->longitude - a->longitude);
+}
+
+
+static int tess_same (const RoadMapPosition *a, const RoadMapPosition *b) {
+
+   return (a->longitude == b->longitude) && (a->latitude == b->latitude);
+}
+
+
+static int tess_is_ear (int n, int u, int v, int w) {
+
+   const RoadMapPosition *a = TessInput + TessIndex[u];
+   const RoadMapPosition *b = TessInput + TessIndex[v];
+   const RoadMapPosition *c = TessInput + TessIndex[w];
+   int i;
+
+   if (tess_cross (a, b, c) <= 0) return 0; /* reflex */
+
+   for (i = 0; i < n; i++) {
+
+      const RoadMapPosition *p;
+
+      if ((i == u) || (i == v) || (i == w)) continue;
+
+      p = TessInput + TessIndex[i];
+      if (tess_same (p, a) || tess_same (p, b) || tess_same (p, c)) continue;
+
+      if ((tess_cross (a, b, p) >= 0) &&
+          (tess_cross (b, c, p) >= 0) &&
+          (tess_cross (c, a, p) >= 0)) {
+         return 0;
+      }
+   }
+
+   return 1;
+}
+
+
+static void tess_reserve_points (TessCache *cache, int count) {
+
+   if (cache->point_count + count > cache->point_size) {
+      while (cache->point_count + count > cache->point_size) {
+         cache->point_size = cache->point_size ? cache->point_size * 2 : 1024;
+      }
+      cache->points = realloc (cache->points, cache->point_size * sizeof (RoadMapPosition));
+      roadmap_check_allocated (cache->points);
+   }
+}
+
+
+/* Ear clipping over TessInput[0..count-1]. Returns 0 on failure. */
+static int tess_triangulate (TessCache *cache, TessPolygon *polygon, int count) {
+
+   double area = 0;
+   int n = 0;
+   int guard;
+   int i;
+   int v;
+
+   /* Drop the repeated points, including the closing one. */
+   for (i = 0; i < count; i++) {
+      if (n > 0 && tess_same (TessInput + i, TessInput + n - 1)) continue;
+      TessInput[n++] = TessInput[i];
+   }
+   while (n > 1 && tess_same (TessInput, TessInput + n - 1)) n--;
+
+   if (n < 3) return 0;
+
+   for (i = 1; i < n - 1; i++) {
+      area += tess_cross (TessInput, TessInput + i, TessInput + i + 1);
+   }
+
+   /* Walk counter-clockwise. */
+   for (i = 0; i < n; i++) {
+      TessIndex[i] = (area > 0) ? i : n - 1 - i;
+   }
+
+   tess_reserve_points (cache, 3 * (n - 2));
+   polygon->first = cache->point_count;
+
+   guard = 2 * n;
+
+   for (v = n - 1; n > 2; ) {
+
+      int u;
+      int w;
+
+      /* Looping without finding an ear: not a simple polygon. */
+      if (guard-- <= 0) {
+         cache->point_count = polygon->first;
+         return 0;
+      }
+
+      u = v;     if (u >= n) u = 0;
+      v = u + 1; if (v >= n) v = 0;
+      w = v + 1; if (w >= n) w = 0;
+
+      if (tess_cross (TessInput + TessIndex[u],
+                      TessInput + TessIndex[v],
+                      TessInput + TessIndex[w]) == 0) {
+
+         /* Flat corner: nothing to draw. */
+
+      } else if (tess_is_ear (n, u, v, w)) {
+
+         cache->points[cache->point_count++] = TessInput[TessIndex[u]];
+         cache->points[cache->point_count++] = TessInput[TessIndex[v]];
+         cache->points[cache->point_count++] = TessInput[TessIndex[w]];
+
+      } else {
+         continue;
+      }
+
+      memmove (TessIndex + v, TessIndex + v + 1, (n - v - 1) * sizeof (int));
+      n--;
+      guard = 2 * n;
+   }
+
+   polygon->count = cache->point_count - polygon->first;
+
+   return polygon->count;
+}
+
+
+static void tess_polygon (TessCache *cache, int polygon) {
+
+   TessPolygon *tess = cache->polygons + polygon;
+   int count;
+   int i;
+
+   if (TessInputSize < 256) tess_reserve (256);
+
+   while ((count = roadmap_polygon_points (polygon, TessPointIds, TessInputSize)) < 0) {
+      tess_reserve (2 * TessInputSize);
+   }
+
+   for (i = 0; i < count; i++) {
+      roadmap_point_position (TessPointIds[i], TessInput + i);
+   }
+
+   if (!tess_triangulate (cache, tess, count)) {
+      tess->first = TESS_FAILED;
+      tess->count = 0;
+   }
+}
+
+
+int roadmap_polygon_tess_get (int polygon, const RoadMapPosition **triangles) {
+
+   int square = roadmap_square_active ();
+   TessCache *cache;
+   TessPolygon *tess;
+
+   cache = tess_cache_find (square);
+   if (!cache) cache = tess_cache_allocate (square);
+
+   if (polygon < 0 || polygon >= cache->polygon_count) return 0;
+
+   tess = cache->polygons + polygon;
+   if (tess->first == TESS_UNKNOWN) {
+      tess_polygon (cache, polygon);
+   }
+
+   if (tess->first < 0) return 0;
+
+   *triangles = cache->points + tess->first;
+   return tess->count;
+}
+
+
+void roadmap_polygon_tess_clear (int square) {
+
+   int slot;
+
+   for (slot = 0; slot < TessCacheCount; slot++) {
+      if (TessCacheEntries[slot].square != -1 &&
+          (square == -1 || TessCacheEntries[slot].square == square)) {
+         tess_cache_release (slot);
+      }
+   }
+}
@@ -0,0 +1,37 @@
+/* roadmap_polygon_tess.h - cached triangulation of the area polygons.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ROADMAP_POLYGON_TESS__H_
+#define _ROADMAP_POLYGON_TESS__H_
+
+#include "roadmap_types.h"
+
+/* Get the triangles of a polygon of the active square, in map coordinates
+ * and three positions per triangle. Returns the number of positions, or 0
+ * if the polygon cannot be triangulated (e.g. it crosses itself).
+ */
+int  roadmap_polygon_tess_get (int polygon, const RoadMapPosition **triangles);
+
+void roadmap_polygon_tess_clear (int square); /* -1 for all squares */
+
+#endif // _ROADMAP_POLYGON_TESS__H_
@@ -86,6 +86,9 @@
 #include "roadmap_message_ticker.h"
 #include "roadmap_warning.h"
 #include "roadmap_time.h"
+#include "roadmap_hash.h"
+#include "roadmap_shape_simplify.h"
+#include "roadmap_polygon_tess.h"
 #include "animation/roadmap_animation.h"
 
 //#define HI_RES_SCREEN
@@ -309,6 +312,15 @@ static RoadMapGuiPoint *RoadMapScreenLinePointsAccum = RoadMapScreenLinePoints.d
 static struct roadmap_screen_point_buffer RoadMapScreenPoints;
 
 static int RoadMapPolygonGeoPoints[ROADMAP_SCREEN_BULK];
+static RoadMapPosition RoadMapPolygonPositions[ROADMAP_SCREEN_BULK];
+static RoadMapGuiPoint RoadMapShapePoints[ROADMAP_SCREEN_BULK];
+
+/* Polygons are filled from their cached triangles when the canvas can draw
+ * triangles (-1: not checked yet).
+ */
+static int RoadMapScreenTriangles = -1;
+static RoadMapGuiPoint *RoadMapScreenTrianglePoints = NULL;
+static int RoadMapScreenTriangleSize = 0;
 
 
 static RoadMapPen RoadMapBackground = NULL;
@@ -358,7 +370,7 @@ INLINE_DEC void roadmap_screen_flush_points (void) {
 
    if (RoadMapScreenPoints.cursor == RoadMapScreenPoints.data) return;
 
-   dbg_time_start(DBG_TIME_FLUSH_POINTS);
+   roadmap_performance_begin(PERF_FLUSH_POINTS);
    roadmap_math_rotate_coordinates
        (RoadMapScreenPoints.cursor - RoadMapScreenPoints.data,
         RoadMapScreenPoints.data);
@@ -369,7 +381,7 @@ INLINE_DEC void roadmap_screen_flush_points (void) {
 
    RoadMapScreenPoints.cursor  = RoadMapScreenPoints.data;
 
-   dbg_time_end(DBG_TIME_FLUSH_POINTS);
+   roadmap_performance_end(PERF_FLUSH_POINTS);
 }
 
 
@@ -377,13 +389,13 @@ INLINE_DEC void roadmap_screen_flush_lines (void) {
 
    if (RoadMapScreenObjects.cursor == RoadMapScreenObjects.data) return;
 
-   dbg_time_start(DBG_TIME_FLUSH_LINES);
+   roadmap_performance_begin(PERF_FLUSH_LINES);
 
    roadmap_math_rotate_coordinates
        (RoadMapScreenLinePoints.cursor - RoadMapScreenLinePoints.data,
         RoadMapScreenLinePoints.data);
 
-   dbg_time_end(DBG_TIME_FLUSH_LINES);
+   roadmap_performance_end(PERF_FLUSH_LINES);
    if (RoadMapScreenLastPattern.image == NULL)
 #ifdef BEZIER_LINES
       roadmap_canvas_draw_multiple_lines_smooth
@@ -407,7 +419,7 @@ INLINE_DEC void roadmap_screen_flush_lines (void) {
           RoadMapScreenLastPattern.y_offset);
 #endif //OPENGL
 
-   dbg_time_start(DBG_TIME_FLUSH_LINES);
+   roadmap_performance_begin(PERF_FLUSH_LINES);
    if (RoadMapScreenLinePoints.cursor < RoadMapScreenLinePointsAccum) {
       int count = RoadMapScreenLinePointsAccum - RoadMapScreenLinePoints.cursor;
       memmove(RoadMapScreenLinePoints.data, RoadMapScreenLinePointsAccum,
@@ -419,7 +431,7 @@ INLINE_DEC void roadmap_screen_flush_lines (void) {
    }
    RoadMapScreenObjects.cursor = RoadMapScreenObjects.data;
    RoadMapScreenLinePoints.cursor  = RoadMapScreenLinePoints.data;
-   dbg_time_end(DBG_TIME_FLUSH_LINES);
+   roadmap_performance_end(PERF_FLUSH_LINES);
 }
 
 
@@ -437,7 +449,7 @@ INLINE_DEC int roadmap_screen_add_segment_point (RoadMapGuiPoint *point,
    int layer_proj = 0;
    RoadMapPen pen;
 
-   dbg_time_start(DBG_TIME_ADD_SEGMENT);
+   roadmap_performance_begin(PERF_ADD_SEGMENT);
 
    num_pens--;
 
@@ -471,7 +483,7 @@ INLINE_DEC int roadmap_screen_add_segment_point (RoadMapGuiPoint *point,
          /* This is a speical handling of a point */
 
          if (!pen) {
-            dbg_time_end(DBG_TIME_ADD_SEGMENT);
+            roadmap_performance_end(PERF_ADD_SEGMENT);
             return -1;
          }
 
@@ -510,10 +522,10 @@ INLINE_DEC int roadmap_screen_add_segment_point (RoadMapGuiPoint *point,
 
 
       if (RoadMapScreenLastPen != pen) {
-         dbg_time_end(DBG_TIME_ADD_SEGMENT);
+         roadmap_performance_end(PERF_ADD_SEGMENT);
          roadmap_screen_flush_lines ();
          roadmap_screen_flush_points ();
-         dbg_time_start(DBG_TIME_ADD_SEGMENT);
+         roadmap_performance_begin(PERF_ADD_SEGMENT);
          if (pen) roadmap_canvas_select_pen (pen);
          RoadMapScreenLastPen = pen;
          RoadMapScreenLastPattern.image = pattern->image;
@@ -533,7 +545,7 @@ INLINE_DEC int roadmap_screen_add_segment_point (RoadMapGuiPoint *point,
       }
    }
 
-   dbg_time_end(DBG_TIME_ADD_SEGMENT);
+   roadmap_performance_end(PERF_ADD_SEGMENT);
 
    if (!pen) return -1;
    else return layer_proj;
@@ -577,7 +589,7 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
    int drawn = 0;
    int opposite_flag = 0;
 
-   dbg_time_start(DBG_TIME_DRAW_ONE_LINE);
+   roadmap_performance_begin(PERF_DRAW_ONE_LINE);
 
    if (total_length_ptr) *total_length_ptr = 0;
 
@@ -608,9 +620,9 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
                - 4;
          }
 
-         dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_end(PERF_DRAW_ONE_LINE);
          roadmap_screen_flush_lines ();
-         dbg_time_start(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_begin(PERF_DRAW_ONE_LINE);
       }
 
       /* All the shape positions are relative: we need an absolute position
@@ -624,21 +636,33 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
 #endif
 
       if (fully_visible) {
-         roadmap_math_coordinate (from, &point0);
-         roadmap_screen_add_segment_point (&point0, pens, num_pens,
-                                           pattern, opposite_flag | SEGMENT_START);
+         /* Convert all the points of the line at once (the rotation is
+          * done when the lines are flushed).
+          */
+         int count = 0;
+
+         RoadMapPolygonPositions[count++] = *from;
 
          for (i = first_shape; i <= last_shape; ++i) {
 
             if (shape_itr) (*shape_itr) (i, &midposition);
             else roadmap_shape_get_position (i, &midposition);
 
-            roadmap_math_coordinate (&midposition, &point0);
-            roadmap_screen_add_segment_point (&point0, pens, num_pens, pattern, opposite_flag);
+            RoadMapPolygonPositions[count++] = midposition;
          }
 
-         roadmap_math_coordinate (to, &point0);
-         roadmap_screen_add_segment_point (&point0, pens, num_pens,
+         RoadMapPolygonPositions[count++] = *to;
+
+         roadmap_math_coordinates (count, RoadMapPolygonPositions, RoadMapShapePoints);
+
+         roadmap_screen_add_segment_point (RoadMapShapePoints, pens, num_pens,
+                                           pattern, opposite_flag | SEGMENT_START);
+
+         for (i = 1; i < count - 1; ++i) {
+            roadmap_screen_add_segment_point (RoadMapShapePoints + i, pens, num_pens, pattern, opposite_flag);
+         }
+
+         roadmap_screen_add_segment_point (RoadMapShapePoints + count - 1, pens, num_pens,
                                            pattern, opposite_flag | SEGMENT_END);
          drawn = 1;
 
@@ -838,9 +862,9 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
                   drawn = 1;
                   if (last_shape - i + 3 >=
                         RoadMapScreenLinePoints.end - RoadMapScreenLinePoints.cursor) {
-                     dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+                     roadmap_performance_end(PERF_DRAW_ONE_LINE);
                      roadmap_screen_flush_lines ();
-                     dbg_time_start(DBG_TIME_DRAW_ONE_LINE);
+                     roadmap_performance_begin(PERF_DRAW_ONE_LINE);
                   }
                }
             }
@@ -899,7 +923,7 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
       /* Optimization: do not draw a line that is obviously not visible. */
       if (! fully_visible) {
          if (! roadmap_math_line_is_visible (from, to)) {
-            dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+            roadmap_performance_end(PERF_DRAW_ONE_LINE);
             return 0;
          }
       }
@@ -907,6 +931,7 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
       /* Optimization: adjust the edges of the line so
        * they do not go out of the screen. */
       if (!roadmap_math_get_visible_coordinates (from, to, &point0, &point1)) {
+         roadmap_performance_end(PERF_DRAW_ONE_LINE);
          return 0;
       }
 
@@ -916,7 +941,7 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
          roadmap_screen_add_segment_point (&point0, pens, num_pens,
                                            pattern, opposite_flag | SEGMENT_AS_POINT);
 
-         dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_end(PERF_DRAW_ONE_LINE);
          return 1;
 
       } else {
@@ -935,9 +960,9 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
       }
 
       if (RoadMapScreenLinePoints.cursor + 2 >= RoadMapScreenLinePoints.end) {
-         dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_end(PERF_DRAW_ONE_LINE);
          roadmap_screen_flush_lines ();
-         dbg_time_start(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_begin(PERF_DRAW_ONE_LINE);
       }
 
       roadmap_screen_add_segment_point (&point0, pens, num_pens, pattern, opposite_flag | SEGMENT_START);
@@ -946,7 +971,7 @@ INLINE_DEC int  roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
       drawn = 1;
    }
 
-   dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+   roadmap_performance_end(PERF_DRAW_ONE_LINE);
 
    return drawn;
 }
@@ -981,7 +1006,7 @@ INLINE_DEC int roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
 
    int drawn = 0;
 
-   dbg_time_start(DBG_TIME_DRAW_ONE_LINE);
+   roadmap_performance_begin(PERF_DRAW_ONE_LINE);
 
    if (total_length_ptr) *total_length_ptr = 0;
 
@@ -1006,9 +1031,9 @@ INLINE_DEC int roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
                - 3;
          }
 
-         dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_end(PERF_DRAW_ONE_LINE);
          roadmap_screen_flush_lines ();
-         dbg_time_start(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_begin(PERF_DRAW_ONE_LINE);
       }
 
       /* All the shape positions are relative: we need an absolute position
@@ -1080,7 +1105,7 @@ INLINE_DEC int roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
       /* Optimization: do not draw a line that is obviously not visible. */
       if (! fully_visible) {
          if (! roadmap_math_line_is_visible (from, to)) {
-            dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+            roadmap_performance_end(PERF_DRAW_ONE_LINE);
             return 0;
          }
       }
@@ -1094,7 +1119,7 @@ INLINE_DEC int roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
          roadmap_screen_add_segment_point (&point0, pens, num_pens,
                                            SEGMENT_AS_POINT);
 
-         dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_end(PERF_DRAW_ONE_LINE);
          return 1;
 
       } else {
@@ -1113,9 +1138,9 @@ INLINE_DEC int roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
       }
 
       if (RoadMapScreenLinePoints.cursor + 2 >= RoadMapScreenLinePoints.end) {
-         dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_end(PERF_DRAW_ONE_LINE);
          roadmap_screen_flush_lines ();
-         dbg_time_start(DBG_TIME_DRAW_ONE_LINE);
+         roadmap_performance_begin(PERF_DRAW_ONE_LINE);
       }
 
       roadmap_screen_add_segment_point (&point0, pens, num_pens, SEGMENT_START);
@@ -1124,7 +1149,7 @@ INLINE_DEC int roadmap_screen_draw_one_line_internal (RoadMapPosition *from,
       drawn = 1;
    }
 
-   dbg_time_end(DBG_TIME_DRAW_ONE_LINE);
+   roadmap_performance_end(PERF_DRAW_ONE_LINE);
    return drawn;
 }
 
@@ -1186,7 +1211,7 @@ int roadmap_screen_draw_one_tex_line (RoadMapPosition *from,
 }
 
 
-static void roadmap_screen_flush_polygons (RoadMapPen outline) {
+static void roadmap_screen_flush_polygons (RoadMapPen outline, int triangles) {
 
    int count = RoadMapScreenObjects.cursor - RoadMapScreenObjects.data;
 
@@ -1219,9 +1244,23 @@ static void roadmap_screen_flush_polygons (RoadMapPen outline) {
        (RoadMapScreenLinePoints.cursor - RoadMapScreenLinePoints.data,
         RoadMapScreenLinePoints.data);
 
-   roadmap_canvas_draw_multiple_polygons
-      (count, RoadMapScreenObjects.data, RoadMapScreenLinePoints.data, 1,
-       FAST_REFRESH);
+   if (triangles > 0) {
+
+      /* Only the edges, the fill comes from the triangles. */
+      if (!FAST_REFRESH) {
+         roadmap_canvas_draw_multiple_polygons
+            (count, RoadMapScreenObjects.data, RoadMapScreenLinePoints.data, 0,
+             FAST_REFRESH);
+      }
+      roadmap_canvas_draw_triangles
+         (triangles / 3, RoadMapScreenTrianglePoints, FAST_REFRESH);
+
+   } else {
+
+      roadmap_canvas_draw_multiple_polygons
+         (count, RoadMapScreenObjects.data, RoadMapScreenLinePoints.data, 1,
+          FAST_REFRESH);
+   }
 
    if (outline) {
       int i;
@@ -1294,6 +1333,9 @@ static void roadmap_screen_draw_polygons (void) {
 
    if (! roadmap_is_visible (ROADMAP_SHOW_AREA)) return;
 
+   if (RoadMapScreenTriangles < 0) {
+      RoadMapScreenTriangles = roadmap_canvas_draw_triangles (0, NULL, 0);
+   }
 
    for (i = roadmap_polygon_count() - 1; i >= 0; --i) {
 
@@ -1303,7 +1345,7 @@ static void roadmap_screen_draw_polygons (void) {
       if (pen == NULL) continue;
 
       if (RoadMapScreenLastPen != pen) {
-         roadmap_screen_flush_polygons (NULL);
+         roadmap_screen_flush_polygons (NULL, 0);
          roadmap_canvas_select_pen (pen);
          RoadMapScreenLastPen = pen;
       }
@@ -1336,7 +1378,7 @@ static void roadmap_screen_draw_polygons (void) {
 
       if (size <= 0) {
 
-         roadmap_screen_flush_polygons (NULL);
+         roadmap_screen_flush_polygons (NULL, 0);
 
          size = roadmap_polygon_points
                    (i,
@@ -1345,24 +1387,32 @@ static void roadmap_screen_draw_polygons (void) {
                        - RoadMapScreenLinePoints.cursor - 1);
       }
 
+      for (j = 0; j < size; ++j) {
+         roadmap_point_position
+            (RoadMapPolygonGeoPoints[j], RoadMapPolygonPositions + j);
+      }
+      roadmap_math_coordinates
+         (size, RoadMapPolygonPositions, RoadMapScreenLinePoints.cursor);
+
+      /* Drop consecutive duplicates, compacting the points in place. */
       geo_point = RoadMapPolygonGeoPoints;
       graphic_point = RoadMapScreenLinePoints.cursor;
       previous_point = &null_point;
 
-      for (j = size; j > 0; --j) {
+      for (j = 0; j < size; ++j) {
+
+         RoadMapGuiPoint *point = RoadMapScreenLinePoints.cursor + j;
 
-         roadmap_point_position  (*geo_point, &position);
-         roadmap_math_coordinate (&position, graphic_point);
-         RoadMapScreenLinePoints.real
-            [graphic_point - RoadMapScreenLinePoints.data] = !(POINT_FAKE_FLAG & *geo_point);
+         if ((point->x != previous_point->x) ||
+             (point->y != previous_point->y)) {
 
-         if ((graphic_point->x != previous_point->x) ||
-             (graphic_point->y != previous_point->y)) {
+            *graphic_point = *point;
+            RoadMapScreenLinePoints.real
+               [graphic_point - RoadMapScreenLinePoints.data] = !(POINT_FAKE_FLAG & geo_point[j]);
 
             previous_point = graphic_point;
             graphic_point += 1;
          }
-         geo_point += 1;
       }
 
       /* Do not show polygons that have been reduced to a single
@@ -1371,6 +1421,7 @@ static void roadmap_screen_draw_polygons (void) {
       if (graphic_point != RoadMapScreenLinePoints.cursor) {
 
          RoadMapGuiPoint center;
+         int triangles = 0;
 
          RoadMapScreenLinePoints.real[graphic_point - RoadMapScreenLinePoints.data] = RoadMapScreenLinePoints.real[RoadMapScreenLinePoints.cursor - RoadMapScreenLinePoints.data];
 
@@ -1381,7 +1432,28 @@ static void roadmap_screen_draw_polygons (void) {
 
          RoadMapScreenLinePoints.cursor = graphic_point;
 
-         roadmap_screen_flush_polygons (roadmap_layer_get_pen (category, 1, 0));
+         if (RoadMapScreenTriangles) {
+
+            const RoadMapPosition *positions;
+
+            triangles = roadmap_polygon_tess_get (i, &positions);
+
+            if (triangles > RoadMapScreenTriangleSize) {
+               RoadMapScreenTriangleSize = triangles + 1024;
+               RoadMapScreenTrianglePoints =
+                  realloc (RoadMapScreenTrianglePoints,
+                           RoadMapScreenTriangleSize * sizeof(RoadMapGuiPoint));
+               roadmap_check_allocated (RoadMapScreenTrianglePoints);
+            }
+
+            if (triangles > 0) {
+               roadmap_math_project_coordinates
+                  (triangles, positions, RoadMapScreenTrianglePoints);
+            }
+         }
+
+         roadmap_screen_flush_polygons
+            (roadmap_layer_get_pen (category, 1, 0), triangles);
 
          if (!FAST_REFRESH) {
             int size;
@@ -1402,7 +1474,7 @@ static void roadmap_screen_draw_polygons (void) {
       }
    }
 
-   roadmap_screen_flush_polygons (NULL);
+   roadmap_screen_flush_polygons (NULL, 0);
 }
 
 
@@ -1448,119 +1520,530 @@ static void roadmap_screen_draw_square_edges (int square) {
    RoadMapScreenLastPen = NULL;
 }
 
-#if 0
-struct square_cache_line {
+/* Per square cache of the projected lines.
+ *
+ * The lines of a fully visible square are projected once for the current
+ * zoom and kept in screen space (before rotation). The cached points hold
+ * the exact quotient and remainder of the projection, so a pure pan is
+ * applied as an integer translation that gives the same pixels as
+ * roadmap_math_coordinate(). The rotation and the 3D projection are done
+ * when the lines are flushed, so they do not invalidate the cache. A zoom
+ * change rebuilds the cache, and a tile change clears it through
+ * roadmap_screen_cache_clear().
+ */
+#if !defined(J2ME) && !defined(OPENGL)
+#define SCREEN_SQUARE_CACHE
+#endif
+
+#ifdef SCREEN_SQUARE_CACHE
+
+#define SQUARE_CACHE_SIZE   512
+
+typedef struct {
+   int first_point;
+   int point_count;  /* 0: not cached, draw from the map data */
+   int angle;        /* label angle, lines with no shape only */
+   int shaped;
+} SquareCacheLine;
+
+typedef struct {
+   int x;
+   int y;
+   int rem_x;
+   int rem_y;
+} SquareCachePoint;
+
+typedef struct {
+   int square;
    int cfcc;
-   RoadMapPosition from;
-   RoadMapPosition to;
-   int first_shape;
-   int last_shape;
-   int contained;
-};
+   unsigned int last_access;
+
+   zoom_t zoom_x;
+   zoom_t zoom_y;
+   int west;
+   int north;
+
+   int first_line;
+   int line_count;
+   int line_size;
+   SquareCacheLine *lines;
+
+   int point_count;
+   int point_size;
+   SquareCachePoint *points;
+} SquareCache;
+
+static SquareCache   SquareCacheEntries[SQUARE_CACHE_SIZE];
+static int           SquareCacheCount = 0;
+static unsigned int  SquareCacheAccess = 0;
+static RoadMapHash  *SquareCacheHash = NULL;
+
+/* The translation of the current view relative to the cached one */
+static int SquareCacheDx;
+static int SquareCacheDxRem;
+static int SquareCacheDy;
+static int SquareCacheDyRem;
+static zoom_t SquareCacheZoomX;
+static zoom_t SquareCacheZoomY;
+
+
+static int square_cache_key (int square, int cfcc) {
+
+   return (square ^ (cfcc << 24)) & 0x7fffffff;
+}
 
-struct square_cache {
-   int count;
-   struct square_cache_line lines[1];
-};
 
-static struct square_cache *SquareCache[9000];
+static void square_cache_floor_div (int n, int d, int *q, int *r) {
 
-static struct square_cache *roadmap_screen_cache_square
-              (int square, int *layers, int layer_count) {
+   *q = n / d;
+   *r = n % d;
+   if (*r < 0) {
+      *r += d;
+      (*q)--;
+   }
+}
+
+
+static void square_cache_release (int slot) {
+
+   SquareCache *cache = SquareCacheEntries + slot;
+
+   roadmap_hash_remove (SquareCacheHash,
+                        square_cache_key (cache->square, cache->cfcc), slot);
+   cache->square = -1;
+   cache->zoom_x = 0;
+}
+
+
+static SquareCache *square_cache_find (int square, int cfcc) {
+
+   int slot;
+
+   if (!SquareCacheHash) return NULL;
+
+   for (slot = roadmap_hash_get_first (SquareCacheHash, square_cache_key (square, cfcc));
+        slot >= 0;
+        slot = roadmap_hash_get_next (SquareCacheHash, slot)) {
+
+      SquareCache *cache = SquareCacheEntries + slot;
+      if (cache->square == square && cache->cfcc == cfcc) {
+         cache->last_access = ++SquareCacheAccess;
+         return cache;
+      }
+   }
+
+   return NULL;
+}
+
+
+static SquareCache *square_cache_allocate (int square, int cfcc) {
+
+   int slot;
+   SquareCache *cache;
+
+   if (!SquareCacheHash) {
+      SquareCacheHash = roadmap_hash_new ("SquareCache", SQUARE_CACHE_SIZE);
+   }
+
+   if (SquareCacheCount < SQUARE_CACHE_SIZE) {
+      slot = SquareCacheCount++;
+   } else {
+      int i;
+
+      /* Replace the least recently drawn entry, or a cleared one */
+      slot = 0;
+      for (i = 0; i < SQUARE_CACHE_SIZE; i++) {
+         if (SquareCacheEntries[i].square == -1) {
+            slot = i;
+            break;
+         }
+         if (SquareCacheEntries[i].last_access < SquareCacheEntries[slot].last_access) {
+            slot = i;
+         }
+      }
+      if (SquareCacheEntries[slot].square != -1) {
+         square_cache_release (slot);
+      }
+   }
+
+   cache = SquareCacheEntries + slot;
+   cache->square = square;
+   cache->cfcc = cfcc;
+   cache->zoom_x = 0;
+   cache->last_access = ++SquareCacheAccess;
+   roadmap_hash_add (SquareCacheHash, square_cache_key (square, cfcc), slot);
+
+   return cache;
+}
+
+
+static int square_cache_add_point (SquareCache *cache, const RoadMapPosition *position) {
+
+   SquareCachePoint *point;
+
+   if (cache->point_count == cache->point_size) {
+      cache->point_size = cache->point_size ? cache->point_size * 2 : 256;
+      cache->points = realloc (cache->points, cache->point_size * sizeof (SquareCachePoint));
+      roadmap_check_allocated (cache->points);
+   }
+
+   point = cache->points + cache->point_count++;
+   square_cache_floor_div (position->longitude - cache->west, cache->zoom_x,
+                           &point->x, &point->rem_x);
+   square_cache_floor_div (cache->north - position->latitude, cache->zoom_y,
+                           &point->y, &point->rem_y);
+
+   return cache->point_count - 1;
+}
+
+
+static int square_cache_contains (const RoadMapArea *edges, const RoadMapPosition *position) {
+
+   return position->longitude >= edges->west &&
+          position->longitude <= edges->east &&
+          position->latitude  >= edges->south &&
+          position->latitude  <= edges->north;
+}
+
+
+static void square_cache_build (SquareCache *cache, int square, int cfcc) {
 
    int line;
    int first_line;
    int last_line;
-   int first_shape;
-   int last_shape;
-   int fips = roadmap_locator_active ();
+   int first_shape = -1;
+   int last_shape = -1;
+   int has_shapes;
+   int max_points = ROADMAP_SCREEN_BULK - 4;
+   RoadMapArea edges;
 
-   int i;
+   cache->zoom_x = RoadMapContext.zoom_x;
+   cache->zoom_y = RoadMapContext.zoom_y;
+   cache->west = RoadMapContext.upright_screen.west;
+   cache->north = RoadMapContext.upright_screen.north;
+   cache->line_count = 0;
+   cache->point_count = 0;
+   cache->first_line = 0;
 
-   struct square_cache *cache = NULL;
-   RoadMapArea square_edges;
+   if (roadmap_line_in_square (square, cfcc, &first_line, &last_line) <= 0) {
+      return;
+   }
+
+   roadmap_square_edges (square, &edges);
+   has_shapes = roadmap_square_has_shapes (square);
+
+   cache->first_line = first_line;
+   cache->line_count = last_line - first_line + 1;
+   if (cache->line_count > cache->line_size) {
+      cache->line_size = cache->line_count;
+      cache->lines = realloc (cache->lines, cache->line_size * sizeof (SquareCacheLine));
+      roadmap_check_allocated (cache->lines);
+   }
 
-   roadmap_square_edges (square, &square_edges);
+   for (line = first_line; line <= last_line; ++line) {
 
-   roadmap_square_set_current (square);
+      SquareCacheLine *entry = cache->lines + (line - first_line);
+      RoadMapPosition from;
+      RoadMapPosition to;
+      RoadMapPosition position;
+      RoadMapShapeItr shape_itr = NULL;
+      int contained;
+      int i;
 
-   for (i = 0; i < layer_count; ++i) {
+      if (has_shapes) {
+         roadmap_line_shapes (line, &first_shape, &last_shape);
+      }
 
-      int cfcc = layers[i];
+      roadmap_line_from (line, &from);
+      roadmap_line_to (line, &to);
 
-      if ((cfcc < ROADMAP_ROAD_FIRST) || (cfcc > ROADMAP_ROAD_LAST)) {
-         continue;
+      /* Cache the shape as drawn: simplified when zoomed out */
+      if (first_shape >= 0) {
+         roadmap_shape_simplify_line
+            (line, &from, &to, &first_shape, &last_shape, &shape_itr);
       }
 
-      if (roadmap_line_in_square (square, cfcc, &first_line, &last_line) > 0) {
-         int has_shapes;
+      entry->first_point = cache->point_count;
+      entry->point_count = 0;
+      entry->shaped = (first_shape >= 0);
+      entry->angle = 0;
 
-         if (!cache) {
-            cache = malloc(sizeof(*cache) + sizeof(struct square_cache_line) * 2000);
-            cache->count = 0;
-         }
+      /* Lines leaving the square are clipped on screen: keep them uncached */
+      contained = square_cache_contains (&edges, &from) &&
+                  square_cache_contains (&edges, &to);
 
-         if (roadmap_square_has_shapes (square)) {
-            has_shapes = 1;
+      if (contained && entry->shaped) {
+         if (last_shape - first_shape + 3 >= max_points) {
+            contained = 0;
          } else {
-            has_shapes = 0;
-            first_shape = last_shape = -1;
+            position = from;
+            for (i = first_shape; i <= last_shape; ++i) {
+               if (shape_itr) (*shape_itr) (i, &position);
+               else roadmap_shape_get_position (i, &position);
+               if (!square_cache_contains (&edges, &position)) {
+                  contained = 0;
+                  break;
+               }
+            }
          }
+      }
 
-         for (line = first_line; line <= last_line; ++line) {
+      if (!contained) continue;
 
-            /* A plugin may override a line: it can change the pen or
-             * decide not to draw the line.
-             */
+      square_cache_add_point (cache, &from);
 
-            struct square_cache_line *cache_entry = cache->lines + cache->count;
+      if (entry->shaped) {
+         position = from;
+         for (i = first_shape; i <= last_shape; ++i) {
+            if (shape_itr) (*shape_itr) (i, &position);
+            else roadmap_shape_get_position (i, &position);
+            square_cache_add_point (cache, &position);
+         }
+      } else {
+         entry->angle = roadmap_math_azymuth (&from, &to);
+      }
 
-            if (!roadmap_plugin_override_line (line, cfcc, fips)) {
+      square_cache_add_point (cache, &to);
+      entry->point_count = cache->point_count - entry->first_point;
+   }
+}
 
 
-               if (has_shapes) {
+static SquareCache *square_cache_get (int square, int cfcc) {
 
-                  roadmap_line_shapes (line, square, &first_shape, &last_shape);
-               }
+   SquareCache *cache = square_cache_find (square, cfcc);
 
-               cache_entry->contained = 1;
+   if (!cache) {
+      cache = square_cache_allocate (square, cfcc);
+   }
 
-               roadmap_line_from (line, &cache_entry->from);
-               roadmap_line_to (line, &cache_entry->to);
+   if (cache->zoom_x != RoadMapContext.zoom_x ||
+       cache->zoom_y != RoadMapContext.zoom_y) {
+      square_cache_build (cache, square, cfcc);
+   }
 
-               if (first_shape != -1) {
-                  int j;
-                  RoadMapPosition shape_pos;
-                  shape_pos = cache_entry->from;
-                  for (j = first_shape; j <= last_shape; ++j) {
+   SquareCacheZoomX = cache->zoom_x;
+   SquareCacheZoomY = cache->zoom_y;
+   square_cache_floor_div (cache->west - RoadMapContext.upright_screen.west, cache->zoom_x,
+                           &SquareCacheDx, &SquareCacheDxRem);
+   square_cache_floor_div (RoadMapContext.upright_screen.north - cache->north, cache->zoom_y,
+                           &SquareCacheDy, &SquareCacheDyRem);
 
-                     roadmap_shape_get_position (j, &shape_pos);
+   return cache;
+}
 
-                     if ((shape_pos.longitude > square_edges.east) ||
-                           (shape_pos.longitude < square_edges.west) ||
-                           (shape_pos.latitude  > square_edges.north) ||
-                           (shape_pos.latitude  < square_edges.south)) {
 
-                        cache_entry->contained = 0;
-                        break;
-                     }
-                  }
-               }
+/* Same result as roadmap_math_coordinate() for the current view */
+INLINE_DEC void square_cache_point (const SquareCachePoint *cached, RoadMapGuiPoint *point) {
 
-               cache_entry->first_shape = first_shape;
-               cache_entry->last_shape = last_shape;
-               cache_entry->cfcc = cfcc;
-               cache->count++;
-            }
-         }
+   int rem;
+
+   point->x = cached->x + SquareCacheDx;
+   rem = cached->rem_x + SquareCacheDxRem;
+   if (rem >= SquareCacheZoomX) {
+      rem -= SquareCacheZoomX;
+      point->x++;
+   }
+   if (point->x < 0 && rem) point->x++;
+
+   point->y = cached->y + SquareCacheDy;
+   rem = cached->rem_y + SquareCacheDyRem;
+   if (rem >= SquareCacheZoomY) {
+      rem -= SquareCacheZoomY;
+      point->y++;
+   }
+   if (point->y < 0 && rem) point->y++;
+}
+
+
+/* Replay of a fully visible line, see roadmap_screen_draw_one_line_internal() */
+static int square_cache_draw_line (SquareCache *cache,
+                                   const SquareCacheLine *line,
+                                   RoadMapPen *pens,
+                                   int num_pens,
+                                   int *total_length_ptr,
+                                   RoadMapGuiPoint *middle,
+                                   int *angle) {
+
+   static RoadMapScreenPattern empty_pattern = {NULL, 0};
+   const SquareCachePoint *cached = cache->points + line->first_point;
+   RoadMapGuiPoint point0;
+   RoadMapGuiPoint point1;
+   int i;
+
+   if (total_length_ptr) *total_length_ptr = 0;
+
+   if (line->shaped) {
+
+      if (line->point_count >=
+            RoadMapScreenLinePoints.end - RoadMapScreenLinePoints.cursor) {
+         roadmap_screen_flush_lines ();
+      }
+
+      square_cache_point (cached, &point0);
+      roadmap_screen_add_segment_point (&point0, pens, num_pens,
+                                        &empty_pattern, SEGMENT_START);
+
+      for (i = 1; i < line->point_count - 1; ++i) {
+         square_cache_point (cached + i, &point0);
+         roadmap_screen_add_segment_point (&point0, pens, num_pens, &empty_pattern, 0);
       }
+
+      square_cache_point (cached + line->point_count - 1, &point0);
+      roadmap_screen_add_segment_point (&point0, pens, num_pens,
+                                        &empty_pattern, SEGMENT_END);
+      return 1;
    }
 
-   roadmap_log_pop ();
-   if (!cache) cache = -1;
-   return cache;
+   square_cache_point (cached, &point0);
+   square_cache_point (cached + 1, &point1);
+
+   if ((point0.x == point1.x) && (point0.y == point1.y)) {
+      roadmap_screen_add_segment_point (&point0, pens, num_pens,
+                                        &empty_pattern, SEGMENT_AS_POINT);
+      return 1;
+   }
+
+   if (total_length_ptr) {
+      *total_length_ptr = roadmap_math_screen_distance
+                             (&point1, &point0, MATH_DIST_SQUARED);
+      if (angle) {
+         *angle = line->angle;
+      }
+      middle->x = (point1.x + point0.x) / 2;
+      middle->y = (point1.y + point0.y) / 2;
+   }
+
+   if (RoadMapScreenLinePoints.cursor + 2 >= RoadMapScreenLinePoints.end) {
+      roadmap_screen_flush_lines ();
+   }
+
+   roadmap_screen_add_segment_point (&point0, pens, num_pens, &empty_pattern, SEGMENT_START);
+   roadmap_screen_add_segment_point (&point1, pens, num_pens, &empty_pattern, SEGMENT_END);
+
+   return 1;
+}
+
+#endif //SCREEN_SQUARE_CACHE
+
+
+/* The map (everything drawn up to the labels) is kept by the canvas once
+ * drawn, and is drawn again only when the view changes or when its content
+ * is invalidated. Repaints caused by the overlays (car, objects, alerts,
+ * bars, dialogs) paste the kept map back instead. The overlays that know
+ * what they changed report it through roadmap_screen_damage(), and then
+ * only the damaged area is repainted.
+ */
+#define SCREEN_MAP_MAX_AGE 2000 /* ms, in case a change was not reported */
+
+#define SCREEN_DAMAGE_NONE 0
+#define SCREEN_DAMAGE_RECT 1
+#define SCREEN_DAMAGE_ALL  2
+
+typedef struct {
+   RoadMapPosition center;
+   zoom_t zoom;
+   int orientation;
+   int view_mode;
+   int horizon;
+   int width;
+   int height;
+   int fast;
+} RoadMapScreenMapView;
+
+static RoadMapScreenMapView RoadMapScreenMapKept;
+static int RoadMapScreenMapValid = 0;
+static uint32_t RoadMapScreenMapTime;
+
+static int RoadMapScreenDamageState = SCREEN_DAMAGE_ALL;
+static RoadMapGuiRect RoadMapScreenDamageArea;
+static int RoadMapScreenDamaging = 0;
+
+
+static void roadmap_screen_map_view (RoadMapScreenMapView *view) {
+
+   memset (view, 0, sizeof(*view));
+
+   roadmap_math_get_context (&view->center, &view->zoom);
+   view->orientation = roadmap_math_get_orientation ();
+   view->view_mode = RoadMapScreenViewMode;
+   view->horizon = RoadMapScreen3dHorizon;
+   view->width = roadmap_canvas_width ();
+   view->height = roadmap_canvas_height ();
+   view->fast = FAST_REFRESH;
+}
+
+
+static int roadmap_screen_map_is_kept (void) {
+
+   RoadMapScreenMapView view;
+
+   if (!RoadMapScreenMapValid) return 0;
+
+   if (roadmap_time_get_millis () - RoadMapScreenMapTime > SCREEN_MAP_MAX_AGE) {
+      return 0;
+   }
+
+   roadmap_screen_map_view (&view);
+
+   return !memcmp (&view, &RoadMapScreenMapKept, sizeof(view));
+}
+
+
+static void roadmap_screen_map_keep (void) {
+
+   RoadMapScreenMapValid = roadmap_canvas_save_map ();
+
+   if (RoadMapScreenMapValid) {
+      roadmap_screen_map_view (&RoadMapScreenMapKept);
+      RoadMapScreenMapTime = roadmap_time_get_millis ();
+   }
+}
+
+
+static void roadmap_screen_map_invalidate (void) {
+
+   RoadMapScreenMapValid = 0;
+}
+
+
+void roadmap_screen_damage (const RoadMapGuiRect *rect) {
+
+   if (!rect) {
+      RoadMapScreenDamageState = SCREEN_DAMAGE_ALL;
+   } else if (RoadMapScreenDamageState == SCREEN_DAMAGE_NONE) {
+      RoadMapScreenDamageState = SCREEN_DAMAGE_RECT;
+      RoadMapScreenDamageArea = *rect;
+   } else if (RoadMapScreenDamageState == SCREEN_DAMAGE_RECT) {
+      if (rect->minx < RoadMapScreenDamageArea.minx) RoadMapScreenDamageArea.minx = rect->minx;
+      if (rect->miny < RoadMapScreenDamageArea.miny) RoadMapScreenDamageArea.miny = rect->miny;
+      if (rect->maxx > RoadMapScreenDamageArea.maxx) RoadMapScreenDamageArea.maxx = rect->maxx;
+      if (rect->maxy > RoadMapScreenDamageArea.maxy) RoadMapScreenDamageArea.maxy = rect->maxy;
+   }
+
+   RoadMapScreenDamaging = 1;
+   roadmap_screen_repaint ();
+   RoadMapScreenDamaging = 0;
+}
+
+
+void roadmap_screen_cache_clear (int square) {
+
+   roadmap_shape_simplify_clear (square);
+   roadmap_polygon_tess_clear (square);
+   roadmap_screen_map_invalidate ();
+
+#ifdef SCREEN_SQUARE_CACHE
+   int slot;
+
+   for (slot = 0; slot < SquareCacheCount; slot++) {
+      if (SquareCacheEntries[slot].square != -1 &&
+          (square == -1 || SquareCacheEntries[slot].square == square)) {
+         square_cache_release (slot);
+      }
+   }
+#endif //SCREEN_SQUARE_CACHE
 }
-#endif
 
 //#define DEBUG_TIME
 #ifdef J2ME
@@ -1827,6 +2310,18 @@ INLINE_DEC int roadmap_screen_draw_square
 #endif
    if (roadmap_line_in_square (square, cfcc, &first_line, &last_line) > 0) {
       int has_shapes;
+#ifdef SCREEN_SQUARE_CACHE
+      SquareCache *cache = NULL;
+      SquareCacheLine *cache_line = NULL;
+
+      if (fully_visible) {
+         cache = square_cache_get (square, cfcc);
+         if (cache->first_line != first_line ||
+             cache->line_count != last_line - first_line + 1) {
+            cache = NULL;
+         }
+      }
+#endif //SCREEN_SQUARE_CACHE
 
       if (roadmap_square_has_shapes (square)) {
          has_shapes = 1;
@@ -1850,7 +2345,16 @@ INLINE_DEC int roadmap_screen_draw_square
             RoadMapPosition from;
             RoadMapPosition to;
             RoadMapPen override_pen;
-
+            RoadMapShapeItr shape_itr = NULL;
+            int line_cached = 0;
+
+#ifdef SCREEN_SQUARE_CACHE
+            cache_line = NULL;
+            if (cache && cache->lines[line - first_line].point_count) {
+               cache_line = cache->lines + (line - first_line);
+               line_cached = 1;
+            }
+#endif //SCREEN_SQUARE_CACHE
 
             if (has_shapes) {
 
@@ -1860,16 +2364,30 @@ INLINE_DEC int roadmap_screen_draw_square
             roadmap_line_from (line, &from);
             roadmap_line_to (line, &to);
 
+            /* A cached line already holds its simplified shape */
+            if (first_shape >= 0 && !line_cached) {
+               roadmap_shape_simplify_line
+                  (line, &from, &to, &first_shape, &last_shape, &shape_itr);
+            }
+
             /* Check if the plugin wants to override the pen. */
             if (/*FAST_REFRESH == 0 &&*/
             	  roadmap_plugin_override_pen
                      (line, cfcc, active_fips, pen_type, &override_pen)) {
 
                if (override_pen == NULL) continue;
-               roadmap_screen_draw_one_line_internal
-                  (&from, &to, fully_visible, &from, first_shape, last_shape,
-                   NULL, &override_pen, 1, label_max_proj,
-                   total_length_ptr, &seg_middle, angle_ptr, NULL, FALSE);
+#ifdef SCREEN_SQUARE_CACHE
+               if (cache_line) {
+                  square_cache_draw_line (cache, cache_line, &override_pen, 1,
+                                          total_length_ptr, &seg_middle, angle_ptr);
+               } else
+#endif //SCREEN_SQUARE_CACHE
+               {
+                  roadmap_screen_draw_one_line_internal
+                     (&from, &to, fully_visible, &from, first_shape, last_shape,
+                      shape_itr, &override_pen, 1, label_max_proj,
+                      total_length_ptr, &seg_middle, angle_ptr, NULL, FALSE);
+               }
             } else {
             	int low_weight;
             	int scale = roadmap_square_get_screen_scale ();
@@ -1877,18 +2395,26 @@ INLINE_DEC int roadmap_screen_draw_square
             	if ((cfcc < ROADMAP_ROAD_PEDESTRIAN) && (pen_type == 1) && low_weight && editor_screen_gray_scale() && !scale) {
        					roadmap_screen_draw_one_line_internal
                   			(&from, &to, fully_visible, &from, first_shape, last_shape,
-                   				NULL, layer_pens2, LAYER_PROJ_AREAS,
+                   				shape_itr, layer_pens2, LAYER_PROJ_AREAS,
                    				label_max_proj, total_length_ptr, &seg_middle, angle_ptr, NULL, FALSE);
 						roadmap_screen_draw_line_points(&from, &to, &from, first_shape, last_shape,
-                   				NULL, "#b2bfdc");
+                   				shape_itr, "#b2bfdc");
                 }
                 else{
                   int width = roadmap_canvas_get_thickness(layer_pens[0]);
                   int direction = roadmap_line_route_get_direction (line, ROUTE_CAR_ALLOWED);
-     					roadmap_screen_draw_one_line_internal
-                  			(&from, &to, fully_visible, &from, first_shape, last_shape,
-                   				NULL, layer_pens, LAYER_PROJ_AREAS,
-                   				label_max_proj, total_length_ptr, &seg_middle, angle_ptr, NULL, FALSE);
+#ifdef SCREEN_SQUARE_CACHE
+                  if (cache_line) {
+                     square_cache_draw_line (cache, cache_line, layer_pens, LAYER_PROJ_AREAS,
+                                             total_length_ptr, &seg_middle, angle_ptr);
+                  } else
+#endif //SCREEN_SQUARE_CACHE
+                  {
+                     roadmap_screen_draw_one_line_internal
+                        (&from, &to, fully_visible, &from, first_shape, last_shape,
+                         shape_itr, layer_pens, LAYER_PROJ_AREAS,
+                         label_max_proj, total_length_ptr, &seg_middle, angle_ptr, NULL, FALSE);
+                  }
 
      					if (!FAST_REFRESH &&
      					    RoadMapScreenViewMode == VIEW_MODE_2D &&
@@ -1901,7 +2427,7 @@ INLINE_DEC int roadmap_screen_draw_square
                                                             &from,
                                                             first_shape,
                                                             last_shape,
-     					                                          NULL,
+     					                                          shape_itr,
      					                                          //width,
                                                          8,
      					                                          direction,
@@ -2294,18 +2820,10 @@ INLINE_DEC int roadmap_screen_repaint_square (int square, int pen_type,
    int category;
    int fully_visible;
 
-   dbg_time_start(DBG_TIME_DRAW_SQUARE);
+   roadmap_performance_begin(PERF_DRAW_SQUARE);
 
    if (pen_type == 0) roadmap_screen_draw_square_edges (square);
 
-#if 0
-   if (!SquareCache[square]) {
-      SquareCache[square] = roadmap_screen_cache_square (square, layers, layer_count);
-   }
-
-   if (SquareCache[square] == -1) return 0;
-#endif
-
    roadmap_log_push ("roadmap_screen_repaint_square");
 
    roadmap_square_edges (square, &edges);
@@ -2313,6 +2831,7 @@ INLINE_DEC int roadmap_screen_repaint_square (int square, int pen_type,
    switch (roadmap_math_is_visible (&edges)) {
    case 0:
       roadmap_log_pop ();
+      roadmap_performance_end(PERF_DRAW_SQUARE);
       return 0;
    case 1:
       fully_visible = 1;
@@ -2332,7 +2851,7 @@ INLINE_DEC int roadmap_screen_repaint_square (int square, int pen_type,
 
    }
 
-   dbg_time_end(DBG_TIME_DRAW_SQUARE);
+   roadmap_performance_end(PERF_DRAW_SQUARE);
 
    roadmap_screen_flush_lines();
    roadmap_screen_flush_points();
@@ -2548,6 +3067,8 @@ void roadmap_screen_draw_map (RoadMapGuiRect *rect) {
    int max_pen = roadmap_layer_max_pen();
    int use_only_main_pen = 0;
 
+   roadmap_performance_begin(PERF_MAP_SETUP);
+
    if (rect) {
       RoadMapArea focus;
       roadmap_canvas_select_pen (RoadMapBackground);
@@ -2590,15 +3111,15 @@ void roadmap_screen_draw_map (RoadMapGuiRect *rect) {
 
    /* - For each candidate county: */
 
-   dbg_time_end(DBG_TIME_T1);
+   roadmap_performance_end(PERF_MAP_SETUP);
 #ifdef SUPPORT_MULTI_FIPS
    for (i = fp_count-1; i >= 0; --i) {
 
-      dbg_time_start(DBG_TIME_T2);
+      roadmap_performance_begin(PERF_SQUARE_VIEW);
       /* -- Access the county's database. */
 
       if (roadmap_locator_activate (fips[i]) != ROADMAP_US_OK) {
-         dbg_time_end(DBG_TIME_T2);
+         roadmap_performance_end(PERF_SQUARE_VIEW);
          continue;
       }
 #endif //SUPPORT_MULTI_FIPS
@@ -2614,7 +3135,7 @@ void roadmap_screen_draw_map (RoadMapGuiRect *rect) {
 //      for (j = count - 1; j >= 0; --j) {
 //         printf("going to draw square: %d\n",in_view[j]);
 //      }
-      dbg_time_end(DBG_TIME_T2);
+      roadmap_performance_end(PERF_SQUARE_VIEW);
       max_pen--;
       for (k = 0; k <= max_pen; ++k) {
 
@@ -2623,10 +3144,10 @@ void roadmap_screen_draw_map (RoadMapGuiRect *rect) {
          int layers[256];
          int pen_type = k;
 //         printf("++++ pen: %d\n", k);
-         dbg_time_start(DBG_TIME_T3);
+         roadmap_performance_begin(PERF_LAYERS);
          layer_count = roadmap_layer_visible_lines (layers, 256, k);
          if (!layer_count) {
-            dbg_time_end(DBG_TIME_T3);
+            roadmap_performance_end(PERF_LAYERS);
             continue;
          }
 
@@ -2641,7 +3162,7 @@ void roadmap_screen_draw_map (RoadMapGuiRect *rect) {
          printf ("roadmap_screen_repaint before squares %d ms\n", end_time - start_time);
          start_time = end_time;
 #endif
-         dbg_time_end(DBG_TIME_T3);
+         roadmap_performance_end(PERF_LAYERS);
 
 #if 1
          for (n = layer_count -1; n >= 0; n--) {
@@ -2680,10 +3201,8 @@ void roadmap_screen_draw_map (RoadMapGuiRect *rect) {
 #endif
       }
 
-      dbg_time_end(DBG_TIME_FULL);
       roadmap_screen_flush_lines ();
       roadmap_screen_flush_points ();
-      dbg_time_start(DBG_TIME_FULL);
 
 #ifdef DEBUG_TIME
       end_time = NOPH_System_currentTimeMillis();
@@ -2731,6 +3250,8 @@ void roadmap_screen_repaint_now( void ) {
    static RoadMapPosition last_tile_center = {-1, -1};
 #endif
    int full_draw = 1;
+   int map_kept;
+   int damage_state = RoadMapScreenDamageState;
 
 #ifdef DEBUG_TIME
     int start_time;
@@ -2802,8 +3323,8 @@ void roadmap_screen_repaint_now( void ) {
     start_time = NOPH_System_currentTimeMillis();
     printf ("In roadmap_screen_repaint...\n");
 #endif
-    dbg_time_start(DBG_TIME_FULL);
-    dbg_time_start(DBG_TIME_T1);
+    roadmap_performance_frame_begin();
+    roadmap_performance_begin(PERF_MAP_SETUP);
 
     if (isViewModeAny3D()) {
        RoadMapScreenLowerEdge.x = roadmap_canvas_width() / 2;
@@ -2834,104 +3355,133 @@ void roadmap_screen_repaint_now( void ) {
 
     roadmap_log_push ("roadmap_screen_repaint");
 
-    /* Repaint the drawing buffer. */
+    RoadMapScreenDamageState = SCREEN_DAMAGE_NONE;
+    RoadMapScreenLastPen = NULL;
+
+    map_kept = roadmap_screen_map_is_kept ();
+
+    /* The map setup goes on in roadmap_screen_draw_map(), when drawn */
+    roadmap_performance_end(PERF_MAP_SETUP);
+
+    if (map_kept) {
 
-    /* Clean the drawing buffer. */
+       if (damage_state == SCREEN_DAMAGE_RECT) {
+          roadmap_canvas_restore_map (&RoadMapScreenDamageArea);
+          roadmap_canvas_set_clip (&RoadMapScreenDamageArea);
+       } else {
+          roadmap_canvas_restore_map (NULL);
+       }
+
+    } else {
+
+       /* Repaint the drawing buffer. */
+
+       /* Clean the drawing buffer. */
 #ifndef OGL_TILE
-    roadmap_canvas_select_pen (RoadMapBackground);
+       roadmap_canvas_select_pen (RoadMapBackground);
 #else
-   roadmap_canvas_select_pen (RoadMapNoTileBg);
+      roadmap_canvas_select_pen (RoadMapNoTileBg);
 #endif
 
-    roadmap_canvas_erase ();
-    RoadMapScreenLastPen = NULL;
-/*
-    if (count == 0) {
-       roadmap_display_text("Info", roadmap_lang_get ("No map available"));
-       nomap = 1;
-    } else if (nomap) {
-       roadmap_display_hide("Info");
-       nomap = 0;
-    }
-*/
+       roadmap_canvas_erase ();
+   /*
+       if (count == 0) {
+          roadmap_display_text("Info", roadmap_lang_get ("No map available"));
+          nomap = 1;
+       } else if (nomap) {
+          roadmap_display_hide("Info");
+          nomap = 0;
+       }
+   */
 
 #ifndef OGL_TILE
-    if (!FAST_REFRESH) {
-       roadmap_label_start();
-    }
+       if (!FAST_REFRESH) {
+          roadmap_label_start();
+       }
 #endif
 
 #ifndef OGL_TILE
-   roadmap_screen_draw_map(NULL);
+      roadmap_performance_begin(PERF_DRAW_MAP);
+      roadmap_screen_draw_map(NULL);
+      roadmap_performance_end(PERF_DRAW_MAP);
 #else
-   if (last_tile_center.longitude == -1) { //tODO: change this flag
-      RoadMapGuiPoint current_center;
-      RoadMapGuiPoint last_center;
+      if (last_tile_center.longitude == -1) { //tODO: change this flag
+         RoadMapGuiPoint current_center;
+         RoadMapGuiPoint last_center;
+         RoadMapPosition math_center;
+         zoom_t zoom;
+
+         roadmap_math_get_context(&math_center, &zoom);
+         roadmap_math_coordinate(&math_center, &current_center);
+         roadmap_math_coordinate(&last_tile_center, &last_center);
+
+         center_delta.x = 0;
+         center_delta.y = 0;
+
+         last_tile_center = math_center;
+           }
+
       RoadMapPosition math_center;
       zoom_t zoom;
-
+      RoadMapGuiPointF delta;
+      RoadMapGuiPointF current_center;
       roadmap_math_get_context(&math_center, &zoom);
-      roadmap_math_coordinate(&math_center, &current_center);
-      roadmap_math_coordinate(&last_tile_center, &last_center);
 
-      center_delta.x = 0;
-      center_delta.y = 0;
+      roadmap_math_coordinate_f(&last_tile_center, &center_delta);
+      RoadMapPosition back_to_last;
+      roadmap_math_to_position_f(&center_delta, &back_to_last, 0);
+      //printf("D: %f, %f\nB: %d, %d\nA: %d, %d\n\n", center_delta.x, center_delta.y,
+   //          last_tile_center.longitude, last_tile_center.latitude,
+   //          back_to_last.longitude, back_to_last.latitude);
 
+      roadmap_math_coordinate_f(&math_center, &current_center);
+      delta.x = -current_center.x + center_delta.x;
+      delta.y = -current_center.y + center_delta.y;
       last_tile_center = math_center;
-        }
+         RoadMapScreenFastRefreshOverride = 1;
+         roadmap_canvas_tile_set(0, roadmap_math_get_zoom(), &delta, roadmap_math_get_orientation(), OGL_3Dmode, roadmap_screen_draw_map, 0);
 
-   RoadMapPosition math_center;
-   zoom_t zoom;
-   RoadMapGuiPointF delta;
-   RoadMapGuiPointF current_center;
-   roadmap_math_get_context(&math_center, &zoom);
-
-   roadmap_math_coordinate_f(&last_tile_center, &center_delta);
-   RoadMapPosition back_to_last;
-   roadmap_math_to_position_f(&center_delta, &back_to_last, 0);
-   //printf("D: %f, %f\nB: %d, %d\nA: %d, %d\n\n", center_delta.x, center_delta.y,
-//          last_tile_center.longitude, last_tile_center.latitude,
-//          back_to_last.longitude, back_to_last.latitude);
-
-   roadmap_math_coordinate_f(&math_center, &current_center);
-   delta.x = -current_center.x + center_delta.x;
-   delta.y = -current_center.y + center_delta.y;
-   last_tile_center = math_center;
-      RoadMapScreenFastRefreshOverride = 1;
-      roadmap_canvas_tile_set(0, roadmap_math_get_zoom(), &delta, roadmap_math_get_orientation(), OGL_3Dmode, roadmap_screen_draw_map, 0);
-
-   full_draw = roadmap_canvas_tile_draw(0, RoadMapScreenFastRefresh);
-   RoadMapScreenFastRefreshOverride = 0;
+      full_draw = roadmap_canvas_tile_draw(0, RoadMapScreenFastRefresh);
+      RoadMapScreenFastRefreshOverride = 0;
 
 #endif //OGL_TILE
 
 
-   max_pen--;
-   roadmap_square_set_current (in_view[0]); //any square, in case we did not select any square yet...
-   roadmap_plugin_screen_repaint (max_pen);
-   roadmap_screen_flush_lines();
-   roadmap_screen_flush_points();
+      max_pen--;
+      roadmap_square_set_current (in_view[0]); //any square, in case we did not select any square yet...
+      roadmap_plugin_screen_repaint (max_pen);
+      roadmap_screen_flush_lines();
+      roadmap_screen_flush_points();
 
 
-   //draw labels
-        dbg_time_start(DBG_TIME_T4);
-   if (!FAST_REFRESH || 1) {
+      //draw labels
+      if (!FAST_REFRESH || 1) {
 #ifdef VIEW_MODE_3D_OGL
-    roadmap_canvas3_set3DMode(OGL_2Dmode);
+       roadmap_canvas3_set3DMode(OGL_2Dmode);
 #endif// VIEW_MODE_3D_OGL
-      if (!roadmap_label_draw_cache (!isViewModeAny3D(), full_draw)){
-         full_draw = 0;
-      }
+         roadmap_performance_begin(PERF_LABELS);
+         if (!roadmap_label_draw_cache (!isViewModeAny3D(), full_draw)){
+            full_draw = 0;
+         }
+         roadmap_performance_end(PERF_LABELS);
 #ifdef VIEW_MODE_3D_OGL
-    roadmap_canvas3_set3DMode(OGL_3Dmode);
+       roadmap_canvas3_set3DMode(OGL_3Dmode);
 #endif// VIEW_MODE_3D_OGL
 #ifdef DEBUG_TIME
-    end_time = NOPH_System_currentTimeMillis();
-    printf ("roadmap_screen_repaint end drawing labels %d ms\n", end_time - start_time);
-    start_time = end_time;
+       end_time = NOPH_System_currentTimeMillis();
+       printf ("roadmap_screen_repaint end drawing labels %d ms\n", end_time - start_time);
+       start_time = end_time;
 #endif
-        }
+           }
+
+       if (full_draw) {
+          roadmap_screen_map_keep ();
+       } else {
+          roadmap_screen_map_invalidate ();
+       }
+    }
 
+    roadmap_performance_begin(PERF_OVERLAYS);
 
 
 #ifdef VIEW_MODE_3D_OGL
@@ -3011,20 +3561,26 @@ void roadmap_screen_repaint_now( void ) {
    ssd_dialog_draw_now ();
 #endif
 
+   roadmap_performance_display ();
+
 #ifdef DEBUG_TIME
     end_time = NOPH_System_currentTimeMillis();
     printf ("roadmap_screen_repaint b4 canvas refresh %d ms\n", end_time - start_time);
     start_time = end_time;
 #endif
-    dbg_time_end(DBG_TIME_T4);
+    roadmap_performance_end(PERF_OVERLAYS);
 #ifdef GTK2_OGL
     roadmap_canvas_ogl_end();
 #endif// GTK2_OGL
+    if (map_kept && (damage_state == SCREEN_DAMAGE_RECT)) {
+       roadmap_canvas_set_clip (NULL);
+    }
+    roadmap_performance_begin(PERF_FLIP);
     roadmap_canvas_refresh ();
+    roadmap_performance_end(PERF_FLIP);
 
     roadmap_log_pop ();
-    dbg_time_end(DBG_TIME_FULL);
-//    dbg_time_print();
+    roadmap_performance_frame_end();
 #ifdef DEBUG_TIME
     printf ("Finished roadmap_screen_repaint in %d ms\n", (int)NOPH_System_currentTimeMillis() - start_time);
 #endif
@@ -3121,6 +3677,14 @@ static void roadmap_screen_repaint (void) {
 //		return;
 //	}
 
+   /* Unless it comes from roadmap_screen_damage(), a repaint may change
+    * anything on the screen.
+    */
+   if (!RoadMapScreenDamaging) {
+      RoadMapScreenDamageState = SCREEN_DAMAGE_ALL;
+   }
+   RoadMapScreenDamaging = 0;
+
    if (!RoadMapScreenRefreshFlowControl) {
    /* TODO SYMBIAN HACK!!! */
       if (SYMBIAN_HACK_NET) {
@@ -3169,6 +3733,7 @@ static void roadmap_screen_configure (void) {
 
    RoadMapScreenWidth = roadmap_canvas_width();
    RoadMapScreenHeight = roadmap_canvas_height();
+   roadmap_screen_map_invalidate ();
    roadmap_log (ROADMAP_DEBUG, "In roadmap_screen_configure. width:%d, height:%d", RoadMapScreenWidth, RoadMapScreenHeight);
 
    RoadMapScreenLabels = ! roadmap_config_match(&RoadMapConfigMapLabels, "off");
@@ -3909,11 +4474,14 @@ int roadmap_screen_refresh (void) {
 
 void roadmap_screen_mark_redraw (void) {
    RoadMapScreenDirty++;
+   roadmap_screen_map_invalidate ();
 }
 
 
 void roadmap_screen_redraw (void) {
 
+   roadmap_screen_map_invalidate ();
+
    /* Since we already need a redraw, check if a refresh
     * is needed.
     */
@@ -3927,6 +4495,39 @@ void roadmap_screen_redraw (void) {
 }
 
 
+/* Draw the map for the given view at once, without following the focus and
+ * without animations, e.g. for the render benchmark.
+ */
+void roadmap_screen_draw_view (const RoadMapPosition *center,
+                               int zoom,
+                               int orientation,
+                               int view_mode) {
+
+#ifdef VIEW_MODE_3D_OGL
+   RoadMapScreenOGLViewModeConfig = view_mode;
+   RoadMapScreenOGLViewMode = view_mode;
+#else
+   RoadMapScreenViewMode = view_mode;
+#endif
+   set_horizon ();
+
+   RoadMapScreenOrientationMode = ORIENTATION_FIXED;
+   RoadMapScreenRotation = orientation;
+   roadmap_math_set_orientation (orientation);
+
+   roadmap_math_zoom_set ((zoom_t)zoom);
+   roadmap_layer_adjust ();
+
+   roadmap_screen_update_center (center);
+
+   /* The labels placed in the previous frame would change this one. */
+   roadmap_label_clear_all ();
+
+   roadmap_screen_map_invalidate ();
+   roadmap_screen_repaint_now ();
+}
+
+
 void roadmap_screen_freeze (void) {
 
    RoadMapScreenFrozen = 1;
@@ -4421,6 +5022,8 @@ void roadmap_screen_initialize (void) {
 
    roadmap_device_events_register( on_device_event, NULL);
 
+   roadmap_performance_initialize ();
+
 }
 
 
@@ -4710,35 +5313,6 @@ int roadmap_screen_animating (void) {
    return (RoadMapScreenFastRefresh & SCREEN_FAST_ANIMATING);
 }
 
-#if 0
-//#ifndef J2ME
-//#ifdef _WIN32
-static unsigned long dbg_time_rec[DBG_TIME_LAST_COUNTER];
-static unsigned long dbg_time_tmp[DBG_TIME_LAST_COUNTER];
-
-void dbg_time_start(int type) {
-   dbg_time_tmp[type] = (long)NOPH_System_currentTimeMillis();
-}
-
-void dbg_time_end(int type) {
-   dbg_time_rec[type] += (long)NOPH_System_currentTimeMillis() - dbg_time_tmp[type];
-}
-
-int dbg_time_print() {
-    int i;
-    for (i=0; i<DBG_TIME_LAST_COUNTER; i++) printf ("Timer %d: %ld\n", i, dbg_time_rec[i]);
-}
-
-#else
-void dbg_time_start(int type) {
-}
-
-void dbg_time_end(int type) {
-}
-
-int dbg_time_print() { return 0; }
-#endif
-
 void roadmap_screen_draw_flush(void){
 	RoadMapScreenLastPen = NULL;
 }
@@ -78,6 +78,12 @@ void roadmap_screen_rotate (int delta);
 
 int  roadmap_screen_refresh (void); /* Conditional: only if needed. */
 void roadmap_screen_redraw  (void); /* Force a screen redraw, no move. */
+void roadmap_screen_draw_view (const RoadMapPosition *center,
+                               int zoom,
+                               int orientation,
+                               int view_mode); /* Draw this view now. */
+void roadmap_screen_damage  (const RoadMapGuiRect *rect); /* Overlays only,
+                                                          * NULL: anywhere. */
 
 void roadmap_screen_hold     (void); /* Hold on at the current position. */
 void roadmap_screen_freeze   (void); /* Forbid any screen refresh. */
@@ -85,6 +91,8 @@ void roadmap_screen_unfreeze (void); /* Enable screen refresh. */
 
 void roadmap_screen_update_center (const RoadMapPosition *pos);
 
+void roadmap_screen_cache_clear (int square); /* -1 for all squares */
+
 
 void roadmap_screen_get_center (RoadMapPosition *center);
 
@@ -166,34 +174,6 @@ int roadmap_screen_adjust_width( int orig_width );
 void roadmap_screen_mark_redraw (void);
 int roadmap_screen_show_icons_only_when_touched(void);
 int roadmap_screen_show_top_bar_only_when_touched(void);
-#define DBG_TIME_FULL 0
-#define DBG_TIME_DRAW_SQUARE 1
-#define DBG_TIME_DRAW_ONE_LINE 2
-#define DBG_TIME_SELECT_PEN 3
-#define DBG_TIME_DRAW_LINES 4
-#define DBG_TIME_CREATE_PATH 5
-#define DBG_TIME_ADD_PATH 6
-#define DBG_TIME_FLIP 7
-#define DBG_TIME_TEXT_FULL 8
-#define DBG_TIME_TEXT_CNV 9
-#define DBG_TIME_TEXT_LOAD 10
-#define DBG_TIME_TEXT_ONE_LETTER 11
-#define DBG_TIME_TEXT_GET_GLYPH 12
-#define DBG_TIME_TEXT_ONE_RAS 13
-#define DBG_TIME_DRAW_LONG_LINES 14
-#define DBG_TIME_FIND_LONG_LINES 15
-#define DBG_TIME_ADD_SEGMENT 16
-#define DBG_TIME_FLUSH_LINES 17
-#define DBG_TIME_FLUSH_POINTS 18
-#define DBG_TIME_T1 19
-#define DBG_TIME_T2 20
-#define DBG_TIME_T3 21
-#define DBG_TIME_T4 22
-#define DBG_TIME_LAST_COUNTER 23
-
-void dbg_time_start(int type);
-void dbg_time_end(int type);
-int dbg_time_print();
 void roadmap_screen_draw_flush(void);
 int roadmap_screen_show_top_bar(void);
 void roadmap_screen_set_Xicon_state(BOOL state);
@@ -0,0 +1,366 @@
+/* roadmap_shape_simplify.c - zoom dependent simplified line shapes.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   When zoomed out, most shape points of a line fall within the same
+ *   pixel as their neighbours. The shapes are simplified (Douglas-Peucker)
+ *   once per square and per zoom band, where a band covers the zooms from
+ *   2^n to 2^(n+1), with a tolerance of half a pixel at the smallest zoom
+ *   of the band. The simplified shapes are computed when a line is first
+ *   drawn in a band and kept until the square's tile changes.
+ *
+ * SYNOPSYS:
+ *
+ *   See roadmap_shape_simplify.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "roadmap.h"
+#include "roadmap_hash.h"
+#include "roadmap_math.h"
+#include "roadmap_line.h"
+#include "roadmap_shape.h"
+#include "roadmap_square.h"
+
+#include "roadmap_shape_simplify.h"
+
+
+#define SIMPLIFY_CACHE_SIZE   128
+
+/* Below this band (zoom < 16), few points are dropped and simplifying
+ * does not pay back.
+ */
+#define SIMPLIFY_MIN_BAND     4
+
+typedef struct {
+   int first_point;  /* -1: not simplified yet */
+   int point_count;
+} SimplifyLine;
+
+typedef struct {
+   int square;
+   int band;
+   unsigned int last_access;
+
+   int line_count;
+   SimplifyLine *lines;
+
+   int point_count;
+   int point_size;
+   RoadMapPosition *points;
+} SimplifyCache;
+
+static SimplifyCache  SimplifyCacheEntries[SIMPLIFY_CACHE_SIZE];
+static int            SimplifyCacheCount = 0;
+static unsigned int   SimplifyCacheAccess = 0;
+static RoadMapHash   *SimplifyCacheHash = NULL;
+
+/* The line being drawn, see roadmap_shape_simplify_itr() */
+static const RoadMapPosition *SimplifyCurrent = NULL;
+
+/* Work buffers */
+static RoadMapPosition *SimplifyInput = NULL;
+static char            *SimplifyKeep = NULL;
+static int             *SimplifyStack = NULL;
+static int              SimplifyInputSize = 0;
+
+
+static int simplify_cache_key (int square, int band) {
+
+   return (square ^ (band << 24)) & 0x7fffffff;
+}
+
+
+static void simplify_cache_release (int slot) {
+
+   SimplifyCache *cache = SimplifyCacheEntries + slot;
+
+   roadmap_hash_remove (SimplifyCacheHash,
+                        simplify_cache_key (cache->square, cache->band), slot);
+   cache->square = -1;
+   cache->line_count = 0;
+   cache->point_count = 0;
+}
+
+
+static SimplifyCache *simplify_cache_find (int square, int band) {
+
+   int slot;
+
+   if (!SimplifyCacheHash) return NULL;
+
+   for (slot = roadmap_hash_get_first (SimplifyCacheHash, simplify_cache_key (square, band));
+        slot >= 0;
+        slot = roadmap_hash_get_next (SimplifyCacheHash, slot)) {
+
+      SimplifyCache *cache = SimplifyCacheEntries + slot;
+      if (cache->square == square && cache->band == band) {
+         cache->last_access = ++SimplifyCacheAccess;
+         return cache;
+      }
+   }
+
+   return NULL;
+}
+
+
+static SimplifyCache *simplify_cache_allocate (int square, int band) {
+
+   int slot;
+   int i;
+   SimplifyCache *cache;
+   int line_count = roadmap_line_count ();
+
+   if (!SimplifyCacheHash) {
+      SimplifyCacheHash = roadmap_hash_new ("ShapeSimplify", SIMPLIFY_CACHE_SIZE);
+   }
+
+   if (SimplifyCacheCount < SIMPLIFY_CACHE_SIZE) {
+      slot = SimplifyCacheCount++;
+   } else {
+
+      /* Replace the least recently drawn entry, or a cleared one */
+      slot = 0;
+      for (i = 0; i < SIMPLIFY_CACHE_SIZE; i++) {
+         if (SimplifyCacheEntries[i].square == -1) {
+            slot = i;
+            break;
+         }
+         if (SimplifyCacheEntries[i].last_access < SimplifyCacheEntries[slot].last_access) {
+            slot = i;
+         }
+      }
+      if (SimplifyCacheEntries[slot].square != -1) {
+         simplify_cache_release (slot);
+      }
+   }
+
+   cache = SimplifyCacheEntries + slot;
+   cache->square = square;
+   cache->band = band;
+   cache->last_access = ++SimplifyCacheAccess;
+   cache->point_count = 0;
+
+   cache->lines = realloc (cache->lines, line_count * sizeof (SimplifyLine));
+   roadmap_check_allocated (cache->lines);
+   cache->line_count = line_count;
+   for (i = 0; i < line_count; i++) {
+      cache->lines[i].first_point = -1;
+   }
+
+   roadmap_hash_add (SimplifyCacheHash, simplify_cache_key (square, band), slot);
+
+   return cache;
+}
+
+
+static int simplify_band (void) {
+
+   int band = 0;
+   int zoom = (int)RoadMapContext.zoom_y;
+
+   while (zoom > 1) {
+      zoom >>= 1;
+      band++;
+   }
+
+   return band;
+}
+
+
+static void simplify_reserve (int count) {
+
+   if (count <= SimplifyInputSize) return;
+
+   SimplifyInputSize = count + 64;
+
+   SimplifyInput = realloc (SimplifyInput, SimplifyInputSize * sizeof (RoadMapPosition));
+   roadmap_check_allocated (SimplifyInput);
+   SimplifyKeep = realloc (SimplifyKeep, SimplifyInputSize);
+   roadmap_check_allocated (SimplifyKeep);
+   SimplifyStack = realloc (SimplifyStack, 2 * SimplifyInputSize * sizeof (int));
+   roadmap_check_allocated (SimplifyStack);
+}
+
+
+/* Douglas-Peucker, distances measured in pixels of the band's zoom. */
+static void simplify_points (int count, int band) {
+
+   double pixel_y = (double)(1 << band);
+   double pixel_x = pixel_y * RoadMapContext.zoom_x / RoadMapContext.zoom_y;
+   int top = 0;
+
+   memset (SimplifyKeep, 0, count);
+   SimplifyKeep[0] = 1;
+   SimplifyKeep[count - 1] = 1;
+
+   SimplifyStack[top++] = 0;
+   SimplifyStack[top++] = count - 1;
+
+   while (top > 0) {
+
+      int last = SimplifyStack[--top];
+      int first = SimplifyStack[--top];
+      const RoadMapPosition *a = SimplifyInput + first;
+      double dx = (SimplifyInput[last].longitude - a->longitude) / pixel_x;
+      double dy = (SimplifyInput[last].latitude - a->latitude) / pixel_y;
+      double length_sq = dx * dx + dy * dy;
+      double max_sq = 0.25; /* half a pixel */
+      int farthest = -1;
+      int i;
+
+      for (i = first + 1; i < last; i++) {
+
+         double px = (SimplifyInput[i].longitude - a->longitude) / pixel_x;
+         double py = (SimplifyInput[i].latitude - a->latitude) / pixel_y;
+         double distance_sq;
+
+         if (length_sq > 0) {
+            double cross = px * dy - py * dx;
+            distance_sq = cross * cross / length_sq;
+         } else {
+            distance_sq = px * px + py * py;
+         }
+
+         if (distance_sq > max_sq) {
+            max_sq = distance_sq;
+            farthest = i;
+         }
+      }
+
+      if (farthest > 0) {
+         SimplifyKeep[farthest] = 1;
+         SimplifyStack[top++] = first;
+         SimplifyStack[top++] = farthest;
+         SimplifyStack[top++] = farthest;
+         SimplifyStack[top++] = last;
+      }
+   }
+}
+
+
+static void simplify_line (SimplifyCache *cache, SimplifyLine *line,
+                           const RoadMapPosition *from,
+                           const RoadMapPosition *to,
+                           int first_shape, int last_shape) {
+
+   int count = last_shape - first_shape + 3;
+   RoadMapPosition position = *from;
+   int i;
+
+   simplify_reserve (count);
+
+   SimplifyInput[0] = *from;
+   for (i = first_shape; i <= last_shape; i++) {
+      roadmap_shape_get_position (i, &position);
+      SimplifyInput[i - first_shape + 1] = position;
+   }
+   SimplifyInput[count - 1] = *to;
+
+   simplify_points (count, cache->band);
+
+   if (cache->point_count + count > cache->point_size) {
+      while (cache->point_count + count > cache->point_size) {
+         cache->point_size = cache->point_size ? cache->point_size * 2 : 1024;
+      }
+      cache->points = realloc (cache->points, cache->point_size * sizeof (RoadMapPosition));
+      roadmap_check_allocated (cache->points);
+   }
+
+   /* Keep the shape points only: the line ends are given by the caller. */
+   line->first_point = cache->point_count;
+   for (i = 1; i < count - 1; i++) {
+      if (SimplifyKeep[i]) {
+         cache->points[cache->point_count++] = SimplifyInput[i];
+      }
+   }
+   line->point_count = cache->point_count - line->first_point;
+}
+
+
+static void roadmap_shape_simplify_itr (int shape, RoadMapPosition *position) {
+
+   *position = SimplifyCurrent[shape];
+}
+
+
+int  roadmap_shape_simplify_line (int line,
+                                  const RoadMapPosition *from,
+                                  const RoadMapPosition *to,
+                                  int *first_shape,
+                                  int *last_shape,
+                                  RoadMapShapeItr *shape_itr) {
+
+   int square = roadmap_square_active ();
+   int band;
+   SimplifyCache *cache;
+   SimplifyLine *simple;
+
+   /* Not worth it for a line with one or two shape points. */
+   if (*last_shape - *first_shape < 2) return 0;
+
+   /* The 3D perspective magnifies the bottom of the screen. */
+   if (RoadMapContext._is3D_projection == PROJECTION_MODE_3D ||
+       RoadMapContext._is3D_projection == PROJECTION_MODE_3D_NON_OGL) return 0;
+
+   band = simplify_band ();
+   if (band < SIMPLIFY_MIN_BAND) return 0;
+
+   cache = simplify_cache_find (square, band);
+   if (!cache) cache = simplify_cache_allocate (square, band);
+
+   if (line < 0 || line >= cache->line_count) return 0;
+
+   simple = cache->lines + line;
+   if (simple->first_point < 0) {
+      simplify_line (cache, simple, from, to, *first_shape, *last_shape);
+   }
+
+   SimplifyCurrent = cache->points + simple->first_point;
+
+   if (simple->point_count > 0) {
+      *first_shape = 0;
+      *last_shape = simple->point_count - 1;
+   } else {
+      *first_shape = -1;
+      *last_shape = -1;
+   }
+   *shape_itr = roadmap_shape_simplify_itr;
+
+   return 1;
+}
+
+
+void roadmap_shape_simplify_clear (int square) {
+
+   int slot;
+
+   for (slot = 0; slot < SimplifyCacheCount; slot++) {
+      if (SimplifyCacheEntries[slot].square != -1 &&
+          (square == -1 || SimplifyCacheEntries[slot].square == square)) {
+         simplify_cache_release (slot);
+      }
+   }
+}
@@ -0,0 +1,44 @@
+/* roadmap_shape_simplify.h - zoom dependent simplified line shapes.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ROADMAP_SHAPE_SIMPLIFY__H_
+#define _ROADMAP_SHAPE_SIMPLIFY__H_
+
+#include "roadmap_types.h"
+
+/* Replace the shape of a line of the active square with its simplified
+ * version for the current zoom. On success, first_shape and last_shape
+ * index the simplified points (both -1 if none is left) and shape_itr
+ * iterates over them. Returns 0 (and changes nothing) if the line should
+ * be drawn with its full shape.
+ */
+int  roadmap_shape_simplify_line (int line,
+                                  const RoadMapPosition *from,
+                                  const RoadMapPosition *to,
+                                  int *first_shape,
+                                  int *last_shape,
+                                  RoadMapShapeItr *shape_itr);
+
+void roadmap_shape_simplify_clear (int square); /* -1 for all squares */
+
+#endif // _ROADMAP_SHAPE_SIMPLIFY__H_
@@ -119,6 +119,7 @@
 #include "roadmap_device_events.h"
 #include "roadmap_alternative_routes.h"
 #include "roadmap_debug_info.h"
+#include "roadmap_performance.h"
 #include "roadmap_map_download.h"
 #include "roadmap_ticker.h"
 #include "roadmap_reminder.h"
@@ -1126,6 +1127,12 @@ RoadMapAction RoadMapStartActions[MAX_ACTIONS + 1] = {
   {"submit_logs", "Send logs", NULL,  NULL,
           "Send logs", roadmap_debug_info_submit},
 
+  {"toggle_performance", "Performance overlay", NULL,  NULL,
+          "Show or hide the frame time statistics", roadmap_performance_toggle},
+
+  {"dump_performance", "Save frame trace", NULL,  NULL,
+          "Save the frame time trace to the debug directory", roadmap_performance_dump_trace},
+
   {"show_ticker", "Show ticker", NULL,  NULL,
                   "Show ticker", roadmap_ticker_show},
 
@@ -45,6 +45,7 @@
 #include "roadmap_shape.h"
 #include "roadmap_point.h"
 #include "roadmap_line.h"
+#include "roadmap_line_index.h"
 #include "roadmap_layer.h"
 #include "roadmap_dictionary.h"
 #include "roadmap_city.h"
@@ -847,8 +848,12 @@ static int roadmap_street_get_closest_in_square
    int last_line;
    int first_shape;
    int last_shape;
+   int has_shapes;
    int i;
+   int k;
    int fips;
+   const int *visible = NULL;
+   int visible_count;
    RoadMapNeighbour this[3];
    int max_possible_shapes = (int)(sizeof(this) / sizeof(this[0]));
 
@@ -861,9 +866,24 @@ static int roadmap_street_get_closest_in_square
 
    if (roadmap_line_in_square (square, cfcc, &first_line, &last_line) > 0) {
 
-      if (roadmap_square_has_shapes (square)) {
+      has_shapes = roadmap_square_has_shapes (square);
 
-         for (line = first_line; line <= last_line; line++) {
+      /* Only test the lines that may be visible in the focus. */
+      visible_count = roadmap_line_index_visible (&visible);
+
+      for (k = 0; ; k++) {
+
+         if (visible_count >= 0) {
+            if (k >= visible_count) break;
+            line = visible[k];
+            if (line < first_line) continue;
+            if (line > last_line) break;
+         } else {
+            line = first_line + k;
+            if (line > last_line) break;
+         }
+
+         if (has_shapes) {
 
             if (roadmap_plugin_override_line (line, cfcc, fips)) continue;
 
@@ -881,11 +901,8 @@ static int roadmap_street_get_closest_in_square
             for (i = 0; i < found; i++) {
                count = roadmap_street_replace (neighbours, count, max, this + i);
             }
-         }
-
-      } else {
 
-         for (line = first_line; line <= last_line; line++) {
+         } else {
 
             if (roadmap_street_get_distance_no_shape
                         (position, line, cfcc, this)) {
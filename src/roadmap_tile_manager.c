@@ -37,10 +37,13 @@
 #include "roadmap_locator.h"
 #include "roadmap_data_format.h"
 #include "roadmap_label.h"
+#include "roadmap_screen.h"
 #include "roadmap_square.h"
 #include "roadmap_main.h"
 #include "roadmap_config.h"
+#include "roadmap_net.h"
 #include "navigate/navigate_graph.h"
+#include "roadmap_line_index.h"
 #include "Realtime/Realtime.h"
 #include "roadmap_street.h"
 #include "roadmap_tile.h"
@@ -267,6 +270,8 @@ static void http_cb_done (void *context,char *last_modified, const char *format,
 
   	roadmap_label_clear (tile_index);
   	navigate_graph_clear (tile_index);
+  	roadmap_line_index_clear (tile_index);
+  	roadmap_screen_cache_clear (tile_index);
    if (!unloaded) {
    	roadmap_square_delete_reference (tile_index);
    }
@@ -453,6 +458,7 @@ static void roadmap_tile_manager_check_timeouts (void) {
 
 static void start_network (void) {
    init_url ();
+   roadmap_net_prefetch (get_url_prefix ());
 	Status = stat_Active;
 	load_next_tile ();
 }
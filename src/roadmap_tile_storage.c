@@ -235,3 +235,30 @@ int roadmap_tile_load (int fips, int tile_index, void **base, size_t *size) {
 }
 
 
+
+/* No transactions in the file storage - batch tiles are written synchronously
+ * in the calling thread, so the caller can rely on them being stored on return
+ */
+int roadmap_tile_store_batch_begin (int fips) {
+
+   return 0;
+}
+
+
+int roadmap_tile_store_batch (int fips, int tile_index, void *data, size_t size) {
+
+   TileContext context;
+
+   context.data = data;
+   context.free_memory = FALSE;
+   strncpy (context.full_path, get_tile_filename (fips, tile_index, 0), sizeof (context.full_path));
+   context.size = size;
+
+   return roadmap_tile_store_context (&context);
+}
+
+
+int roadmap_tile_store_batch_end (int fips, BOOL commit) {
+
+   return 0;
+}
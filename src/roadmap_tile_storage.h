@@ -48,4 +48,13 @@ int roadmap_tile_store_context( TileContext* context );
 
 int roadmap_tile_load (int fips, int tile_index, void **data, size_t *size);
 
+/* Bulk storage: all the tiles stored between begin and end are written
+ * within one transaction (when supported by the storage engine)
+ */
+int roadmap_tile_store_batch_begin (int fips);
+
+int roadmap_tile_store_batch (int fips, int tile_index, void *data, size_t size);
+
+int roadmap_tile_store_batch_end (int fips, BOOL commit);
+
 #endif /*ROADMAP_TILE_STORAGE_H_*/
@@ -54,6 +54,7 @@ typedef enum
 
 #define   RM_TILE_STORAGE_STMT_CREATE_TABLE		"CREATE TABLE IF NOT EXISTS tiles_table(id INTEGER PRIMARY KEY, data BLOB)"
 #define   RM_TILE_STORAGE_STMT_STORE		    "INSERT OR REPLACE INTO tiles_table values (%d,?);"
+#define   RM_TILE_STORAGE_STMT_STORE_BATCH	    "INSERT OR REPLACE INTO tiles_table values (?,?);"
 #define   RM_TILE_STORAGE_STMT_LOAD		        "SELECT data FROM tiles_table WHERE id=?;"
 #define   RM_TILE_STORAGE_STMT_REMOVE	        "DELETE FROM tiles_table WHERE id=?;"
 #define   RM_TILE_STORAGE_STMT_SYNC_OFF 		"PRAGMA synchronous = OFF"
@@ -70,11 +71,13 @@ static RMTileStorageConLifetime sgConLifetime = _con_lifetime_session;		// The t
 static BOOL sgIsInTransaction = FALSE;
 static int  sgTransStmtsCount = 0;
 
+static sqlite3_stmt* sgBatchStmt = NULL;	// Prepared store statement of the active batch (NULL if no batch)
+
 #define check_sqlite_error( errstr, code ) \
 	check_sqlite_error_line( errstr, code, __LINE__ )
 
 static void trans_timeout( void );
-static void trans_commit( void );
+static BOOL trans_commit( void );
 
 /***********************************************************/
 /*  Name        : roadmap_camera_image_capture()
@@ -255,22 +258,29 @@ static sqlite3*  trans_open( int fips )
 
 /***********************************************************/
 /*  Name        : trans_commit( void )
- *  Purpose     : Auxiliary function. Commits the transaction to the DB
+ *  Purpose     : Auxiliary function. Commits the transaction to the DB.
+ *                  Returns FALSE if the transaction was not committed (and rolled back)
  *  Params		:
  *  			:
  *				:
  */
-static void trans_commit( void )
+static BOOL trans_commit( void )
 {
 
 	int ret_val;
+	BOOL committed;
 
 	if ( !sgSQLiteDb )
 	{
 		roadmap_log( ROADMAP_ERROR, "Commit transaction failed - cannot open database" );
-		return;
+		return FALSE;
+	}
+	committed = check_sqlite_error( "Commit transaction", sqlite3_exec( sgSQLiteDb, "COMMIT;", NULL, NULL, NULL) );
+	if ( !committed && !sqlite3_get_autocommit( sgSQLiteDb ) )
+	{
+		// The transaction is still open - do not leave it behind
+		check_sqlite_error( "Rollback transaction", sqlite3_exec( sgSQLiteDb, "ROLLBACK;", NULL, NULL, NULL) );
 	}
-	check_sqlite_error( "Commit transaction", sqlite3_exec( sgSQLiteDb, "COMMIT;", NULL, NULL, NULL) );
 
 	/*
 	 * Close the database
@@ -282,6 +292,8 @@ static void trans_commit( void )
 
 	sgIsInTransaction = FALSE;
 	sgTransStmtsCount = 0;
+
+	return committed;
 }
 
 /***********************************************************/
@@ -615,3 +627,130 @@ void roadmap_tile_remove_all( int fips )
 
 
  
+
+
+/***********************************************************/
+/*  Name        : roadmap_tile_store_batch_begin
+ *  Purpose     : Interface function. Opens the bulk storage transaction.
+ *                  The store statement is prepared once for the whole batch
+ *  Params		: [in] fips
+ *				:
+ */
+int roadmap_tile_store_batch_begin( int fips )
+{
+	sqlite3* db;
+	int ret_val;
+
+	if ( sgBatchStmt )
+	{
+		roadmap_log( ROADMAP_ERROR, "Tile batch is already open" );
+		return -1;
+	}
+
+	/*
+	 * Flush the pending regular transaction
+	 */
+	if ( sgIsInTransaction )
+	{
+		roadmap_main_remove_periodic( trans_timeout );
+		trans_commit();
+	}
+
+	db = get_db( fips );
+	if ( !db )
+	{
+		roadmap_log( ROADMAP_ERROR, "Tile batch failed - cannot open database" );
+		return -1;
+	}
+
+	ret_val = sqlite3_exec( db, "BEGIN TRANSACTION;", NULL, NULL, NULL );
+	if ( !check_sqlite_error( "Begin batch transaction", ret_val ) )
+	{
+		close_db();
+		return -1;
+	}
+	sgIsInTransaction = TRUE;
+
+	ret_val = sqlite3_prepare( db, RM_TILE_STORAGE_STMT_STORE_BATCH, -1, &sgBatchStmt, NULL );
+	if ( !check_sqlite_error( "preparing the batch statement", ret_val ) )
+	{
+		sgBatchStmt = NULL;
+		trans_rollback();
+		return -1;
+	}
+
+	return 0;
+}
+
+/***********************************************************/
+/*  Name        : roadmap_tile_store_batch
+ *  Purpose     : Interface function. Stores the tile within the open batch
+ *  Params		: [in] fips
+ *  			: [in] tile_index - primary key
+ *  			: [in] data - the pointer to the blob data
+ *  			: [in] size - the size of the blob data block
+ *				:
+ */
+int roadmap_tile_store_batch( int fips, int tile_index, void *data, size_t size )
+{
+	int ret_val;
+
+	if ( !sgBatchStmt )
+	{
+		return roadmap_tile_store( fips, tile_index, data, size );
+	}
+
+	ret_val = sqlite3_bind_int( sgBatchStmt, 1, tile_index );
+	if ( !check_sqlite_error( "binding int parameter", ret_val ) )
+	{
+		return -1;
+	}
+
+	ret_val = sqlite3_bind_blob( sgBatchStmt, 2, data, size, SQLITE_STATIC );
+	if ( !check_sqlite_error( "binding the blob statement", ret_val ) )
+	{
+		return -1;
+	}
+
+	ret_val = sqlite3_step( sgBatchStmt );
+	sqlite3_reset( sgBatchStmt );
+	if ( ret_val != SQLITE_DONE )
+	{
+		check_sqlite_error( "batch statement evaluation", ret_val );
+		return -1;
+	}
+
+	return 0;
+}
+
+/***********************************************************/
+/*  Name        : roadmap_tile_store_batch_end
+ *  Purpose     : Interface function. Commits or rollbacks the bulk storage transaction
+ *  Params		: [in] fips
+ *  			: [in] commit - FALSE to discard the batch
+ *				:
+ */
+int roadmap_tile_store_batch_end( int fips, BOOL commit )
+{
+	if ( !sgBatchStmt )
+	{
+		return -1;
+	}
+
+	sqlite3_finalize( sgBatchStmt );
+	sgBatchStmt = NULL;
+
+	if ( commit )
+	{
+		if ( !trans_commit() )
+		{
+			return -1;
+		}
+	}
+	else
+	{
+		trans_rollback();
+	}
+
+	return 0;
+}
@@ -41,6 +41,7 @@
 #include "tts_db.h"
 #include "tts_ui.h"
 #include "roadmap_path.h"
+#include "roadmap_file.h"
 #include "roadmap_time.h"
 #include "roadmap_hash.h"
 #include "roadmap_config.h"
@@ -625,6 +626,13 @@ void tts_clear_cache( void )
 {
    tts_cache_clear( NULL );
 }
+/*
+ ******************************************************************************
+ */
+int tts_pending_count( void )
+{
+   return tts_queue_count();
+}
 /*
  ******************************************************************************
  */
@@ -795,6 +803,27 @@ BOOL tts_text_available( const char* text, const char* voice_id )
    return result;
 }
 
+/*
+ ******************************************************************************
+*/
+int tts_text_size( const char* text, const char* voice_id )
+{
+   const TtsPath* tts_path;
+   int size;
+
+   if ( !tts_enabled() )
+      return 0;
+
+   // The providers store the audio in files ( see storage_type )
+   tts_path = tts_get_path( _parse_text( text ), voice_id );
+   if ( !tts_path || !tts_path->path[0] )
+      return 0;
+
+   size = roadmap_file_length( NULL, tts_path->path );
+
+   return ( size > 0 ) ? size : 0;
+}
+
 /*
  ******************************************************************************
  */
@@ -1020,6 +1049,15 @@ static void _queue_one( const char* text, TtsTextType text_type, TtsRequestCompl
 
    // Queue. Text duplicated in parser
    queue_idx = tts_queue_add( NULL, text );
+   if ( queue_idx < 0 )
+   {
+      if ( completed_cb )
+      {
+         completed_cb( user_context, TTS_RES_STATUS_ERROR, text );
+      }
+      free( (char*) text );
+      return;
+   }
 
    // Set the context
    sgUserCtxPool[queue_idx].completed_cb_count = 0;
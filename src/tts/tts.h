@@ -126,6 +126,15 @@ void tts_request_ex( const char* text, TtsTextType text_type, TtsRequestComplete
   */
  void tts_clear_cache( void );
 
+ /*
+  * Returns the number of texts waiting for the synthesis (queued or committed to the provider)
+  * Params:  void
+  *
+  *
+  * Returns: count of the pending texts
+  */
+ int tts_pending_count( void );
+
  /*
   * Returns path of the audio file for the supplied text and voice (if voice is NULL - current voice is applied)
   *
@@ -151,6 +160,14 @@ void tts_request_ex( const char* text, TtsTextType text_type, TtsRequestComplete
   * Returns: true if available
   */
  BOOL tts_text_available( const char* text, const char* voice_id );
+
+ /*
+  * Returns the size of the stored audio of the text for the supplied voice (can be null - using the current voice)
+  * Params:  text to look for
+  *          voice_id - voice of the audio to look for
+  * Returns: size in bytes, 0 if the text is not synthesized
+  */
+ int tts_text_size( const char* text, const char* voice_id );
  /*
   * Creates the playlist for the tts items
   * Params:  voice_id - voice_id of the playlist
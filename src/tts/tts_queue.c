@@ -311,6 +311,21 @@ int tts_queue_get_indexes( int indexes[], int indexes_size, int status )
    return match_count;
 }
 
+/*
+ ******************************************************************************
+ */
+int tts_queue_count( void )
+{
+   int i;
+   int count = 0;
+   for ( i = 0; i < TTS_QUEUE_SIZE; ++i )
+   {
+      if ( sgTtsQueue[i].busy )
+         count++;
+   }
+   return count;
+}
+
 /*
  ******************************************************************************
  */
@@ -133,6 +133,14 @@ int tts_queue_is_empty( int index );
  */
 int tts_queue_get_indexes( int indexes[], int indexes_size, int status );
 
+/*
+ * Returns the number of the entries in the queue (of any status)
+ * Params:  void
+ *
+ * Returns: Count of the entries
+ */
+int tts_queue_count( void );
+
 
 /*
  * Saves configuration, frees all dynamic allocations
@@ -35,6 +35,7 @@
 #include "roadmap_config.h"
 #include "roadmap_time.h"
 #include "roadmap_httpcopy_async.h"
+#include "roadmap_net.h"
 #include "roadmap_path.h"
 #include "Realtime/Realtime.h"
 #include "websvc_trans/web_date_format.h"
@@ -188,6 +189,9 @@ void tts_was_provider_init( void )
    roadmap_config_declare( "session", &WasProviderConfigProtocolVersion,
          WAS_TTS_CFG_PROTOCOL_VERSION_DEFAULT, NULL );
 
+   // The synthesis requests should not wait for the DNS
+   roadmap_net_prefetch( roadmap_config_get( &WasProviderConfigWebService ) );
+
    // Provider initialization
    sgWasProvider.batch_request_limit = WAS_TTS_BATCH_REQUESTS_LIMIT;
    sgWasProvider.provider_name = WAS_TTS_PROVIDER;
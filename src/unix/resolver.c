@@ -8,6 +8,17 @@
  *   TODO:: Rename to dnsresolver ?
  *   TODO:  Rename domain entry to resolver entry ?
  *
+ * The table is a cache of the resolved domains:
+ *   - A resolved address is used for RSLV_POSITIVE_TTL. After that it is still
+ *     returned (stale) while a new lookup refreshes it in the background.
+ *   - A failure is remembered for RSLV_NEGATIVE_TTL, so that connections to a
+ *     bad domain fail at once instead of waiting for the DNS again.
+ *   - When the table is full, the least recently used entry is replaced.
+ *
+ * The lookup threads only write the result of their entry. The main thread
+ * polls for the finished lookups, and calls the requests callbacks. A lookup
+ * that does not finish in time is given up: the thread is killed on Android,
+ * elsewhere it is detached and its late result is ignored.
  */
 #include "roadmap.h"
 #include "roadmap_hash.h"
@@ -18,25 +29,23 @@
 #include <errno.h>
 #include <netdb.h>
 #include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
 
 //======================== Local defines =========================
 
-#define RSLV_TABLE_SIZE             64          // Maximum size 255 (see messages related code )
+#define RSLV_TABLE_SIZE             64
 #define RSLV_DOMAIN_NAME_MAX_LEN    256
-#define RSLV_IP_ADDR_MAX_LEN        256
 #define RSLV_REQUEST_MAX_NUM        16
 #define RSLV_WATCHDOG_TIMEOUT       5000
+#define RSLV_POLL_TIMEOUT           100               // While lookups are running
 #define RSLV_HANDLER_TIMEOUT        30000
 #define RSLV_RETRY_COUNT            5
-#define RSLV_RETRY_PERIOD           30000             // 30 sec
 
-#define RSLV_MSG_RETRY_INDEX_SHIFT  8
-#define RSLV_MSG_ENTRY_ID_MASK      0x00FF
-#define RSLV_MSG_RETRY_INDEX_MASK   0xFF00
+#define RSLV_POSITIVE_TTL           600               // 10 min
+#define RSLV_NEGATIVE_TTL           30                // 30 sec
+#define RSLV_STALE_MAX              (24*3600)         // Stale address is used for a day at most
 
-#define RSLV_MSG_RETRY_INDEX( msg ) ( ( msg & RSLV_MSG_RETRY_INDEX_MASK ) >> RSLV_MSG_RETRY_INDEX_SHIFT )
-#define RSLV_MSG_BUILD( entry_id, retry_idx ) ( ( RSLV_MSG_RETRY_INDEX_MASK & (retry_idx<<RSLV_MSG_RETRY_INDEX_SHIFT) ) \
-                                                | ( RSLV_MSG_ENTRY_ID_MASK & entry_id ) )
 //======================== Local types ========================
 
 typedef struct
@@ -48,32 +57,42 @@ typedef ResolverRequest_t *ResolverRequest;
 
 typedef struct
 {
-//   int busy __attribute__ ((aligned(32)));   // Ensure this variable is aligned. Necessary to ensure the read/write is atomic-wise (one cycle)
-   int busy;
+   int busy;                                 // Lookup thread is running
+   int done;                                 // Lookup thread has finished. Note: This is updated in resolver thread
    char domain[RSLV_DOMAIN_NAME_MAX_LEN];    // Domain to resolve
-   in_addr_t ip_addr;                        // Resolved address. Note: This is updated in resolver thread
+   in_addr_t ip_addr;                        // Cached address (INADDR_NONE - failure)
+   in_addr_t lookup_addr;                    // Lookup result. Note: This is updated in resolver thread
+   time_t            expire_time;            // Cached result is refreshed after
+   time_t            stale_time;             // Cached address is not used after
+   time_t            last_used;
 
    pthread_t         thread_id;
+   int               launch_id;              // Matches the lookup thread to its entry
+   int               joinable;               // Lookup thread is to be joined
    time_t            start_time;
-   int               retry_index  __attribute__ ((aligned(32)));    // Ensure this variable is atomic-wise (one cycle) read/write
-                                                                    // Current retry number starting from 0
+   int               retry_index;            // Current retry number starting from 0
    int               request_count;
    ResolverRequest_t requests[RSLV_REQUEST_MAX_NUM];
 } ResolverEntry_t;
 
 typedef ResolverEntry_t* ResolverEntry;
-#define RSLV_ENTRY_INITIALIZER         { 0, {0}, INADDR_NONE, 0, 0, 0, 0, {{NULL, NULL}} }
 
 //======================== Globals ========================
 
 static ResolverEntry_t  sgResolverTable[RSLV_TABLE_SIZE];
 static RoadMapHash*    sgResolverHash = NULL;
+static pthread_mutex_t sgResolverLock = PTHREAD_MUTEX_INITIALIZER;
+static int             sgResolverRunning = 0;  // Lookup threads count
+static int             sgResolverLaunches = 0; // Lookup threads ever started
 
 //======================== Local Declarations ========================
 static ResolverEntry _find_entry( const char* domain );
+static ResolverEntry _new_entry( const char* domain );
 static void *_resolver( void* params );
 static int _find_empty( void );
-static void _start_resolver( const char* domain, ResolverRequestCb callback, const void* context );
+static BOOL _start_resolver( ResolverEntry entry );
+static BOOL _add_request( ResolverEntry entry, ResolverRequestCb callback, const void* context );
+static void _poll( void );
 static void _watchdog( void );
 static void _reset_entry( ResolverEntry entry );
 static void _reset_table( void );
@@ -85,7 +104,6 @@ static BOOL _restart_resolver( int entry_id );
 void resolver_init( void )
 {
    sgResolverHash = roadmap_hash_new( "RESOLVER TABLE", RSLV_TABLE_SIZE );
-   roadmap_main_set_periodic( RSLV_WATCHDOG_TIMEOUT, _watchdog );
    _reset_table();
 }
 
@@ -94,43 +112,46 @@ void resolver_init( void )
  */
 void resolver_shutdown( void )
 {
+   if ( sgResolverRunning )
+   {
+      roadmap_main_remove_periodic( _poll );
+      roadmap_main_remove_periodic( _watchdog );
+   }
    roadmap_hash_free( sgResolverHash );
+   sgResolverHash = NULL;
 }
 /*
  ******************************************************************************
  */
-void resolver_handler( int msg )
+void resolver_handler( int entry_id )
 {
    int i;
-   int entry_id = msg & RSLV_MSG_ENTRY_ID_MASK;
-   int retry_idx = RSLV_MSG_RETRY_INDEX( msg );
    ResolverEntry entry = &sgResolverTable[entry_id];
    ResolverRequestCb cb;
    const void *ctx;
-   struct in_addr addr = {entry->ip_addr};
-   time_t timeout = time( NULL ) - entry->start_time;
+   in_addr_t ip_addr;
+   struct in_addr addr;
+   time_t now = time( NULL );
+   int request_count;
+   ResolverRequest_t requests[RSLV_REQUEST_MAX_NUM];
 
-   roadmap_log( ROADMAP_INFO, "Resolver handler is called for entry %d. Domain '%s' is resolved to %s (%s) within: %d msec.\n" \
-         "Current retry index: %d, reported retry index: %d",
-         entry_id, entry->domain, inet_ntoa( addr ),
-         entry->ip_addr == INADDR_NONE ? "Failure" : "Success",
-         timeout, entry->retry_index, retry_idx );
+   pthread_mutex_lock( &sgResolverLock );
+   ip_addr = entry->lookup_addr;
+   entry->done = 0;
+   pthread_mutex_unlock( &sgResolverLock );
 
-   if ( retry_idx != entry->retry_index )
-   {
-      roadmap_log( ROADMAP_WARNING, "Mismatch in retry indexes (%d, %d). This handling message is obsolete - dismissing",
-            entry->retry_index, retry_idx );
-      return;
-   }
+   addr.s_addr = ip_addr;
+   roadmap_log( ROADMAP_INFO, "Resolver handler is called for entry %d. Domain '%s' is resolved to %s (%s) within: %d sec. Retry: %d",
+         entry_id, entry->domain, inet_ntoa( addr ),
+         ip_addr == INADDR_NONE ? "Failure" : "Success",
+         (int) ( now - entry->start_time ), entry->retry_index );
 
-   // If any retries remain - give a chance
-   if ( entry->ip_addr == INADDR_NONE ) //Failure
+   // If any retries remain - give a chance. Not when there is a (stale) address to use meanwhile
+   if ( ip_addr == INADDR_NONE && entry->ip_addr == INADDR_NONE && entry->request_count > 0 )
    {
       if ( entry->retry_index < RSLV_RETRY_COUNT )
       {
          // AGA TODO:: Apply retry after timeout ?
-         // Now the intention is to apply retry after timeout
-         // Check can be added for the time passed from the last handler thread start
          if ( _restart_resolver( entry_id ) )
             return;
       }
@@ -141,81 +162,221 @@ void resolver_handler( int msg )
       }
    }
 
-   for ( i = 0; i < entry->request_count; ++i )
+   if ( ip_addr != INADDR_NONE )
+   {
+      entry->ip_addr = ip_addr;
+      entry->expire_time = now + RSLV_POSITIVE_TTL;
+      entry->stale_time = entry->expire_time + RSLV_STALE_MAX;
+   }
+   else if ( entry->ip_addr != INADDR_NONE && now < entry->stale_time )
    {
-      cb = entry->requests[i].cb;
-      ctx = entry->requests[i].context;
+      // Keep the stale address, try again later
+      entry->expire_time = now + RSLV_NEGATIVE_TTL;
+   }
+   else
+   {
+      entry->ip_addr = INADDR_NONE;
+      entry->expire_time = now + RSLV_NEGATIVE_TTL;
+   }
+
+   entry->busy = 0;  // Not busy any more
+   entry->retry_index = 0;
+
+   // The callbacks may issue new requests
+   request_count = entry->request_count;
+   memcpy( requests, entry->requests, request_count * sizeof( ResolverRequest_t ) );
+   entry->request_count = 0;
+   ip_addr = entry->ip_addr;
+
+   for ( i = 0; i < request_count; ++i )
+   {
+      cb = requests[i].cb;
+      ctx = requests[i].context;
 
       if ( cb )
-         cb( ctx, entry->ip_addr );
+         cb( ctx, ip_addr );
    }
+}
+
+/*
+ ******************************************************************************
+ */
+int resolver_lookup( const char* domain, in_addr_t* ip_addr )
+{
+   ResolverEntry entry = _find_entry( domain );
+   time_t now = time( NULL );
+
+   *ip_addr = INADDR_NONE;
+
+   if ( !entry || ( entry->busy && entry->ip_addr == INADDR_NONE ) )
+      return 0;
+
+   entry->last_used = now;
 
-   if ( entry->ip_addr == INADDR_NONE ) // Failure
+   if ( entry->ip_addr == INADDR_NONE )
    {
-      _reset_entry( entry );
+      if ( now < entry->expire_time )
+         return -1;
+
+      return 0;   // Failure has expired
    }
-   else  // Add to hash
+
+   if ( now >= entry->stale_time )
+      return 0;
+
+   if ( now >= entry->expire_time && !entry->busy )
    {
-      entry->busy = 0;  // Not busy any more
-      entry->request_count = 0;
-      roadmap_hash_add( sgResolverHash, roadmap_hash_string( entry->domain ), entry_id );
+      // Stale - refresh it for the next time
+      _start_resolver( entry );
    }
 
+   *ip_addr = entry->ip_addr;
+   return 1;
 }
-
 /*
  ******************************************************************************
  */
 in_addr_t resolver_find( const char* domain )
 {
-   in_addr_t ip_addr = INADDR_NONE;
-   ResolverEntry entry = NULL;
-   entry = _find_entry( domain );
+   in_addr_t ip_addr;
 
-   if ( entry && !entry->busy )
-   {
-      ip_addr = entry->ip_addr;
-   }
+   resolver_lookup( domain, &ip_addr );
 
    return ip_addr;
 }
 /*
  ******************************************************************************
  */
-in_addr_t resolver_request( const char* domain, ResolverRequestCb callback, const void* context )
+void resolver_store( const char* domain, in_addr_t ip_addr )
 {
-   in_addr_t ip_addr = INADDR_NONE;
-   ResolverEntry entry = NULL;
+   ResolverEntry entry = _find_entry( domain );
+
+   if ( !entry )
+      entry = _new_entry( domain );
+
+   if ( !entry )
+      return;
+
+   entry->ip_addr = ip_addr;
+   entry->expire_time = time( NULL ) + ( ip_addr == INADDR_NONE ? RSLV_NEGATIVE_TTL : RSLV_POSITIVE_TTL );
+   entry->stale_time = entry->expire_time + RSLV_STALE_MAX;
+   entry->last_used = time( NULL );
+}
+/*
+ ******************************************************************************
+ */
+void resolver_prefetch( const char* domain )
+{
+   ResolverEntry entry;
+
+   if ( !domain || !domain[0] || isdigit( domain[0] ) )
+      return;
 
    entry = _find_entry( domain );
 
-   if ( entry )
+   if ( !entry )
    {
-      if ( entry->busy > 0 ) // In process
+      entry = _new_entry( domain );
+      if ( entry )
+         _start_resolver( entry );
+   }
+   else if ( !entry->busy && time( NULL ) >= entry->expire_time )
+   {
+      _start_resolver( entry );
+   }
+}
+/*
+ ******************************************************************************
+ */
+void resolver_refresh( void )
+{
+   int i;
+   ResolverEntry entry;
+
+   for ( i = 0; i < RSLV_TABLE_SIZE; ++i )
+   {
+      entry = &sgResolverTable[i];
+      if ( !entry->domain[0] || entry->busy )
+         continue;
+
+      if ( entry->ip_addr == INADDR_NONE )
       {
-         if ( entry->request_count < RSLV_REQUEST_MAX_NUM )
-         {
-            ResolverRequest request = &entry->requests[entry->request_count];
-            request->cb = callback;
-            request->context = context;
-            entry->request_count++;
-         }
-         else // TODO:: Add error notification
-         {
-            roadmap_log( ROADMAP_ERROR, "Too many requests for the domain %s resolving", domain );
-         }
+         // The failures may be due to the previous network
+         entry->expire_time = 0;
       }
       else
       {
-         ip_addr = entry->ip_addr;
+         _start_resolver( entry );
       }
    }
-   else
+}
+/*
+ ******************************************************************************
+ */
+in_addr_t resolver_request( const char* domain, ResolverRequestCb callback, const void* context )
+{
+   in_addr_t ip_addr = INADDR_NONE;
+   ResolverEntry entry = NULL;
+   int res;
+
+   res = resolver_lookup( domain, &ip_addr );
+
+   if ( res > 0 )
+      return ip_addr;
+
+   if ( res < 0 )
    {
-      _start_resolver( domain, callback, context );
+      // Known failure
+      if ( callback )
+         callback( context, INADDR_NONE );
+      return INADDR_NONE;
    }
 
-   return ip_addr;
+   entry = _find_entry( domain );
+   if ( !entry )
+      entry = _new_entry( domain );
+
+   if ( !entry )
+   {
+      roadmap_log( ROADMAP_ERROR, "Cannot find empty entry for the new domain: %s", domain );
+      if ( callback )
+         callback( context, INADDR_NONE );
+      return INADDR_NONE;
+   }
+
+   if ( !_add_request( entry, callback, context ) )
+   {
+      if ( callback )
+         callback( context, INADDR_NONE );
+      return INADDR_NONE;
+   }
+
+   if ( !entry->busy && !_start_resolver( entry ) )
+   {
+      // Only this request is waiting for the entry
+      entry->request_count = 0;
+      if ( callback )
+         callback( context, INADDR_NONE );
+   }
+
+   return INADDR_NONE;
+}
+/*
+ ******************************************************************************
+ */
+static BOOL _add_request( ResolverEntry entry, ResolverRequestCb callback, const void* context )
+{
+   if ( entry->request_count < RSLV_REQUEST_MAX_NUM )
+   {
+      ResolverRequest request = &entry->requests[entry->request_count];
+      request->cb = callback;
+      request->context = context;
+      entry->request_count++;
+      return TRUE;
+   }
+
+   roadmap_log( ROADMAP_ERROR, "Too many requests for the domain %s resolving", entry->domain );
+   return FALSE;
 }
 /*
  ******************************************************************************
@@ -225,7 +386,7 @@ static ResolverEntry _find_entry( const char* domain )
    ResolverEntry entry = NULL;
    int i, hash;
 
-   if ( domain == NULL )
+   if ( domain == NULL || sgResolverHash == NULL )
       return NULL;
 
    hash = roadmap_hash_string ( domain );
@@ -243,6 +404,35 @@ static ResolverEntry _find_entry( const char* domain )
 
    return entry;
 }
+/*
+ ******************************************************************************
+ */
+static ResolverEntry _new_entry( const char* domain )
+{
+   int entry_id;
+   ResolverEntry entry;
+
+   if ( domain == NULL || sgResolverHash == NULL || strlen( domain ) >= RSLV_DOMAIN_NAME_MAX_LEN )
+      return NULL;
+
+   entry_id = _find_empty();
+   if ( entry_id < 0 )
+      return NULL;
+
+   entry = &sgResolverTable[entry_id];
+   if ( entry->domain[0] )
+   {
+      roadmap_hash_remove( sgResolverHash, roadmap_hash_string( entry->domain ), entry_id );
+      _reset_entry( entry );
+   }
+
+   strncpy_safe( entry->domain, domain, sizeof( entry->domain ) );
+   entry->last_used = time( NULL );
+   roadmap_hash_add( sgResolverHash, roadmap_hash_string( entry->domain ), entry_id );
+
+   return entry;
+}
+#ifdef ANDROID
 /*
  ******************************************************************************
  * Android workaround due to absence of pthread_cancel
@@ -252,69 +442,74 @@ static void _resolver_exit_handler(int sig)
 {
    pthread_exit(0);
 }
+#endif
 /*
  ******************************************************************************
  */
 static void *_resolver( void* params )
 {
-   int entry_id = (int) params;
+   int entry_id = (int) (long) params;
    ResolverEntry entry = &sgResolverTable[entry_id];
-   struct hostent *host = NULL;
+   char domain[RSLV_DOMAIN_NAME_MAX_LEN];
    in_addr_t ip_addr = INADDR_NONE;
-   struct sigaction actions;
-   int retry_idx;
-   int msg;
-
-   // This is very important to save the retry_index here. It's used to match thread and resolving request
-   // For example If the thread will stuck on gethostbyname
-   // But afterwards will send the message just before being killed due to timeout, the retry_idx in the sgResolverTable[entry_id]
-   // will be already different.
-   retry_idx = entry->retry_index;
-
-   // AGA DEBUG
-//   roadmap_log( ROADMAP_WARNING, "Started resolver for: %s. Retry: %d. Thread id: %ld",
-//         entry->domain, entry->retry_index, pthread_self() );
+   int launch_id;
+
+   // This is very important to save the launch_id here. It's used to match thread and resolving request
+   // For example If the thread will stuck on the lookup and will be given up by the watchdog
+   // But afterwards will write the result, the launch_id in the sgResolverTable[entry_id]
+   // will be already different (even if the entry is used for another domain meanwhile).
+   pthread_mutex_lock( &sgResolverLock );
+   launch_id = entry->launch_id;
+   strncpy_safe( domain, entry->domain, sizeof( domain ) );
+   pthread_mutex_unlock( &sgResolverLock );
+
+#ifdef ANDROID
 /*
  * AGA Comment. No pthread_cancel in android - using _kill ( SIGTERM )
- * instead
+ * instead. The handler is process wide: it is only installed on Android,
+ * where the application does not use SIGTERM.
  */
+   {
+      struct sigaction actions;
+      memset( &actions, 0, sizeof(actions) );
+      sigemptyset( &actions.sa_mask );
+      actions.sa_flags = 0;
+      actions.sa_handler = _resolver_exit_handler;
+      sigaction( SIGTERM, &actions, NULL );
+   }
+#endif
 
-//   pthread_setcancelstate( PTHREAD_CANCEL_ENABLE, NULL );
-//   pthread_setcanceltype( PTHREAD_CANCEL_ASYNCHRONOUS, NULL );
-
-   memset( &actions, 0, sizeof(actions) );
-   sigemptyset( &actions.sa_mask );
-   actions.sa_flags = 0;
-   actions.sa_handler = _resolver_exit_handler;
-   sigaction( SIGTERM, &actions, NULL );
-
-   if ( isdigit( entry->domain[0] ) )
+   if ( isdigit( domain[0] ) )
    {
-      ip_addr = inet_addr( entry->domain );
+      ip_addr = inet_addr( domain );
    }
    else
    {
-      struct in_addr addr;
-      host = gethostbyname( entry->domain );
+      // Unlike gethostbyname, getaddrinfo is safe with several lookup threads
+      struct addrinfo hints;
+      struct addrinfo *result = NULL;
+
+      memset( &hints, 0, sizeof( hints ) );
+      hints.ai_family = AF_INET;
+      hints.ai_socktype = SOCK_STREAM;
 
-      if ( host )
+      if ( getaddrinfo( domain, NULL, &hints, &result ) == 0 && result )
       {
-         memcpy ( &addr , host->h_addr, host->h_length );
-         ip_addr = addr.s_addr;
+         ip_addr = ((struct sockaddr_in *) result->ai_addr)->sin_addr.s_addr;
       }
+
+      if ( result )
+         freeaddrinfo( result );
    }
 
    // Cancellation point !!!!
-   if ( entry->retry_index != retry_idx )
+   pthread_mutex_lock( &sgResolverLock );
+   if ( entry->launch_id == launch_id && entry->busy )
    {
-      return NULL;
+      entry->lookup_addr = ip_addr;
+      entry->done = 1;
    }
-
-   entry->ip_addr = ip_addr;
-
-   // Notify the main thread on completion
-   msg = RSLV_MSG_BUILD( entry_id, retry_idx );
-   roadmap_main_post_resolver_result( msg );
+   pthread_mutex_unlock( &sgResolverLock );
 
    return NULL;
 }
@@ -322,38 +517,54 @@ static void *_resolver( void* params )
 /*
  ******************************************************************************
  */
-static void _start_resolver( const char* domain, ResolverRequestCb callback, const void* context )
+static BOOL _launch( int entry_id )
 {
    pthread_t thread_id;
    int res;
-   int entry_id = _find_empty();
    ResolverEntry entry = &sgResolverTable[entry_id];
-   if ( entry_id >= 0 )
-   {
 
-      // Post the request
-      entry->busy = 1;
-      entry->start_time = time( NULL );
-      entry->request_count = 1;
-      entry->requests[0].cb = callback;
-      entry->requests[0].context = context;
-      strncpy_safe( entry->domain, domain, sizeof( entry->domain ) );
-      res = pthread_create( &thread_id, NULL, _resolver, (void*) entry_id );
-      entry->thread_id = thread_id;
+   // Post the request
+   pthread_mutex_lock( &sgResolverLock );
+   entry->busy = 1;
+   entry->done = 0;
+   entry->lookup_addr = INADDR_NONE;
+   entry->launch_id = ++sgResolverLaunches;
+   pthread_mutex_unlock( &sgResolverLock );
 
-      roadmap_log( ROADMAP_INFO, "Started resolver thread %ld with result %d. Domain '%s'. Callback: 0x%x",
-            entry->thread_id, res, domain, callback );
+   entry->start_time = time( NULL );
+   res = pthread_create( &thread_id, NULL, _resolver, (void*) (long) entry_id );
 
-      if ( res < 0 )
-      {
-         _reset_entry( entry );
-         roadmap_log( ROADMAP_ERROR, "Error starting thread. Error: %d ( %s )", errno, strerror( errno ) );
-      }
+   if ( res != 0 )
+   {
+      entry->busy = 0;
+      roadmap_log( ROADMAP_ERROR, "Error starting resolver thread. Error: %d ( %s )", res, strerror( res ) );
+      return FALSE;
    }
-   else
+
+   entry->thread_id = thread_id;
+   entry->joinable = 1;
+
+   if ( sgResolverRunning++ == 0 )
    {
-      roadmap_log( ROADMAP_ERROR, "Cannot find empty entry for the new domain: %s", domain );
+      roadmap_main_set_periodic( RSLV_POLL_TIMEOUT, _poll );
+      roadmap_main_set_periodic( RSLV_WATCHDOG_TIMEOUT, _watchdog );
    }
+
+   return TRUE;
+}
+/*
+ ******************************************************************************
+ */
+static BOOL _start_resolver( ResolverEntry entry )
+{
+   int entry_id = (int) ( entry - sgResolverTable );
+
+   entry->retry_index = 0;
+
+   roadmap_log( ROADMAP_INFO, "Starting resolver. Domain '%s'. Requests: %d",
+         entry->domain, entry->request_count );
+
+   return _launch( entry_id );
 }
 
 /*
@@ -361,44 +572,36 @@ static void _start_resolver( const char* domain, ResolverRequestCb callback, con
  */
 static BOOL _restart_resolver( int entry_id )
 {
-   pthread_t thread_id;
-   int res;
    ResolverEntry entry = &sgResolverTable[entry_id];
-   // Post the request
-   entry->busy = 1;
-   entry->start_time = time( NULL );
+
    entry->retry_index++;
-   entry->ip_addr = INADDR_NONE;
-   res = pthread_create( &thread_id, NULL, _resolver, (void*) entry_id );
-   entry->thread_id = thread_id;
 
-   roadmap_log( ROADMAP_INFO, "Retry: %d. Restarted resolver thread %d with result %d. Domain '%s'.",
-         entry->retry_index, entry->thread_id, res, entry->domain );
+   roadmap_log( ROADMAP_INFO, "Retry: %d. Restarting resolver. Domain '%s'.",
+         entry->retry_index, entry->domain );
 
-   if ( res != 0 )
-   {
-      _reset_entry( entry );
-      roadmap_log( ROADMAP_ERROR, "Error restarting thread. Error: %d ( %s )", errno, strerror( errno ) );
-   }
-   return ( res == 0 );
+   return _launch( entry_id );
 }
 
-
 /*
  ******************************************************************************
+ * Free entry, or the least recently used entry which is not being resolved
  */
 static int _find_empty( void )
 {
-   int i = -1;
+   int i;
+   int lru = -1;
    ResolverEntry entry = NULL;
 
    for ( i = 0; i < RSLV_TABLE_SIZE; ++i )
    {
       entry = &sgResolverTable[i];
       if ( !entry->busy && !entry->domain[0] )
-         break;
+         return i;
+
+      if ( !entry->busy && ( lru < 0 || entry->last_used < sgResolverTable[lru].last_used ) )
+         lru = i;
    }
-   return i;
+   return lru;
 }
 /*
  ******************************************************************************
@@ -408,10 +611,52 @@ static void _reset_entry( ResolverEntry entry )
    if ( entry )
    {
       entry->busy = 0;
+      entry->done = 0;
       entry->domain[0] = 0;
       entry->ip_addr = INADDR_NONE;
+      entry->lookup_addr = INADDR_NONE;
+      entry->expire_time = 0;
+      entry->stale_time = 0;
+      entry->last_used = 0;
       entry->request_count = 0;
       entry->retry_index = 0;
+      entry->joinable = 0;
+   }
+}
+/*
+ ******************************************************************************
+ * Lookup threads were running: handle the finished ones
+ */
+static void _poll( void )
+{
+   int i;
+   ResolverEntry entry;
+   int done;
+
+   for ( i = 0; i < RSLV_TABLE_SIZE; ++i )
+   {
+      entry = &sgResolverTable[i];
+      if ( entry->busy == 0 )
+         continue;
+
+      pthread_mutex_lock( &sgResolverLock );
+      done = entry->done;
+      pthread_mutex_unlock( &sgResolverLock );
+
+      if ( !done )
+         continue;
+
+      if ( entry->joinable )
+         pthread_join( entry->thread_id, NULL );
+      entry->joinable = 0;
+      resolver_handler( i );   // May start a new lookup
+      sgResolverRunning--;
+   }
+
+   if ( sgResolverRunning == 0 )
+   {
+      roadmap_main_remove_periodic( _poll );
+      roadmap_main_remove_periodic( _watchdog );
    }
 }
 /*
@@ -423,12 +668,11 @@ static void _watchdog( void )
    ResolverEntry entry;
    time_t timeout;
    int res;
-   int msg;
 
    for ( i = 0; i < RSLV_TABLE_SIZE; ++i )
    {
       entry = &sgResolverTable[i];
-      if ( entry->busy == 0 ) // Not busy go to next
+      if ( entry->busy == 0 || entry->done ) // Not busy or already finished - go to next
          continue;
 
       timeout = 1000*( time( NULL ) - entry->start_time );
@@ -439,16 +683,29 @@ static void _watchdog( void )
       roadmap_log( ROADMAP_WARNING, "Timeout passed in resolving domain '%s'. Cancelling thread: %d",
             entry->domain, entry->thread_id );
 
-//      pthread_cancel( entry->thread_id );
+      // The thread result is ignored from now
+      pthread_mutex_lock( &sgResolverLock );
+      entry->launch_id = ++sgResolverLaunches;
+      entry->lookup_addr = INADDR_NONE;
+      entry->done = 1;
+      pthread_mutex_unlock( &sgResolverLock );
+
+#ifdef ANDROID
       if ( ( res = pthread_kill( entry->thread_id, SIGTERM ) ) != 0 )
       {
          roadmap_log( ROADMAP_ERROR, "Error cancelling resolver thread %d, error = %d (%s)",
                entry->thread_id, res, strerror( res ) );
       }
-      pthread_join( entry->thread_id, NULL );  // Wait for the thread to completely terminate
-
-      msg = RSLV_MSG_BUILD( i, entry->retry_index );
-      resolver_handler( msg );
+      // The thread is joined by _poll()
+#else
+      // getaddrinfo() may not return at all: leave the thread to itself
+      if ( ( res = pthread_detach( entry->thread_id ) ) != 0 )
+      {
+         roadmap_log( ROADMAP_ERROR, "Error detaching resolver thread %d, error = %d (%s)",
+               entry->thread_id, res, strerror( res ) );
+      }
+      entry->joinable = 0;
+#endif
    }
 }
 /*
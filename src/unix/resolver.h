@@ -13,10 +13,30 @@
 
 typedef void (*ResolverRequestCb) ( const void* context, in_addr_t ip_addr );
 
+/*
+ * Returns the cached address of the domain, or INADDR_NONE. In the later case the callback
+ * is called when the domain is resolved (immediately for a domain which recently failed,
+ * or when the request cannot be queued)
+ */
 in_addr_t resolver_request( const char* domain, ResolverRequestCb callback, const void* context );
-void resolver_handler( int msg );
+void resolver_handler( int entry_id );
 void resolver_shutdown( void );
 void resolver_init( void );
 in_addr_t resolver_find( const char* domain );
 
+/*
+ * Cache only lookup. Returns 1 and the address if it is cached, -1 if the domain
+ * recently failed, 0 if unknown. An expired address is still returned, and refreshed.
+ */
+int resolver_lookup( const char* domain, in_addr_t* ip_addr );
+
+/* Caches the result of a lookup made by the caller (INADDR_NONE - failure) */
+void resolver_store( const char* domain, in_addr_t ip_addr );
+
+/* Resolves the domain in the background, if not cached */
+void resolver_prefetch( const char* domain );
+
+/* Network has changed: refreshes the cached addresses, forgets the failures */
+void resolver_refresh( void );
+
 #endif /* INCLUDE__RESOLVER__H */
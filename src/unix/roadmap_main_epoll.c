@@ -0,0 +1,538 @@
+/* roadmap_main_epoll.c - The main loop of the application, without a display.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The same input, output and periodic services as the GTK main loop,
+ *   on top of a Linux epoll set: each periodic callback is a timerfd, and
+ *   the inputs and outputs are watched file descriptors. There is no
+ *   window: the AGG canvas draws in memory (as in roadmap_bench.c). This
+ *   file does not use GTK, and is built without it.
+ *
+ *   This lets the navigation, realtime and tile download code run as a
+ *   plain process, e.g. many simulated clients on a machine for server
+ *   load tests, or timed runs in the CI. Ctrl-C (or a SIGTERM) exits as
+ *   the GUI would.
+ *
+ *   Compiled with ROADMAP_HEADLESS_DRIVER, there is no main(): a test or
+ *   benchmark driver calls roadmap_main_headless_initialize() and
+ *   roadmap_main_headless_run() itself (see roadmap_main_epoll.h).
+ *
+ * SYNOPSYS:
+ *
+ *   gtkroadmap-headless [--headless-size=WIDTHxHEIGHT]
+ *                       [--headless-duration=SECONDS]
+ *                       [roadmap options]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+#include "roadmap.h"
+#include "roadmap_start.h"
+#include "roadmap_net.h"
+#include "roadmap_canvas.h"
+
+#include "roadmap_main.h"
+#include "roadmap_main_epoll.h"
+
+
+/* The epoll data of a timer or of the signals; the others are a file. */
+#define HEADLESS_TIMER_TAG    0x100000000ULL
+#define HEADLESS_SIGNAL_TAG   0x200000000ULL
+
+#define HEADLESS_MAX_EVENTS   32
+
+
+struct roadmap_main_io {
+   int fd;
+   int events;    /* EPOLLIN or EPOLLOUT */
+   RoadMapIO io;
+   RoadMapInput callback;
+   time_t start_time;
+};
+
+#define ROADMAP_MAX_IO 32
+static struct roadmap_main_io RoadMapMainIo[ROADMAP_MAX_IO];
+
+
+struct roadmap_main_timer {
+   int fd;
+   RoadMapCallback callback;
+};
+
+#define ROADMAP_MAX_TIMER 32
+static struct roadmap_main_timer RoadMapMainPeriodicTimer[ROADMAP_MAX_TIMER];
+
+
+static int HeadlessEpoll  = -1;
+static int HeadlessSignal = -1;
+static int HeadlessExit   = 0;
+
+static int HeadlessWidth    = 480;
+static int HeadlessHeight   = 800;
+#ifndef ROADMAP_HEADLESS_DRIVER
+static int HeadlessDuration = 0;
+#endif
+
+int USING_PHONE_KEYPAD = 0;
+
+
+/* The GUI, without a window. ---------------------------------------------- */
+
+void roadmap_main_toggle_full_screen (void) {}
+
+void roadmap_main_new (const char *title, int width, int height) {}
+
+void roadmap_main_set_keyboard (struct RoadMapFactoryKeyMap *bindings,
+                                RoadMapKeyInput callback) {}
+
+RoadMapMenu roadmap_main_new_menu (void) {
+
+   return NULL;
+}
+
+void roadmap_main_free_menu (RoadMapMenu menu) {}
+
+void roadmap_main_add_menu (RoadMapMenu menu, const char *label) {}
+
+void roadmap_main_add_menu_item (RoadMapMenu menu,
+                                 const char *label,
+                                 const char *tip,
+                                 RoadMapCallback callback) {}
+
+void roadmap_main_popup_menu (RoadMapMenu menu, int x, int y) {}
+
+void roadmap_main_add_separator (RoadMapMenu menu) {}
+
+void roadmap_main_add_tool (const char *label,
+                            const char *icon,
+                            const char *tip,
+                            RoadMapCallback callback) {}
+
+void roadmap_main_add_tool_space (void) {}
+
+void roadmap_main_add_canvas (void) {}
+
+void roadmap_main_add_status (void) {}
+
+void roadmap_main_show (void) {}
+
+void roadmap_gui_minimize (void) {}
+
+void roadmap_gui_maximize (void) {}
+
+void roadmap_main_minimize (void) {}
+
+BOOL roadmap_horizontal_screen_orientation () {
+
+   return HeadlessWidth > HeadlessHeight;
+}
+
+void roadmap_main_set_status (const char *text) {}
+
+void roadmap_main_set_cursor (int cursor) {}
+
+
+/* The inputs and outputs. ------------------------------------------------- */
+
+/* An fd may be watched for input and for output at the same time: the
+ * epoll set holds the union of its watches.
+ */
+static void headless_watch_update (int fd) {
+
+   struct epoll_event event;
+   int i;
+   int events = 0;
+
+   for (i = 0; i < ROADMAP_MAX_IO; ++i) {
+      if (RoadMapMainIo[i].io.subsystem != ROADMAP_IO_INVALID &&
+          RoadMapMainIo[i].fd == fd) {
+         events |= RoadMapMainIo[i].events;
+      }
+   }
+
+   memset (&event, 0, sizeof(event));
+   event.events = events;
+   event.data.u64 = (uint64_t) fd;
+
+   if (events == 0) {
+      /* The fd may have been closed already, which removed it. */
+      epoll_ctl (HeadlessEpoll, EPOLL_CTL_DEL, fd, &event);
+
+   } else if (epoll_ctl (HeadlessEpoll, EPOLL_CTL_MOD, fd, &event) < 0) {
+
+      if (epoll_ctl (HeadlessEpoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+         roadmap_log (ROADMAP_ERROR, "cannot watch fd %d, errno = %d", fd, errno);
+      }
+   }
+}
+
+
+static void set_io_handler (RoadMapIO *io, int events, RoadMapInput callback) {
+
+   int i;
+   int fd = io->os.file; /* All the same on UNIX. */
+
+   if (io->subsystem == ROADMAP_IO_NET)
+      fd = roadmap_net_get_fd (io->os.socket);
+
+   for (i = 0; i < ROADMAP_MAX_IO; ++i) {
+      if (RoadMapMainIo[i].io.subsystem == ROADMAP_IO_INVALID) {
+         io->data = &RoadMapMainIo[i];
+         RoadMapMainIo[i].fd = fd;
+         RoadMapMainIo[i].events = events;
+         RoadMapMainIo[i].io = *io;
+         RoadMapMainIo[i].callback = callback;
+         RoadMapMainIo[i].start_time = events == EPOLLOUT ? time(NULL) : 0;
+         headless_watch_update (fd);
+         return;
+      }
+   }
+
+   roadmap_log (ROADMAP_ERROR, "Too many inputs and outputs");
+}
+
+void roadmap_main_set_input (RoadMapIO *io, RoadMapInput callback) {
+
+   set_io_handler (io, EPOLLIN, callback);
+}
+
+void roadmap_main_set_output (RoadMapIO *io, RoadMapInput callback, BOOL is_connected) {
+
+   set_io_handler (io, EPOLLOUT, callback);
+}
+
+void roadmap_main_remove_input (RoadMapIO *io) {
+
+   struct roadmap_main_io *r = io->data;
+
+   if (r == NULL || r->io.subsystem == ROADMAP_IO_INVALID) return;
+
+   r->io.os.file = -1;
+   r->io.subsystem = ROADMAP_IO_INVALID;
+   headless_watch_update (r->fd);
+   r->fd = -1;
+}
+
+RoadMapIO *roadmap_main_output_timedout (time_t timeout) {
+
+   int i;
+
+   for (i = 0; i < ROADMAP_MAX_IO; ++i)
+      if (RoadMapMainIo[i].io.subsystem != ROADMAP_IO_INVALID &&
+          RoadMapMainIo[i].start_time &&
+          timeout > RoadMapMainIo[i].start_time)
+         return &RoadMapMainIo[i].io;
+
+   return NULL;
+}
+
+
+static void headless_io_event (int fd, uint32_t events) {
+
+   int i;
+
+   /* Errors and hang ups are reported to both the reader and the writer. */
+   if (events & (EPOLLERR | EPOLLHUP)) events |= EPOLLIN | EPOLLOUT;
+
+   for (i = 0; i < ROADMAP_MAX_IO; ++i) {
+
+      struct roadmap_main_io *r = RoadMapMainIo + i;
+
+      if (r->io.subsystem != ROADMAP_IO_INVALID &&
+          r->fd == fd &&
+          (r->events & events)) {
+         /* The callback may remove (or replace) this watch. */
+         (*r->callback) (&r->io);
+      }
+   }
+}
+
+
+/* The periodic callbacks. ------------------------------------------------- */
+
+void roadmap_main_set_periodic (int interval, RoadMapCallback callback) {
+
+   int index;
+   struct roadmap_main_timer *timer = NULL;
+   struct itimerspec period;
+   struct epoll_event event;
+
+   for (index = 0; index < ROADMAP_MAX_TIMER; ++index) {
+
+      if (RoadMapMainPeriodicTimer[index].callback == callback) {
+         return;
+      }
+      if (timer == NULL) {
+         if (RoadMapMainPeriodicTimer[index].callback == NULL) {
+            timer = RoadMapMainPeriodicTimer + index;
+         }
+      }
+   }
+
+   if (timer == NULL) {
+      roadmap_log (ROADMAP_FATAL, "Timer table saturated");
+   }
+
+   if (timer->fd < 0) {
+
+      timer->fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      if (timer->fd < 0) {
+         roadmap_log (ROADMAP_FATAL, "cannot create a timer, errno = %d", errno);
+      }
+
+      memset (&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      event.data.u64 = HEADLESS_TIMER_TAG | (uint64_t) (timer - RoadMapMainPeriodicTimer);
+      epoll_ctl (HeadlessEpoll, EPOLL_CTL_ADD, timer->fd, &event);
+   }
+
+   if (interval <= 0) interval = 1;
+
+   period.it_interval.tv_sec = interval / 1000;
+   period.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+   period.it_value = period.it_interval;
+   timerfd_settime (timer->fd, 0, &period, NULL);
+
+   timer->callback = callback;
+}
+
+void roadmap_main_remove_periodic (RoadMapCallback callback) {
+
+   int index;
+
+   for (index = 0; index < ROADMAP_MAX_TIMER; ++index) {
+
+      if (RoadMapMainPeriodicTimer[index].callback == callback) {
+
+         struct itimerspec stop;
+
+         /* Keep the timerfd for the next periodic callback. */
+         memset (&stop, 0, sizeof(stop));
+         timerfd_settime (RoadMapMainPeriodicTimer[index].fd, 0, &stop, NULL);
+         RoadMapMainPeriodicTimer[index].callback = NULL;
+
+         return;
+      }
+   }
+
+   roadmap_log (ROADMAP_ERROR, "timer 0x%08x not found", callback);
+}
+
+
+static void headless_timer_event (int index) {
+
+   struct roadmap_main_timer *timer = RoadMapMainPeriodicTimer + index;
+   uint64_t expirations;
+
+   /* Nothing to read if the timer was stopped or reset since the event. */
+   if (read (timer->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+      return;
+   }
+
+   /* A late loop calls once, as GTK does. */
+   if (timer->callback != NULL) {
+      (*timer->callback) ();
+   }
+}
+
+
+/* The loop. --------------------------------------------------------------- */
+
+static void headless_dispatch (int timeout) {
+
+   struct epoll_event events[HEADLESS_MAX_EVENTS];
+   int count;
+   int i;
+
+   count = epoll_wait (HeadlessEpoll, events, HEADLESS_MAX_EVENTS, timeout);
+
+   if (count < 0) {
+      if (errno != EINTR) {
+         roadmap_log (ROADMAP_ERROR, "epoll_wait failed, errno = %d", errno);
+      }
+      return;
+   }
+
+   for (i = 0; i < count && !HeadlessExit; ++i) {
+
+      uint64_t data = events[i].data.u64;
+
+      if (data & HEADLESS_TIMER_TAG) {
+
+         headless_timer_event ((int) (data & 0xffffffff));
+
+      } else if (data & HEADLESS_SIGNAL_TAG) {
+
+         struct signalfd_siginfo info;
+
+         if (read (HeadlessSignal, &info, sizeof(info)) == sizeof(info)) {
+            roadmap_log (ROADMAP_WARNING, "signal %d, exiting", info.ssi_signo);
+            roadmap_main_exit ();
+         }
+
+      } else {
+
+         headless_io_event ((int) data, events[i].events);
+      }
+   }
+}
+
+
+void roadmap_main_flush (void) {
+
+   if (!HeadlessExit) headless_dispatch (0);
+}
+
+
+void roadmap_main_exit (void) {
+
+   static int exit_done;
+
+   if (!exit_done++) {
+      roadmap_start_exit ();
+      HeadlessExit = 1;
+   }
+}
+
+
+void roadmap_main_headless_initialize (void) {
+
+   int i;
+   sigset_t signals;
+   struct epoll_event event;
+
+   for (i = 0; i < ROADMAP_MAX_IO; ++i) {
+      RoadMapMainIo[i].fd = -1;
+      RoadMapMainIo[i].io.os.file = -1;
+      RoadMapMainIo[i].io.subsystem = ROADMAP_IO_INVALID;
+   }
+
+   for (i = 0; i < ROADMAP_MAX_TIMER; ++i) {
+      RoadMapMainPeriodicTimer[i].fd = -1;
+   }
+
+   HeadlessEpoll = epoll_create (ROADMAP_MAX_IO + ROADMAP_MAX_TIMER);
+   if (HeadlessEpoll < 0) {
+      fprintf (stderr, "cannot create the epoll set, errno = %d\n", errno);
+      exit (1);
+   }
+
+   /* Blocked before any thread starts, so that all threads inherit it. */
+   sigemptyset (&signals);
+   sigaddset (&signals, SIGINT);
+   sigaddset (&signals, SIGTERM);
+   sigprocmask (SIG_BLOCK, &signals, NULL);
+
+   HeadlessSignal = signalfd (-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+   if (HeadlessSignal >= 0) {
+      memset (&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      event.data.u64 = HEADLESS_SIGNAL_TAG;
+      epoll_ctl (HeadlessEpoll, EPOLL_CTL_ADD, HeadlessSignal, &event);
+   }
+}
+
+
+void roadmap_main_headless_run (void) {
+
+   while (!HeadlessExit) {
+      headless_dispatch (-1);
+   }
+}
+
+
+/* Leave the loop without roadmap_start_exit(), for a driver that did not
+ * call roadmap_start().
+ */
+void roadmap_main_headless_stop (void) {
+
+   HeadlessExit = 1;
+}
+
+
+#ifndef ROADMAP_HEADLESS_DRIVER
+
+static void headless_duration_expired (void) {
+
+   roadmap_log (ROADMAP_WARNING, "ran for %d seconds, exiting", HeadlessDuration);
+   roadmap_main_exit ();
+}
+
+
+/* Take out the options of the headless loop, the others go to roadmap_start(). */
+static int headless_options (int argc, char **argv) {
+
+   int i;
+   int count = 1;
+
+   for (i = 1; i < argc; i++) {
+
+      const char *option = argv[i];
+
+      if (!strncmp (option, "--headless-size=", 16)) {
+         if (sscanf (option + 16, "%dx%d", &HeadlessWidth, &HeadlessHeight) != 2 ||
+             HeadlessWidth <= 0 || HeadlessHeight <= 0) {
+            fprintf (stderr, "invalid size %s\n", option + 16);
+            exit (1);
+         }
+      } else if (!strncmp (option, "--headless-duration=", 20)) {
+         HeadlessDuration = atoi (option + 20);
+      } else {
+         argv[count++] = argv[i];
+      }
+   }
+
+   return count;
+}
+
+
+int main (int argc, char **argv) {
+
+   argc = headless_options (argc, argv);
+
+   roadmap_main_headless_initialize ();
+
+   roadmap_start (argc, argv);
+
+   roadmap_canvas_headless_configure (HeadlessWidth, HeadlessHeight);
+
+   if (HeadlessDuration > 0) {
+      roadmap_main_set_periodic (HeadlessDuration * 1000, headless_duration_expired);
+   }
+
+   roadmap_main_headless_run ();
+
+   return 0;
+}
+
+#endif // ROADMAP_HEADLESS_DRIVER
@@ -0,0 +1,40 @@
+/* roadmap_main_epoll.h - The main loop of the application, without a display.
+ *
+ * LICENSE:
+ *
+ *   Copyright 2010 Waze Ltd
+ *
+ *   This file is part of Waze.
+ *
+ *   Waze is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Waze is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Waze; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * DESCRIPTION:
+ *
+ *   The epoll main loop, for the test and benchmark drivers that have
+ *   their own main() (see roadmap_main_epoll.c).
+ */
+
+#ifndef INCLUDE__ROADMAP_MAIN_EPOLL__H
+#define INCLUDE__ROADMAP_MAIN_EPOLL__H
+
+void roadmap_main_headless_initialize (void);
+void roadmap_main_headless_run (void);
+
+/* Leave the loop without roadmap_start_exit(), for a driver that did not
+ * call roadmap_start().
+ */
+void roadmap_main_headless_stop (void);
+
+#endif // INCLUDE__ROADMAP_MAIN_EPOLL__H
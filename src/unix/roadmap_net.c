@@ -54,6 +54,7 @@
 #include "../websvc_trans/web_date_format.h"
 #include "roadmap_main.h"
 #include "roadmap_ssl.h"
+#include "resolver.h"
 
 #if defined(ANDROID) || defined(GTK)
 #define __SSL__
@@ -81,6 +82,20 @@ static RoadMapConfigDescriptor RoadMapConfigNetCompressEnabled =
 static int  RoadMapNetNumConnects;
 static BOOL RoadMapNetCompressEnabled = FALSE;
 
+/* Async connects waiting for the resolver. The resolver keeps the entry
+ * as its context: a cancelled connect only clears 'io'.
+ */
+#define ROADMAP_NET_MAX_RESOLVING   16
+
+typedef struct {
+   RoadMapIO *io;
+   BOOL       busy;
+   BOOL       starting;
+   BOOL       failed;
+} RoadMapNetResolving;
+
+static RoadMapNetResolving RoadMapNetResolvingTable[ROADMAP_NET_MAX_RESOLVING];
+
 static const char* GetProxyAddress() {
 #ifdef IPHONE
    return (roadmap_main_get_proxy ("http://www.waze.com"));
@@ -159,6 +174,7 @@ static void check_connect_timeout (void) {
       free(protocol);
       free(name);
       free(resolved_name);
+      free(reuse_connect_io);
       connect_callback(ROADMAP_INVALID_SOCKET, data);
    }
 }
@@ -242,10 +258,14 @@ static void io_connect_callback (RoadMapIO *io) {
 #endif
 }
 
+/* With 'unresolved', a host name which is not cached is not looked up:
+ * it is returned there (to be freed) instead of a socket.
+ */
 static RoadMapSocket create_socket (const char *protocol,
                                     const char *name,
                                     int default_port,
-                                    struct sockaddr *saddr) {
+                                    struct sockaddr *saddr,
+                                    char **unresolved) {
    int   s;
    char *hostname;
    char *separator = strchr (name, ':');
@@ -298,8 +318,36 @@ static RoadMapSocket create_socket (const char *protocol,
    }
 
    if (!isdigit(hostname[0])) {
-      roadmap_log(ROADMAP_INFO, "Calling gethostbyname:%s", hostname);
-      host = gethostbyname(hostname);
+
+      in_addr_t cached;
+
+      switch (resolver_lookup(hostname, &cached)) {
+
+      case 1:
+         addr->sin_addr.s_addr = cached;
+         goto host_resolved;
+
+      case -1:
+         roadmap_log (ROADMAP_ERROR, "host name '%s' recently failed to resolve", hostname);
+         goto connection_failure;
+
+      default:
+         if (unresolved != NULL) {
+            *unresolved = hostname;
+            return ROADMAP_INVALID_SOCKET;
+         }
+
+         /* A blocking connect resolves in place */
+         roadmap_log(ROADMAP_INFO, "Calling gethostbyname:%s", hostname);
+         host = gethostbyname(hostname);
+         if (host == NULL) {
+            resolver_store(hostname, INADDR_NONE);
+         } else {
+            memcpy (&cached, host->h_addr, sizeof(cached));
+            resolver_store(hostname, cached);
+         }
+         break;
+      }
    }
 
    if (host == NULL) {
@@ -319,6 +367,8 @@ static RoadMapSocket create_socket (const char *protocol,
       memcpy (&addr->sin_addr, host->h_addr, host->h_length);
    }
 
+host_resolved:
+
    if (strcmp (protocol, "udp") == 0) {
       s = socket (PF_INET, SOCK_DGRAM, 0);
    } else if (strcmp (protocol, "tcp") == 0) {
@@ -401,6 +451,184 @@ static int create_async_connection (RoadMapIO *io, struct sockaddr *addr) {
 #endif
 
 
+static void free_retry_params (RoadMapIO *io) {
+
+   if (io->retry_params.protocol && io->retry_params.protocol[0]) {
+      free(io->retry_params.protocol);
+   }
+   if (io->retry_params.name && io->retry_params.name[0]) {
+      free(io->retry_params.name);
+   }
+   if (io->retry_params.resolved_name && io->retry_params.resolved_name[0]) {
+      free(io->retry_params.resolved_name);
+   }
+}
+
+
+static void on_host_resolved (const void *context, in_addr_t ip_addr) {
+
+   RoadMapNetResolving *resolving = (RoadMapNetResolving *)context;
+   RoadMapIO *io = resolving->io;
+   RoadMapIO retry_io;
+   RoadMapNetData *data;
+   RoadMapSocket s;
+
+   resolving->busy = FALSE;
+
+   if (io == NULL) return; /* Cancelled */
+
+   if (resolving->starting) {
+      /* Failed before the request returned */
+      resolving->failed = TRUE;
+      return;
+   }
+
+   resolving->io = NULL;
+
+   data = io->context;
+   s = io->os.socket;
+   retry_io = *io;
+
+   s->connect_io = NULL;
+   roadmap_net_close(s);
+
+   if (ip_addr != INADDR_NONE) {
+
+      /* The address is cached now: connect again, keeping the same io */
+      RoadMapNetNumConnects--;
+
+      if (roadmap_net_connect_internal (retry_io.retry_params.protocol,
+                                        retry_io.retry_params.name,
+                                        retry_io.retry_params.resolved_name,
+                                        retry_io.retry_params.update_time,
+                                        retry_io.retry_params.default_port,
+                                        TRUE,
+                                        retry_io.retry_params.flags,
+                                        retry_io.retry_params.callback,
+                                        retry_io.retry_params.context,
+                                        io,
+                                        retry_io.retry_params.num_retries) != NULL) {
+         free_retry_params(&retry_io);
+         free(data);
+         return;
+      }
+
+      RoadMapNetNumConnects++;
+
+   } else {
+      roadmap_log (ROADMAP_ERROR, "cannot resolve the host of '%s'", retry_io.retry_params.name);
+   }
+
+   free_retry_params(&retry_io);
+   free(io);
+   connect_callback(ROADMAP_INVALID_SOCKET, data);
+}
+
+
+/* Queues the connect until the resolver has the address of 'hostname'.
+ * Until then the io holds a socket that is not opened.
+ */
+static void *roadmap_net_resolve_async (char *hostname,
+                                        const char *protocol, const char *name, const char *resolved_name,
+                                        time_t update_time,
+                                        int default_port,
+                                        int flags,
+                                        RoadMapNetConnectCallback callback,
+                                        void *context,
+                                        RoadMapIO *reuse_connect_io,
+                                        int num_retries) {
+
+   RoadMapNetResolving *resolving = NULL;
+   RoadMapNetData *data;
+   RoadMapSocket s;
+   RoadMapIO *io;
+   int i;
+
+   for (i = 0; i < ROADMAP_NET_MAX_RESOLVING; ++i) {
+      if (!RoadMapNetResolvingTable[i].busy) {
+         resolving = RoadMapNetResolvingTable + i;
+         break;
+      }
+   }
+
+   if (resolving == NULL) {
+      roadmap_log (ROADMAP_ERROR, "too many connections waiting for the resolver ('%s')", hostname);
+      free(hostname);
+      roadmap_net_mon_disconnect();
+      roadmap_net_mon_error("Error connecting.");
+      return NULL;
+   }
+
+   s = (RoadMapSocket) calloc(sizeof(struct roadmap_socket_t), 1);
+   roadmap_check_allocated(s);
+   s->s = -1;
+
+   data = (RoadMapNetData *)malloc(sizeof(RoadMapNetData));
+   roadmap_check_allocated(data);
+   data->packet[0] = '\0';
+   data->callback = callback;
+   data->context = context;
+
+   if (!reuse_connect_io)
+      io = malloc(sizeof(RoadMapIO));
+   else
+      io = reuse_connect_io;
+
+   io->os.socket = s;
+   s->connect_io = io;
+
+   io->subsystem = ROADMAP_IO_NET;
+   io->context = data;
+
+   io->retry_params.num_retries = num_retries;
+   io->retry_params.protocol = strdup(protocol);
+   io->retry_params.name = strdup(name);
+   io->retry_params.resolved_name = strdup(resolved_name);
+   io->retry_params.update_time = update_time;
+   io->retry_params.default_port = default_port;
+   io->retry_params.flags = flags;
+   io->retry_params.callback = callback;
+   io->retry_params.context = context;
+
+   resolving->io = io;
+   resolving->busy = TRUE;
+   resolving->starting = TRUE;
+   resolving->failed = FALSE;
+
+   RoadMapNetNumConnects++;
+
+   if (RoadMapNetNumConnects == 1) {
+      roadmap_main_set_periodic(CONNECT_TIMEOUT_SEC * 1000 /2, check_connect_timeout);
+   }
+
+   roadmap_log (ROADMAP_DEBUG, "waiting for the address of '%s'", hostname);
+   resolver_request (hostname, on_host_resolved, resolving);
+   free(hostname);
+
+   resolving->starting = FALSE;
+
+   if (resolving->failed) {
+
+      resolving->io = NULL;
+
+      free_retry_params(io);
+      free(data);
+      if (reuse_connect_io) s->connect_io = NULL;
+      roadmap_net_close(s);
+
+      RoadMapNetNumConnects--;
+
+      if (RoadMapNetNumConnects == 0) {
+         roadmap_main_remove_periodic(check_connect_timeout);
+      }
+
+      return NULL;
+   }
+
+   return io;
+}
+
+
 static void *roadmap_net_connect_internal (const char *protocol, const char *name, const char *resolved_name,
                                          time_t update_time,
                                          int default_port,
@@ -417,17 +645,23 @@ static void *roadmap_net_connect_internal (const char *protocol, const char *nam
    int             server_port;
    const char*     proxy_address = GetProxyAddress();
    char            packet[512];
-   char            update_since[WDF_MODIFIED_HEADER_SIZE + 1];
    RoadMapSocket   res_socket, temp_socket;
-   const char *   req_type = "GET";
    struct sockaddr addr;
    RoadMapNetData *data = NULL;
    RoadMapIO      *io;
+   char           *unresolved = NULL;
 
    if( strncmp( protocol, "http", 4) != 0) {
-      temp_socket = create_socket(protocol, name, default_port, &addr);
+      temp_socket = create_socket(protocol, name, default_port, &addr,
+                                  async ? &unresolved : NULL);
 
-      if(ROADMAP_INVALID_SOCKET == temp_socket) return NULL;
+      if(ROADMAP_INVALID_SOCKET == temp_socket) {
+         if (unresolved == NULL) return NULL;
+
+         return roadmap_net_resolve_async (unresolved, protocol, name, resolved_name,
+                                           update_time, default_port, flags,
+                                           callback, context, reuse_connect_io, num_retries);
+      }
       
          res_socket = temp_socket;
 
@@ -438,9 +672,6 @@ static void *roadmap_net_connect_internal (const char *protocol, const char *nam
    } else {
       // HTTP Connection, using system configuration for Proxy
 
-      WDF_FormatHttpIfModifiedSince (update_time, update_since);
-      if (!strcmp(protocol, "http_post")) req_type = "POST";
-
       if( !WSA_ExtractParams( name,          //   IN        -   Web service full address (http://...)
                               server_url,    //   OUT,OPT   -   Server URL[:Port]
                               &server_port,  //   OUT,OPT   -   Server Port
@@ -464,34 +695,23 @@ static void *roadmap_net_connect_internal (const char *protocol, const char *nam
          char* port_offset = strchr(proxy_address, ':');
          if (port_offset) proxy_port = atoi(port_offset + 1);
 
-         temp_socket = create_socket("tcp", proxy_address, proxy_port, &addr);
-
-         sprintf(packet,
-                 "%s %s HTTP/1.0\r\n"
-                 "Host: %s\r\n"
-                 "User-Agent: FreeMap/%s\r\n"
-                 "%s"
-                 "%s",
-                 req_type, name, server_url, roadmap_start_version(),
-                 TEST_NET_COMPRESS( flags ) ? "Accept-Encoding: gzip, deflate\r\n" : "",
-                 update_since); 
+         temp_socket = create_socket("tcp", proxy_address, proxy_port, &addr,
+                                     async ? &unresolved : NULL);
       } else {
 
-         temp_socket = create_socket("tcp", resolved_server_url, server_port, &addr);
-
-         sprintf(packet,
-                 "%s %s HTTP/1.0\r\n"
-                 "Host: %s\r\n"
-                 "User-Agent: FreeMap/%s\r\n"
-                 "%s"
-                 "%s",
-                 req_type, service_name, server_url, roadmap_start_version(),
-                 TEST_NET_COMPRESS( flags ) ? "Accept-Encoding: gzip, deflate\r\n" : "",
-                 update_since);
-         
+         temp_socket = create_socket("tcp", resolved_server_url, server_port, &addr,
+                                     async ? &unresolved : NULL);
+      }
+
+      if(ROADMAP_INVALID_SOCKET == temp_socket) {
+         if (unresolved == NULL) return ROADMAP_INVALID_SOCKET;
+
+         return roadmap_net_resolve_async (unresolved, protocol, name, resolved_name,
+                                           update_time, default_port, flags,
+                                           callback, context, reuse_connect_io, num_retries);
       }
 
-      if(ROADMAP_INVALID_SOCKET == temp_socket) return ROADMAP_INVALID_SOCKET;
+      roadmap_net_http_header (protocol, name, update_time, flags, packet, sizeof(packet));
       
          res_socket = temp_socket;
       
@@ -535,7 +755,10 @@ static void *roadmap_net_connect_internal (const char *protocol, const char *nam
       if (create_async_connection(io, &addr) == -1)
 #endif
       {
+         /* A reused io stays the caller's */
+         free_retry_params(io);
          free(data);
+         if (reuse_connect_io) res_socket->connect_io = NULL;
          roadmap_net_close(res_socket);
          return NULL;
       }
@@ -569,6 +792,45 @@ static void *roadmap_net_connect_internal (const char *protocol, const char *nam
 }
 
 
+int roadmap_net_http_header (const char *protocol, const char *name,
+                             time_t update_time,
+                             int flags,
+                             char *header,
+                             int size) {
+
+   char            server_url  [ WSA_SERVER_URL_MAXSIZE   + 1];
+   char            service_name[ WSA_SERVICE_NAME_MAXSIZE + 1];
+   char            update_since[WDF_MODIFIED_HEADER_SIZE + 1];
+   int             server_port;
+   const char *   req_type = "GET";
+
+   if( !WSA_ExtractParams( name,          //   IN        -   Web service full address (http://...)
+                           server_url,    //   OUT,OPT   -   Server URL[:Port]
+                           &server_port,  //   OUT,OPT   -   Server Port
+                           service_name)) //   OUT,OPT   -   Web service name
+   {
+      roadmap_log( ROADMAP_ERROR, "roadmap_net_http_header() - Failed to extract information from '%s'", name);
+      return 0;
+   }
+
+   WDF_FormatHttpIfModifiedSince (update_time, update_since);
+   if (!strcmp(protocol, "http_post")) req_type = "POST";
+
+   // A proxy needs the full address
+   snprintf(header, size,
+            "%s %s HTTP/1.0\r\n"
+            "Host: %s\r\n"
+            "User-Agent: FreeMap/%s\r\n"
+            "%s"
+            "%s",
+            req_type, GetProxyAddress() ? name : service_name, server_url, roadmap_start_version(),
+            TEST_NET_COMPRESS( flags ) ? "Accept-Encoding: gzip, deflate\r\n" : "",
+            update_since);
+
+   return 1;
+}
+
+
 int roadmap_net_get_fd(RoadMapSocket s) {
    return s->s;
 }
@@ -613,10 +875,21 @@ void *roadmap_net_connect_async (const char *protocol, const char *name, const c
 void roadmap_net_cancel_connect (RoadMapIO *io) {
    RoadMapNetData *data = io->context;
    RoadMapSocket s = io->os.socket;
+   BOOL resolving = FALSE;
+   int i;
    
    if ( io == NULL || io->subsystem == ROADMAP_IO_INVALID )
       return;
 
+   for (i = 0; i < ROADMAP_NET_MAX_RESOLVING; ++i) {
+      if (RoadMapNetResolvingTable[i].io == io) {
+         /* The resolver still has the entry: only forget the io */
+         RoadMapNetResolvingTable[i].io = NULL;
+         resolving = TRUE;
+         break;
+      }
+   }
+
    if (io->retry_params.protocol && io->retry_params.protocol[0]) {
       free(io->retry_params.protocol);
    }
@@ -628,7 +901,7 @@ void roadmap_net_cancel_connect (RoadMapIO *io) {
    }
    
    roadmap_log(ROADMAP_DEBUG, "Cancelling async connect request (%d)", s->s);
-   roadmap_main_remove_input(io);
+   if (!resolving) roadmap_main_remove_input(io);
    roadmap_net_close(s);
    free(data);
    
@@ -756,14 +1029,18 @@ int roadmap_net_receive (RoadMapSocket s, void *data, int size) {
          if (s->compress_ctx == NULL) return -1;
       }
       
-      roadmap_http_comp_get_buffer(s->compress_ctx, &ctx_buffer, &ctx_buffer_size);
-      
-      if (!s->is_secured)
-         received = read(s->s, ctx_buffer, ctx_buffer_size);
-      else
-         received = roadmap_ssl_read(s->ssl_ctx, ctx_buffer, ctx_buffer_size);
-      
-      roadmap_http_comp_add_data(s->compress_ctx, received);
+      /* Read the socket only when what it received so far is used up */
+      if (!roadmap_http_comp_pending(s->compress_ctx)) {
+
+         roadmap_http_comp_get_buffer(s->compress_ctx, &ctx_buffer, &ctx_buffer_size);
+
+         if (!s->is_secured)
+            received = read(s->s, ctx_buffer, ctx_buffer_size);
+         else
+            received = roadmap_ssl_read(s->ssl_ctx, ctx_buffer, ctx_buffer_size);
+
+         roadmap_http_comp_add_data(s->compress_ctx, received);
+      }
       
       while ((received = roadmap_http_comp_read(s->compress_ctx, data + total_received, size - total_received))
              != 0) {
@@ -794,6 +1071,20 @@ int roadmap_net_receive (RoadMapSocket s, void *data, int size) {
 }
  
 
+int roadmap_net_receive_pending (RoadMapSocket s) {
+
+   return s->compress_ctx && roadmap_http_comp_pending(s->compress_ctx);
+}
+
+
+int roadmap_net_receive_left (RoadMapSocket s) {
+
+   if (!s->compress_ctx) return -1;
+
+   return roadmap_http_comp_body_left(s->compress_ctx);
+}
+ 
+
 static int roadmap_net_send_ssl (RoadMapSocket s, const void *data, int length, int wait) {
 #ifndef IPHONE
    return roadmap_ssl_send (s->ssl_ctx, data, length);
@@ -881,6 +1172,7 @@ void roadmap_net_shutdown (void) {
    const char* netcompress_cfg_value = RoadMapNetCompressEnabled ? "yes" : "no";
    roadmap_config_set( &RoadMapConfigNetCompressEnabled, netcompress_cfg_value );
    roadmap_net_mon_destroy();
+   resolver_shutdown();
 }
 
 void roadmap_net_initialize (void) {
@@ -889,6 +1181,31 @@ void roadmap_net_initialize (void) {
    RoadMapNetCompressEnabled = roadmap_config_match( &RoadMapConfigNetCompressEnabled, "yes" );
 
    roadmap_net_mon_start ();
+   resolver_init ();
+}
+
+void roadmap_net_prefetch (const char *address) {
+
+   char  server_url[WSA_SERVER_URL_MAXSIZE + 1];
+   char *separator;
+
+   if (!address || !address[0]) return;
+
+   if (strstr (address, "://")) {
+      if (!WSA_ExtractParams (address, server_url, NULL, NULL)) return;
+   } else {
+      strncpy_safe (server_url, address, sizeof(server_url));
+   }
+
+   separator = strchr (server_url, ':');
+   if (separator) *separator = '\0';
+
+   resolver_prefetch (server_url);
+}
+
+void roadmap_net_refresh_hosts (void) {
+
+   resolver_refresh ();
 }
 
 int roadmap_net_socket_secured (RoadMapSocket s) {
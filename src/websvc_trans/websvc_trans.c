@@ -23,6 +23,7 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <ctype.h>
 #ifndef WIN32
 #include "../roadmap_string.h"
 #endif
@@ -41,7 +42,7 @@ static   BOOL  wst_Receive          ( wst_context_ptr session);
 
 static transaction_result OnHTTPAck( cyclic_buffer_ptr CB, http_parsing_state* parser_state);
 static   transaction_result
-               OnHTTPHeader         ( cyclic_buffer_ptr CB, http_parsing_state* parser_state);
+               OnHTTPHeader         ( cyclic_buffer_ptr CB, http_parsing_state* parser_state, BOOL* keep_alive, BOOL* gzip_response);
 static   transaction_result
                OnCustomResponse     ( wst_context_ptr session);
 static LastNetConnectRes ELastNetConnectRes = LastNetConnect_Success;
@@ -57,9 +58,11 @@ static BOOL wst_start_trans__int(wst_context_ptr      session,
                                  CB_OnWSTCompleted    cbOnCompleted,
                                  void*                context,
                                  char*                packet,
+                                 const wstq_item*     coalesced,
                                  BOOL                 retry);
 
 static void wst_stop_trans__int( wst_handle h, BOOL bStopNow, BOOL bNotifyCb);
+static BOOL wst_connect( wst_context_ptr session, int flags, const char* action);
 
 
 void wst_context_init( wst_context_ptr this)
@@ -151,9 +154,14 @@ static void wst_context_reset( wst_context_ptr this, int use_ack)
 /*15*/   //this->cbOnWSTCompleted     = NULL;
 /*16*/   this->result               = trans_succeeded;
 /*17*/   this->rc                   = succeeded;
+
+   this->keep_alive           = FALSE;
+   this->gzip_response        = FALSE;
+   this->socket_reused        = FALSE;
    
    this->active_item.type = WEBSVC_NO_TYPE;
    this->active_item.packet = NULL;
+   this->active_item.coalesced_count = 0;
 
 // Restore:
 /* 1*/   this->service     = service;
@@ -187,6 +195,21 @@ static BOOL wst_Receive( wst_context_ptr session)
    return TRUE;
 }
 
+static void wst_close_socket( wst_context_ptr session)
+{
+   if( session->async_receive_started)
+   {
+      socket_async_receive_end( session->Socket);
+      session->async_receive_started = FALSE;
+   }
+
+   if( ROADMAP_INVALID_SOCKET != session->Socket)
+   {
+      roadmap_net_close( session->Socket);
+      session->Socket = ROADMAP_INVALID_SOCKET;
+   }
+}
+
 static void  wst_context_load(wst_context_ptr         this,
                               int                     flags,
                               const char*             action,
@@ -323,21 +346,28 @@ BOOL wst_process_queue_item( wst_handle h, BOOL* transaction_started)
    if( wst_queue_is_empty( session))
       return TRUE;
 
+   // Send the similar requests waiting behind the next one in the same packet:
+   if( trans_idle == session->state)
+      wstq_coalesce( &(session->queue));
+
    if( !wstq_dequeue( &(session->queue), &Item))
    {
       roadmap_log( ROADMAP_ERROR, "wst_process_queue_item() - 'wstq_dequeue()' had failed!");
       return FALSE;
    }
 
-   bRes = wst_start_trans( session,
-                           Item.flags,
-                           Item.action,
-                           Item.type,
-                           Item.parsers,
-                           Item.parsers_count,
-                           Item.cbOnCompleted,
-                           Item.context,
-                           Item.packet);
+   // The packet is already formatted (and was checked when queued):
+   bRes = wst_start_trans__int(  session,
+                                 Item.flags,
+                                 Item.action,
+                                 Item.type,
+                                 Item.parsers,
+                                 Item.parsers_count,
+                                 Item.cbOnCompleted,
+                                 Item.context,
+                                 Item.packet,
+                                 &Item,
+                                 FALSE);
 
    wstq_item_release( &Item);
 
@@ -347,6 +377,25 @@ BOOL wst_process_queue_item( wst_handle h, BOOL* transaction_started)
    return bRes;
 }
 
+// Call the callback of the transaction, and of the requests merged into it
+static void wst_notify_completed(CB_OnWSTCompleted       cb,
+                                 void*                   context,
+                                 const wstq_completion*  coalesced,
+                                 int                     coalesced_count,
+                                 roadmap_result          res)
+{
+   int i;
+
+   if(cb)
+      cb( context, res);
+
+   for( i=0; i<coalesced_count; i++)
+   {
+      if( coalesced[i].cbOnCompleted)
+         coalesced[i].cbOnCompleted( coalesced[i].context, res);
+   }
+}
+
 // This method terminates the a-sync transaction:
 // 1. Call callback
 // 2. Reset context
@@ -355,6 +404,12 @@ void wst_transaction_completed( wst_handle h, roadmap_result res)
    wst_context_ptr   session  = (wst_context_ptr)h;
    CB_OnWSTCompleted cb       = session->active_item.cbOnCompleted;
    void*             context  = session->active_item.context;
+   wstq_completion   coalesced[TRANSACTION_MAX_COALESCED-1];
+   int               coalesced_count = session->active_item.coalesced_count;
+
+   // Callbacks may start new transactions, which reload the active item:
+   if( coalesced_count)
+      memcpy( coalesced, session->active_item.coalesced, coalesced_count * sizeof(wstq_completion));
 
    if( session->delete_on_idle)
    {
@@ -382,8 +437,14 @@ void wst_transaction_completed( wst_handle h, roadmap_result res)
 
    if( ROADMAP_INVALID_SOCKET != session->Socket)
    {
-      roadmap_net_close( session->Socket);
-      session->Socket = ROADMAP_INVALID_SOCKET;
+      if( (succeeded == res) && session->keep_alive)
+      {
+         // Keep the connection for the next transaction:
+         roadmap_log( ROADMAP_DEBUG, "wst_transaction_completed() - Keeping connection (SOCKET: %d)", roadmap_net_get_fd(session->Socket));
+         session->socket_idle_time = time(NULL);
+      }
+      else
+         wst_close_socket( session);
    }
 
    if (res == err_timed_out &&
@@ -398,12 +459,12 @@ void wst_transaction_completed( wst_handle h, roadmap_result res)
                                        session->active_item.cbOnCompleted, // Callback for transaction completion
                                        session->active_item.context,       // Caller context
                                        session->active_item.packet,        // Custom data for the HTTP request
+                                       NULL,                               // Coalesced requests (kept)
                                        TRUE);                              // Retry
       if (!bRes) {
          wst_context_reset( session, 0);
          
-         if(cb)
-            cb( context, err_net_failed);
+         wst_notify_completed( cb, context, coalesced, coalesced_count, err_net_failed);
       }
    } else {
       if (session->active_item.packet && session->active_item.packet[0]){
@@ -413,8 +474,7 @@ void wst_transaction_completed( wst_handle h, roadmap_result res)
       
       wst_context_reset( session, 0);
       
-      if(cb)
-         cb( context, res);
+      wst_notify_completed( cb, context, coalesced, coalesced_count, res);
    }
 }
 
@@ -424,6 +484,13 @@ void wst_watchdog( wst_handle h)
    time_t            now            = time(NULL);
    int               seconds_passed = (int)(now - session->last_receive_time);
 
+   if (trans_idle == session->state &&
+       session->Socket != ROADMAP_INVALID_SOCKET &&
+       now - session->socket_idle_time >= WST_KEEP_ALIVE_TIMEOUT) {
+      roadmap_log( ROADMAP_DEBUG, "wst_watchdog() - Closing idle connection");
+      wst_close_socket( session);
+   }
+
    if (!session->last_receive_time)
       return;
    
@@ -469,9 +536,11 @@ static void wstq_RemoveType ( wst_context_ptr   session,
                              int        type) {
    wstq_remove_type (&(session->queue), type);
    
+   // A merged packet carries other requests too: let it complete
    if (trans_idle != session->state &&
        session->active_item.type != WEBSVC_NO_TYPE &&
-       session->active_item.type == type) {
+       session->active_item.type == type &&
+       !session->active_item.coalesced_count) {
       roadmap_log(ROADMAP_WARNING, "wstq_RemoveType() - stopping active session with type %d", type);
       wst_stop_trans__int(session, TRUE, FALSE);
    }
@@ -515,6 +584,150 @@ static BOOL wstq_Add( wst_context_ptr      session,
    return FALSE;
 }
 
+// Full address of the action, and of the resolved server; Returns the port
+static int wst_format_method( wst_context_ptr   session,
+                              int               flags,
+                              const char*       action,
+                              char*             WebServiceMethod,
+                              char*             WebServiceMethodResolved)
+{
+   if ((flags & WEBSVC_FLAG_SECURED) && !(flags & WEBSVC_FLAG_V2)) {
+      snprintf(WebServiceMethod,
+               WST_WEBSERVICE_METHOD_MAX_SIZE,
+               "%s/%s", session->secured_service, action);
+      snprintf(WebServiceMethodResolved,
+               WST_WEBSERVICE_METHOD_MAX_SIZE,
+               "%s/%s", session->secured_service_resolved, action);
+      return session->secured_port;
+   } else if (!(flags & WEBSVC_FLAG_SECURED) && (flags & WEBSVC_FLAG_V2)) {
+      snprintf(WebServiceMethod,
+               WST_WEBSERVICE_METHOD_MAX_SIZE,
+               "%s%s/%s", session->service, session->service_v2_suffix, action);
+      snprintf(WebServiceMethodResolved,
+               WST_WEBSERVICE_METHOD_MAX_SIZE,
+               "%s%s/%s", session->service, session->service_v2_suffix, action);
+      return session->port;
+   } else if ((flags & WEBSVC_FLAG_SECURED) && (flags & WEBSVC_FLAG_V2)) {
+      snprintf(WebServiceMethod,
+               WST_WEBSERVICE_METHOD_MAX_SIZE,
+               "%s%s/%s", session->secured_service, session->service_v2_suffix, action);
+      snprintf(WebServiceMethodResolved,
+               WST_WEBSERVICE_METHOD_MAX_SIZE,
+               "%s%s/%s", session->secured_service_resolved, session->service_v2_suffix, action);
+      return session->secured_port;
+   } else {
+      snprintf(WebServiceMethod,
+               WST_WEBSERVICE_METHOD_MAX_SIZE,
+               "%s/%s", session->service, action);
+      snprintf(WebServiceMethodResolved,
+               WST_WEBSERVICE_METHOD_MAX_SIZE,
+               "%s/%s", session->service, action);
+      return session->port;
+   }
+}
+
+// Open a new connection; 'session->packet' is sent once connected
+static BOOL wst_connect( wst_context_ptr session, int flags, const char* action)
+{
+   char  WebServiceMethod[WST_WEBSERVICE_METHOD_MAX_SIZE];
+   char  WebServiceMethodResolved[WST_WEBSERVICE_METHOD_MAX_SIZE];
+   int   port;
+
+   port = wst_format_method( session, flags, action, WebServiceMethod, WebServiceMethodResolved);
+
+   session->connect_context = roadmap_net_connect_async("http_post",
+                                                        WebServiceMethod,
+                                                        WebServiceMethodResolved,
+                                                        0,
+                                                        port,
+                                                        NET_COMPRESS,
+                                                        on_socket_connected,
+                                                        session);
+   if( NULL == session->connect_context)
+   {
+      ELastNetConnectRes = LastNetConnect_Failure;
+      roadmap_log( ROADMAP_ERROR, "wst_start_trans() - 'roadmap_net_connect_async' had failed (Invalid params or queue is full?)");
+      return FALSE;
+   }
+   ELastNetConnectRes = LastNetConnect_Success;
+   session->socket_flags = (flags & WEBSVC_FLAG_SECURED);
+   session->socket_compressed = (0 != TEST_NET_COMPRESS( NET_COMPRESS));
+
+   // Mark starting time:
+   session->last_receive_time = time(NULL);
+
+   return TRUE;
+}
+
+// Send the request on the connection kept from the previous transaction.
+// Returns FALSE if there is no such connection, or it cannot be used.
+static BOOL wst_send_on_kept_socket( wst_context_ptr session, int flags, const char* action)
+{
+   char        WebServiceMethod[WST_WEBSERVICE_METHOD_MAX_SIZE];
+   char        WebServiceMethodResolved[WST_WEBSERVICE_METHOD_MAX_SIZE];
+   const char* packet = ebuffer_get_buffer( &(session->packet));
+   ebuffer     Request;
+   char*       Data;
+   int         HeaderSize;
+   BOOL        bRes;
+
+   if( ROADMAP_INVALID_SOCKET == session->Socket)
+      return FALSE;
+
+   // Idle for too long, connected to the other server, or compression was switched?
+   if( (time(NULL) - session->socket_idle_time >= WST_KEEP_ALIVE_TIMEOUT) ||
+       ((flags & WEBSVC_FLAG_SECURED) != session->socket_flags)           ||
+       ((0 != TEST_NET_COMPRESS( NET_COMPRESS)) != session->socket_compressed))
+   {
+      wst_close_socket( session);
+      return FALSE;
+   }
+
+   wst_format_method( session, flags, action, WebServiceMethod, WebServiceMethodResolved);
+
+   // The request header, as 'roadmap_net_connect_async' would have sent it.
+   ebuffer_init( &Request);
+   Data = ebuffer_alloc( &Request, HTTP_HEADER_MAX_SIZE + WST_WEBSERVICE_METHOD_MAX_SIZE + strlen(packet));
+
+   if( !roadmap_net_http_header( "http_post", WebServiceMethod, 0, NET_COMPRESS, Data, HTTP_HEADER_MAX_SIZE + WST_WEBSERVICE_METHOD_MAX_SIZE))
+   {
+      ebuffer_free( &Request);
+      wst_close_socket( session);
+      return FALSE;
+   }
+
+   HeaderSize = (int)strlen( Data);
+   strcpy( Data + HeaderSize, packet);
+
+   bRes = ((-1 != wst_Send( session->Socket, Data)) && wst_Receive( session));
+   ebuffer_free( &Request);
+
+   if( !bRes)
+   {
+      roadmap_log( ROADMAP_WARNING, "wst_start_trans() - Failed to use kept connection, reconnecting");
+      wst_close_socket( session);
+      return FALSE;
+   }
+
+   roadmap_log( ROADMAP_DEBUG, "wst_start_trans() - Reusing connection (SOCKET: %d)", roadmap_net_get_fd(session->Socket));
+   session->socket_reused     = TRUE;
+   session->last_receive_time = time(NULL);
+
+   return TRUE;
+}
+
+// The server closed the kept connection before responding; connect again
+static void wst_reconnect( wst_context_ptr session)
+{
+   roadmap_log( ROADMAP_DEBUG, "wst_reconnect() - Kept connection was closed by the server");
+
+   wst_close_socket( session);
+   session->socket_reused = FALSE;
+
+   if( !wst_connect( session, session->active_item.flags, session->active_item.action))
+      wst_transaction_completed( session, err_net_failed);
+}
+
 // Assumptions and implementation notes:
 // 1. This method is called from a single thread, thus no MT locks are used.
 // 2. This method supports only one request at a time.
@@ -536,13 +749,11 @@ static BOOL wst_start_trans__int(wst_context_ptr      session,
                                  CB_OnWSTCompleted    cbOnCompleted,
                                  void*                context,
                                  char*                packet,
+                                 const wstq_item*     coalesced,
                                  BOOL                 retry)
 {
    char* AsyncPacket    = NULL;
    int   AsyncPacketSize= 0;
-   char  WebServiceMethod[WST_WEBSERVICE_METHOD_MAX_SIZE];
-   char  WebServiceMethodResolved[WST_WEBSERVICE_METHOD_MAX_SIZE];
-   int   port;
    
    if (!retry) {
       if(!session || !action        || !(*action)     ||
@@ -564,15 +775,17 @@ static BOOL wst_start_trans__int(wst_context_ptr      session,
                          cbOnCompleted, context, packet);
       }
       
-      if( ROADMAP_INVALID_SOCKET != session->Socket)
-      {
-         assert(0);  // No session is active - Socket should be invalid..
-         roadmap_log( ROADMAP_ERROR, "wst_start_trans() - socket should be invalid");
-         return FALSE;
-      }
-      
       //    Inital transaction context:
       wst_context_load( session, flags, action, type, parsers, parsers_count, cbOnCompleted, context, packet);
+
+      //    Callbacks of the requests merged into this packet:
+      if( coalesced && coalesced->coalesced_count)
+      {
+         session->active_item.coalesced_count = coalesced->coalesced_count;
+         memcpy( session->active_item.coalesced,
+                 coalesced->coalesced,
+                 coalesced->coalesced_count * sizeof(wstq_completion));
+      }
    } else {
       roadmap_log( ROADMAP_ERROR, "wst_start_trans() - retry # %d", session->retries); //TODO: reduce log level
       session->state             = trans_active;
@@ -588,70 +801,27 @@ static BOOL wst_start_trans__int(wst_context_ptr      session,
    AsyncPacketSize= HTTP_HEADER_MAX_SIZE + strlen(packet) + 10;
    AsyncPacket    = ebuffer_alloc( &(session->packet), AsyncPacketSize);
 
-   if ((flags & WEBSVC_FLAG_SECURED) && !(flags & WEBSVC_FLAG_V2)) {
-      snprintf(WebServiceMethod,
-               WST_WEBSERVICE_METHOD_MAX_SIZE,
-               "%s/%s", session->secured_service, action);
-      snprintf(WebServiceMethodResolved,
-               WST_WEBSERVICE_METHOD_MAX_SIZE,
-               "%s/%s", session->secured_service_resolved, action);
-      port = session->secured_port;
-   } else if (!(flags & WEBSVC_FLAG_SECURED) && (flags & WEBSVC_FLAG_V2)) {
-      snprintf(WebServiceMethod,
-               WST_WEBSERVICE_METHOD_MAX_SIZE,
-               "%s%s/%s", session->service, session->service_v2_suffix, action);
-      snprintf(WebServiceMethodResolved,
-               WST_WEBSERVICE_METHOD_MAX_SIZE,
-               "%s%s/%s", session->service, session->service_v2_suffix, action);
-      port = session->port;
-   } else if ((flags & WEBSVC_FLAG_SECURED) && (flags & WEBSVC_FLAG_V2)) {
-      snprintf(WebServiceMethod,
-               WST_WEBSERVICE_METHOD_MAX_SIZE,
-               "%s%s/%s", session->secured_service, session->service_v2_suffix, action);
-      snprintf(WebServiceMethodResolved,
-               WST_WEBSERVICE_METHOD_MAX_SIZE,
-               "%s%s/%s", session->secured_service_resolved, session->service_v2_suffix, action);
-      port = session->secured_port;
-   } else {
-      snprintf(WebServiceMethod,
-               WST_WEBSERVICE_METHOD_MAX_SIZE,
-               "%s/%s", session->service, action);
-      snprintf(WebServiceMethodResolved,
-               WST_WEBSERVICE_METHOD_MAX_SIZE,
-               "%s/%s", session->service, action);
-      port = session->port;
-   }
-
-
    snprintf(AsyncPacket,
             AsyncPacketSize,
             "Content-type: %s\r\n"
             "Content-Length: %d\r\n"
+            "Connection: keep-alive\r\n"
             "\r\n"
             "%s",
             session->content_type,
             (unsigned int)strlen(packet),
             packet);
 
+   // Use the connection kept from the previous transaction:
+   if( wst_send_on_kept_socket( session, flags, action))
+      return TRUE;
+
    // Start the async-connect process:
-   session->connect_context = roadmap_net_connect_async("http_post",
-                                                        WebServiceMethod,
-                                                        WebServiceMethodResolved,
-                                                        0,
-                                                        port,
-                                                        NET_COMPRESS,
-                                                        on_socket_connected,
-                                                        session);
-   if( NULL == session->connect_context)
+   if( !wst_connect( session, flags, action))
    {
-      ELastNetConnectRes = LastNetConnect_Failure;
-      roadmap_log( ROADMAP_ERROR, "wst_start_trans() - 'roadmap_net_connect_async' had failed (Invalid params or queue is full?)");
       wst_context_reset( session, (flags & WEBSVC_FLAG_V2));
       return FALSE;
    }
-   ELastNetConnectRes = LastNetConnect_Success;
-   // Mark starting time:
-   session->last_receive_time = time(NULL);
 
    return TRUE;
 }
@@ -677,6 +847,7 @@ static void wst_stop_trans__int( wst_handle h, BOOL bStopNow, BOOL bNotifyCb)
    if (bStopNow) {
       if (!bNotifyCb) {
          session->active_item.cbOnCompleted = NULL;
+         session->active_item.coalesced_count = 0;
       }
       wst_transaction_completed( session, err_aborted);
    } else {
@@ -770,6 +941,7 @@ BOOL wst_start_trans(wst_handle           h,             // Session object
                                  cbOnCompleted, // Callback for transaction completion
                                  context,       // Caller context
                                  Data,          // Custom data for the HTTP request
+                                 NULL,          // Coalesced requests
                                  FALSE);        // Retry
 
    ebuffer_free( &Packet);
@@ -881,6 +1053,9 @@ transaction_result on_data_received_( void* data, int size, wst_context_ptr sess
 
    roadmap_log( ROADMAP_DEBUG, "on_data_received( SOCKET: %d) - Received %d bytes", roadmap_net_get_fd(session->Socket), size);
    session->last_receive_time = time(NULL);
+
+   if( 0 == size)
+      session->keep_alive = FALSE;   // Server closed the connection
    
    CB                = &(session->CB);
    http_parser_state = session->http_parser_state;
@@ -917,7 +1092,7 @@ transaction_result on_data_received_( void* data, int size, wst_context_ptr sess
       http_not_acked != http_parser_state)
    {
       //   Http data was not processed yet; Use HTTP handler:
-      res = OnHTTPHeader( CB, &http_parser_state);
+      res = OnHTTPHeader( CB, &http_parser_state, &(session->keep_alive), &(session->gzip_response));
 
       //   Done?
       if( trans_succeeded == res )
@@ -942,6 +1117,13 @@ transaction_result on_data_received_( void* data, int size, wst_context_ptr sess
       return trans_failed;
    }
 
+   // The content-length of a compressed body counts the bytes as sent,
+   //  which only the net layer sees:
+   if( session->gzip_response                          &&
+       (http_parse_completed == http_parser_state)     &&
+       (0 == roadmap_net_receive_left( session->Socket)))
+      CB->data_size = CB->data_processed + CB->read_size;
+
    // If no more data is expected to be received because either
    //  the last packet has arrived or amount specified by content-length
    //  has been received:
@@ -996,11 +1178,31 @@ static void on_data_received( void* data, int size, void* context)
 {
    wst_context_ptr session = (wst_context_ptr)context;
 
+   // Did the server drop the kept connection before responding?
+   if( session->socket_reused                               &&
+       (size <= 0)                                          &&
+       (0 == session->CB.read_size)                         &&
+       ((http_not_acked  == session->http_parser_state) ||
+        (http_not_parsed == session->http_parser_state))    &&
+       (trans_active == session->state))
+   {
+      wst_reconnect( session);
+      return;
+   }
+
    if( -1 == session->CB.data_size)
       session->CB.data_size = size;
 
    session->result = on_data_received_( data, size, session);
 
+   // Decompressed data left from the last read: the socket may have nothing more
+   while( (trans_in_progress == session->result) &&
+          roadmap_net_receive_pending( session->Socket))
+   {
+      size = roadmap_net_receive( session->Socket, session->CB.next_read, session->CB.free_size);
+      session->result = on_data_received_( session->CB.next_read, size, session);
+   }
+
    switch( session->result)
    {
       case trans_succeeded:
@@ -1077,9 +1279,20 @@ static transaction_result OnHTTPAck( cyclic_buffer_ptr CB, http_parsing_state* p
    return trans_succeeded;
 }
 
+//   Search a (lower case) header field, up to the end of the headers
+static const char* wst_header_find( const char* buffer, const char* header_end, const char* field)
+{
+   const char* found = strstr( buffer, field);
+
+   if( found && (found < header_end))
+      return found;
+
+   return NULL;
+}
+
 //   General HTTP packet parser
 //   Used prior to any response by all response-cases
-static transaction_result OnHTTPHeader( cyclic_buffer_ptr CB, http_parsing_state* parser_state)
+static transaction_result OnHTTPHeader( cyclic_buffer_ptr CB, http_parsing_state* parser_state, BOOL* keep_alive, BOOL* gzip_response)
 {
    const char* pDataSize;
    const char* pHeaderEnd;
@@ -1148,17 +1361,168 @@ static transaction_result OnHTTPHeader( cyclic_buffer_ptr CB, http_parsing_state
 	   roadmap_log( ROADMAP_DEBUG, "WST::OnHTTPHeader() - Did not find 'Content-Length:' in response (%s)", buffer);
    }
 
+   //   A compressed body is decompressed by the net layer, which finds its end
+   //   (see 'on_data_received_'):
+   (*gzip_response) = (NULL != wst_header_find( buffer, pHeaderEnd, "content-encoding: gzip"));
+   if( *gzip_response)
+      CB->data_size = INT_MAX;
+
+   //   The connection can carry the next request only if the response end is known:
+   (*keep_alive) = ( pDataSize &&
+                     wst_header_find( buffer, pHeaderEnd, "connection: keep-alive"));
+
    (*parser_state) = http_parse_completed;
 
    return trans_succeeded;      //   Quit loop
 }
 
+//   Parser tables:
+//   The 'wst_parser' arrays are static, and some of them have dozens of tags. Each
+//   array is compiled once into an open-addressing hash table of its tags, so that
+//   finding the parser of a response line costs a single string compare.
+#define  WST_PARSER_TABLES_COUNT    (8)
+
+typedef struct tag_wst_parser_table
+{
+   wst_parser_ptr    parsers;
+   int               parsers_count;
+   int               mask;          //   Slots count - 1
+   int*              slots;         //   Index of the parser + 1, or 0 if empty
+   CB_OnWSTResponse  def_parser;
+   BOOL              have_tags;
+
+}  wst_parser_table, *wst_parser_table_ptr;
+
+static   wst_parser_table  gs_ParserTables[WST_PARSER_TABLES_COUNT];
+static   int               gs_ParserTablesCount = 0;
+static   int               gs_ParserTablesNext  = 0;
+
+static unsigned int wst_parser_tag_hash( const char* tag)
+{
+   unsigned int hash = 2166136261U;
+
+   //   Case-insensitive FNV-1a:
+   while( *tag)
+   {
+      hash ^= (unsigned char)tolower( (unsigned char)*tag);
+      hash *= 16777619U;
+      tag++;
+   }
+
+   return hash;
+}
+
+static BOOL wst_parser_tag_equal( const char* tag, const char* parser_tag)
+{
+#ifdef _WIN32
+   return (0 == _stricmp( tag, parser_tag));
+#else
+   return (0 == roadmap_string_compare_ignore_case( tag, parser_tag));
+#endif
+}
+
+static void wst_parser_table_build( wst_parser_table_ptr table, wst_parser_ptr parsers, int parsers_count)
+{
+   int   size;
+   int   i;
+
+   free( table->slots);
+
+   table->parsers       = parsers;
+   table->parsers_count = parsers_count;
+   table->def_parser    = NULL;
+   table->have_tags     = FALSE;
+
+   // Select default parser:
+   for( i=0; i<parsers_count; i++)
+   {
+      if( parsers[i].tag && parsers[i].tag[0])
+         table->have_tags = TRUE;
+      else
+      {
+         table->def_parser= parsers[i].parser;
+         break;
+      }
+   }
+
+   //   At most half full:
+   for( size=8; size < (2 * parsers_count); size *= 2)
+      ;
+
+   table->mask  = size - 1;
+   table->slots = calloc( size, sizeof(int));
+   roadmap_check_allocated( table->slots);
+
+   for( i=0; i<parsers_count; i++)
+   {
+      unsigned int slot;
+
+      if( !parsers[i].tag || !parsers[i].tag[0])
+         continue;
+
+      for( slot = wst_parser_tag_hash( parsers[i].tag) & table->mask;
+           table->slots[slot];
+           slot = (slot + 1) & table->mask)
+      {
+         //   The first parser of a tag wins, as it did with a linear search:
+         if( wst_parser_tag_equal( parsers[i].tag, parsers[table->slots[slot] - 1].tag))
+            break;
+      }
+
+      if( !table->slots[slot])
+         table->slots[slot] = i + 1;
+   }
+}
+
+static wst_parser_table_ptr wst_parser_table_get( wst_parser_ptr parsers, int parsers_count)
+{
+   wst_parser_table_ptr table;
+   int                  i;
+
+   for( i=0; i<gs_ParserTablesCount; i++)
+   {
+      table = gs_ParserTables + i;
+      if( (table->parsers == parsers) && (table->parsers_count == parsers_count))
+         return table;
+   }
+
+   if( gs_ParserTablesCount < WST_PARSER_TABLES_COUNT)
+      table = gs_ParserTables + gs_ParserTablesCount++;
+   else
+   {
+      table = gs_ParserTables + gs_ParserTablesNext;
+      gs_ParserTablesNext = (gs_ParserTablesNext + 1) % WST_PARSER_TABLES_COUNT;
+   }
+
+   wst_parser_table_build( table, parsers, parsers_count);
+
+   return table;
+}
+
+static CB_OnWSTResponse wst_parser_table_find( wst_parser_table_ptr table, const char* tag)
+{
+   unsigned int slot;
+
+   for( slot = wst_parser_tag_hash( tag) & table->mask;
+        table->slots[slot];
+        slot = (slot + 1) & table->mask)
+   {
+      wst_parser_ptr parser = table->parsers + (table->slots[slot] - 1);
+
+      if( wst_parser_tag_equal( tag, parser->tag))
+         return parser->parser;
+   }
+
+   return NULL;
+}
+
 static transaction_result OnCustomResponse( wst_context_ptr session)
 {
    char                 tag[WST_RESPONSE_TAG_MAXSIZE+1];
    cyclic_buffer_ptr    CB                = &(session->CB);
    wst_parser_ptr       parsers           = session->active_item.parsers;
    int                  parsers_count     = session->active_item.parsers_count;
+   wst_parser_table_ptr table;
    const char*          next              = NULL;
    const char*          last              = NULL;   //   For logging
    CB_OnWSTResponse     parser            = NULL;
@@ -1166,7 +1530,6 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
    BOOL                 have_tags         = FALSE;
    BOOL                 more_data_needed  = FALSE;
    int                  buffer_size;
-   int                  i;
    roadmap_result		rc						= succeeded;
 
    assert(session);
@@ -1174,17 +1537,9 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
    assert(parsers);
    assert(parsers_count);
 
-   // Select default parser:
-   for( i=0; i<parsers_count; i++)
-   {
-      if( parsers[i].tag && parsers[i].tag[0])
-         have_tags = TRUE;
-      else
-      {
-         def_parser= parsers[i].parser;
-         break;
-      }
-   }
+   table       = wst_parser_table_get( parsers, parsers_count);
+   have_tags   = table->have_tags;
+   def_parser  = table->def_parser;
    
    //   As long as we have data - keep on parsing:
    while( CB->read_size > CB->read_processed )
@@ -1233,19 +1588,7 @@ static transaction_result OnCustomResponse( wst_context_ptr session)
          }
 
          //   Find parser:
-         parser = NULL;
-         for( i=0; i<parsers_count; i++)
-         {
-            #ifdef _WIN32
-               if( parsers[i].tag && (0 ==   _stricmp( tag, parsers[i].tag)))
-            #else
-               if( parsers[i].tag && (0 ==   roadmap_string_compare_ignore_case( tag, parsers[i].tag)))
-            #endif
-            {
-               parser = parsers[i].parser;
-               break;
-            }
-         }
+         parser = wst_parser_table_find( table, tag);
       }
 
       if( parser)
@@ -38,6 +38,7 @@
 #define  WST_ACK_TIMEOUT                     (5)  /* seconds */
 #define  WST_ACK_HEADER_TIMEOUT              (25)  /* seconds */
 #define  WST_RECEIVE_TIMEOUT                 (5)  /* seconds */
+#define  WST_KEEP_ALIVE_TIMEOUT              (10)  /* seconds */
 #define  HTTP_HEADER_MAX_SIZE                (400)
 #define  WST_WEBSERVICE_METHOD_MAX_SIZE      (0xFF)
 #define  WST_MIN_PARSERS_COUNT               ( 1)
@@ -45,6 +46,7 @@
 
 #define WEBSVC_FLAG_SECURED                  0x0001
 #define WEBSVC_FLAG_V2                       0x0002
+#define WEBSVC_FLAG_COALESCE                 0x0004   // May share a packet with similar requests
 
 
 typedef void*  wst_handle;
@@ -173,6 +175,14 @@ typedef struct tag_wst_context
 /*18*/   BOOL                 delete_on_idle;
          void                 *connect_context;
 
+/* Keep-alive:    */
+         BOOL                 keep_alive;       // Server will keep the connection after this response
+         BOOL                 gzip_response;    // Response body is compressed; its size counts the compressed bytes
+         BOOL                 socket_reused;    // Request was sent on a kept connection
+         int                  socket_flags;     // WEBSVC_FLAG_SECURED of the kept connection
+         BOOL                 socket_compressed;// The kept connection decompresses its responses
+         time_t               socket_idle_time; // When the kept connection became idle
+
 }     wst_context, *wst_context_ptr;
 void  wst_context_init  (  wst_context_ptr      this);
 void  wst_context_free  (  wst_context_ptr      this);
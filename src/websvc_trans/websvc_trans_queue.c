@@ -119,6 +119,20 @@ BOOL wstq_dequeue( wst_queue_ptr this, wstq_item_ptr item)
    return TRUE;
 }
 
+static void wstq_remove_at( wst_queue_ptr this, int i)
+{
+   wstq_item_release( this->queue + i);
+   this->size--;
+
+   if (i < this->size) {
+      void* dest     = &(this->queue[i]);
+      void* src      = &(this->queue[i+1]);
+      int   count    =((this->size - i) * sizeof(wstq_item));
+      memmove( dest, src, count);
+      wstq_item_init( this->queue + this->size);
+   }
+}
+
 void wstq_remove_type( wst_queue_ptr this, int type)
 {
    int i;
@@ -140,16 +154,81 @@ void wstq_remove_type( wst_queue_ptr this, int type)
          //TODO: change log level to debug once stable
          roadmap_log( ROADMAP_WARNING, "wstq_remove_type() - removing old item type %d at pos: %d", type, i);
          
-         wstq_item_release( this->queue + i);
-         this->size--;
-         
-         if (i < this->size) {
-            void* dest     = &(this->queue[i]);
-            void* src      = &(this->queue[i+1]);
-            int   count    =((this->size - i) * sizeof(wstq_item));
-            memmove( dest, src, count);
-            wstq_item_init( this->queue + this->size);
-         }
+         wstq_remove_at( this, i);
+         i--;
       }
    }
-}
\ No newline at end of file
+}
+
+// Length of the first line of the packet, including its end of line
+static int wstq_header_length( const char* packet)
+{
+   const char* eol = strchr( packet, '\n');
+
+   if( !eol)
+      return 0;
+
+   return (int)(eol - packet) + 1;
+}
+
+static BOOL wstq_can_coalesce( const wstq_item* head, const wstq_item* item)
+{
+   int header_length = wstq_header_length( head->packet);
+
+   return ((item->flags & WEBSVC_FLAG_COALESCE)                      &&
+           (item->flags          == head->flags)                     &&
+           (item->parsers        == head->parsers)                   &&
+           (item->parsers_count  == head->parsers_count)             &&
+           (item->context        == head->context)                   &&
+           !strcmp( item->action, head->action)                      &&
+           (header_length > 0)                                       &&
+           (header_length == wstq_header_length( item->packet))      &&
+           !strncmp( item->packet, head->packet, header_length)      &&
+           item->packet[header_length]);
+}
+
+int wstq_coalesce( wst_queue_ptr this)
+{
+   wstq_item_ptr  head;
+   int            merged = 0;
+
+   if( !this || !this->size)
+      return 0;
+
+   head = this->queue;
+   if( !(head->flags & WEBSVC_FLAG_COALESCE))
+      return 0;
+
+   while( (1 < this->size) &&
+          (head->coalesced_count < TRANSACTION_MAX_COALESCED-1) &&
+          wstq_can_coalesce( head, this->queue + 1))
+   {
+      wstq_item_ptr  item  = this->queue + 1;
+      const char*    body  = item->packet + wstq_header_length( item->packet);
+      int            size  = strlen( head->packet);
+      BOOL           eol   = ('\n' == head->packet[size-1]);
+      char*          packet;
+
+      // The same header line once, then the commands of both items:
+      packet = realloc( head->packet, size + strlen( body) + 2);
+      if( !packet)
+         break;
+
+      if( !eol)
+         packet[size++] = '\n';
+      strcpy( packet + size, body);
+      head->packet = packet;
+
+      head->coalesced[head->coalesced_count].cbOnCompleted = item->cbOnCompleted;
+      head->coalesced[head->coalesced_count].context       = item->context;
+      head->coalesced_count++;
+
+      wstq_remove_at( this, 1);
+      merged++;
+   }
+
+   if( merged)
+      roadmap_log( ROADMAP_DEBUG, "wstq_coalesce() - merged %d items into '%s' request", merged, head->action);
+
+   return merged;
+}
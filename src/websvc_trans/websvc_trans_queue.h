@@ -22,6 +22,15 @@
 #define	__HTTPTRANSQUEUE_H__
 
 #define  TRANSACTION_QUEUE_SIZE              (20)
+#define  TRANSACTION_MAX_COALESCED           (8)
+
+// Completion of an item which was merged into the packet of another item
+typedef struct tag_wstq_completion
+{
+   CB_OnWSTCompleted cbOnCompleted; // Callback for transaction completion
+   void*             context;       // Caller context
+
+}  wstq_completion;
 
 typedef struct tag_wstq_item
 {
@@ -33,6 +42,8 @@ typedef struct tag_wstq_item
    void*             context;       // Caller context
    char*             packet;        // Custom data for the HTTP request
    int               flags;         // Flags for server type
+   wstq_completion   coalesced[TRANSACTION_MAX_COALESCED-1];
+   int               coalesced_count;
 
 }  wstq_item, *wstq_item_ptr;
 
@@ -58,4 +69,9 @@ BOOL  wstq_enqueue   ( wst_queue_ptr this, wstq_item_ptr item);
 BOOL  wstq_dequeue   ( wst_queue_ptr this, wstq_item_ptr item);
 void wstq_remove_type( wst_queue_ptr this, int type);
 
+// Merge the items following the head into the head item, as long as they
+// have the WEBSVC_FLAG_COALESCE flag and the same action, flags, parsers,
+// context and packet header line. Returns the number of merged items.
+int  wstq_coalesce   ( wst_queue_ptr this);
+
 #endif	//	__HTTPTRANSQUEUE_H__